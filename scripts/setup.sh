@@ -42,6 +42,7 @@ MODULES=(
 "ietf-network-instance@2019-01-21.yang"
 "ietf-subscribed-notifications@2019-09-09.yang -e encode-xml -e replay -e subtree -e xpath"
 "ietf-yang-push@2019-09-09.yang -e on-change"
+"netopeer2-server@2026-10-16.yang"
 )
 
 # functions
@@ -21,6 +21,10 @@
 #include <assert.h>
 #include <ctype.h>
 #include <errno.h>
+#include <grp.h>
+#include <pwd.h>
+#include <stdarg.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
@@ -47,6 +51,9 @@
 #include "netconf_monitoring.h"
 
 struct np2srv np2srv = {.unix_mode = -1, .unix_uid = -1, .unix_gid = -1,
+                        .ps_lock = PTHREAD_MUTEX_INITIALIZER,
+                        .ps_cond = PTHREAD_COND_INITIALIZER,
+                        .worker_lock = PTHREAD_MUTEX_INITIALIZER,
 #ifdef ENABLE_RESTCONF
                         .fcgi_sock_mode = -1,
                         .fcgi_sock_uid = -1,
@@ -124,28 +131,219 @@ np_modtimespec(const struct timespec *ts, uint32_t msec)
     return ret;
 }
 
+/**
+ * @brief Hash table of NETCONF sessions by an ID.
+ */
+struct np_sess_ht {
+    struct np_sess_ht_item {
+        uint32_t id;                    /**< session ID */
+        struct nc_session *session;     /**< NETCONF session */
+        struct np_sess_ht_item *next;   /**< next item in the bucket */
+    } **buckets;
+    uint32_t size;                      /**< number of buckets, power of 2 */
+    uint32_t count;                     /**< number of items */
+};
+
+/**
+ * @brief Index of all the NETCONF sessions by their NC ID and SR ID.
+ */
+static struct {
+    struct np_sess_ht by_nc_id;     /**< sessions by NC ID */
+    struct np_sess_ht by_sr_id;     /**< sessions by SR ID of their user session */
+    pthread_rwlock_t lock;          /**< lock for accessing the index */
+} sess_index = {.lock = PTHREAD_RWLOCK_INITIALIZER};
+
+/**
+ * @brief Get the bucket of a session ID, IDs are sequential so the lowest bits are used.
+ */
+#define NP_SESS_HT_BUCKET(ht, id) ((id) & ((ht)->size - 1))
+
+/**
+ * @brief Insert a session into a hash table. Index lock is expected to be held for writing.
+ *
+ * @param[in] ht Hash table.
+ * @param[in] id Session ID.
+ * @param[in] session NETCONF session.
+ * @return 0 on success, -1 on error.
+ */
+static int
+np_sess_ht_insert(struct np_sess_ht *ht, uint32_t id, struct nc_session *session)
+{
+    struct np_sess_ht_item **buckets, *item, *next;
+    uint32_t i, size;
+
+    if (ht->count >= ht->size) {
+        /* enlarge and rehash */
+        size = ht->size ? ht->size * 2 : 64;
+        buckets = calloc(size, sizeof *buckets);
+        if (!buckets) {
+            EMEM;
+            return -1;
+        }
+        for (i = 0; i < ht->size; ++i) {
+            for (item = ht->buckets[i]; item; item = next) {
+                next = item->next;
+                item->next = buckets[item->id & (size - 1)];
+                buckets[item->id & (size - 1)] = item;
+            }
+        }
+        free(ht->buckets);
+        ht->buckets = buckets;
+        ht->size = size;
+    }
+
+    item = malloc(sizeof *item);
+    if (!item) {
+        EMEM;
+        return -1;
+    }
+    item->id = id;
+    item->session = session;
+    item->next = ht->buckets[NP_SESS_HT_BUCKET(ht, id)];
+    ht->buckets[NP_SESS_HT_BUCKET(ht, id)] = item;
+    ++ht->count;
+
+    return 0;
+}
+
+/**
+ * @brief Remove a session from a hash table. Index lock is expected to be held for writing.
+ *
+ * @param[in] ht Hash table.
+ * @param[in] id Session ID.
+ * @param[in] session NETCONF session.
+ */
+static void
+np_sess_ht_remove(struct np_sess_ht *ht, uint32_t id, const struct nc_session *session)
+{
+    struct np_sess_ht_item **item_p, *item;
+
+    if (!ht->size) {
+        return;
+    }
+
+    for (item_p = &ht->buckets[NP_SESS_HT_BUCKET(ht, id)]; *item_p; item_p = &(*item_p)->next) {
+        if ((*item_p)->session == session) {
+            item = *item_p;
+            *item_p = item->next;
+            free(item);
+            --ht->count;
+            return;
+        }
+    }
+}
+
+/**
+ * @brief Find a session in a hash table. Index lock is expected to be held for reading.
+ *
+ * @param[in] ht Hash table.
+ * @param[in] id Session ID.
+ * @return Found NETCONF session, NULL if not found.
+ */
+static struct nc_session *
+np_sess_ht_find(const struct np_sess_ht *ht, uint32_t id)
+{
+    const struct np_sess_ht_item *item;
+
+    if (!ht->size) {
+        return NULL;
+    }
+
+    for (item = ht->buckets[NP_SESS_HT_BUCKET(ht, id)]; item; item = item->next) {
+        if (item->id == id) {
+            return item->session;
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Free all the items of a hash table.
+ *
+ * @param[in] ht Hash table.
+ */
+static void
+np_sess_ht_clear(struct np_sess_ht *ht)
+{
+    struct np_sess_ht_item *item, *next;
+    uint32_t i;
+
+    for (i = 0; i < ht->size; ++i) {
+        for (item = ht->buckets[i]; item; item = next) {
+            next = item->next;
+            free(item);
+        }
+    }
+    free(ht->buckets);
+    memset(ht, 0, sizeof *ht);
+}
+
+int
+np_sess_index_add(struct nc_session *nc_sess)
+{
+    struct np2_user_sess *user_sess = nc_session_get_data(nc_sess);
+    int rc = 0;
+
+    /* INDEX WRITE LOCK */
+    pthread_rwlock_wrlock(&sess_index.lock);
+
+    if (np_sess_ht_insert(&sess_index.by_nc_id, nc_session_get_id(nc_sess), nc_sess)) {
+        rc = -1;
+    } else if (np_sess_ht_insert(&sess_index.by_sr_id, sr_session_get_id(user_sess->sess), nc_sess)) {
+        np_sess_ht_remove(&sess_index.by_nc_id, nc_session_get_id(nc_sess), nc_sess);
+        rc = -1;
+    }
+
+    /* INDEX UNLOCK */
+    pthread_rwlock_unlock(&sess_index.lock);
+
+    return rc;
+}
+
+void
+np_sess_index_del(struct nc_session *nc_sess)
+{
+    struct np2_user_sess *user_sess = nc_session_get_data(nc_sess);
+
+    /* INDEX WRITE LOCK */
+    pthread_rwlock_wrlock(&sess_index.lock);
+
+    np_sess_ht_remove(&sess_index.by_nc_id, nc_session_get_id(nc_sess), nc_sess);
+    if (user_sess) {
+        np_sess_ht_remove(&sess_index.by_sr_id, sr_session_get_id(user_sess->sess), nc_sess);
+    }
+
+    /* INDEX UNLOCK */
+    pthread_rwlock_unlock(&sess_index.lock);
+}
+
+void
+np_sess_index_destroy(void)
+{
+    np_sess_ht_clear(&sess_index.by_nc_id);
+    np_sess_ht_clear(&sess_index.by_sr_id);
+}
+
 int
 np_get_nc_sess_by_id(uint32_t sr_id, uint32_t nc_id, struct nc_session **nc_sess)
 {
-    uint32_t i;
     struct nc_session *ncs = NULL;
-    struct np2_user_sess *user_sess;
 
     assert((sr_id && !nc_id) || (!sr_id && nc_id));
 
-    for (i = 0; (ncs = nc_ps_get_session(np2srv.nc_ps, i)); ++i) {
-        if (sr_id) {
-            user_sess = nc_session_get_data(ncs);
-            if (sr_session_get_id(user_sess->sess) == sr_id) {
-                break;
-            }
-        } else {
-            if (nc_session_get_id(ncs) == nc_id) {
-                break;
-            }
-        }
+    /* INDEX READ LOCK */
+    pthread_rwlock_rdlock(&sess_index.lock);
+
+    if (sr_id) {
+        ncs = np_sess_ht_find(&sess_index.by_sr_id, sr_id);
+    } else {
+        ncs = np_sess_ht_find(&sess_index.by_nc_id, nc_id);
     }
 
+    /* INDEX UNLOCK */
+    pthread_rwlock_unlock(&sess_index.lock);
+
     if (!ncs) {
         if (nc_id) {
             ERR("Failed to find NETCONF session with NC ID %u.", nc_id);
@@ -224,10 +422,43 @@ np_release_user_sess(struct np2_user_sess *user_sess)
     if (ATOMIC_LOAD_RELAXED(prev_ref_count) == 1) {
         /* is 0 now, free */
         sr_session_stop(user_sess->sess);
+        np_ntf_queue_session_destroy(&user_sess->ntf_queue);
+        free(user_sess->err_msg);
         free(user_sess);
     }
 }
 
+void
+np_set_error_message(sr_session_ctx_t *ev_sess, const char *format, ...)
+{
+    struct nc_session *ncs = NULL;
+    struct np2_user_sess *user_sess = NULL;
+    va_list ap;
+    char *msg;
+
+    va_start(ap, format);
+    if (vasprintf(&msg, format, ap) == -1) {
+        EMEM;
+        va_end(ap);
+        return;
+    }
+    va_end(ap);
+
+    if (NP_IS_ORIG_NP(ev_sess) && !np_get_user_sess(ev_sess, &ncs, &user_sess) && ncs &&
+            (user_sess->sess == ev_sess)) {
+        /* executed directly, there is no event session to set the error in, keep only the first message */
+        if (!user_sess->err_msg) {
+            user_sess->err_msg = msg;
+            msg = NULL;
+        }
+    } else {
+        sr_session_set_error_message(ev_sess, "%s", msg);
+    }
+
+    np_release_user_sess(user_sess);
+    free(msg);
+}
+
 static LY_ERR
 sub_ntf_lysc_has_notif_clb(struct lysc_node *node, void *UNUSED(data), ly_bool *UNUSED(dfs_continue))
 {
@@ -277,9 +508,6 @@ np2srv_new_session_cb(const char *UNUSED(client_name), struct nc_session *new_se
     uint32_t nc_id;
     const char *username;
 
-    /* monitor NETCONF session */
-    ncm_session_add(new_session);
-
     /* start sysrepo session for every NETCONF session (so that it can be used for notification subscriptions and
      * held lock persistence) */
     c = sr_session_start(np2srv.sr_conn, SR_DS_RUNNING, &sr_sess);
@@ -289,13 +517,14 @@ np2srv_new_session_cb(const char *UNUSED(client_name), struct nc_session *new_se
     }
 
     /* create user session with ref-count so that it is not freed while being used */
-    user_sess = malloc(sizeof *user_sess);
+    user_sess = calloc(1, sizeof *user_sess);
     if (!user_sess) {
         EMEM;
         goto error;
     }
     user_sess->sess = sr_sess;
     ATOMIC_STORE_RELAXED(user_sess->ref_count, 1);
+    np_ntf_queue_session_init(&user_sess->ntf_queue, new_session);
     nc_session_set_data(new_session, user_sess);
 
     /* set NC ID and NETCONF username for sysrepo callbacks */
@@ -305,6 +534,14 @@ np2srv_new_session_cb(const char *UNUSED(client_name), struct nc_session *new_se
     username = nc_session_get_username(new_session);
     sr_session_push_orig_data(sr_sess, strlen(username) + 1, username);
 
+    /* make the session findable by its IDs */
+    if (np_sess_index_add(new_session)) {
+        goto error;
+    }
+
+    /* monitor NETCONF session */
+    ncm_session_add(new_session);
+
     c = 0;
     while ((c < 3) && nc_ps_add_session(np2srv.nc_ps, new_session)) {
         /* presumably timeout, give it a shot 2 times */
@@ -315,9 +552,14 @@ np2srv_new_session_cb(const char *UNUSED(client_name), struct nc_session *new_se
     if (c == 3) {
         /* there is some serious problem in synchronization/system planner */
         EINT;
-        goto error;
+        goto error_monitored;
     }
 
+    /* wake up any worker waiting for a session to poll */
+    pthread_mutex_lock(&np2srv.ps_lock);
+    pthread_cond_broadcast(&np2srv.ps_cond);
+    pthread_mutex_unlock(&np2srv.ps_lock);
+
     if ((mod = ly_ctx_get_module_implemented(sr_get_context(np2srv.sr_conn), "ietf-netconf-notifications"))) {
         /* generate ietf-netconf-notification's netconf-session-start event for sysrepo */
         if (nc_session_get_ti(new_session) != NC_TI_UNIX) {
@@ -347,9 +589,14 @@ np2srv_new_session_cb(const char *UNUSED(client_name), struct nc_session *new_se
 
     return 0;
 
-error:
+error_monitored:
     ncm_session_del(new_session);
+    np_sess_index_del(new_session);
+error:
     sr_session_stop(sr_sess);
+    if (user_sess) {
+        np_ntf_queue_session_destroy(&user_sess->ntf_queue);
+    }
     free(user_sess);
     return -1;
 }
@@ -995,225 +1242,1570 @@ filter_xpath_buf_add_r(const struct lyd_node *node, char **buf, int size, struct
     return 0;
 }
 
-int
-op_filter_subtree2xpath(const struct lyd_node *node, struct np2_filter *filter)
-{
-    const struct lyd_node *iter;
-    char *buf = NULL;
-
-    LY_LIST_FOR(node, iter) {
-        if (iter->schema && lyd_get_value(iter) && !strws(lyd_get_value(iter))) {
-            /* special case of top-level content match node */
-            if (filter_xpath_buf_add_top_content(iter, filter)) {
-                goto error;
-            }
-        } else if (iter->schema || !((struct lyd_node_opaq *)iter)->value || strws(((struct lyd_node_opaq *)iter)->value)) {
-            /* containment or selection node */
-            if (filter_xpath_buf_add_r(iter, &buf, 1, filter)) {
-                goto error;
-            }
-        } else {
-            WRN("Skipping unsupported top-level filter node \"%s\".", LYD_NAME(iter));
-        }
-    }
-
-    free(buf);
-    return 0;
-
-error:
-    free(buf);
-    op_filter_erase(filter);
-    return -1;
-}
+/* number of filter cache hash table buckets */
+#define FILTER_CACHE_BUCKETS (NP2SRV_FILTER_CACHE_SIZE * 2)
 
-void
-op_filter_erase(struct np2_filter *filter)
-{
-    uint32_t i;
+/**
+ * @brief Cache of subtree filters transformed into NP2 filters, shared by all the sessions.
+ */
+static struct {
+    struct np2_filter_cache_entry {
+        char *key;          /**< canonical subtree filter */
+        uint32_t hash;      /**< hash of key */
+        struct np2_filter filter;   /**< transformed filter */
+        struct np2_filter_cache_entry *prev;
+        struct np2_filter_cache_entry *next;
+        struct np2_filter_cache_entry *hnext;   /**< next entry in the hash table bucket */
+    } *first, *last;        /**< entries from the most recently used */
+    struct np2_filter_cache_entry *buckets[FILTER_CACHE_BUCKETS];   /**< entries by the hash of their key */
+    uint32_t count;         /**< number of entries */
+    uint64_t hits;          /**< number of filters found in the cache */
+    uint64_t misses;        /**< number of filters not found in the cache */
+    pthread_mutex_t lock;   /**< lock for accessing the cache */
+} filter_cache = {.lock = PTHREAD_MUTEX_INITIALIZER};
 
-    for (i = 0; i < filter->count; ++i) {
-        free(filter->filters[i].str);
-    }
-    free(filter->filters);
-    filter->filters = NULL;
-    filter->count = 0;
-}
+/**
+ * @brief Canonical subtree filter key buffer.
+ */
+struct filter_cache_key {
+    char *buf;
+    size_t len;
+    size_t size;
+};
 
 /**
- * @brief Append string to another string by enlarging it.
+ * @brief Append a string prefixed by its length to a canonical subtree filter key.
  *
- * @param[in] str String to append.
- * @param[in,out] ret String to append to, is enlarged.
+ * @param[in] str String to append, NULL is treated as an empty string.
+ * @param[in,out] key Key to append to.
  * @return 0 on success;
  * @return -1 on error.
  */
 static int
-np_append_str(const char *str, char **ret)
+filter_cache_key_append(const char *str, struct filter_cache_key *key)
 {
-    void *mem;
-    int len;
+    size_t len, needed;
+    char *mem;
 
-    if (!*ret) {
-        *ret = strdup(str);
-        if (!*ret) {
-            EMEM;
-            return -1;
+    len = str ? strlen(str) : 0;
+
+    /* length prefix, string, and terminating zero */
+    needed = key->len + 21 + len + 1;
+    if (needed > key->size) {
+        if (needed < key->size * 2) {
+            needed = key->size * 2;
         }
-    } else {
-        len = strlen(*ret);
-        mem = realloc(*ret, len + strlen(str) + 1);
+        mem = realloc(key->buf, needed);
         if (!mem) {
             EMEM;
             return -1;
         }
-        *ret = mem;
-        strcat(*ret + len, str);
+        key->buf = mem;
+        key->size = needed;
     }
 
+    key->len += sprintf(key->buf + key->len, "%zu:%s", len, str ? str : "");
     return 0;
 }
 
-int
-op_filter_filter2xpath(const struct np2_filter *filter, char **xpath)
+/**
+ * @brief Create canonical key of subtree filter nodes, recursively.
+ *
+ * @param[in] first First subtree filter sibling.
+ * @param[in,out] key Key to append to.
+ * @return 0 on success;
+ * @return -1 on error.
+ */
+static int
+filter_cache_key_r(const struct lyd_node *first, struct filter_cache_key *key)
 {
-    int rc;
-    uint32_t i;
+    const struct lyd_node *node;
+    const struct lyd_meta *meta;
 
-    *xpath = NULL;
-
-    /* all selection filters first */
-    for (i = 0; i < filter->count; ++i) {
-        if (!filter->filters[i].selection && (filter->count > 1)) {
-            ERR("Several top-level content match filters are not supported as they are redundant.");
-            rc = SR_ERR_UNSUPPORTED;
-            goto error;
+    LY_LIST_FOR(first, node) {
+        if (filter_cache_key_append("(", key)) {
+            return -1;
         }
 
-        /* put all selection filters into parentheses */
-        if (!*xpath) {
-            if (np_append_str("(", xpath)) {
-                rc = SR_ERR_NO_MEMORY;
-                goto error;
+        /* node module and name */
+        if (node->schema) {
+            if (filter_cache_key_append(node->schema->module->name, key)) {
+                return -1;
             }
+        } else if (filter_cache_key_append(((struct lyd_node_opaq *)node)->name.module_ns, key)) {
+            return -1;
+        }
+        if (filter_cache_key_append(LYD_NAME(node), key)) {
+            return -1;
+        }
 
-            if (np_append_str(filter->filters[i].str, xpath)) {
-                rc = SR_ERR_NO_MEMORY;
-                goto error;
-            }
-        } else {
-            if (np_append_str(" | ", xpath)) {
-                rc = SR_ERR_NO_MEMORY;
-                goto error;
+        /* metadata, opaque attributes are ignored by the transformation */
+        if (node->schema) {
+            LY_LIST_FOR(node->meta, meta) {
+                if (filter_cache_key_append("@", key) ||
+                        filter_cache_key_append(meta->annotation->module->name, key) ||
+                        filter_cache_key_append(meta->name, key) ||
+                        filter_cache_key_append(lyd_get_meta_value(meta), key)) {
+                    return -1;
+                }
             }
+        }
 
-            if (np_append_str(filter->filters[i].str, xpath)) {
-                rc = SR_ERR_NO_MEMORY;
-                goto error;
+        /* value */
+        if (lyd_get_value(node)) {
+            if (filter_cache_key_append("=", key) || filter_cache_key_append(lyd_get_value(node), key)) {
+                return -1;
             }
         }
-    }
 
-    if (*xpath) {
-        /* finish parentheses */
-        if (np_append_str(")", xpath)) {
-            rc = SR_ERR_NO_MEMORY;
-            goto error;
+        /* children */
+        if (filter_cache_key_r(lyd_child(node), key) || filter_cache_key_append(")", key)) {
+            return -1;
         }
     }
 
-    return SR_ERR_OK;
-
-error:
-    free(*xpath);
-    *xpath = NULL;
-    return rc;
+    return 0;
 }
 
-int
-op_filter_data_get(sr_session_ctx_t *session, uint32_t max_depth, sr_get_oper_options_t get_opts,
-        const struct np2_filter *filter, sr_session_ctx_t *ev_sess, struct lyd_node **data)
+/**
+ * @brief Hash a canonical subtree filter key (Jenkins one-at-a-time hash).
+ *
+ * @param[in] key Key to hash.
+ * @param[in] len Length of @p key.
+ * @return Key hash.
+ */
+static uint32_t
+filter_cache_hash(const char *key, size_t len)
 {
-    const sr_error_info_t *err_info;
-    struct lyd_node *node;
-    uint32_t i;
-    int rc;
+    uint32_t hash = 0;
+    size_t i;
 
-    for (i = 0; i < filter->count; ++i) {
-        /* get the selected data */
-        rc = sr_get_data(session, filter->filters[i].str, max_depth, np2srv.sr_timeout, get_opts, &node);
-        if (rc) {
-            ERR("Getting data \"%s\" from sysrepo failed (%s).", filter->filters[i].str, sr_strerror(rc));
-            sr_session_get_error(session, &err_info);
-            sr_session_set_error_message(ev_sess, err_info->err[0].message);
-            return rc;
+    for (i = 0; i < len; ++i) {
+        hash += key[i];
+        hash += (hash << 10);
+        hash ^= (hash >> 6);
+    }
+    hash += (hash << 3);
+    hash ^= (hash >> 11);
+    hash += (hash << 15);
+
+    return hash;
+}
+
+/**
+ * @brief Duplicate an NP2 filter structure.
+ *
+ * @param[in] src NP2 filter to duplicate.
+ * @param[out] dst Duplicated NP2 filter.
+ * @return 0 on success;
+ * @return -1 on error.
+ */
+static int
+op_filter_dup(const struct np2_filter *src, struct np2_filter *dst)
+{
+    uint32_t i;
+
+    dst->filters = NULL;
+    dst->count = 0;
+    if (!src->count) {
+        return 0;
+    }
+
+    dst->filters = malloc(src->count * sizeof *dst->filters);
+    if (!dst->filters) {
+        EMEM;
+        return -1;
+    }
+
+    for (dst->count = 0; dst->count < src->count; ++dst->count) {
+        i = dst->count;
+        dst->filters[i].str = strdup(src->filters[i].str);
+        if (!dst->filters[i].str) {
+            EMEM;
+            op_filter_erase(dst);
+            return -1;
+        }
+        dst->filters[i].selection = src->filters[i].selection;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Unlink a filter cache entry from the LRU list.
+ *
+ * @param[in] entry Entry to unlink.
+ */
+static void
+filter_cache_unlink(struct np2_filter_cache_entry *entry)
+{
+    if (entry->prev) {
+        entry->prev->next = entry->next;
+    } else {
+        filter_cache.first = entry->next;
+    }
+    if (entry->next) {
+        entry->next->prev = entry->prev;
+    } else {
+        filter_cache.last = entry->prev;
+    }
+    entry->prev = NULL;
+    entry->next = NULL;
+}
+
+/**
+ * @brief Insert a filter cache entry at the beginning of the LRU list.
+ *
+ * @param[in] entry Entry to insert.
+ */
+static void
+filter_cache_insert_first(struct np2_filter_cache_entry *entry)
+{
+    entry->prev = NULL;
+    entry->next = filter_cache.first;
+    if (filter_cache.first) {
+        filter_cache.first->prev = entry;
+    } else {
+        filter_cache.last = entry;
+    }
+    filter_cache.first = entry;
+}
+
+/**
+ * @brief Remove a filter cache entry from its hash table bucket.
+ *
+ * Filter cache lock is expected to be held.
+ *
+ * @param[in] entry Entry to remove.
+ */
+static void
+filter_cache_bucket_del(struct np2_filter_cache_entry *entry)
+{
+    struct np2_filter_cache_entry **iter;
+
+    for (iter = &filter_cache.buckets[entry->hash % FILTER_CACHE_BUCKETS]; *iter != entry; iter = &(*iter)->hnext) {}
+    *iter = entry->hnext;
+    entry->hnext = NULL;
+}
+
+/**
+ * @brief Find a filter cache entry.
+ *
+ * Filter cache lock is expected to be held.
+ *
+ * @param[in] key Canonical subtree filter key.
+ * @param[in] hash Hash of @p key.
+ * @return Found entry, NULL if not found.
+ */
+static struct np2_filter_cache_entry *
+filter_cache_find(const char *key, uint32_t hash)
+{
+    struct np2_filter_cache_entry *entry;
+
+    for (entry = filter_cache.buckets[hash % FILTER_CACHE_BUCKETS]; entry; entry = entry->hnext) {
+        if ((entry->hash == hash) && !strcmp(entry->key, key)) {
+            return entry;
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Get a transformed subtree filter from the cache.
+ *
+ * @param[in] key Canonical subtree filter key.
+ * @param[in] hash Hash of @p key.
+ * @param[out] filter Copy of the cached NP2 filter.
+ * @return 0 if found;
+ * @return 1 if not found;
+ * @return -1 on error.
+ */
+static int
+filter_cache_get(const char *key, uint32_t hash, struct np2_filter *filter)
+{
+    struct np2_filter_cache_entry *entry;
+    int rc = 1;
+
+    /* FILTER CACHE LOCK */
+    pthread_mutex_lock(&filter_cache.lock);
+
+    entry = filter_cache_find(key, hash);
+    if (entry) {
+        /* most recently used */
+        filter_cache_unlink(entry);
+        filter_cache_insert_first(entry);
+
+        rc = op_filter_dup(&entry->filter, filter);
+        ++filter_cache.hits;
+    } else {
+        ++filter_cache.misses;
+    }
+
+    /* FILTER CACHE UNLOCK */
+    pthread_mutex_unlock(&filter_cache.lock);
+
+    return rc;
+}
+
+/**
+ * @brief Free a filter cache entry.
+ *
+ * @param[in] entry Entry to free.
+ */
+static void
+filter_cache_entry_free(struct np2_filter_cache_entry *entry)
+{
+    free(entry->key);
+    op_filter_erase(&entry->filter);
+    free(entry);
+}
+
+/**
+ * @brief Store a transformed subtree filter in the cache, evicting the least recently used filter if full.
+ *
+ * @param[in] key Canonical subtree filter key, is spent.
+ * @param[in] hash Hash of @p key.
+ * @param[in] filter Transformed NP2 filter to store a copy of.
+ */
+static void
+filter_cache_add(char *key, uint32_t hash, const struct np2_filter *filter)
+{
+    struct np2_filter_cache_entry *entry;
+
+    entry = calloc(1, sizeof *entry);
+    if (!entry) {
+        EMEM;
+        free(key);
+        return;
+    }
+    entry->key = key;
+    entry->hash = hash;
+    if (op_filter_dup(filter, &entry->filter)) {
+        filter_cache_entry_free(entry);
+        return;
+    }
+
+    /* FILTER CACHE LOCK */
+    pthread_mutex_lock(&filter_cache.lock);
+
+    if (filter_cache_find(key, hash)) {
+        /* added meanwhile by another thread */
+        /* FILTER CACHE UNLOCK */
+        pthread_mutex_unlock(&filter_cache.lock);
+        filter_cache_entry_free(entry);
+        return;
+    }
+
+    filter_cache_insert_first(entry);
+    entry->hnext = filter_cache.buckets[hash % FILTER_CACHE_BUCKETS];
+    filter_cache.buckets[hash % FILTER_CACHE_BUCKETS] = entry;
+    ++filter_cache.count;
+
+    if (filter_cache.count > NP2SRV_FILTER_CACHE_SIZE) {
+        /* evict the least recently used filter */
+        entry = filter_cache.last;
+        filter_cache_unlink(entry);
+        filter_cache_bucket_del(entry);
+        --filter_cache.count;
+        filter_cache_entry_free(entry);
+    }
+
+    /* FILTER CACHE UNLOCK */
+    pthread_mutex_unlock(&filter_cache.lock);
+}
+
+void
+op_filter_cache_stats(uint32_t *entries, uint64_t *hits, uint64_t *misses)
+{
+    /* FILTER CACHE LOCK */
+    pthread_mutex_lock(&filter_cache.lock);
+
+    *entries = filter_cache.count;
+    *hits = filter_cache.hits;
+    *misses = filter_cache.misses;
+
+    /* FILTER CACHE UNLOCK */
+    pthread_mutex_unlock(&filter_cache.lock);
+}
+
+void
+op_filter_cache_clear(void)
+{
+    struct np2_filter_cache_entry *entry;
+
+    /* FILTER CACHE LOCK */
+    pthread_mutex_lock(&filter_cache.lock);
+
+    while ((entry = filter_cache.first)) {
+        filter_cache_unlink(entry);
+        filter_cache_entry_free(entry);
+    }
+    memset(filter_cache.buckets, 0, sizeof filter_cache.buckets);
+    filter_cache.count = 0;
+
+    /* FILTER CACHE UNLOCK */
+    pthread_mutex_unlock(&filter_cache.lock);
+}
+
+int
+op_filter_subtree2xpath(const struct lyd_node *node, struct np2_filter *filter)
+{
+    const struct lyd_node *iter;
+    struct filter_cache_key key = {0};
+    uint32_t hash = 0;
+    char *buf = NULL;
+    int r;
+
+    assert(!filter->count);
+
+    /* try to find the filter in the cache first */
+    if (filter_cache_key_r(node, &key) || !key.buf) {
+        free(key.buf);
+        key.buf = NULL;
+    } else {
+        hash = filter_cache_hash(key.buf, key.len);
+        r = filter_cache_get(key.buf, hash, filter);
+        if (r < 1) {
+            free(key.buf);
+            return r;
+        }
+    }
+
+    LY_LIST_FOR(node, iter) {
+        if (iter->schema && lyd_get_value(iter) && !strws(lyd_get_value(iter))) {
+            /* special case of top-level content match node */
+            if (filter_xpath_buf_add_top_content(iter, filter)) {
+                goto error;
+            }
+        } else if (iter->schema || !((struct lyd_node_opaq *)iter)->value || strws(((struct lyd_node_opaq *)iter)->value)) {
+            /* containment or selection node */
+            if (filter_xpath_buf_add_r(iter, &buf, 1, filter)) {
+                goto error;
+            }
+        } else {
+            WRN("Skipping unsupported top-level filter node \"%s\".", LYD_NAME(iter));
+        }
+    }
+
+    free(buf);
+
+    if (key.buf) {
+        /* store the transformed filter */
+        filter_cache_add(key.buf, hash, filter);
+    }
+    return 0;
+
+error:
+    free(buf);
+    free(key.buf);
+    op_filter_erase(filter);
+    return -1;
+}
+
+void
+op_filter_erase(struct np2_filter *filter)
+{
+    uint32_t i;
+
+    for (i = 0; i < filter->count; ++i) {
+        free(filter->filters[i].str);
+    }
+    free(filter->filters);
+    filter->filters = NULL;
+    filter->count = 0;
+}
+
+/**
+ * @brief Append string to another string by enlarging it.
+ *
+ * @param[in] str String to append.
+ * @param[in,out] ret String to append to, is enlarged.
+ * @return 0 on success;
+ * @return -1 on error.
+ */
+static int
+np_append_str(const char *str, char **ret)
+{
+    void *mem;
+    int len;
+
+    if (!*ret) {
+        *ret = strdup(str);
+        if (!*ret) {
+            EMEM;
+            return -1;
+        }
+    } else {
+        len = strlen(*ret);
+        mem = realloc(*ret, len + strlen(str) + 1);
+        if (!mem) {
+            EMEM;
+            return -1;
+        }
+        *ret = mem;
+        strcat(*ret + len, str);
+    }
+
+    return 0;
+}
+
+int
+op_filter_filter2xpath(const struct np2_filter *filter, char **xpath)
+{
+    int rc;
+    uint32_t i;
+
+    *xpath = NULL;
+
+    /* all selection filters first */
+    for (i = 0; i < filter->count; ++i) {
+        if (!filter->filters[i].selection && (filter->count > 1)) {
+            ERR("Several top-level content match filters are not supported as they are redundant.");
+            rc = SR_ERR_UNSUPPORTED;
+            goto error;
+        }
+
+        /* put all selection filters into parentheses */
+        if (!*xpath) {
+            if (np_append_str("(", xpath)) {
+                rc = SR_ERR_NO_MEMORY;
+                goto error;
+            }
+
+            if (np_append_str(filter->filters[i].str, xpath)) {
+                rc = SR_ERR_NO_MEMORY;
+                goto error;
+            }
+        } else {
+            if (np_append_str(" | ", xpath)) {
+                rc = SR_ERR_NO_MEMORY;
+                goto error;
+            }
+
+            if (np_append_str(filter->filters[i].str, xpath)) {
+                rc = SR_ERR_NO_MEMORY;
+                goto error;
+            }
+        }
+    }
+
+    if (*xpath) {
+        /* finish parentheses */
+        if (np_append_str(")", xpath)) {
+            rc = SR_ERR_NO_MEMORY;
+            goto error;
+        }
+    }
+
+    return SR_ERR_OK;
+
+error:
+    free(*xpath);
+    *xpath = NULL;
+    return rc;
+}
+
+/**
+ * @brief Create a single XPath selecting the union of all the filters in an NP2 filter structure.
+ *
+ * @param[in] filter NP2 filter structure.
+ * @param[in] with_selection Whether to include even selection filters.
+ * @param[out] xpath Union XPath, NULL if there are no filters to include.
+ * @return SR error value.
+ */
+static int
+op_filter_union_xpath(const struct np2_filter *filter, int with_selection, char **xpath)
+{
+    uint32_t i;
+    size_t len = 0, l;
+
+    *xpath = NULL;
+
+    for (i = 0; i < filter->count; ++i) {
+        if (!with_selection && filter->filters[i].selection) {
+            continue;
+        }
+        len += (len ? 3 : 0) + strlen(filter->filters[i].str);
+    }
+    if (!len) {
+        return SR_ERR_OK;
+    }
+
+    *xpath = malloc(len + 1);
+    if (!*xpath) {
+        EMEM;
+        return SR_ERR_NO_MEMORY;
+    }
+
+    len = 0;
+    for (i = 0; i < filter->count; ++i) {
+        if (!with_selection && filter->filters[i].selection) {
+            continue;
+        }
+        if (len) {
+            memcpy(*xpath + len, " | ", 3);
+            len += 3;
+        }
+        l = strlen(filter->filters[i].str);
+        memcpy(*xpath + len, filter->filters[i].str, l);
+        len += l;
+    }
+    (*xpath)[len] = '\0';
+
+    return SR_ERR_OK;
+}
+
+int
+np2srv_get_first_ns(const char *expr, const char **start, int *len)
+{
+    int i;
+
+    if (expr[0] != '/') {
+        return -1;
+    }
+    if (expr[1] == '/') {
+        expr += 2;
+    } else {
+        ++expr;
+    }
+
+    if (!isalpha(expr[0]) && (expr[0] != '_')) {
+        return -1;
+    }
+    for (i = 1; expr[i] && (isalnum(expr[i]) || (expr[i] == '_') || (expr[i] == '-') || (expr[i] == '.')); ++i) {}
+    if (expr[i] != ':') {
+        return -1;
+    }
+
+    *start = expr;
+    *len = i;
+    return 0;
+}
+
+/**
+ * @brief Data fetch batch, all the jobs of a single data retrieval.
+ */
+struct np_fetch_batch {
+    sr_datastore_t ds;          /**< datastore to get the data from */
+    uint32_t max_depth;         /**< max depth of the retrieved data */
+    sr_get_oper_options_t get_opts;    /**< SR get options */
+    const char *orig_name;      /**< originator name of the requesting session */
+    const void **orig_data;     /**< originator data of the requesting session */
+    uint32_t *orig_size;        /**< sizes of originator data */
+    uint32_t orig_count;        /**< number of originator data */
+    uint32_t pending;           /**< number of jobs not finished yet */
+};
+
+/**
+ * @brief Data fetch job, retrieval of the data of a single module.
+ */
+struct np_fetch_job {
+    char *xpath;                /**< XPath selecting the data */
+    struct np_fetch_batch *batch;   /**< batch of the job */
+    struct lyd_node *data;      /**< retrieved data */
+    int rc;                     /**< SR error value */
+    char *err_msg;              /**< error message, if any */
+    struct np_fetch_job *next;  /**< next job in the queue */
+};
+
+/**
+ * @brief Pool of threads retrieving data of different modules concurrently.
+ */
+static struct {
+    pthread_t threads[NP2SRV_FETCH_THREAD_COUNT];   /**< fetch threads */
+    uint32_t thread_count;      /**< number of running fetch threads */
+    struct np_fetch_job *first; /**< first queued job */
+    struct np_fetch_job *last;  /**< last queued job */
+    int stop;                   /**< whether the fetch threads should terminate */
+    pthread_mutex_t lock;       /**< lock for accessing the queue and batches */
+    pthread_cond_t cond;        /**< condition signalled when a job is queued */
+    pthread_cond_t done_cond;   /**< condition signalled when a batch is finished */
+} fetch_pool = {.lock = PTHREAD_MUTEX_INITIALIZER, .cond = PTHREAD_COND_INITIALIZER,
+                .done_cond = PTHREAD_COND_INITIALIZER};
+
+/**
+ * @brief Execute a data fetch job.
+ *
+ * @param[in] job Job to execute.
+ * @param[in] session SR session to use.
+ * @param[in] own Whether @p session is the requesting session, otherwise it is prepared first and cleared afterwards.
+ */
+static void
+np_fetch_job_exec(struct np_fetch_job *job, sr_session_ctx_t *session, int own)
+{
+    const struct np_fetch_batch *batch = job->batch;
+    const sr_error_info_t *err_info;
+    uint32_t i;
+
+    if (!own) {
+        /* act as the requesting session, in case the operational callbacks care */
+        sr_session_switch_ds(session, batch->ds);
+        sr_session_set_orig_name(session, batch->orig_name);
+        for (i = 0; i < batch->orig_count; ++i) {
+            sr_session_push_orig_data(session, batch->orig_size[i], batch->orig_data[i]);
+        }
+    }
+
+    job->rc = sr_get_data(session, job->xpath, batch->max_depth, np2srv.sr_timeout, batch->get_opts, &job->data);
+    if (job->rc) {
+        ERR("Getting data \"%s\" from sysrepo failed (%s).", job->xpath, sr_strerror(job->rc));
+        sr_session_get_error(session, &err_info);
+        if (err_info && err_info->err_count) {
+            job->err_msg = strdup(err_info->err[0].message);
+        }
+    }
+
+    if (!own) {
+        /* the session is reused by the following jobs, remove the originator data of this request */
+        sr_session_del_orig_data(session);
+    }
+}
+
+/**
+ * @brief Mark a data fetch job finished.
+ *
+ * Fetch pool lock is expected to be held.
+ *
+ * @param[in] job Finished job.
+ */
+static void
+np_fetch_job_done(struct np_fetch_job *job)
+{
+    if (!--job->batch->pending) {
+        pthread_cond_broadcast(&fetch_pool.done_cond);
+    }
+}
+
+/**
+ * @brief Fetch thread executing queued data fetch jobs.
+ *
+ * @param[in] arg Unused.
+ * @return NULL.
+ */
+static void *
+np_fetch_thread(void *UNUSED(arg))
+{
+    sr_session_ctx_t *session;
+    struct np_fetch_job *job;
+    int rc;
+
+    rc = sr_session_start(np2srv.sr_conn, SR_DS_RUNNING, &session);
+    if (rc) {
+        ERR("Creating sysrepo session failed (%s).", sr_strerror(rc));
+        return NULL;
+    }
+
+    /* FETCH LOCK */
+    pthread_mutex_lock(&fetch_pool.lock);
+
+    while (1) {
+        while (!fetch_pool.first && !fetch_pool.stop) {
+            pthread_cond_wait(&fetch_pool.cond, &fetch_pool.lock);
+        }
+        if (!fetch_pool.first) {
+            break;
+        }
+
+        /* dequeue a job */
+        job = fetch_pool.first;
+        fetch_pool.first = job->next;
+        if (!fetch_pool.first) {
+            fetch_pool.last = NULL;
+        }
+        job->next = NULL;
+
+        /* FETCH UNLOCK */
+        pthread_mutex_unlock(&fetch_pool.lock);
+
+        np_fetch_job_exec(job, session, 0);
+
+        /* FETCH LOCK */
+        pthread_mutex_lock(&fetch_pool.lock);
+
+        np_fetch_job_done(job);
+    }
+
+    /* FETCH UNLOCK */
+    pthread_mutex_unlock(&fetch_pool.lock);
+
+    sr_session_stop(session);
+    return NULL;
+}
+
+int
+np_fetch_pool_init(void)
+{
+    int r;
+
+    for (fetch_pool.thread_count = 0; fetch_pool.thread_count < NP2SRV_FETCH_THREAD_COUNT; ++fetch_pool.thread_count) {
+        if ((r = pthread_create(&fetch_pool.threads[fetch_pool.thread_count], NULL, np_fetch_thread, NULL))) {
+            ERR("Creating a fetch thread failed (%s).", strerror(r));
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+void
+np_fetch_pool_destroy(void)
+{
+    uint32_t i;
+
+    /* FETCH LOCK */
+    pthread_mutex_lock(&fetch_pool.lock);
+
+    fetch_pool.stop = 1;
+    pthread_cond_broadcast(&fetch_pool.cond);
+
+    /* FETCH UNLOCK */
+    pthread_mutex_unlock(&fetch_pool.lock);
+
+    for (i = 0; i < fetch_pool.thread_count; ++i) {
+        pthread_join(fetch_pool.threads[i], NULL);
+    }
+    fetch_pool.thread_count = 0;
+}
+
+/**
+ * @brief Split an NP2 filter into filters of separate modules.
+ *
+ * Filters with no simple module prefix are all added into one more filter. Filter strings are not duplicated.
+ *
+ * @param[in] filter NP2 filter to split.
+ * @param[out] mod_filters Array of NP2 filters of single modules.
+ * @param[out] mod_count Count of @p mod_filters.
+ * @return SR error value.
+ */
+static int
+op_filter_split_modules(const struct np2_filter *filter, struct np2_filter **mod_filters, uint32_t *mod_count)
+{
+    const char *start, *mstart;
+    int len, mlen;
+    uint32_t i, j;
+    void *mem;
+
+    *mod_filters = calloc(filter->count, sizeof **mod_filters);
+    if (!*mod_filters) {
+        EMEM;
+        return SR_ERR_NO_MEMORY;
+    }
+    *mod_count = 0;
+
+    for (i = 0; i < filter->count; ++i) {
+        if (np2srv_get_first_ns(filter->filters[i].str, &start, &len)) {
+            start = NULL;
+            len = 0;
+        }
+
+        /* find the filter of the module */
+        for (j = 0; j < *mod_count; ++j) {
+            if (np2srv_get_first_ns((*mod_filters)[j].filters[0].str, &mstart, &mlen)) {
+                mstart = NULL;
+                mlen = 0;
+            }
+            if ((len == mlen) && (!len || !strncmp(start, mstart, len))) {
+                break;
+            }
+        }
+        if (j == *mod_count) {
+            ++(*mod_count);
+        }
+
+        mem = realloc((*mod_filters)[j].filters, ((*mod_filters)[j].count + 1) * sizeof *(*mod_filters)[j].filters);
+        if (!mem) {
+            EMEM;
+            return SR_ERR_NO_MEMORY;
+        }
+        (*mod_filters)[j].filters = mem;
+        (*mod_filters)[j].filters[(*mod_filters)[j].count] = filter->filters[i];
+        ++(*mod_filters)[j].count;
+    }
+
+    return SR_ERR_OK;
+}
+
+int
+op_filter_data_get(sr_session_ctx_t *session, uint32_t max_depth, sr_get_oper_options_t get_opts,
+        const struct np2_filter *filter, sr_session_ctx_t *ev_sess, struct lyd_node **data)
+{
+    struct np2_filter *mod_filters = NULL;
+    struct np_fetch_batch batch = {0};
+    struct np_fetch_job *jobs = NULL, *job, *prev;
+    uint32_t i, mod_count = 0;
+    const void *odata;
+    uint32_t osize;
+    void *mem;
+    int rc = SR_ERR_OK;
+
+    if (!filter->count) {
+        /* nothing to get */
+        return SR_ERR_OK;
+    }
+
+    /* the filters of every module are retrieved at once so that the data are not merged, different modules
+     * are retrieved concurrently because their operational data are usually provided by different daemons */
+    if ((rc = op_filter_split_modules(filter, &mod_filters, &mod_count))) {
+        goto cleanup;
+    }
+    if (!mod_count) {
+        /* nothing to get */
+        goto cleanup;
+    }
+
+    jobs = calloc(mod_count, sizeof *jobs);
+    if (!jobs) {
+        EMEM;
+        rc = SR_ERR_NO_MEMORY;
+        goto cleanup;
+    }
+    for (i = 0; i < mod_count; ++i) {
+        if ((rc = op_filter_union_xpath(&mod_filters[i], 1, &jobs[i].xpath))) {
+            goto cleanup;
+        }
+        jobs[i].batch = &batch;
+    }
+
+    /* prepare the batch */
+    batch.ds = sr_session_get_ds(session);
+    batch.max_depth = max_depth;
+    batch.get_opts = get_opts;
+    batch.orig_name = sr_session_get_orig_name(session);
+    while (!sr_session_get_orig_data(session, batch.orig_count, &osize, &odata)) {
+        mem = realloc(batch.orig_data, (batch.orig_count + 1) * sizeof *batch.orig_data);
+        if (!mem) {
+            EMEM;
+            rc = SR_ERR_NO_MEMORY;
+            goto cleanup;
+        }
+        batch.orig_data = mem;
+        mem = realloc(batch.orig_size, (batch.orig_count + 1) * sizeof *batch.orig_size);
+        if (!mem) {
+            EMEM;
+            rc = SR_ERR_NO_MEMORY;
+            goto cleanup;
         }
+        batch.orig_size = mem;
+
+        batch.orig_data[batch.orig_count] = odata;
+        batch.orig_size[batch.orig_count] = osize;
+        ++batch.orig_count;
+    }
+    batch.pending = mod_count;
+
+    /* FETCH LOCK */
+    pthread_mutex_lock(&fetch_pool.lock);
 
-        /* merge */
-        if (lyd_merge_siblings(data, node, LYD_MERGE_DESTRUCT)) {
-            lyd_free_siblings(node);
-            return SR_ERR_LY;
+    if (fetch_pool.thread_count && (mod_count > 1) && batch.orig_name) {
+        /* queue all the jobs except the first one for the fetch threads */
+        for (i = 1; i < mod_count; ++i) {
+            if (fetch_pool.last) {
+                fetch_pool.last->next = &jobs[i];
+            } else {
+                fetch_pool.first = &jobs[i];
+            }
+            fetch_pool.last = &jobs[i];
         }
+        pthread_cond_broadcast(&fetch_pool.cond);
     }
 
-    return SR_ERR_OK;
+    /* FETCH UNLOCK */
+    pthread_mutex_unlock(&fetch_pool.lock);
+
+    /* execute the first job on the session itself */
+    np_fetch_job_exec(&jobs[0], session, 1);
+
+    /* FETCH LOCK */
+    pthread_mutex_lock(&fetch_pool.lock);
+
+    np_fetch_job_done(&jobs[0]);
+
+    /* execute any jobs of this batch not yet picked up by the fetch threads ourselves */
+    while (batch.pending) {
+        for (prev = NULL, job = fetch_pool.first; job && (job->batch != &batch); prev = job, job = job->next) {}
+        if (!job) {
+            /* all the remaining jobs are being executed */
+            pthread_cond_wait(&fetch_pool.done_cond, &fetch_pool.lock);
+            continue;
+        }
+
+        /* dequeue the job */
+        if (prev) {
+            prev->next = job->next;
+        } else {
+            fetch_pool.first = job->next;
+        }
+        if (fetch_pool.last == job) {
+            fetch_pool.last = prev;
+        }
+        job->next = NULL;
+
+        /* FETCH UNLOCK */
+        pthread_mutex_unlock(&fetch_pool.lock);
+
+        np_fetch_job_exec(job, session, 1);
+
+        /* FETCH LOCK */
+        pthread_mutex_lock(&fetch_pool.lock);
+
+        np_fetch_job_done(job);
+    }
+
+    /* FETCH UNLOCK */
+    pthread_mutex_unlock(&fetch_pool.lock);
+
+    /* merge the results */
+    for (i = 0; i < mod_count; ++i) {
+        if (jobs[i].rc) {
+            if (!rc) {
+                rc = jobs[i].rc;
+                if (jobs[i].err_msg) {
+                    /* the job may have been executed on a fetch thread session */
+                    np_set_error_message(ev_sess, "%s", jobs[i].err_msg);
+                }
+            }
+            continue;
+        }
+        if (!jobs[i].data) {
+            continue;
+        }
+
+        if (!*data) {
+            *data = jobs[i].data;
+        } else if (lyd_merge_siblings(data, jobs[i].data, LYD_MERGE_DESTRUCT)) {
+            rc = SR_ERR_LY;
+            continue;
+        }
+        jobs[i].data = NULL;
+    }
+
+cleanup:
+    for (i = 0; jobs && (i < mod_count); ++i) {
+        free(jobs[i].xpath);
+        free(jobs[i].err_msg);
+        lyd_free_siblings(jobs[i].data);
+    }
+    free(jobs);
+    for (i = 0; i < mod_count; ++i) {
+        free(mod_filters[i].filters);
+    }
+    free(mod_filters);
+    free(batch.orig_data);
+    free(batch.orig_size);
+    return rc;
+}
+
+/**
+ * @brief Compare callback for sorting and searching node pointers.
+ */
+static int
+op_filter_ptr_cmp_cb(const void *ptr1, const void *ptr2)
+{
+    uintptr_t p1 = (uintptr_t)*(void **)ptr1, p2 = (uintptr_t)*(void **)ptr2;
+
+    if (p1 < p2) {
+        return -1;
+    } else if (p1 > p2) {
+        return 1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Free all the siblings that are neither selected nor have any selected descendants, recursively.
+ *
+ * Selected nodes are kept with all their descendants, keys of kept lists are never freed.
+ *
+ * @param[in,out] first First sibling to filter.
+ * @param[in] sel Sorted array of the selected nodes.
+ * @param[in] sel_count Count of @p sel.
+ * @return Whether any of the siblings was kept.
+ */
+static int
+op_filter_data_prune_r(struct lyd_node **first, struct lyd_node **sel, uint32_t sel_count)
+{
+    struct lyd_node *next, *elem, *child;
+    int kept = 0;
+
+    LY_LIST_FOR_SAFE(*first, next, elem) {
+        if (bsearch(&elem, sel, sel_count, sizeof *sel, op_filter_ptr_cmp_cb)) {
+            /* selected, keep the whole subtree */
+            kept = 1;
+            continue;
+        }
+
+        if (lysc_is_key(elem->schema)) {
+            /* keys are kept together with their list */
+            continue;
+        }
+
+        child = lyd_child(elem);
+        if (child && op_filter_data_prune_r(&child, sel, sel_count)) {
+            /* some descendants selected, keep the node */
+            kept = 1;
+            continue;
+        }
+
+        /* not selected, free the subtree */
+        if ((elem == *first) && !(*first)->parent) {
+            *first = (*first)->next;
+        }
+        lyd_free_tree(elem);
+    }
+
+    return kept;
 }
 
 int
 op_filter_data_filter(struct lyd_node **data, const struct np2_filter *filter, int with_selection,
         struct lyd_node **filtered_data)
 {
-    struct lyd_node *node;
-    int has_filter = 0, rc = SR_ERR_OK;
     struct ly_set *set = NULL;
-    uint32_t i, j;
+    char *xpath = NULL;
+    int rc = SR_ERR_OK;
 
     if (!*data) {
         /* nothing to filter */
         return SR_ERR_OK;
     }
 
-    for (i = 0; i < filter->count; i++) {
-        if (!with_selection && filter->filters[i].selection) {
-            continue;
-        }
-        has_filter = 1;
+    /* evaluate all the filters at once */
+    if ((rc = op_filter_union_xpath(filter, with_selection, &xpath))) {
+        goto cleanup;
+    }
 
-        /* apply content (or even selection) filter */
-        if (lyd_find_xpath(*data, filter->filters[i].str, &set)) {
+    if (xpath) {
+        if (lyd_find_xpath(*data, xpath, &set)) {
             rc = SR_ERR_LY;
             goto cleanup;
         }
+        if (!set->count) {
+            /* nothing selected */
+            goto cleanup;
+        }
 
-        for (j = 0; j < set->count; ++j) {
-            if (lyd_dup_single(set->dnodes[j], NULL, LYD_DUP_RECURSIVE | LYD_DUP_WITH_PARENTS | LYD_DUP_WITH_FLAGS, &node)) {
-                rc = SR_ERR_LY;
-                goto cleanup;
-            }
+        /* free all the data not selected in place, in a single pass */
+        qsort(set->dnodes, set->count, sizeof *set->dnodes, op_filter_ptr_cmp_cb);
+        op_filter_data_prune_r(data, set->dnodes, set->count);
+    } /* else no filter, just use all the data */
 
-            /* always find parent */
-            while (node->parent) {
-                node = lyd_parent(node);
-            }
+    *filtered_data = *data;
+    *data = NULL;
+
+cleanup:
+    ly_set_free(set, NULL);
+    free(xpath);
+    return rc;
+}
+
+/**
+ * @brief Cache of system user and group information, shared by all the sessions.
+ */
+static struct {
+    struct np_user_cache_entry {
+        char *name;         /**< user name */
+        int found;          /**< whether the user exists */
+        uid_t uid;          /**< user UID */
+        gid_t gid;          /**< user GID */
+        char *home;         /**< user home directory */
+        char **groups;      /**< names of all the groups of the user, if loaded */
+        uint32_t group_count;   /**< number of groups */
+        int groups_loaded;  /**< whether groups were loaded */
+        time_t created;     /**< time the entry was loaded */
+    } *entries;             /**< entries from the oldest */
+    uint32_t count;         /**< number of entries */
+    uint64_t hits;          /**< number of lookups found in the cache */
+    uint64_t misses;        /**< number of lookups not found in the cache */
+    pthread_mutex_t lock;   /**< lock for accessing the cache */
+} user_cache = {.lock = PTHREAD_MUTEX_INITIALIZER};
+
+/**
+ * @brief Erase a user cache entry.
+ *
+ * @param[in] entry Entry to erase.
+ */
+static void
+user_cache_entry_erase(struct np_user_cache_entry *entry)
+{
+    uint32_t i;
+
+    for (i = 0; i < entry->group_count; ++i) {
+        free(entry->groups[i]);
+    }
+    free(entry->groups);
+    free(entry->home);
+    free(entry->name);
+    memset(entry, 0, sizeof *entry);
+}
+
+/**
+ * @brief Load the information about a user from the system.
+ *
+ * @param[in] user User name.
+ * @param[in] with_groups Whether to load all the groups of the user as well.
+ * @param[out] entry Entry to fill.
+ * @return 0 on success;
+ * @return -1 on error.
+ */
+static int
+user_cache_entry_load(const char *user, int with_groups, struct np_user_cache_entry *entry)
+{
+    struct passwd pwd, *pwd_p;
+    struct group grp, *grp_p;
+    char *buf = NULL, *mem;
+    gid_t *gids = NULL;
+    ssize_t buflen;
+    int gid_count = 0, ret, rc = -1;
+    uint32_t i;
+    void *m;
+
+    memset(entry, 0, sizeof *entry);
+    entry->name = strdup(user);
+    if (!entry->name) {
+        EMEM;
+        goto cleanup;
+    }
+    entry->created = time(NULL);
+
+    /* passwd entry */
+    buflen = sysconf(_SC_GETPW_R_SIZE_MAX);
+    if (buflen == -1) {
+        buflen = 2048;
+    }
+    buf = malloc(buflen);
+    if (!buf) {
+        EMEM;
+        goto cleanup;
+    }
+    ret = getpwnam_r(user, &pwd, buf, buflen, &pwd_p);
+    if (ret) {
+        ERR("Getting user \"%s\" pwd entry failed (%s).", user, strerror(ret));
+        goto cleanup;
+    } else if (!pwd_p) {
+        /* no user, no groups */
+        entry->groups_loaded = 1;
+        rc = 0;
+        goto cleanup;
+    }
+    entry->found = 1;
+    entry->uid = pwd.pw_uid;
+    entry->gid = pwd.pw_gid;
+    entry->home = strdup(pwd.pw_dir);
+    if (!entry->home) {
+        EMEM;
+        goto cleanup;
+    }
+
+    if (!with_groups) {
+        rc = 0;
+        goto cleanup;
+    }
+
+    /* get all GIDs */
+    getgrouplist(user, entry->gid, gids, &gid_count);
+    gids = malloc(gid_count * sizeof *gids);
+    if (!gids) {
+        EMEM;
+        goto cleanup;
+    }
+    ret = getgrouplist(user, entry->gid, gids, &gid_count);
+    if (ret == -1) {
+        ERR("Getting system groups of user \"%s\" failed.", user);
+        goto cleanup;
+    }
+
+    /* learn all GIDs group names */
+    buflen = sysconf(_SC_GETGR_R_SIZE_MAX);
+    if (buflen == -1) {
+        buflen = 2048;
+    }
+    mem = realloc(buf, buflen);
+    if (!mem) {
+        EMEM;
+        goto cleanup;
+    }
+    buf = mem;
+    for (i = 0; i < (unsigned)gid_count; ++i) {
+        ret = getgrgid_r(gids[i], &grp, buf, buflen, &grp_p);
+        if (ret) {
+            ERR("Getting GID grp entry failed (%s).", strerror(ret));
+            goto cleanup;
+        } else if (!grp_p) {
+            ERR("Getting GID grp entry failed (Group not found).");
+            goto cleanup;
+        }
+
+        m = realloc(entry->groups, (entry->group_count + 1) * sizeof *entry->groups);
+        if (!m) {
+            EMEM;
+            goto cleanup;
+        }
+        entry->groups = m;
+        entry->groups[entry->group_count] = strdup(grp.gr_name);
+        if (!entry->groups[entry->group_count]) {
+            EMEM;
+            goto cleanup;
+        }
+        ++entry->group_count;
+    }
+    entry->groups_loaded = 1;
+
+    /* success */
+    rc = 0;
+
+cleanup:
+    free(gids);
+    free(buf);
+    if (rc) {
+        user_cache_entry_erase(entry);
+    }
+    return rc;
+}
+
+/**
+ * @brief Find a valid user cache entry, remove it if expired. User cache lock is expected to be held.
+ *
+ * @param[in] user User name.
+ * @return Found entry, NULL if not cached.
+ */
+static struct np_user_cache_entry *
+user_cache_find(const char *user)
+{
+    uint32_t i;
+
+    for (i = 0; i < user_cache.count; ++i) {
+        if (strcmp(user_cache.entries[i].name, user)) {
+            continue;
+        }
+
+        if (time(NULL) > user_cache.entries[i].created + NP2SRV_USER_CACHE_TIMEOUT) {
+            /* expired */
+            user_cache_entry_erase(&user_cache.entries[i]);
+            --user_cache.count;
+            memmove(&user_cache.entries[i], &user_cache.entries[i + 1], (user_cache.count - i) * sizeof *user_cache.entries);
+            return NULL;
+        }
+        return &user_cache.entries[i];
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Store a loaded entry into the user cache, replacing any previous entry of the user.
+ * User cache lock is expected to be held.
+ *
+ * @param[in] entry Loaded entry to store, is spent.
+ */
+static void
+user_cache_store(struct np_user_cache_entry *entry)
+{
+    struct np_user_cache_entry *cur;
+    void *mem;
+
+    if ((cur = user_cache_find(entry->name))) {
+        if (cur->groups_loaded && !entry->groups_loaded) {
+            /* loaded with groups by another thread in the meantime */
+            user_cache_entry_erase(entry);
+            return;
+        }
+
+        /* loaded by another thread in the meantime or with groups now */
+        user_cache_entry_erase(cur);
+        *cur = *entry;
+        return;
+    }
+
+    if (user_cache.count == NP2SRV_USER_CACHE_SIZE) {
+        /* evict the oldest entry */
+        user_cache_entry_erase(&user_cache.entries[0]);
+        --user_cache.count;
+        memmove(&user_cache.entries[0], &user_cache.entries[1], user_cache.count * sizeof *user_cache.entries);
+    } else {
+        mem = realloc(user_cache.entries, (user_cache.count + 1) * sizeof *user_cache.entries);
+        if (!mem) {
+            /* just do not cache it */
+            user_cache_entry_erase(entry);
+            return;
+        }
+        user_cache.entries = mem;
+    }
+
+    user_cache.entries[user_cache.count] = *entry;
+    ++user_cache.count;
+}
+
+/**
+ * @brief Copy the requested information from a user cache entry.
+ *
+ * @param[in] entry Entry to copy from.
+ * @param[out] uid Optional user UID.
+ * @param[out] gid Optional user GID.
+ * @param[out] home Optional user home directory.
+ * @param[out] groups Optional names of all the groups of the user.
+ * @param[out] group_count Number of @p groups.
+ * @return 0 on success;
+ * @return 1 if the user does not exist;
+ * @return -1 on error.
+ */
+static int
+user_cache_entry_copy(const struct np_user_cache_entry *entry, uid_t *uid, gid_t *gid, char **home, char ***groups,
+        uint32_t *group_count)
+{
+    uint32_t i;
+
+    if (!entry->found) {
+        return 1;
+    }
 
-            /* merge */
-            if (lyd_merge_tree(filtered_data, node, LYD_MERGE_DESTRUCT)) {
-                lyd_free_tree(node);
-                rc = SR_ERR_LY;
-                goto cleanup;
+    if (uid) {
+        *uid = entry->uid;
+    }
+    if (gid) {
+        *gid = entry->gid;
+    }
+    if (home) {
+        *home = strdup(entry->home);
+        if (!*home) {
+            EMEM;
+            return -1;
+        }
+    }
+    if (groups) {
+        *groups = NULL;
+        *group_count = 0;
+        if (entry->group_count) {
+            *groups = malloc(entry->group_count * sizeof **groups);
+            if (!*groups) {
+                EMEM;
+                goto error;
             }
         }
+        for (i = 0; i < entry->group_count; ++i) {
+            (*groups)[i] = strdup(entry->groups[i]);
+            if (!(*groups)[i]) {
+                EMEM;
+                goto error;
+            }
+            ++(*group_count);
+        }
+    }
+
+    return 0;
+
+error:
+    if (home) {
+        free(*home);
+        *home = NULL;
+    }
+    if (groups) {
+        for (i = 0; i < *group_count; ++i) {
+            free((*groups)[i]);
+        }
+        free(*groups);
+        *groups = NULL;
+        *group_count = 0;
+    }
+    return -1;
+}
+
+/**
+ * @brief Get information about a user, from the cache if possible.
+ *
+ * @param[in] user User name.
+ * @param[out] uid Optional user UID.
+ * @param[out] gid Optional user GID.
+ * @param[out] home Optional user home directory.
+ * @param[out] groups Optional names of all the groups of the user, loads them if not cached.
+ * @param[out] group_count Number of @p groups.
+ * @return 0 on success;
+ * @return 1 if the user does not exist;
+ * @return -1 on error.
+ */
+static int
+user_cache_get(const char *user, uid_t *uid, gid_t *gid, char **home, char ***groups, uint32_t *group_count)
+{
+    struct np_user_cache_entry *cur, entry;
+    int rc;
+
+    assert(user);
+
+    /* USER CACHE LOCK */
+    pthread_mutex_lock(&user_cache.lock);
 
-        ly_set_free(set, NULL);
-        set = NULL;
+    cur = user_cache_find(user);
+    if (cur && (!groups || cur->groups_loaded)) {
+        ++user_cache.hits;
+        rc = user_cache_entry_copy(cur, uid, gid, home, groups, group_count);
+
+        /* USER CACHE UNLOCK */
+        pthread_mutex_unlock(&user_cache.lock);
+        return rc;
     }
+    ++user_cache.misses;
 
-    if (!has_filter) {
-        /* no filter, just use all the data */
-        *filtered_data = *data;
-        *data = NULL;
+    /* USER CACHE UNLOCK */
+    pthread_mutex_unlock(&user_cache.lock);
+
+    /* load the user without holding the lock, the lookups may take long */
+    if (user_cache_entry_load(user, groups ? 1 : 0, &entry)) {
+        return -1;
     }
+    rc = user_cache_entry_copy(&entry, uid, gid, home, groups, group_count);
+
+    /* USER CACHE LOCK */
+    pthread_mutex_lock(&user_cache.lock);
+
+    user_cache_store(&entry);
+
+    /* USER CACHE UNLOCK */
+    pthread_mutex_unlock(&user_cache.lock);
 
-cleanup:
-    ly_set_free(set, NULL);
     return rc;
 }
+
+int
+np_user_getpw(const char *user, uid_t *uid, gid_t *gid, char **home)
+{
+    return user_cache_get(user, uid, gid, home, NULL, NULL);
+}
+
+int
+np_user_getgroups(const char *user, char ***groups, uint32_t *group_count)
+{
+    return user_cache_get(user, NULL, NULL, NULL, groups, group_count);
+}
+
+void
+np_user_cache_stats(uint32_t *entries, uint64_t *hits, uint64_t *misses)
+{
+    /* USER CACHE LOCK */
+    pthread_mutex_lock(&user_cache.lock);
+
+    *entries = user_cache.count;
+    *hits = user_cache.hits;
+    *misses = user_cache.misses;
+
+    /* USER CACHE UNLOCK */
+    pthread_mutex_unlock(&user_cache.lock);
+}
+
+void
+np_user_cache_clear(void)
+{
+    uint32_t i;
+
+    /* USER CACHE LOCK */
+    pthread_mutex_lock(&user_cache.lock);
+
+    for (i = 0; i < user_cache.count; ++i) {
+        user_cache_entry_erase(&user_cache.entries[i]);
+    }
+    free(user_cache.entries);
+    user_cache.entries = NULL;
+    user_cache.count = 0;
+
+    /* USER CACHE UNLOCK */
+    pthread_mutex_unlock(&user_cache.lock);
+}
@@ -27,6 +27,8 @@
 
 #include "compat.h"
 #include "config.h"
+#include "netconf_monitoring.h"
+#include "notif_queue.h"
 
 /* define clock ID to use */
 #ifdef _POSIX_MONOTONIC_CLOCK
@@ -46,6 +48,9 @@
 struct np2_user_sess {
     sr_session_ctx_t *sess;
     ATOMIC_T ref_count;
+    struct ncm_session_stats stats; /* ietf-netconf-monitoring session counters */
+    struct np_ntf_queue ntf_queue;  /* outbound notification queue */
+    char *err_msg;                  /* error message of the RPC being executed directly, without an event session */
 };
 
 /* server internal data */
@@ -61,8 +66,14 @@ struct np2srv {
     uid_t unix_uid;                 /**< UNIX socket UID */
     gid_t unix_gid;                 /**< UNIX socket GID */
     uint32_t sr_timeout;            /**< timeout in ms for all sysrepo functions */
+    int server_mod;                 /**< whether the netopeer2-server module with its statistics and RPCs is
+                                         implemented */
 
     const char *server_dir;         /**< path to server files (just confirmed commit for the moment) */
+    uint32_t yp_full_update_periods;    /**< yang-push delta mode, send complete periodic updates only every
+                                         this many periods and differences in between, 0 if disabled */
+    uint32_t ntf_queue_depth;       /**< maximum number of notifications queued for a session */
+    enum np_ntf_overflow ntf_overflow;  /**< policy for a notification to a session with a full queue */
 
 #ifdef ENABLE_RESTCONF
     char *fcgi_sock_path;           /**< path to the FCGI UNIX socket */
@@ -72,7 +83,24 @@ struct np2srv {
 #endif
 
     struct nc_pollsession *nc_ps;   /**< libnetconf2 pollsession structure */
-    pthread_t workers[NP2SRV_THREAD_COUNT]; /**< worker threads handling sessions */
+    pthread_mutex_t ps_lock;        /**< lock for waiting on new sessions in the pollsession and for polling it */
+    pthread_cond_t ps_cond;         /**< condition signalled when a new session is added into the pollsession
+                                         or when polling it is released */
+    int ps_polling;                 /**< whether a worker is polling the pollsession, only one polls it at a time */
+    pthread_t ps_poller;            /**< worker polling the pollsession */
+    pthread_t acceptors[NP2SRV_ACCEPT_THREAD_COUNT];    /**< threads accepting new sessions */
+    uint32_t acceptor_count;        /**< number of started accept threads */
+
+    uint32_t worker_min;            /**< minimum number of worker threads */
+    uint32_t worker_max;            /**< maximum number of worker threads */
+    pthread_mutex_t worker_lock;    /**< lock for starting and stopping worker threads */
+    struct np2srv_worker {
+        pthread_t tid;              /**< worker thread ID */
+        int running;                /**< whether this worker is running */
+        int stopped;                /**< whether this worker was stopped and not yet joined */
+    } *workers;                     /**< worker threads handling sessions, ::np2srv.worker_max items */
+    ATOMIC_T worker_count;          /**< number of running worker threads */
+    ATOMIC_T worker_busy;           /**< number of worker threads processing an RPC */
 };
 
 extern struct np2srv np2srv;
@@ -121,9 +149,31 @@ void np_addtimespec(struct timespec *ts, uint32_t msec);
  */
 struct timespec np_modtimespec(const struct timespec *ts, uint32_t msec);
 
+/**
+ * @brief Add a new NC session into the index of sessions by their NC ID and SR ID.
+ *
+ * @param[in] nc_sess NETCONF session with its user session set.
+ * @return 0 on success, -1 on error.
+ */
+int np_sess_index_add(struct nc_session *nc_sess);
+
+/**
+ * @brief Remove an NC session from the index of sessions.
+ *
+ * @param[in] nc_sess NETCONF session to remove.
+ */
+void np_sess_index_del(struct nc_session *nc_sess);
+
+/**
+ * @brief Free the index of sessions.
+ */
+void np_sess_index_destroy(void);
+
 /**
  * @brief Get NC session by SR or NC session ID.
  *
+ * Sessions are found in the index of sessions in constant time.
+ *
  * @param[in] sr_id Search by sysrepo SID, set only if @p nc_id is 0.
  * @param[in] nc_id Search by NETCONF SID, set only if @p sr_id is 0.
  * @param[out] nc_sess Found NETCONF session.
@@ -152,6 +202,18 @@ int np_get_user_sess(sr_session_ctx_t *ev_sess, struct nc_session **nc_sess, str
  */
 void np_release_user_sess(struct np2_user_sess *user_sess);
 
+/**
+ * @brief Set an error message of a failed callback.
+ *
+ * Callbacks of RPCs executed directly by the worker threads get the user session instead of an event session,
+ * the message is then stored in the user session to be added into the error reply.
+ *
+ * @param[in] ev_sess Sysrepo event session or the user session.
+ * @param[in] format Format string of the message.
+ * @param[in] ... Format arguments.
+ */
+void np_set_error_message(sr_session_ctx_t *ev_sess, const char *format, ...);
+
 /**
  * @brief Learn whether a module includes any notification definitions.
  *
@@ -243,6 +305,8 @@ struct np2_filter {
 /**
  * @brief Transform subtree filter into NP2 filter structure.
  *
+ * The transformed filters are cached and shared by all the sessions.
+ *
  * @param[in] node Subtree filter.
  * @param[out] filter Generated NP2 filter.
  * @return 0 on success;
@@ -250,6 +314,20 @@ struct np2_filter {
  */
 int op_filter_subtree2xpath(const struct lyd_node *node, struct np2_filter *filter);
 
+/**
+ * @brief Get statistics of the cache of transformed subtree filters.
+ *
+ * @param[out] entries Number of cached filters.
+ * @param[out] hits Number of filters found in the cache.
+ * @param[out] misses Number of filters not found in the cache.
+ */
+void op_filter_cache_stats(uint32_t *entries, uint64_t *hits, uint64_t *misses);
+
+/**
+ * @brief Free all the cached transformed subtree filters.
+ */
+void op_filter_cache_clear(void);
+
 /**
  * @brief Erase all members of an NP2 filter structure.
  *
@@ -266,14 +344,40 @@ void op_filter_erase(struct np2_filter *filter);
  */
 int op_filter_filter2xpath(const struct np2_filter *filter, char **xpath);
 
+/**
+ * @brief Learn the module name of the first node in an XPath expression.
+ *
+ * @param[in] expr XPath expression.
+ * @param[out] start Start of the module name in @p expr.
+ * @param[out] len Length of the module name.
+ * @return 0 on success;
+ * @return -1 if the expression does not start with a prefixed node.
+ */
+int np2srv_get_first_ns(const char *expr, const char **start, int *len);
+
+/**
+ * @brief Start the threads retrieving data of different modules concurrently.
+ *
+ * @return 0 on success;
+ * @return -1 on error.
+ */
+int np_fetch_pool_init(void);
+
+/**
+ * @brief Stop the threads retrieving data of different modules concurrently.
+ */
+void np_fetch_pool_destroy(void);
+
 /**
  * @brief Get all data matching the NP2 filter.
  *
+ * Data of different modules are retrieved concurrently.
+ *
  * @param[in] session SR session to get the data on.
  * @param[in] max_depth Max depth fo the retrieved data.
  * @param[in] get_opts SR get options to use.
  * @param[in] filter NP2 filter to use.
- * @param[in,out] ev_sess SR event session to set the error on.
+ * @param[in,out] ev_sess SR event session to set the error on, may be @p session if not called from a callback.
  * @param[out] data Retrieved data.
  * @return SR error value.
  */
@@ -283,7 +387,10 @@ int op_filter_data_get(sr_session_ctx_t *session, uint32_t max_depth, sr_get_ope
 /**
  * @brief Filter out only the data matching the NP2 filter.
  *
- * @param[in,out] data Input data to filter. May be used and set to NULL.
+ * The data are filtered in place in a single pass, all the filters are evaluated at once.
+ *
+ * @param[in,out] data Input data to filter. If any data are selected, they are moved into @p filtered_data
+ * and this is set to NULL.
  * @param[in] filter NP2 filter to use.
  * @param[in] with_selection Whether to apply even selection filters in @p filter.
  * @param[out] filtered_data Data from @p data selected by @p filter.
@@ -292,4 +399,47 @@ int op_filter_data_get(sr_session_ctx_t *session, uint32_t max_depth, sr_get_ope
 int op_filter_data_filter(struct lyd_node **data, const struct np2_filter *filter, int with_selection,
         struct lyd_node **filtered_data);
 
+/**
+ * @brief Get the passwd information of a system user.
+ *
+ * The information is cached for ::NP2SRV_USER_CACHE_TIMEOUT and shared by all the sessions.
+ *
+ * @param[in] user User name.
+ * @param[out] uid Optional user UID.
+ * @param[out] gid Optional user GID.
+ * @param[out] home Optional user home directory, should be freed.
+ * @return 0 on success;
+ * @return 1 if the user does not exist;
+ * @return -1 on error.
+ */
+int np_user_getpw(const char *user, uid_t *uid, gid_t *gid, char **home);
+
+/**
+ * @brief Get the names of all the system groups of a user.
+ *
+ * The groups are cached for ::NP2SRV_USER_CACHE_TIMEOUT and shared by all the sessions.
+ *
+ * @param[in] user User name.
+ * @param[out] groups Array of group names, should be freed.
+ * @param[out] group_count Number of @p groups.
+ * @return 0 on success;
+ * @return 1 if the user does not exist;
+ * @return -1 on error.
+ */
+int np_user_getgroups(const char *user, char ***groups, uint32_t *group_count);
+
+/**
+ * @brief Get statistics of the cache of system users.
+ *
+ * @param[out] entries Number of cached users.
+ * @param[out] hits Number of lookups found in the cache.
+ * @param[out] misses Number of lookups not found in the cache.
+ */
+void np_user_cache_stats(uint32_t *entries, uint64_t *hits, uint64_t *misses);
+
+/**
+ * @brief Free all the cached system users so that they are looked up again.
+ */
+void np_user_cache_clear(void);
+
 #endif /* NP2SRV_COMMON_H_ */
@@ -16,11 +16,14 @@
 
 #define _GNU_SOURCE
 
+#include <assert.h>
 #include <errno.h>
 #include <fcntl.h>
 #include <grp.h>
+#include <inttypes.h>
 #include <pwd.h>
 #include <signal.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <string.h>
 #include <sys/stat.h>
@@ -55,6 +58,9 @@
 #include "netconf_monitoring.h"
 #include "netconf_nmda.h"
 #include "netconf_subscribed_notifications.h"
+#include "netopeer2_server.h"
+#include "notif_queue.h"
+#include "timer_wheel.h"
 #include "yang_push.h"
 
 /** @brief flag for main loop */
@@ -63,7 +69,153 @@ ATOMIC_T loop_continue = 1;
 /* NETCONF SID of session to skip diff check for */
 ATOMIC_T skip_nacm_nc_sid;
 
-static void *netconf_worker_thread(int idx);
+static void *worker_thread(void *arg);
+
+/**
+ * @brief Start a new worker thread, if the maximum number of workers is not running already.
+ *
+ * @return 0 on success or if no more workers can be started;
+ * @return -1 on error.
+ */
+static int
+np2srv_worker_add(void)
+{
+    uint32_t idx;
+    int r, rc = 0;
+
+    /* WORKER LOCK */
+    pthread_mutex_lock(&np2srv.worker_lock);
+
+    if (!ATOMIC_LOAD_RELAXED(loop_continue) || (ATOMIC_LOAD_RELAXED(np2srv.worker_count) >= np2srv.worker_max)) {
+        /* terminating or all the workers are running */
+        goto cleanup;
+    }
+
+    /* find a free worker */
+    for (idx = 0; np2srv.workers[idx].running; ++idx) {}
+    assert(idx < np2srv.worker_max);
+
+    if (np2srv.workers[idx].stopped) {
+        /* join the stopped worker before reusing its thread ID */
+        r = pthread_join(np2srv.workers[idx].tid, NULL);
+        if (r) {
+            ERR("Failed to join worker thread %" PRIu32 " (%s).", idx, strerror(r));
+        }
+        np2srv.workers[idx].stopped = 0;
+    }
+
+    r = pthread_create(&np2srv.workers[idx].tid, NULL, worker_thread, (void *)(uintptr_t)idx);
+    if (r) {
+        ERR("Failed to create worker thread %" PRIu32 " (%s).", idx, strerror(r));
+        rc = -1;
+        goto cleanup;
+    }
+    np2srv.workers[idx].running = 1;
+    ATOMIC_INC_RELAXED(np2srv.worker_count);
+
+    VRB("Worker thread %" PRIu32 " started (%" PRIu32 " running).", idx, (uint32_t)ATOMIC_LOAD_RELAXED(np2srv.worker_count));
+
+cleanup:
+    /* WORKER UNLOCK */
+    pthread_mutex_unlock(&np2srv.worker_lock);
+    return rc;
+}
+
+/**
+ * @brief Stop a worker thread, if there are more than the minimum workers running.
+ *
+ * The worker must exit right after this function succeeds, it is joined once its slot is reused or on termination.
+ *
+ * @param[in] idx Index of the worker calling this function.
+ * @return 0 if the worker was stopped;
+ * @return 1 if the worker must keep running.
+ */
+static int
+np2srv_worker_del(uint32_t idx)
+{
+    int rc = 1;
+
+    if (!idx) {
+        /* the main thread always keeps running */
+        return rc;
+    }
+
+    /* WORKER LOCK */
+    pthread_mutex_lock(&np2srv.worker_lock);
+
+    if (!ATOMIC_LOAD_RELAXED(loop_continue) || (ATOMIC_LOAD_RELAXED(np2srv.worker_count) <= np2srv.worker_min)) {
+        /* terminating, the worker will be joined, or the minimum number of workers is running */
+        goto cleanup;
+    }
+
+    np2srv.workers[idx].running = 0;
+    np2srv.workers[idx].stopped = 1;
+    ATOMIC_DEC_RELAXED(np2srv.worker_count);
+    rc = 0;
+
+    VRB("Worker thread %" PRIu32 " stopped (%" PRIu32 " running).", idx, (uint32_t)ATOMIC_LOAD_RELAXED(np2srv.worker_count));
+
+cleanup:
+    /* WORKER UNLOCK */
+    pthread_mutex_unlock(&np2srv.worker_lock);
+    return rc;
+}
+
+/**
+ * @brief Wait until this worker may poll the sessions, only one idle worker polls them at a time.
+ *
+ * Waits at most ::NP2SRV_PS_IDLE_TIMEOUT so that the server termination is noticed.
+ *
+ * @return 1 if this worker polls the sessions, it may have been polling them already;
+ * @return 0 if another worker is still polling them.
+ */
+static int
+np2srv_poll_acquire(void)
+{
+    struct timespec ts;
+    int acquired = 0;
+
+    ts = np_gettimespec(1);
+    np_addtimespec(&ts, NP2SRV_PS_IDLE_TIMEOUT);
+
+    /* PS LOCK */
+    pthread_mutex_lock(&np2srv.ps_lock);
+
+    while (ATOMIC_LOAD_RELAXED(loop_continue) && np2srv.ps_polling &&
+            !pthread_equal(np2srv.ps_poller, pthread_self())) {
+        if (pthread_cond_timedwait(&np2srv.ps_cond, &np2srv.ps_lock, &ts) == ETIMEDOUT) {
+            break;
+        }
+    }
+    if (ATOMIC_LOAD_RELAXED(loop_continue) &&
+            (!np2srv.ps_polling || pthread_equal(np2srv.ps_poller, pthread_self()))) {
+        np2srv.ps_polling = 1;
+        np2srv.ps_poller = pthread_self();
+        acquired = 1;
+    }
+
+    /* PS UNLOCK */
+    pthread_mutex_unlock(&np2srv.ps_lock);
+    return acquired;
+}
+
+/**
+ * @brief Let another idle worker poll the sessions, if this one is polling them.
+ */
+static void
+np2srv_poll_release(void)
+{
+    /* PS LOCK */
+    pthread_mutex_lock(&np2srv.ps_lock);
+
+    if (np2srv.ps_polling && pthread_equal(np2srv.ps_poller, pthread_self())) {
+        np2srv.ps_polling = 0;
+        pthread_cond_signal(&np2srv.ps_cond);
+    }
+
+    /* PS UNLOCK */
+    pthread_mutex_unlock(&np2srv.ps_lock);
+}
 
 /**
  * @brief Signal handler to control the process
@@ -115,8 +267,14 @@ np2srv_del_session_cb(struct nc_session *session)
     /* terminate any subscriptions for the NETCONF session */
     np2srv_sub_ntf_session_destroy(session);
 
-    /* stop sysrepo session subscriptions */
+    /* drop any queued notifications and wait for a notification being sent */
     user_sess = nc_session_get_data(session);
+    np_ntf_queue_session_close(&user_sess->ntf_queue);
+
+    /* the session can no longer be found by its IDs */
+    np_sess_index_del(session);
+
+    /* stop sysrepo session subscriptions */
     sr_session_unsubscribe(user_sess->sess);
 
     /* stop sysrepo session, if no callback is using it */
@@ -310,6 +468,91 @@ np2srv_err_reply_sr(const sr_error_info_t *err_info)
     return reply;
 }
 
+/**
+ * @brief Read-only RPCs executed directly by the worker threads instead of being sent to sysrepo.
+ *
+ * All the RPCs sent to sysrepo are processed one after another by the single RPC subscription,
+ * these RPCs only read data so they can be processed concurrently for all the sessions.
+ */
+static const struct {
+    const char *module;
+    const char *name;
+    const char *op_path;
+    sr_rpc_tree_cb cb;
+} np2srv_direct_rpcs[] = {
+    {"ietf-netconf", "get", "/ietf-netconf:get", np2srv_rpc_get_cb},
+    {"ietf-netconf", "get-config", "/ietf-netconf:get-config", np2srv_rpc_get_cb},
+    {"ietf-netconf-nmda", "get-data", "/ietf-netconf-nmda:get-data", np2srv_rpc_getdata_cb}
+};
+
+/**
+ * @brief Execute an RPC directly, if it is one of the read-only RPCs.
+ *
+ * @param[in] user_sess User session of the NETCONF session.
+ * @param[in] rpc RPC to execute, default input nodes are added.
+ * @param[out] output RPC output, if executed.
+ * @param[out] rc Sysrepo error value of the callback, if executed.
+ * @param[out] reply Error reply, if the RPC input is not valid or the callback failed with an error message.
+ * @return Whether the RPC was executed.
+ */
+static int
+np2srv_rpc_direct(struct np2_user_sess *user_sess, struct lyd_node *rpc, struct lyd_node **output, int *rc,
+        struct nc_server_reply **reply)
+{
+    struct lyd_node *e;
+    uint32_t i;
+
+    if (rpc->parent) {
+        /* action */
+        return 0;
+    }
+
+    for (i = 0; i < sizeof np2srv_direct_rpcs / sizeof *np2srv_direct_rpcs; ++i) {
+        if (!strcmp(rpc->schema->name, np2srv_direct_rpcs[i].name) &&
+                !strcmp(rpc->schema->module->name, np2srv_direct_rpcs[i].module)) {
+            break;
+        }
+    }
+    if (i == sizeof np2srv_direct_rpcs / sizeof *np2srv_direct_rpcs) {
+        /* must be sent to sysrepo */
+        return 0;
+    }
+
+    /* validate the input as sysrepo would, parsing it does not check mandatory nodes and alike */
+    if (lyd_validate_op(rpc, NULL, LYD_TYPE_RPC_YANG, NULL)) {
+        e = nc_err(LYD_CTX(rpc), NC_ERR_OP_FAILED, NC_ERR_TYPE_APP);
+        nc_err_set_msg(e, ly_errmsg(LYD_CTX(rpc)), "en");
+        *reply = nc_server_reply_err(e);
+        *output = NULL;
+        *rc = SR_ERR_VALIDATION_FAILED;
+        return 1;
+    }
+
+    /* prepare the output, the operation node itself */
+    if (lyd_dup_single(rpc, NULL, LYD_DUP_WITH_FLAGS, output)) {
+        *rc = SR_ERR_LY;
+        return 1;
+    }
+
+    /* the user session carries the same originator data as an event session would */
+    *rc = np2srv_direct_rpcs[i].cb(user_sess->sess, 0, np2srv_direct_rpcs[i].op_path, rpc, SR_EV_RPC, 0, *output, NULL);
+    if (*rc) {
+        lyd_free_tree(*output);
+        *output = NULL;
+
+        if (user_sess->err_msg) {
+            /* error set by the callback, possibly raised on a fetch thread session */
+            e = nc_err(LYD_CTX(rpc), NC_ERR_OP_FAILED, NC_ERR_TYPE_APP);
+            nc_err_set_msg(e, user_sess->err_msg, "en");
+            *reply = nc_server_reply_err(e);
+        }
+    }
+    free(user_sess->err_msg);
+    user_sess->err_msg = NULL;
+
+    return 1;
+}
+
 /**
  * @brief Callback for libnetconf2 handling all the RPCs.
  *
@@ -331,6 +574,12 @@ np2srv_rpc_cb(struct lyd_node *rpc, struct nc_session *ncs)
     char *str;
     int rc;
 
+    /* this worker is busy now, let another one poll the sessions and make sure there is one to do it */
+    np2srv_poll_release();
+    if (ATOMIC_INC_RELAXED(np2srv.worker_busy) + 1 >= ATOMIC_LOAD_RELAXED(np2srv.worker_count)) {
+        np2srv_worker_add();
+    }
+
     /* check NACM */
     if ((denied = ncac_check_operation(rpc, nc_session_get_username(ncs)))) {
         e = nc_err(LYD_CTX(rpc), NC_ERR_ACCESS_DENIED, NC_ERR_TYPE_APP);
@@ -347,20 +596,35 @@ np2srv_rpc_cb(struct lyd_node *rpc, struct nc_session *ncs)
             free(str);
         }
 
-        return nc_server_reply_err(e);
+        reply = nc_server_reply_err(e);
+        goto cleanup;
     }
 
     /* get this user session with its originator data, no need to use ref-count */
     user_sess = nc_session_get_data(ncs);
 
-    /* sysrepo API, use the default timeout or slightly higher than the configured one */
-    rc = sr_rpc_send_tree(user_sess->sess, rpc, np2srv.sr_timeout ? np2srv.sr_timeout + 2000 : 0, &output);
-    if (rc) {
+    if (!np2srv_rpc_direct(user_sess, rpc, &output, &rc, &reply)) {
+        /* sysrepo API, use the default timeout or slightly higher than the configured one */
+        rc = sr_rpc_send_tree(user_sess->sess, rpc, np2srv.sr_timeout ? np2srv.sr_timeout + 2000 : 0, &output);
+    }
+    if (reply) {
+        /* invalid input or a failed direct RPC */
+        goto cleanup;
+    } else if (rc) {
         ERR("Failed to send an RPC (%s).", sr_strerror(rc));
 
         /* build proper error */
         sr_session_get_error(user_sess->sess, &err_info);
-        return np2srv_err_reply_sr(err_info);
+        if (err_info && err_info->err_count) {
+            reply = np2srv_err_reply_sr(err_info);
+        }
+        if (!reply) {
+            /* the RPC failed without setting any error */
+            e = nc_err(LYD_CTX(rpc), NC_ERR_OP_FAILED, NC_ERR_TYPE_APP);
+            nc_err_set_msg(e, sr_strerror(rc), "en");
+            reply = nc_server_reply_err(e);
+        }
+        goto cleanup;
     }
 
     /* build RPC Reply */
@@ -403,6 +667,8 @@ np2srv_rpc_cb(struct lyd_node *rpc, struct nc_session *ncs)
         reply = nc_server_reply_ok();
     }
 
+cleanup:
+    ATOMIC_DEC_RELAXED(np2srv.worker_busy);
     return reply;
 }
 
@@ -441,7 +707,8 @@ np2srv_diff_check_cb(sr_session_ctx_t *session, const struct lyd_node *diff)
         return SR_ERR_UNAUTHORIZED;
     }
 
-    return SR_ERR_OK;
+    /* back up the changes of a confirmed commit */
+    return ncc_diff_check(session, diff);
 }
 
 /**
@@ -515,6 +782,13 @@ np2srv_check_schemas(sr_session_ctx_t *sr_sess)
     NP2_CHECK_FEATURE("ssh-listen");
     NP2_CHECK_FEATURE("ssh-call-home");
 
+    /* .. netopeer2-server, optional so that existing installations start before it is installed */
+    mod_name = "netopeer2-server";
+    np2srv.server_mod = ly_ctx_get_module_implemented(ly_ctx, mod_name) ? 1 : 0;
+    if (!np2srv.server_mod) {
+        WRN("Module \"%s\" not implemented in sysrepo, server statistics and RPCs are not available.", mod_name);
+    }
+
     return 0;
 }
 
@@ -574,8 +848,28 @@ server_init(void)
     /* init monitoring */
     ncm_init();
 
+    /* init subscriptions */
+    np2srv_sub_ntf_init();
+
     /* init NACM */
-    ncac_init();
+    if (ncac_init()) {
+        goto error;
+    }
+
+    /* start data fetch threads */
+    if (np_fetch_pool_init()) {
+        goto error;
+    }
+
+    /* start the timer wheel */
+    if (np_timer_wheel_init()) {
+        goto error;
+    }
+
+    /* start notification writer threads */
+    if (np_ntf_queue_init()) {
+        goto error;
+    }
 
     /* init libnetconf2 (it modifies only the dictionary) */
     if (nc_server_init((struct ly_ctx *)ly_ctx)) {
@@ -684,6 +978,10 @@ server_destroy(void)
         }
         nc_ps_free(np2srv.nc_ps);
     }
+    np_sess_index_destroy();
+
+    /* stop notification writer threads, all the queues are closed */
+    np_ntf_queue_destroy();
 
     /* libnetconf2 cleanup */
     nc_server_destroy();
@@ -693,6 +991,9 @@ server_destroy(void)
         unlink(np2srv.unix_path);
     }
 
+    /* stop the timers, no callbacks are executed afterwards */
+    np_timer_wheel_destroy();
+
     /* monitoring cleanup */
     ncm_destroy();
 
@@ -705,21 +1006,28 @@ server_destroy(void)
     /* ietf-subscribed-notifications cleanup */
     np2srv_sub_ntf_destroy();
 
-    /* removes the context and clears all the sessions */
-    sr_disconnect(np2srv.sr_conn);
-}
+    /* data fetch threads cleanup */
+    np_fetch_pool_destroy();
 
-#if defined (NC_ENABLED_SSH) || defined (NC_ENABLED_TLS)
+    /* filter cache cleanup */
+    op_filter_cache_clear();
 
-static int
-np2srv_dummy_cb(sr_session_ctx_t *UNUSED(session), uint32_t UNUSED(sub_id), const char *UNUSED(module_name),
-        const char *UNUSED(xpath), sr_event_t UNUSED(event), uint32_t UNUSED(request_id), void *UNUSED(private_data))
-{
-    return SR_ERR_OK;
-}
+    /* user cache cleanup */
+    np_user_cache_clear();
 
+#if defined (NC_ENABLED_SSH) || defined (NC_ENABLED_TLS)
+    /* keystore and truststore cache cleanup */
+    np2srv_ks_cache_clear();
+#endif
+#ifdef NC_ENABLED_SSH
+    /* authorized keys cache cleanup */
+    np2srv_authkeys_cache_clear();
 #endif
 
+    /* removes the context and clears all the sessions */
+    sr_disconnect(np2srv.sr_conn);
+}
+
 /**
  * @brief Subscribe to all the handled RPCs of the server.
  *
@@ -773,6 +1081,11 @@ server_rpc_subscribe(void)
     /* one more yang-push RPC */
     SR_RPC_SUBSCR("/ietf-yang-push:resync-subscription", np2srv_rpc_resync_sub_cb);
 
+    /* netopeer2-server RPCs */
+    if (np2srv.server_mod) {
+        SR_RPC_SUBSCR("/netopeer2-server:clear-user-cache", np2srv_rpc_clear_user_cache_cb);
+    }
+
     return 0;
 
 error:
@@ -818,6 +1131,11 @@ server_data_subscribe(void)
     mod_name = "nc-notifications";
     SR_OPER_SUBSCR(mod_name, "/nc-notifications:netconf", np2srv_nc_ntf_oper_cb);
 
+    if (np2srv.server_mod) {
+        mod_name = "netopeer2-server";
+        SR_OPER_SUBSCR(mod_name, "/netopeer2-server:server-stats", np2srv_stats_oper_cb);
+    }
+
     /*
      * ietf-subscribed-notifications
      */
@@ -930,18 +1248,18 @@ server_data_subscribe(void)
 
 #if defined (NC_ENABLED_SSH) || defined (NC_ENABLED_TLS)
     /*
-     * ietf-keystore (just for in-use operational data)
+     * ietf-keystore (cached for SSH and TLS callbacks)
      */
     mod_name = "ietf-keystore";
     xpath = "/ietf-keystore:keystore/asymmetric-keys";
-    SR_CONFIG_SUBSCR(mod_name, xpath, np2srv_dummy_cb);
+    SR_CONFIG_SUBSCR(mod_name, xpath, np2srv_keystore_cb);
 
     /*
-     * ietf-truststore (just for in-use operational data)
+     * ietf-truststore (cached for TLS callbacks)
      */
     mod_name = "ietf-truststore";
     xpath = "/ietf-truststore:truststore/certificates";
-    SR_CONFIG_SUBSCR(mod_name, xpath, np2srv_dummy_cb);
+    SR_CONFIG_SUBSCR(mod_name, xpath, np2srv_truststore_cb);
 #endif
 
     /*
@@ -977,6 +1295,73 @@ error:
     return -1;
 }
 
+/**
+ * @brief Wait for a session to be added into the pollsession structure.
+ *
+ * Waits at most ::NP2SRV_PS_IDLE_TIMEOUT so that the server termination is noticed.
+ */
+static void
+netconf_worker_wait_session(void)
+{
+    struct timespec ts;
+
+    ts = np_gettimespec(1);
+    np_addtimespec(&ts, NP2SRV_PS_IDLE_TIMEOUT);
+
+    /* PS LOCK */
+    pthread_mutex_lock(&np2srv.ps_lock);
+
+    if (ATOMIC_LOAD_RELAXED(loop_continue) && !nc_ps_session_count(np2srv.nc_ps)) {
+        pthread_cond_timedwait(&np2srv.ps_cond, &np2srv.ps_lock, &ts);
+    }
+
+    /* PS UNLOCK */
+    pthread_mutex_unlock(&np2srv.ps_lock);
+}
+
+/**
+ * @brief Server thread accepting new NETCONF sessions, there are more of them to perform handshakes concurrently.
+ *
+ * @param[in] arg Unused.
+ * @return NULL.
+ */
+static void *
+netconf_accept_thread(void *arg)
+{
+    NC_MSG_TYPE msgtype;
+    struct nc_session *ncs;
+
+    (void)arg;
+
+#ifdef NC_ENABLED_SSH
+    nc_libssh_thread_verbosity(np2_libssh_verbose_level);
+#endif
+
+    while (ATOMIC_LOAD_RELAXED(loop_continue)) {
+        if (!nc_server_endpt_count()) {
+            /* nothing to listen on, nc_accept() would fail right away */
+            np_sleep(NP2SRV_ACCEPT_TIMEOUT);
+            continue;
+        }
+
+        /* block until there is a new connection on any of the endpoints */
+        msgtype = nc_accept(NP2SRV_ACCEPT_TIMEOUT, &ncs);
+        if (msgtype == NC_MSG_HELLO) {
+            if (np2srv_new_session_cb(NULL, ncs)) {
+                nc_session_free(ncs, NULL);
+            }
+        }
+    }
+
+    DBG("Netconf accept thread exiting");
+
+    /* cleanup */
+#if defined (NC_ENABLED_SSH) || defined (NC_ENABLED_TLS)
+    nc_thread_destroy();
+#endif
+    return NULL;
+}
+
 /**
  * @brief Server worker thread function.
  *
@@ -984,58 +1369,74 @@ error:
  * @return NULL.
  */
 static void *
-netconf_worker_thread(int idx)
+netconf_worker_thread(uint32_t idx)
 {
     NC_MSG_TYPE msgtype;
     int rc;
     struct nc_session *ncs;
+    struct timespec last_event, cur_time;
 
 #ifdef NC_ENABLED_SSH
     nc_libssh_thread_verbosity(np2_libssh_verbose_level);
 #endif
 
+    last_event = np_gettimespec(0);
     while (ATOMIC_LOAD_RELAXED(loop_continue)) {
-        /* try to accept new NETCONF sessions */
-        if (nc_server_endpt_count()) {
-            msgtype = nc_accept(0, &ncs);
-            if (msgtype == NC_MSG_HELLO) {
-                if (np2srv_new_session_cb(NULL, ncs)) {
-                    nc_session_free(ncs, NULL);
-                    continue;
-                }
-            }
+        if (np2srv_poll_acquire()) {
+            /* listen for incoming requests on active NETCONF sessions */
+            rc = nc_ps_poll(np2srv.nc_ps, NP2SRV_POLL_IO_TIMEOUT, &ncs);
+        } else {
+            /* another worker is polling the sessions, the wait timed out */
+            rc = NC_PSPOLL_TIMEOUT;
         }
 
-        /* listen for incoming requests on active NETCONF sessions */
-        rc = nc_ps_poll(np2srv.nc_ps, NP2SRV_POLL_IO_TIMEOUT, &ncs);
+        if ((rc & (NC_PSPOLL_NOSESSIONS | NC_PSPOLL_TIMEOUT)) && !(rc & NC_PSPOLL_SESSION_TERM)) {
+            /* stop this worker if it has been idle for too long */
+            cur_time = np_gettimespec(0);
+            if ((np_difftimespec(&last_event, &cur_time) >= NP2SRV_WORKER_IDLE_TIMEOUT) && !np2srv_worker_del(idx)) {
+                break;
+            }
+        } else {
+            last_event = np_gettimespec(0);
+        }
 
-        if ((rc & (NC_PSPOLL_NOSESSIONS | NC_PSPOLL_TIMEOUT | NC_PSPOLL_ERROR)) && !(rc & NC_PSPOLL_SESSION_TERM)) {
-            /* if there is no active session, timeout, or an error, rest for a while */
+        if (rc & NC_PSPOLL_NOSESSIONS) {
+            /* there is no session to handle, sleep until one is added */
+            netconf_worker_wait_session();
+            continue;
+        } else if ((rc & NC_PSPOLL_TIMEOUT) && !(rc & NC_PSPOLL_SESSION_TERM)) {
+            /* the whole timeout was spent waiting for an event already, poll or wait again right away */
+            continue;
+        } else if ((rc & NC_PSPOLL_ERROR) && !(rc & NC_PSPOLL_SESSION_TERM)) {
+            /* error, rest for a while */
             np_sleep(NP2SRV_PS_BACKOFF_SLEEP);
             continue;
         }
 
+        /* an event, let another worker poll the sessions meanwhile, if an RPC has not done so already */
+        np2srv_poll_release();
+
         /* process the result of nc_ps_poll(), increase counters */
         if (rc & NC_PSPOLL_BAD_RPC) {
             ncm_session_bad_rpc(ncs);
-            VRB("Session %d: thread %d event bad RPC.", nc_session_get_id(ncs), idx);
+            VRB("Session %d: thread %" PRIu32 " event bad RPC.", nc_session_get_id(ncs), idx);
         }
         if (rc & NC_PSPOLL_RPC) {
             ncm_session_rpc(ncs);
-            VRB("Session %d: thread %d event new RPC.", nc_session_get_id(ncs), idx);
+            VRB("Session %d: thread %" PRIu32 " event new RPC.", nc_session_get_id(ncs), idx);
         }
         if (rc & NC_PSPOLL_REPLY_ERROR) {
             ncm_session_rpc_reply_error(ncs);
-            VRB("Session %d: thread %d event reply error.", nc_session_get_id(ncs), idx);
+            VRB("Session %d: thread %" PRIu32 " event reply error.", nc_session_get_id(ncs), idx);
         }
         if (rc & NC_PSPOLL_SESSION_TERM) {
-            VRB("Session %d: thread %d event session terminated.", nc_session_get_id(ncs), idx);
+            VRB("Session %d: thread %" PRIu32 " event session terminated.", nc_session_get_id(ncs), idx);
             np2srv_del_session_cb(ncs);
         }
 #ifdef NC_ENABLED_SSH
         else if (rc & NC_PSPOLL_SSH_CHANNEL) {
             /* a new SSH channel on existing session was created */
-            VRB("Session %d: thread %d event new SSH channel.", nc_session_get_id(ncs), idx);
+            VRB("Session %d: thread %" PRIu32 " event new SSH channel.", nc_session_get_id(ncs), idx);
             msgtype = nc_session_accept_ssh_channel(ncs, &ncs);
             if (msgtype == NC_MSG_HELLO) {
                 if (np2srv_new_session_cb(NULL, ncs)) {
@@ -1049,7 +1450,8 @@ netconf_worker_thread(int idx)
 #endif
     }
 
-    DBG("Netconf thread %d exiting", idx);
+    np2srv_poll_release();
+    DBG("Netconf thread %" PRIu32 " exiting", idx);
 
     /* cleanup */
 #if defined (NC_ENABLED_SSH) || defined (NC_ENABLED_TLS)
@@ -1059,16 +1461,17 @@ netconf_worker_thread(int idx)
 }
 
 static void *
-worker_thread (void *arg)
+worker_thread(void *arg)
 {
-    int idx = (int) arg;
+    uint32_t idx = (uintptr_t)arg;
     void *rc;
 
     rc = netconf_worker_thread(idx);
 
-    if (rc)
-        ERR("Thread %d returned %p!", idx, rc);
-    
+    if (rc) {
+        ERR("Thread %" PRIu32 " returned %p!", idx, rc);
+    }
+
     return rc;
 }
 
@@ -1081,7 +1484,7 @@ print_version(void)
 static void
 print_usage(char *progname)
 {
-    fprintf(stdout, "Usage: %s [-dhV] [-p PATH] [-U[PATH]] [-m MODE] [-u UID] [-g GID] [-t TIMEOUT] [-v LEVEL] [-c CATEGORY]\n", progname);
+    fprintf(stdout, "Usage: %s [-dhV] [-p PATH] [-U[PATH]] [-m MODE] [-u UID] [-g GID] [-t TIMEOUT] [-w MIN[:MAX]] [-y PERIODS] [-v LEVEL] [-c CATEGORY]\n", progname);
     fprintf(stdout, " -d         Debug mode (do not daemonize and print verbose messages to stderr instead of syslog).\n");
     fprintf(stdout, " -h         Display help.\n");
     fprintf(stdout, " -V         Show program version.\n");
@@ -1094,6 +1497,16 @@ print_usage(char *progname)
     fprintf(stdout, " -R[PATH]   Enable RestConf FCGI module and specify UNIX socket path (default is \"%s\").\n", NP2SRV_FCGI_SOCKPATH);
     fprintf(stdout, " -t TIMEOUT Timeout in seconds of all sysrepo functions (applying edit-config, reading data, ...),\n");
     fprintf(stdout, "            if 0 (default), the default sysrepo timeouts are used.\n");
+    fprintf(stdout, " -w MIN[:MAX]\n");
+    fprintf(stdout, "            Minimum and maximum number of worker threads handling requests (default is 1:%d, highest\n", NP2SRV_THREAD_COUNT);
+    fprintf(stdout, "            maximum is %d). More workers are started when all of them are busy, idle ones are stopped.\n", NP2SRV_THREAD_MAX_COUNT);
+    fprintf(stdout, " -y PERIODS yang-push delta mode, send complete push-update notifications of periodic subscriptions\n");
+    fprintf(stdout, "            only every PERIODS periods and push-change-update with the differences in between.\n");
+    fprintf(stdout, " -q DEPTH[:POLICY]\n");
+    fprintf(stdout, "            Maximum number of notifications queued for a session (default is %d) and the policy\n", NP2SRV_NOTIF_QUEUE_DEPTH);
+    fprintf(stdout, "            applied when the queue is full, \"block\" (default) to wait until a notification is sent,\n");
+    fprintf(stdout, "            \"drop-oldest\", \"drop-newest\", or \"suspend\" to suspend the subscription until the queue\n");
+    fprintf(stdout, "            is half-empty.\n");
     fprintf(stdout, " -v LEVEL   Verbose output level:\n");
     fprintf(stdout, "                0 - errors\n");
     fprintf(stdout, "                1 - errors and warnings\n");
@@ -1148,9 +1561,13 @@ main(int argc, char *argv[])
 
     /* default value */
     np2srv.server_dir = SERVER_DIR;
+    np2srv.worker_min = 1;
+    np2srv.worker_max = NP2SRV_THREAD_COUNT;
+    np2srv.ntf_queue_depth = NP2SRV_NOTIF_QUEUE_DEPTH;
+    np2srv.ntf_overflow = NP_NTF_OVERFLOW_BLOCK;
 
     /* process command line options */
-    while ((c = getopt(argc, argv, "dhVp:f:U::m:u:g:R::t:v:c:")) != -1) {
+    while ((c = getopt(argc, argv, "dhVp:f:U::m:u:g:R::t:w:y:q:v:c:")) != -1) {
         switch (c) {
         case 'd':
             daemonize = 0;
@@ -1253,6 +1670,51 @@ main(int argc, char *argv[])
             /* make ms from s */
             np2srv.sr_timeout *= 1000;
             break;
+        case 'w':
+            np2srv.worker_min = strtoul(optarg, &ptr, 10);
+            if (*ptr == ':') {
+                np2srv.worker_max = strtoul(ptr + 1, &ptr, 10);
+            } else {
+                np2srv.worker_max = (np2srv.worker_min > NP2SRV_THREAD_COUNT) ? np2srv.worker_min : NP2SRV_THREAD_COUNT;
+            }
+            if (*ptr || !np2srv.worker_min || (np2srv.worker_min > np2srv.worker_max) ||
+                    (np2srv.worker_max > NP2SRV_THREAD_MAX_COUNT)) {
+                ERR("Invalid worker thread count \"%s\" (maximum is %d).", optarg, NP2SRV_THREAD_MAX_COUNT);
+                return EXIT_FAILURE;
+            }
+            break;
+        case 'y':
+            np2srv.yp_full_update_periods = strtoul(optarg, &ptr, 10);
+            if (*ptr) {
+                ERR("Invalid yang-push full update periods \"%s\".", optarg);
+                return EXIT_FAILURE;
+            }
+            break;
+        case 'q':
+            np2srv.ntf_queue_depth = strtoul(optarg, &ptr, 10);
+            if (*ptr == ':') {
+                ++ptr;
+                if (!strcmp(ptr, "block")) {
+                    np2srv.ntf_overflow = NP_NTF_OVERFLOW_BLOCK;
+                } else if (!strcmp(ptr, "drop-oldest")) {
+                    np2srv.ntf_overflow = NP_NTF_OVERFLOW_DROP_OLDEST;
+                } else if (!strcmp(ptr, "drop-newest")) {
+                    np2srv.ntf_overflow = NP_NTF_OVERFLOW_DROP_NEWEST;
+                } else if (!strcmp(ptr, "suspend")) {
+                    np2srv.ntf_overflow = NP_NTF_OVERFLOW_SUSPEND;
+                } else {
+                    ERR("Invalid notification queue overflow policy \"%s\".", ptr);
+                    return EXIT_FAILURE;
+                }
+            } else if (*ptr) {
+                ERR("Invalid notification queue depth \"%s\".", optarg);
+                return EXIT_FAILURE;
+            }
+            if (!np2srv.ntf_queue_depth) {
+                ERR("Invalid notification queue depth \"%s\".", optarg);
+                return EXIT_FAILURE;
+            }
+            break;
         case 'c':
 #ifndef NDEBUG
             if (verb) {
@@ -1310,6 +1772,13 @@ main(int argc, char *argv[])
         }
     }
 
+    /* prepare worker threads */
+    np2srv.workers = calloc(np2srv.worker_max, sizeof *np2srv.workers);
+    if (!np2srv.workers) {
+        EMEM;
+        return EXIT_FAILURE;
+    }
+
     /* daemonize */
     if (daemonize == 1) {
         if (daemon(0, 0) != 0) {
@@ -1370,23 +1839,60 @@ main(int argc, char *argv[])
         goto cleanup;
     }
 
-    /* start additional worker threads */
-    for (i = 1; i < NP2SRV_THREAD_COUNT; ++i) {
-        pthread_create(&np2srv.workers[i], NULL, worker_thread, (void*) i);
+    /* start the threads accepting new sessions */
+    for (i = 0; i < NP2SRV_ACCEPT_THREAD_COUNT; ++i) {
+        c = pthread_create(&np2srv.acceptors[i], NULL, netconf_accept_thread, NULL);
+        if (c) {
+            ERR("Failed to create accept thread (%s).", strerror(c));
+            ret = EXIT_FAILURE;
+            ATOMIC_STORE_RELAXED(loop_continue, 0);
+            break;
+        }
+        ++np2srv.acceptor_count;
     }
 
     /* one worker will use this thread */
-    np2srv.workers[0] = pthread_self();
-    worker_thread((void*) 0);
+    np2srv.workers[0].tid = pthread_self();
+    np2srv.workers[0].running = 1;
+    ATOMIC_STORE_RELAXED(np2srv.worker_count, 1);
+
+    /* start additional worker threads, more are started when needed */
+    for (i = 1; i < (int)np2srv.worker_min; ++i) {
+        if (np2srv_worker_add()) {
+            ret = EXIT_FAILURE;
+            ATOMIC_STORE_RELAXED(loop_continue, 0);
+            break;
+        }
+    }
+
+    if (ret == EXIT_SUCCESS) {
+        worker_thread((void *)0);
+    }
+
+    /* wait for any worker being started or stopped, no more can be after the main loop has ended */
+    pthread_mutex_lock(&np2srv.worker_lock);
+    pthread_mutex_unlock(&np2srv.worker_lock);
 
-    /* wait for other worker threads to finish */
-    for (i = 1; i < NP2SRV_THREAD_COUNT; ++i) {
-        c = pthread_join(np2srv.workers[i], NULL);
+    /* wait for other worker threads to finish, including the stopped ones that may still be exiting */
+    for (i = 1; i < (int)np2srv.worker_max; ++i) {
+        if (!np2srv.workers[i].running && !np2srv.workers[i].stopped) {
+            continue;
+        }
+
+        c = pthread_join(np2srv.workers[i].tid, NULL);
         if (c) {
             ERR("Failed to join worker thread %d (%s).", i, strerror(c));
         }
     }
 
+    /* wait for the accept threads */
+    for (i = 0; i < (int)np2srv.acceptor_count; ++i) {
+        c = pthread_join(np2srv.acceptors[i], NULL);
+        if (c) {
+            ERR("Failed to join accept thread %d (%s).", i, strerror(c));
+        }
+    }
+
 cleanup:
     VRB("Server terminated.");
 
@@ -1395,6 +1901,7 @@ cleanup:
 
     /* destroy the server */
     server_destroy();
+    free(np2srv.workers);
 
     return ret;
 }
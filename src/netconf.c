@@ -41,33 +41,6 @@
 #include "netconf_confirmed_commit.h"
 #include "netconf_monitoring.h"
 
-static int
-np2srv_get_first_ns(const char *expr, const char **start, int *len)
-{
-    int i;
-
-    if (expr[0] != '/') {
-        return -1;
-    }
-    if (expr[1] == '/') {
-        expr += 2;
-    } else {
-        ++expr;
-    }
-
-    if (!isalpha(expr[0]) && (expr[0] != '_')) {
-        return -1;
-    }
-    for (i = 1; expr[i] && (isalnum(expr[i]) || (expr[i] == '_') || (expr[i] == '-') || (expr[i] == '.')); ++i) {}
-    if (expr[i] != ':') {
-        return -1;
-    }
-
-    *start = expr;
-    *len = i;
-    return 0;
-}
-
 /**
  * @brief Get generic filters in the form of "/module:*" from exact xpath filters.
  */
@@ -217,7 +190,12 @@ np2srv_rpc_get_cb(sr_session_ctx_t *session, uint32_t UNUSED(sub_id), const char
 
     /* get know which datastore is being affected for get-config */
     if (!strcmp(op_path, "/ietf-netconf:get-config")) {
-        lyd_find_xpath(input, "source/*", &nodeset);
+        if (lyd_find_xpath(input, "source/*", &nodeset) || !nodeset->count) {
+            ERR("RPC without a valid \"source\" datastore.");
+            ly_set_free(nodeset, NULL);
+            rc = SR_ERR_INVAL_ARG;
+            goto cleanup;
+        }
         if (!strcmp(nodeset->dnodes[0]->schema->name, "running")) {
             ds = SR_DS_RUNNING;
         } else if (!strcmp(nodeset->dnodes[0]->schema->name, "startup")) {
@@ -934,11 +912,9 @@ static void
 np2srv_rpc_subscribe_ntf_cb(sr_session_ctx_t *UNUSED(session), uint32_t sub_id, const sr_ev_notif_type_t notif_type,
         const struct lyd_node *notif, struct timespec *timestamp, void *private_data)
 {
-    struct nc_server_notif *nc_ntf = NULL;
+    struct np_ntf *ntf = NULL;
     struct subscribe_ntf_data *cb_data = private_data;
     struct lyd_node *ly_ntf = NULL;
-    NC_MSG_TYPE msg_type;
-    char *datetime = NULL;
     struct timespec stop, cur_ts;
 
     /* create these notifications, sysrepo only emulates them */
@@ -983,28 +959,27 @@ np2srv_rpc_subscribe_ntf_cb(sr_session_ctx_t *UNUSED(session), uint32_t sub_id,
         goto cleanup;
     }
 
-    /* create the notification object, all the passed arguments must exist until it is sent */
-    ly_time_ts2str(timestamp, &datetime);
-    nc_ntf = nc_server_notif_new((struct lyd_node *)notif, datetime, NC_PARAMTYPE_CONST);
-
-    /* send the notification */
-    msg_type = nc_server_notif_send(cb_data->nc_sess, nc_ntf, NP2SRV_NOTIF_SEND_TIMEOUT);
-    if ((msg_type == NC_MSG_ERROR) || (msg_type == NC_MSG_WOULDBLOCK)) {
-        ERR("Sending a notification to session %d %s.", nc_session_get_id(cb_data->nc_sess), msg_type == NC_MSG_ERROR ?
-                "failed" : "timed out");
+    /* create the notification object, it is sent asynchronously so it must own its data */
+    if (!ly_ntf && lyd_dup_single(notif, NULL, LYD_DUP_RECURSIVE, &ly_ntf)) {
         goto cleanup;
     }
-    ncm_session_notification(cb_data->nc_sess);
+    np_ntf_new(ly_ntf, timestamp, &ntf);
+    ly_ntf = NULL;
+    if (!ntf) {
+        goto cleanup;
+    }
+
+    /* queue the notification, the final ones are never dropped */
+    np_ntf_queue_push(cb_data->nc_sess, 0, ntf,
+            (notif_type == SR_EV_NOTIF_REPLAY_COMPLETE) || (notif_type == SR_EV_NOTIF_TERMINATED));
 
     if (notif_type == SR_EV_NOTIF_TERMINATED) {
-        /* subscription finished */
-        nc_session_dec_notif_status(cb_data->nc_sess);
+        /* subscription finished once all its notifications are sent */
+        np_ntf_queue_notif_status_dec(cb_data->nc_sess);
         free(cb_data);
     }
 
 cleanup:
-    nc_server_notif_free(nc_ntf);
-    free(datetime);
     lyd_free_all(ly_ntf);
 }
 
@@ -1179,7 +1154,7 @@ np2srv_rpc_subscribe_cb(sr_session_ctx_t *session, uint32_t UNUSED(sub_id), cons
 
 cleanup:
     if (rc && has_nc_ntf_status) {
-        nc_session_dec_notif_status(ncs);
+        np_ntf_queue_notif_status_dec(ncs);
     }
     ly_set_erase(&mod_set, NULL);
     free(cb_data);
@@ -19,10 +19,11 @@
 #include "netconf_acm.h"
 
 #include <assert.h>
-#include <grp.h>
-#include <pwd.h>
+#include <inttypes.h>
+#include <sched.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
 #include <unistd.h>
 
 #include <libyang/libyang.h>
@@ -32,13 +33,377 @@
 #include "compat.h"
 #include "log.h"
 
-static struct ncac nacm;
+/** Current NACM snapshot. */
+static ATOMIC_PTR_T(struct ncac) nacm_cur;
+
+/** Number of readers in the process of acquiring a reference to the current snapshot. */
+static ATOMIC_T nacm_acquiring;
+
+/** Lock serializing the NACM configuration callbacks creating new snapshots. */
+static pthread_mutex_t nacm_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/** NACM counters, shared by all the snapshots. */
+static struct {
+    ATOMIC_T denied_operations;     /**< Counter of denied operations (RPC or action). */
+    ATOMIC_T denied_data_writes;    /**< Counter of denied data writes. */
+    ATOMIC_T denied_notifications;  /**< Counter of denied notifications. */
+} nacm_stats;
+
+/**
+ * Cached access decision for a node is not cacheable and must be made for every data node. Used if it depends on
+ * the data instance and also if deciding whether it does failed, so that the decision is never attempted again.
+ */
+#define NCAC_ACCESS_INSTANCE 5
+
+/**
+ * @brief Free cached NACM information of a user.
+ *
+ * @param[in] nuser Cached user to free.
+ */
+static void
+ncac_user_free(struct ncac_user *nuser)
+{
+    uint32_t i;
+
+    if (!nuser) {
+        return;
+    }
+
+    for (i = 0; i < nuser->group_count; ++i) {
+        lydict_remove(sr_get_context(np2srv.sr_conn), nuser->groups[i]);
+    }
+    free(nuser->groups);
+    free(nuser->rules);
+    free(nuser->decisions);
+    free(nuser->name);
+    free(nuser);
+}
+
+/**
+ * @brief Release a reference to a cached user, free it if it was the last one.
+ *
+ * @param[in] nuser Cached user to release.
+ */
+static void
+ncac_user_put(struct ncac_user *nuser)
+{
+    if (nuser && (ATOMIC_DEC(nuser->ref_count) == 1)) {
+        ncac_user_free(nuser);
+    }
+}
+
+/**
+ * @brief Release all the cached users of a snapshot. Users lock is expected to be held.
+ *
+ * @param[in] nacm NACM snapshot.
+ */
+static void
+ncac_cache_clear(struct ncac *nacm)
+{
+    uint32_t i;
+
+    for (i = 0; i < nacm->user_count; ++i) {
+        ncac_user_put(nacm->users[i]);
+    }
+    free(nacm->users);
+    nacm->users = NULL;
+    nacm->user_count = 0;
+}
+
+/**
+ * @brief Create a new empty NACM snapshot.
+ *
+ * @return New snapshot with a single reference, NULL on error.
+ */
+static struct ncac *
+ncac_snapshot_new(void)
+{
+    struct ncac *nacm;
+
+    nacm = calloc(1, sizeof *nacm);
+    if (!nacm) {
+        EMEM;
+        return NULL;
+    }
+    pthread_mutex_init(&nacm->users_lock, NULL);
+    ATOMIC_STORE_RELAXED(nacm->ref_count, 1);
+
+    return nacm;
+}
+
+/**
+ * @brief Remove all rules from a rule list.
+ *
+ * @param[in,out] list Rule list to remove from.
+ */
+static void
+ncac_remove_rules(struct ncac_rule_list *list)
+{
+    struct ncac_rule *rule, *tmp;
+    struct ly_ctx *ly_ctx;
+
+    ly_ctx = (struct ly_ctx *)sr_get_context(np2srv.sr_conn);
+
+    LY_LIST_FOR_SAFE(list->rules, tmp, rule) {
+        lydict_remove(ly_ctx, rule->name);
+        lydict_remove(ly_ctx, rule->module_name);
+        lydict_remove(ly_ctx, rule->target);
+        lydict_remove(ly_ctx, rule->comment);
+        free(rule);
+    }
+    list->rules = NULL;
+}
+
+/**
+ * @brief Free a NACM snapshot.
+ *
+ * @param[in] nacm NACM snapshot to free.
+ */
+static void
+ncac_snapshot_free(struct ncac *nacm)
+{
+    struct ncac_group *group;
+    struct ncac_rule_list *rule_list, *tmp;
+    struct ly_ctx *ly_ctx;
+    uint32_t i, j;
+
+    if (!nacm) {
+        return;
+    }
+
+    ly_ctx = (struct ly_ctx *)sr_get_context(np2srv.sr_conn);
+
+    for (i = 0; i < nacm->group_count; ++i) {
+        group = &nacm->groups[i];
+        lydict_remove(ly_ctx, group->name);
+        for (j = 0; j < group->user_count; ++j) {
+            lydict_remove(ly_ctx, group->users[j]);
+        }
+        free(group->users);
+    }
+    free(nacm->groups);
+
+    LY_LIST_FOR_SAFE(nacm->rule_lists, tmp, rule_list) {
+        lydict_remove(ly_ctx, rule_list->name);
+        for (i = 0; i < rule_list->group_count; ++i) {
+            lydict_remove(ly_ctx, rule_list->groups[i]);
+        }
+        free(rule_list->groups);
+        ncac_remove_rules(rule_list);
+        free(rule_list);
+    }
+
+    ncac_cache_clear(nacm);
+    pthread_mutex_destroy(&nacm->users_lock);
+    free(nacm);
+}
+
+/**
+ * @brief Duplicate the configuration of a NACM snapshot, no cached users.
+ *
+ * @param[in] src NACM snapshot to duplicate.
+ * @return Duplicated snapshot with a single reference, NULL on error.
+ */
+static struct ncac *
+ncac_snapshot_dup(const struct ncac *src)
+{
+    struct ly_ctx *ly_ctx;
+    struct ncac *nacm;
+    struct ncac_group *group;
+    const struct ncac_rule_list *src_rlist;
+    struct ncac_rule_list *rlist, **rlist_p;
+    const struct ncac_rule *src_rule;
+    struct ncac_rule *rule, **rule_p;
+    uint32_t i, j;
+
+    ly_ctx = (struct ly_ctx *)sr_get_context(np2srv.sr_conn);
+
+    if (!(nacm = ncac_snapshot_new())) {
+        return NULL;
+    }
+
+    nacm->enabled = src->enabled;
+    nacm->default_read_deny = src->default_read_deny;
+    nacm->default_write_deny = src->default_write_deny;
+    nacm->default_exec_deny = src->default_exec_deny;
+    nacm->enable_external_groups = src->enable_external_groups;
+
+    /* groups */
+    if (src->group_count) {
+        nacm->groups = calloc(src->group_count, sizeof *nacm->groups);
+        if (!nacm->groups) {
+            goto error_mem;
+        }
+    }
+    for (i = 0; i < src->group_count; ++i) {
+        group = &nacm->groups[i];
+        if (src->groups[i].user_count) {
+            group->users = malloc(src->groups[i].user_count * sizeof *group->users);
+            if (!group->users) {
+                goto error_mem;
+            }
+        }
+        lydict_insert(ly_ctx, src->groups[i].name, 0, &group->name);
+        ++nacm->group_count;
+
+        for (j = 0; j < src->groups[i].user_count; ++j) {
+            lydict_insert(ly_ctx, src->groups[i].users[j], 0, (const char **)&group->users[j]);
+            ++group->user_count;
+        }
+    }
+
+    /* rule lists */
+    rlist_p = &nacm->rule_lists;
+    for (src_rlist = src->rule_lists; src_rlist; src_rlist = src_rlist->next) {
+        rlist = calloc(1, sizeof *rlist);
+        if (!rlist) {
+            goto error_mem;
+        }
+        *rlist_p = rlist;
+        rlist_p = &rlist->next;
+
+        lydict_insert(ly_ctx, src_rlist->name, 0, &rlist->name);
+        if (src_rlist->group_count) {
+            rlist->groups = malloc(src_rlist->group_count * sizeof *rlist->groups);
+            if (!rlist->groups) {
+                goto error_mem;
+            }
+        }
+        for (i = 0; i < src_rlist->group_count; ++i) {
+            lydict_insert(ly_ctx, src_rlist->groups[i], 0, (const char **)&rlist->groups[i]);
+            ++rlist->group_count;
+        }
+
+        /* rules */
+        rule_p = &rlist->rules;
+        for (src_rule = src_rlist->rules; src_rule; src_rule = src_rule->next) {
+            rule = calloc(1, sizeof *rule);
+            if (!rule) {
+                goto error_mem;
+            }
+            *rule_p = rule;
+            rule_p = &rule->next;
+
+            lydict_insert(ly_ctx, src_rule->name, 0, &rule->name);
+            lydict_insert(ly_ctx, src_rule->module_name, 0, &rule->module_name);
+            lydict_insert(ly_ctx, src_rule->target, 0, &rule->target);
+            rule->target_type = src_rule->target_type;
+            rule->operations = src_rule->operations;
+            rule->action_deny = src_rule->action_deny;
+            lydict_insert(ly_ctx, src_rule->comment, 0, &rule->comment);
+        }
+    }
+
+    return nacm;
+
+error_mem:
+    EMEM;
+    ncac_snapshot_free(nacm);
+    return NULL;
+}
+
+/**
+ * @brief Get a reference to the current NACM snapshot, no lock is needed.
+ *
+ * @return Current NACM snapshot, release it with ::ncac_snapshot_put().
+ */
+static struct ncac *
+ncac_snapshot_get(void)
+{
+    struct ncac *nacm;
+
+    /* let the writers know that the snapshot is being referenced */
+    ATOMIC_INC(nacm_acquiring);
+
+    nacm = ATOMIC_PTR_LOAD(nacm_cur);
+    ATOMIC_INC_RELAXED(nacm->ref_count);
+
+    ATOMIC_DEC(nacm_acquiring);
+
+    return nacm;
+}
+
+/**
+ * @brief Release a reference to a NACM snapshot, free it if it was the last one.
+ *
+ * @param[in] nacm NACM snapshot to release.
+ */
+static void
+ncac_snapshot_put(struct ncac *nacm)
+{
+    if (ATOMIC_DEC(nacm->ref_count) == 1) {
+        ncac_snapshot_free(nacm);
+    }
+}
+
+/**
+ * @brief Start modifying the NACM configuration, get a modifiable copy of the current snapshot.
+ *
+ * On success, NACM lock is held and the copy must be passed to ::ncac_snapshot_publish() or ::ncac_snapshot_abort().
+ *
+ * @return Modifiable NACM snapshot, NULL on error.
+ */
+static struct ncac *
+ncac_snapshot_edit(void)
+{
+    struct ncac *nacm;
+
+    /* NACM LOCK */
+    pthread_mutex_lock(&nacm_lock);
+
+    /* only writers change the current snapshot so no reference is needed */
+    nacm = ncac_snapshot_dup(ATOMIC_PTR_LOAD(nacm_cur));
+    if (!nacm) {
+        /* NACM UNLOCK */
+        pthread_mutex_unlock(&nacm_lock);
+    }
+
+    return nacm;
+}
+
+/**
+ * @brief Replace the current NACM snapshot with a modified one.
+ *
+ * @param[in] nacm Modified NACM snapshot from ::ncac_snapshot_edit().
+ */
+static void
+ncac_snapshot_publish(struct ncac *nacm)
+{
+    struct ncac *old;
+
+    old = ATOMIC_PTR_EXCHANGE(nacm_cur, nacm);
+
+    /* wait for all the readers that may have loaded the old snapshot without referencing it yet */
+    while (ATOMIC_LOAD(nacm_acquiring)) {
+        sched_yield();
+    }
+
+    /* NACM UNLOCK */
+    pthread_mutex_unlock(&nacm_lock);
+
+    ncac_snapshot_put(old);
+}
+
+/**
+ * @brief Discard a modified NACM snapshot, the current snapshot is kept.
+ *
+ * @param[in] nacm Modified NACM snapshot from ::ncac_snapshot_edit().
+ */
+static void
+ncac_snapshot_abort(struct ncac *nacm)
+{
+    /* NACM UNLOCK */
+    pthread_mutex_unlock(&nacm_lock);
+
+    ncac_snapshot_free(nacm);
+}
 
 /* /ietf-netconf-acm:nacm */
 int
 ncac_nacm_params_cb(sr_session_ctx_t *session, uint32_t UNUSED(sub_id), const char *UNUSED(module_name), const char *xpath,
         sr_event_t UNUSED(event), uint32_t UNUSED(request_id), void *UNUSED(private_data))
 {
+    struct ncac *nacm;
     sr_change_iter_t *iter;
     sr_change_oper_t op;
     const struct lyd_node *node;
@@ -57,56 +422,59 @@ ncac_nacm_params_cb(sr_session_ctx_t *session, uint32_t UNUSED(sub_id), const ch
         return rc;
     }
 
-    /* NACM LOCK */
-    pthread_mutex_lock(&nacm.lock);
+    /* NACM LOCK, modify a copy of the current snapshot */
+    if (!(nacm = ncac_snapshot_edit())) {
+        sr_free_change_iter(iter);
+        return SR_ERR_NO_MEMORY;
+    }
 
     while ((rc = sr_get_change_tree_next(session, iter, &op, &node, NULL, NULL, NULL)) == SR_ERR_OK) {
         term = (struct lyd_node_term *)node;
         if (!strcmp(node->schema->name, "enable-nacm")) {
             if ((op == SR_OP_CREATED) || (op == SR_OP_MODIFIED)) {
                 if (term->value.boolean) {
-                    nacm.enabled = 1;
+                    nacm->enabled = 1;
                 } else {
-                    nacm.enabled = 0;
+                    nacm->enabled = 0;
                 }
             }
         } else if (!strcmp(node->schema->name, "read-default")) {
             if ((op == SR_OP_CREATED) || (op == SR_OP_MODIFIED)) {
                 if (!strcmp(lyd_get_value(node), "permit")) {
-                    nacm.default_read_deny = 0;
+                    nacm->default_read_deny = 0;
                 } else {
-                    nacm.default_read_deny = 1;
+                    nacm->default_read_deny = 1;
                 }
             }
         } else if (!strcmp(node->schema->name, "write-default")) {
             if ((op == SR_OP_CREATED) || (op == SR_OP_MODIFIED)) {
                 if (!strcmp(lyd_get_value(node), "permit")) {
-                    nacm.default_write_deny = 0;
+                    nacm->default_write_deny = 0;
                 } else {
-                    nacm.default_write_deny = 1;
+                    nacm->default_write_deny = 1;
                 }
             }
         } else if (!strcmp(node->schema->name, "exec-default")) {
             if ((op == SR_OP_CREATED) || (op == SR_OP_MODIFIED)) {
                 if (!strcmp(lyd_get_value(node), "permit")) {
-                    nacm.default_exec_deny = 0;
+                    nacm->default_exec_deny = 0;
                 } else {
-                    nacm.default_exec_deny = 1;
+                    nacm->default_exec_deny = 1;
                 }
             }
         } else if (!strcmp(node->schema->name, "enable-external-groups")) {
             if ((op == SR_OP_CREATED) || (op == SR_OP_MODIFIED)) {
                 if (term->value.boolean) {
-                    nacm.enable_external_groups = 1;
+                    nacm->enable_external_groups = 1;
                 } else {
-                    nacm.enable_external_groups = 0;
+                    nacm->enable_external_groups = 0;
                 }
             }
         }
     }
 
-    /* NACM UNLOCK */
-    pthread_mutex_unlock(&nacm.lock);
+    /* NACM UNLOCK, publish the new snapshot */
+    ncac_snapshot_publish(nacm);
 
     sr_free_change_iter(iter);
     if (rc != SR_ERR_NOT_FOUND) {
@@ -127,24 +495,18 @@ ncac_oper_cb(sr_session_ctx_t *UNUSED(session), uint32_t UNUSED(sub_id), const c
 
     assert(*parent);
 
-    /* NACM LOCK */
-    pthread_mutex_lock(&nacm.lock);
-
     if (!strcmp(path, "/ietf-netconf-acm:nacm/denied-operations")) {
-        sprintf(num_str, "%u", nacm.denied_operations);
+        sprintf(num_str, "%" PRIu32, (uint32_t)ATOMIC_LOAD_RELAXED(nacm_stats.denied_operations));
         lyrc = lyd_new_path(*parent, NULL, "denied-operations", num_str, 0, NULL);
     } else if (!strcmp(path, "/ietf-netconf-acm:nacm/denied-data-writes")) {
-        sprintf(num_str, "%u", nacm.denied_data_writes);
+        sprintf(num_str, "%" PRIu32, (uint32_t)ATOMIC_LOAD_RELAXED(nacm_stats.denied_data_writes));
         lyrc = lyd_new_path(*parent, NULL, "denied-data-writes", num_str, 0, NULL);
     } else {
         assert(!strcmp(path, "/ietf-netconf-acm:nacm/denied-notifications"));
-        sprintf(num_str, "%u", nacm.denied_notifications);
+        sprintf(num_str, "%" PRIu32, (uint32_t)ATOMIC_LOAD_RELAXED(nacm_stats.denied_notifications));
         lyrc = lyd_new_path(*parent, NULL, "denied-notifications", num_str, 0, NULL);
     }
 
-    /* NACM UNLOCK */
-    pthread_mutex_unlock(&nacm.lock);
-
     if (lyrc) {
         return SR_ERR_INTERNAL;
     }
@@ -157,6 +519,7 @@ int
 ncac_group_cb(sr_session_ctx_t *session, uint32_t UNUSED(sub_id), const char *UNUSED(module_name), const char *xpath,
         sr_event_t UNUSED(event), uint32_t UNUSED(request_id), void *UNUSED(private_data))
 {
+    struct ncac *nacm;
     sr_change_iter_t *iter;
     sr_change_oper_t op;
     const struct lyd_node *node;
@@ -181,8 +544,11 @@ ncac_group_cb(sr_session_ctx_t *session, uint32_t UNUSED(sub_id), const char *UN
         return rc;
     }
 
-    /* NACM LOCK */
-    pthread_mutex_lock(&nacm.lock);
+    /* NACM LOCK, modify a copy of the current snapshot */
+    if (!(nacm = ncac_snapshot_edit())) {
+        sr_free_change_iter(iter);
+        return SR_ERR_NO_MEMORY;
+    }
 
     while ((rc = sr_get_change_tree_next(session, iter, &op, &node, NULL, NULL, NULL)) == SR_ERR_OK) {
         if (!strcmp(node->schema->name, "group")) {
@@ -193,17 +559,17 @@ ncac_group_cb(sr_session_ctx_t *session, uint32_t UNUSED(sub_id), const char *UN
             switch (op) {
             case SR_OP_CREATED:
                 /* add new group */
-                mem = realloc(nacm.groups, (nacm.group_count + 1) * sizeof *nacm.groups);
+                mem = realloc(nacm->groups, (nacm->group_count + 1) * sizeof *nacm->groups);
                 if (!mem) {
-                    /* NACM UNLOCK */
-                    pthread_mutex_unlock(&nacm.lock);
+                    /* NACM UNLOCK, discard the changes */
+                    ncac_snapshot_abort(nacm);
 
                     EMEM;
                     return SR_ERR_NO_MEMORY;
                 }
-                nacm.groups = mem;
-                group = &nacm.groups[nacm.group_count];
-                ++nacm.group_count;
+                nacm->groups = mem;
+                group = &nacm->groups[nacm->group_count];
+                ++nacm->group_count;
 
                 lydict_insert(ly_ctx, group_name, 0, &group->name);
                 group->users = NULL;
@@ -211,14 +577,14 @@ ncac_group_cb(sr_session_ctx_t *session, uint32_t UNUSED(sub_id), const char *UN
                 break;
             case SR_OP_DELETED:
                 /* find it */
-                for (i = 0; i < nacm.group_count; ++i) {
+                for (i = 0; i < nacm->group_count; ++i) {
                     /* both in dictionary */
-                    if (nacm.groups[i].name == group_name) {
-                        group = &nacm.groups[i];
+                    if (nacm->groups[i].name == group_name) {
+                        group = &nacm->groups[i];
                         break;
                     }
                 }
-                assert(i < nacm.group_count);
+                assert(i < nacm->group_count);
 
                 /* delete it */
                 lydict_remove(ly_ctx, group->name);
@@ -227,19 +593,19 @@ ncac_group_cb(sr_session_ctx_t *session, uint32_t UNUSED(sub_id), const char *UN
                 }
                 free(group->users);
 
-                --nacm.group_count;
-                if (i < nacm.group_count) {
-                    memcpy(group, &nacm.groups[nacm.group_count], sizeof *group);
+                --nacm->group_count;
+                if (i < nacm->group_count) {
+                    memcpy(group, &nacm->groups[nacm->group_count], sizeof *group);
                 }
-                if (!nacm.group_count) {
-                    free(nacm.groups);
-                    nacm.groups = NULL;
+                if (!nacm->group_count) {
+                    free(nacm->groups);
+                    nacm->groups = NULL;
                 }
                 group = NULL;
                 break;
             default:
-                /* NACM UNLOCK */
-                pthread_mutex_unlock(&nacm.lock);
+                /* NACM UNLOCK, discard the changes */
+                ncac_snapshot_abort(nacm);
 
                 EINT;
                 return SR_ERR_INTERNAL;
@@ -249,10 +615,10 @@ ncac_group_cb(sr_session_ctx_t *session, uint32_t UNUSED(sub_id), const char *UN
             assert(!strcmp(node->parent->child->schema->name, "name"));
             group_name = lyd_get_value(node->parent->child);
             group = NULL;
-            for (i = 0; i < nacm.group_count; ++i) {
+            for (i = 0; i < nacm->group_count; ++i) {
                 /* both in dictionary */
-                if (nacm.groups[i].name == group_name) {
-                    group = &nacm.groups[i];
+                if (nacm->groups[i].name == group_name) {
+                    group = &nacm->groups[i];
                     break;
                 }
             }
@@ -268,8 +634,8 @@ ncac_group_cb(sr_session_ctx_t *session, uint32_t UNUSED(sub_id), const char *UN
                 if (op == SR_OP_CREATED) {
                     mem = realloc(group->users, (group->user_count + 1) * sizeof *group->users);
                     if (!mem) {
-                        /* NACM UNLOCK */
-                        pthread_mutex_unlock(&nacm.lock);
+                        /* NACM UNLOCK, discard the changes */
+                        ncac_snapshot_abort(nacm);
 
                         EMEM;
                         return SR_ERR_NO_MEMORY;
@@ -302,8 +668,8 @@ ncac_group_cb(sr_session_ctx_t *session, uint32_t UNUSED(sub_id), const char *UN
         }
     }
 
-    /* NACM UNLOCK */
-    pthread_mutex_unlock(&nacm.lock);
+    /* NACM UNLOCK, publish the new snapshot */
+    ncac_snapshot_publish(nacm);
 
     sr_free_change_iter(iter);
     if (rc != SR_ERR_NOT_FOUND) {
@@ -314,29 +680,6 @@ ncac_group_cb(sr_session_ctx_t *session, uint32_t UNUSED(sub_id), const char *UN
     return SR_ERR_OK;
 }
 
-/**
- * @brief Remove all rules from a rule list.
- *
- * @param[in,out] list Rule list to remove from.
- */
-static void
-ncac_remove_rules(struct ncac_rule_list *list)
-{
-    struct ncac_rule *rule, *tmp;
-    struct ly_ctx *ly_ctx;
-
-    ly_ctx = (struct ly_ctx *)sr_get_context(np2srv.sr_conn);
-
-    LY_LIST_FOR_SAFE(list->rules, tmp, rule) {
-        lydict_remove(ly_ctx, rule->name);
-        lydict_remove(ly_ctx, rule->module_name);
-        lydict_remove(ly_ctx, rule->target);
-        lydict_remove(ly_ctx, rule->comment);
-        free(rule);
-    }
-    list->rules = NULL;
-}
-
 /**
  * @brief Get pointer to an item on a specific index.
  *
@@ -493,6 +836,7 @@ int
 ncac_rule_list_cb(sr_session_ctx_t *session, uint32_t UNUSED(sub_id), const char *UNUSED(module_name), const char *xpath,
         sr_event_t UNUSED(event), uint32_t UNUSED(request_id), void *UNUSED(private_data))
 {
+    struct ncac *nacm;
     sr_change_iter_t *iter;
     sr_change_oper_t op;
     const struct lyd_node *node;
@@ -516,8 +860,11 @@ ncac_rule_list_cb(sr_session_ctx_t *session, uint32_t UNUSED(sub_id), const char
         return rc;
     }
 
-    /* NACM LOCK */
-    pthread_mutex_lock(&nacm.lock);
+    /* NACM LOCK, modify a copy of the current snapshot */
+    if (!(nacm = ncac_snapshot_edit())) {
+        sr_free_change_iter(iter);
+        return SR_ERR_NO_MEMORY;
+    }
 
     while ((rc = sr_get_change_tree_next(session, iter, &op, &node, NULL, &prev_list, NULL)) == SR_ERR_OK) {
         if (!strcmp(node->schema->name, "rule-list")) {
@@ -529,7 +876,7 @@ ncac_rule_list_cb(sr_session_ctx_t *session, uint32_t UNUSED(sub_id), const char
             case SR_OP_MOVED:
                 /* find it */
                 prev_rlist = NULL;
-                for (rlist = nacm.rule_lists; rlist && (rlist->name != rlist_name); rlist = rlist->next) {
+                for (rlist = nacm->rule_lists; rlist && (rlist->name != rlist_name); rlist = rlist->next) {
                     prev_rlist = rlist;
                 }
                 assert(rlist);
@@ -538,7 +885,7 @@ ncac_rule_list_cb(sr_session_ctx_t *session, uint32_t UNUSED(sub_id), const char
                 if (prev_rlist) {
                     prev_rlist->next = rlist->next;
                 } else {
-                    nacm.rule_lists = rlist->next;
+                    nacm->rule_lists = rlist->next;
                 }
             /* fallthrough */
             case SR_OP_CREATED:
@@ -546,8 +893,8 @@ ncac_rule_list_cb(sr_session_ctx_t *session, uint32_t UNUSED(sub_id), const char
                     /* create new rule list */
                     rlist = calloc(1, sizeof *rlist);
                     if (!rlist) {
-                        /* NACM UNLOCK */
-                        pthread_mutex_unlock(&nacm.lock);
+                        /* NACM UNLOCK, discard the changes */
+                        ncac_snapshot_abort(nacm);
 
                         EMEM;
                         return SR_ERR_NO_MEMORY;
@@ -561,7 +908,7 @@ ncac_rule_list_cb(sr_session_ctx_t *session, uint32_t UNUSED(sub_id), const char
                     assert(strchr(prev_list, '\''));
                     prev_list = strchr(prev_list, '\'') + 1;
                     len = strchr(prev_list, '\'') - prev_list;
-                    prev_rlist = nacm.rule_lists;
+                    prev_rlist = nacm->rule_lists;
                     while (prev_rlist && strncmp(prev_rlist->name, prev_list, len)) {
                         prev_rlist = prev_rlist->next;
                     }
@@ -575,14 +922,14 @@ ncac_rule_list_cb(sr_session_ctx_t *session, uint32_t UNUSED(sub_id), const char
                     rlist->next = prev_rlist->next;
                     prev_rlist->next = rlist;
                 } else {
-                    rlist->next = nacm.rule_lists;
-                    nacm.rule_lists = rlist;
+                    rlist->next = nacm->rule_lists;
+                    nacm->rule_lists = rlist;
                 }
                 break;
             case SR_OP_DELETED:
                 /* find it */
                 prev_rlist = NULL;
-                for (rlist = nacm.rule_lists; rlist && (rlist->name != rlist_name); rlist = rlist->next) {
+                for (rlist = nacm->rule_lists; rlist && (rlist->name != rlist_name); rlist = rlist->next) {
                     prev_rlist = rlist;
                 }
                 assert(rlist);
@@ -597,14 +944,14 @@ ncac_rule_list_cb(sr_session_ctx_t *session, uint32_t UNUSED(sub_id), const char
                 if (prev_rlist) {
                     prev_rlist->next = rlist->next;
                 } else {
-                    nacm.rule_lists = rlist->next;
+                    nacm->rule_lists = rlist->next;
                 }
                 free(rlist);
                 rlist = NULL;
                 break;
             default:
-                /* NACM UNLOCK */
-                pthread_mutex_unlock(&nacm.lock);
+                /* NACM UNLOCK, discard the changes */
+                ncac_snapshot_abort(nacm);
 
                 EINT;
                 return SR_ERR_INTERNAL;
@@ -613,7 +960,7 @@ ncac_rule_list_cb(sr_session_ctx_t *session, uint32_t UNUSED(sub_id), const char
             /* name must be present */
             assert(!strcmp(node->parent->child->schema->name, "name"));
             rlist_name = lyd_get_value(node->parent->child);
-            for (rlist = nacm.rule_lists; rlist && (rlist->name != rlist_name); rlist = rlist->next) {}
+            for (rlist = nacm->rule_lists; rlist && (rlist->name != rlist_name); rlist = rlist->next) {}
 
             if (!strcmp(node->schema->name, "group")) {
                 if ((op == SR_OP_DELETED) && !rlist) {
@@ -626,8 +973,8 @@ ncac_rule_list_cb(sr_session_ctx_t *session, uint32_t UNUSED(sub_id), const char
                 if (op == SR_OP_CREATED) {
                     if ((rc = ncac_strarr_sort_add(ly_ctx, &group_name, sizeof rlist->groups, 0, &rlist->groups,
                             &rlist->group_count))) {
-                        /* NACM UNLOCK */
-                        pthread_mutex_unlock(&nacm.lock);
+                        /* NACM UNLOCK, discard the changes */
+                        ncac_snapshot_abort(nacm);
                         return rc;
                     }
                 } else {
@@ -638,8 +985,8 @@ ncac_rule_list_cb(sr_session_ctx_t *session, uint32_t UNUSED(sub_id), const char
         }
     }
 
-    /* NACM UNLOCK */
-    pthread_mutex_unlock(&nacm.lock);
+    /* NACM UNLOCK, publish the new snapshot */
+    ncac_snapshot_publish(nacm);
 
     sr_free_change_iter(iter);
     if (rc != SR_ERR_NOT_FOUND) {
@@ -655,6 +1002,7 @@ int
 ncac_rule_cb(sr_session_ctx_t *session, uint32_t UNUSED(sub_id), const char *UNUSED(module_name), const char *xpath,
         sr_event_t UNUSED(event), uint32_t UNUSED(request_id), void *UNUSED(private_data))
 {
+    struct ncac *nacm;
     sr_change_iter_t *iter;
     sr_change_oper_t op;
     const struct lyd_node *node;
@@ -678,15 +1026,18 @@ ncac_rule_cb(sr_session_ctx_t *session, uint32_t UNUSED(sub_id), const char *UNU
         return rc;
     }
 
-    /* NACM LOCK */
-    pthread_mutex_lock(&nacm.lock);
+    /* NACM LOCK, modify a copy of the current snapshot */
+    if (!(nacm = ncac_snapshot_edit())) {
+        sr_free_change_iter(iter);
+        return SR_ERR_NO_MEMORY;
+    }
 
     while ((rc = sr_get_change_tree_next(session, iter, &op, &node, NULL, &prev_list, NULL)) == SR_ERR_OK) {
         if (!strcmp(node->schema->name, "rule")) {
             /* find parent rule list */
             assert(!strcmp(node->parent->child->schema->name, "name"));
             rlist_name = lyd_get_value(node->parent->child);
-            for (rlist = nacm.rule_lists; rlist && (rlist->name != rlist_name); rlist = rlist->next) {}
+            for (rlist = nacm->rule_lists; rlist && (rlist->name != rlist_name); rlist = rlist->next) {}
             if ((op == SR_OP_DELETED) && !rlist) {
                 /* even parent rule-list was deleted */
                 continue;
@@ -720,8 +1071,8 @@ ncac_rule_cb(sr_session_ctx_t *session, uint32_t UNUSED(sub_id), const char *UNU
                     if (!rule) {
                         EMEM;
 
-                        /* NACM UNLOCK */
-                        pthread_mutex_unlock(&nacm.lock);
+                        /* NACM UNLOCK, discard the changes */
+                        ncac_snapshot_abort(nacm);
                         return SR_ERR_NO_MEMORY;
                     }
                     lydict_insert(ly_ctx, rule_name, 0, &rule->name);
@@ -774,8 +1125,8 @@ ncac_rule_cb(sr_session_ctx_t *session, uint32_t UNUSED(sub_id), const char *UNU
                 free(rule);
                 break;
             default:
-                /* NACM UNLOCK */
-                pthread_mutex_unlock(&nacm.lock);
+                /* NACM UNLOCK, discard the changes */
+                ncac_snapshot_abort(nacm);
 
                 EINT;
                 return SR_ERR_INTERNAL;
@@ -784,7 +1135,7 @@ ncac_rule_cb(sr_session_ctx_t *session, uint32_t UNUSED(sub_id), const char *UNU
             /* find parent rule list */
             assert(!strcmp(node->parent->parent->child->schema->name, "name"));
             rlist_name = lyd_get_value(node->parent->parent->child);
-            for (rlist = nacm.rule_lists; rlist && (rlist->name != rlist_name); rlist = rlist->next) {}
+            for (rlist = nacm->rule_lists; rlist && (rlist->name != rlist_name); rlist = rlist->next) {}
             if ((op == SR_OP_DELETED) && !rlist) {
                 /* even parent rule-list was deleted */
                 continue;
@@ -873,8 +1224,8 @@ ncac_rule_cb(sr_session_ctx_t *session, uint32_t UNUSED(sub_id), const char *UNU
         }
     }
 
-    /* NACM UNLOCK */
-    pthread_mutex_unlock(&nacm.lock);
+    /* NACM UNLOCK, publish the new snapshot */
+    ncac_snapshot_publish(nacm);
 
     sr_free_change_iter(iter);
     if (rc != SR_ERR_NOT_FOUND) {
@@ -885,112 +1236,65 @@ ncac_rule_cb(sr_session_ctx_t *session, uint32_t UNUSED(sub_id), const char *UNU
     return SR_ERR_OK;
 }
 
-void
+int
 ncac_init(void)
 {
-    pthread_mutex_init(&nacm.lock, NULL);
-}
-
-void
-ncac_destroy(void)
-{
-    struct ncac_group *group;
-    struct ncac_rule_list *rule_list, *tmp;
-    struct ly_ctx *ly_ctx;
-    uint32_t i, j;
-
-    ly_ctx = (struct ly_ctx *)sr_get_context(np2srv.sr_conn);
+    struct ncac *nacm;
 
-    for (i = 0; i < nacm.group_count; ++i) {
-        group = &nacm.groups[i];
-        lydict_remove(ly_ctx, group->name);
-        for (j = 0; j < group->user_count; ++j) {
-            lydict_remove(ly_ctx, group->users[j]);
-        }
-        free(group->users);
-    }
-    free(nacm.groups);
-
-    LY_LIST_FOR_SAFE(nacm.rule_lists, tmp, rule_list) {
-        lydict_remove(ly_ctx, rule_list->name);
-        for (i = 0; i < rule_list->group_count; ++i) {
-            lydict_remove(ly_ctx, rule_list->groups[i]);
-        }
-        free(rule_list->groups);
-        ncac_remove_rules(rule_list);
-        free(rule_list);
+    if (!(nacm = ncac_snapshot_new())) {
+        return -1;
     }
+    ATOMIC_PTR_STORE(nacm_cur, nacm);
 
-    pthread_mutex_destroy(&nacm.lock);
+    return 0;
 }
 
-/**
- * @brief Get passwd entry of a user, specifically its UID and GID.
- *
- * @param[in] user User to learn about.
- * @param[out] uid User UID, if set.
- * @param[out] gid User GID, if set.
- * @return 0 on success, 1 on user not found, -1 on error.
- */
-static int
-ncac_getpwnam(const char *user, uid_t *uid, gid_t *gid)
+int
+ncac_user_cache_clear(void)
 {
-    struct passwd pwd, *pwd_p;
-    char *buf = NULL;
-    ssize_t buflen;
-    int ret;
-
-    assert(user);
+    struct ncac *nacm;
 
-    buflen = sysconf(_SC_GETPW_R_SIZE_MAX);
-    if (buflen == -1) {
-        buflen = 2048;
-    }
-    buf = malloc(buflen);
-    if (!buf) {
-        EMEM;
+    /* the copy of the current snapshot has no cached users */
+    if (!(nacm = ncac_snapshot_edit())) {
         return -1;
     }
-    ret = getpwnam_r(user, &pwd, buf, buflen, &pwd_p);
-    if (ret) {
-        ERR("Getting user \"%s\" pwd entry failed (%s).", user, strerror(ret));
-        free(buf);
-        return -1;
-    } else if (!pwd_p) {
-        free(buf);
-        return 1;
-    }
+    ncac_snapshot_publish(nacm);
 
-    if (uid) {
-        *uid = pwd.pw_uid;
-    }
-    if (gid) {
-        *gid = pwd.pw_gid;
-    }
-    free(buf);
     return 0;
 }
 
+void
+ncac_destroy(void)
+{
+    struct ncac *nacm;
+
+    nacm = ATOMIC_PTR_EXCHANGE(nacm_cur, NULL);
+    if (nacm) {
+        ncac_snapshot_put(nacm);
+    }
+}
+
 /**
  * @brief Check NACM acces for the data tree. If this check passes, no other check is necessary.
  * If not, each node must be checked separately to decide.
  *
+ * @param[in] nacm NACM snapshot.
  * @param[in] root Root schema node of the data subtree.
  * @param[in] user User, whose access to check.
  * @return non-zero if access allowed, 0 if more checks are required.
  */
 static int
-ncac_allowed_tree(const struct lysc_node *root, const char *user)
+ncac_allowed_tree(const struct ncac *nacm, const struct lysc_node *root, const char *user)
 {
     uid_t user_uid;
 
     /* 1) NACM is off */
-    if (!nacm.enabled) {
+    if (!nacm->enabled) {
         return 1;
     }
 
     /* 2) recovery session allowed */
-    if (!ncac_getpwnam(user, &user_uid, NULL) && (user_uid == NP2SRV_NACM_RECOVERY_UID)) {
+    if (!np_user_getpw(user, &user_uid, NULL, NULL) && (user_uid == NP2SRV_NACM_RECOVERY_UID)) {
         return 1;
     }
 
@@ -1016,6 +1320,7 @@ ncac_allowed_tree(const struct lysc_node *root, const char *user)
 /**
  * @brief Collect all NACM groups for a user. If enabled, even system ones.
  *
+ * @param[in] nacm NACM snapshot.
  * @param[in] ly_ctx libyang context for dictionary.
  * @param[in] user User to collect groups for.
  * @param[out] groups Sorted array of collected groups.
@@ -1023,16 +1328,13 @@ ncac_allowed_tree(const struct lysc_node *root, const char *user)
  * @return 0 on success, -1 on error.
  */
 static int
-ncac_collect_groups(const struct ly_ctx *ly_ctx, const char *user, char ***groups, uint32_t *group_count)
+ncac_collect_groups(const struct ncac *nacm, const struct ly_ctx *ly_ctx, const char *user, char ***groups,
+        uint32_t *group_count)
 {
-    struct group grp, *grp_p;
-    gid_t user_gid;
     const char *user_dict = NULL;
-    char *buf = NULL;
-    gid_t *gids = NULL;
-    ssize_t buflen;
-    uint32_t i, j;
-    int gid_count = 0, ret, rc = -1;
+    char **sys_groups = NULL;
+    uint32_t i, j, sys_group_count = 0;
+    int ret, rc = -1;
 
     lydict_insert(ly_ctx, user, 0, &user_dict);
 
@@ -1040,10 +1342,10 @@ ncac_collect_groups(const struct ly_ctx *ly_ctx, const char *user, char ***group
     *group_count = 0;
 
     /* collect NACM groups */
-    for (i = 0; i < nacm.group_count; ++i) {
-        for (j = 0; j < nacm.groups[i].user_count; ++j) {
-            if (nacm.groups[i].users[j] == user_dict) {
-                if (ncac_strarr_sort_add(ly_ctx, &nacm.groups[i].name, sizeof **groups, 0, groups, group_count)) {
+    for (i = 0; i < nacm->group_count; ++i) {
+        for (j = 0; j < nacm->groups[i].user_count; ++j) {
+            if (nacm->groups[i].users[j] == user_dict) {
+                if (ncac_strarr_sort_add(ly_ctx, &nacm->groups[i].name, sizeof **groups, 0, groups, group_count)) {
                     goto cleanup;
                 }
             }
@@ -1051,8 +1353,8 @@ ncac_collect_groups(const struct ly_ctx *ly_ctx, const char *user, char ***group
     }
 
     /* collect system groups */
-    if (nacm.enable_external_groups) {
-        ret = ncac_getpwnam(user, NULL, &user_gid);
+    if (nacm->enable_external_groups) {
+        ret = np_user_getgroups(user, &sys_groups, &sys_group_count);
         if (ret) {
             if (ret == 1) {
                 /* no user, no more groups */
@@ -1061,42 +1363,9 @@ ncac_collect_groups(const struct ly_ctx *ly_ctx, const char *user, char ***group
             goto cleanup;
         }
 
-        /* get all GIDs */
-        getgrouplist(user, user_gid, gids, &gid_count);
-        gids = malloc(gid_count * sizeof *gids);
-        if (!gids) {
-            EMEM;
-            goto cleanup;
-        }
-        ret = getgrouplist(user, user_gid, gids, &gid_count);
-        if (ret == -1) {
-            ERR("Getting system groups of user \"%s\" failed.", user);
-            goto cleanup;
-        }
-
-        /* add all GIDs group names */
-        buflen = sysconf(_SC_GETGR_R_SIZE_MAX);
-        if (buflen == -1) {
-            buflen = 2048;
-        }
-        free(buf);
-        buf = malloc(buflen);
-        if (!buf) {
-            EMEM;
-            goto cleanup;
-        }
-        for (i = 0; i < (unsigned)gid_count; ++i) {
-            ret = getgrgid_r(gids[i], &grp, buf, buflen, &grp_p);
-            if (ret) {
-                ERR("Getting GID grp entry failed (%s).", strerror(ret));
-                goto cleanup;
-            } else if (!grp_p) {
-                ERR("Getting GID grp entry failed (Group not found).");
-                goto cleanup;
-            }
-
+        for (i = 0; i < sys_group_count; ++i) {
             /* add, if not already there */
-            if (ncac_strarr_sort_add(ly_ctx, (const char **)&grp.gr_name, sizeof **groups, 1, groups, group_count)) {
+            if (ncac_strarr_sort_add(ly_ctx, (const char **)&sys_groups[i], sizeof **groups, 1, groups, group_count)) {
                 goto cleanup;
             }
         }
@@ -1106,8 +1375,10 @@ ncac_collect_groups(const struct ly_ctx *ly_ctx, const char *user, char ***group
     rc = 0;
 
 cleanup:
-    free(gids);
-    free(buf);
+    for (i = 0; i < sys_group_count; ++i) {
+        free(sys_groups[i]);
+    }
+    free(sys_groups);
     lydict_remove(ly_ctx, user_dict);
     return rc;
 }
@@ -1205,44 +1476,170 @@ ncac_rule_group_match(struct ncac_rule_list *rlist, char **groups, uint32_t grou
 }
 
 /**
- * @brief Free all NACM groups. Supposed to be called after @ref ncac_collect_group.
+ * @brief Find a cached user and reference it. Users lock is expected to be held.
  *
- * @param[out] groups Sorted array of collected groups to free
- * @param[out] group_count Number of @p groups.
+ * @param[in] nacm NACM snapshot.
+ * @param[in] user User to find.
+ * @return Referenced cached user, NULL if not cached.
  */
-static void
-ncac_free_groups(char **groups, uint32_t group_count)
+static struct ncac_user *
+ncac_user_find(struct ncac *nacm, const char *user)
 {
+    struct ncac_user *nuser;
     uint32_t i;
 
-    if (!groups) {
-        return;
+    for (i = 0; i < nacm->user_count; ++i) {
+        nuser = nacm->users[i];
+        if (strcmp(nuser->name, user)) {
+            continue;
+        }
+
+        if (nacm->enable_external_groups && (time(NULL) > nuser->created + NP2SRV_NACM_USER_CACHE_TIMEOUT)) {
+            /* system groups of the user may have changed, collect everything again */
+            --nacm->user_count;
+            memmove(&nacm->users[i], &nacm->users[i + 1], (nacm->user_count - i) * sizeof *nacm->users);
+            ncac_user_put(nuser);
+            return NULL;
+        }
+
+        ATOMIC_INC_RELAXED(nuser->ref_count);
+        return nuser;
     }
 
-    for (i = 0; i < group_count; ++i) {
-        lydict_remove(sr_get_context(np2srv.sr_conn), groups[i]);
+    return NULL;
+}
+
+/**
+ * @brief Get cached NACM information of a user, collect it if not cached.
+ *
+ * @param[in] nacm NACM snapshot.
+ * @param[in] user User to get.
+ * @return Referenced cached user to be released by ::ncac_user_put(), NULL on error.
+ */
+static struct ncac_user *
+ncac_user_get(struct ncac *nacm, const char *user)
+{
+    const struct ly_ctx *ly_ctx = sr_get_context(np2srv.sr_conn);
+    struct ncac_user *nuser = NULL, *cur;
+    struct ncac_rule_list *rlist;
+    struct ncac_rule *rule;
+    void *mem;
+
+    /* USERS LOCK */
+    pthread_mutex_lock(&nacm->users_lock);
+
+    if (nacm->ctx_change_count != ly_ctx_get_change_count(ly_ctx)) {
+        /* schema nodes of the cached decisions may no longer exist */
+        ncac_cache_clear(nacm);
+        nacm->ctx_change_count = ly_ctx_get_change_count(ly_ctx);
+    }
+
+    cur = ncac_user_find(nacm, user);
+
+    /* USERS UNLOCK */
+    pthread_mutex_unlock(&nacm->users_lock);
+
+    if (cur) {
+        return cur;
+    }
+
+    /* new user, collect everything without holding the lock */
+    nuser = calloc(1, sizeof *nuser);
+    if (!nuser) {
+        EMEM;
+        goto error;
+    }
+    nuser->name = strdup(user);
+    nuser->decisions = calloc(NP2SRV_NACM_DECISION_CACHE_SIZE, sizeof *nuser->decisions);
+    if (!nuser->name || !nuser->decisions) {
+        EMEM;
+        goto error;
+    }
+    nuser->created = time(NULL);
+
+    /* collect groups */
+    if (ncac_collect_groups(nacm, ly_ctx, user, &nuser->groups, &nuser->group_count)) {
+        goto error;
+    }
+
+    /* resolve the rules of all the matching rule lists */
+    for (rlist = nacm->rule_lists; nuser->group_count && rlist; rlist = rlist->next) {
+        if (!ncac_rule_group_match(rlist, nuser->groups, nuser->group_count)) {
+            /* no group match */
+            continue;
+        }
+
+        for (rule = rlist->rules; rule; rule = rule->next) {
+            mem = realloc(nuser->rules, (nuser->rule_count + 1) * sizeof *nuser->rules);
+            if (!mem) {
+                EMEM;
+                goto error;
+            }
+            nuser->rules = mem;
+            nuser->rules[nuser->rule_count] = rule;
+            ++nuser->rule_count;
+        }
     }
-    free(groups);
+
+    /* referenced by the cache and the caller */
+    ATOMIC_STORE_RELAXED(nuser->ref_count, 2);
+
+    /* USERS LOCK */
+    pthread_mutex_lock(&nacm->users_lock);
+
+    if ((cur = ncac_user_find(nacm, user))) {
+        /* cached by another thread in the meantime, USERS UNLOCK */
+        pthread_mutex_unlock(&nacm->users_lock);
+        ncac_user_free(nuser);
+        return cur;
+    }
+
+    /* cache it, evict the oldest user if full */
+    if (nacm->user_count == NP2SRV_NACM_USER_CACHE_SIZE) {
+        ncac_user_put(nacm->users[0]);
+        --nacm->user_count;
+        memmove(&nacm->users[0], &nacm->users[1], nacm->user_count * sizeof *nacm->users);
+    } else {
+        mem = realloc(nacm->users, (nacm->user_count + 1) * sizeof *nacm->users);
+        if (!mem) {
+            /* USERS UNLOCK */
+            pthread_mutex_unlock(&nacm->users_lock);
+            EMEM;
+            goto error;
+        }
+        nacm->users = mem;
+    }
+    nacm->users[nacm->user_count] = nuser;
+    ++nacm->user_count;
+
+    /* USERS UNLOCK */
+    pthread_mutex_unlock(&nacm->users_lock);
+
+    return nuser;
+
+error:
+    ncac_user_free(nuser);
+    return NULL;
 }
 
 /**
  * @brief Check NACM access for a single node.
  *
+ * @param[in] nacm NACM snapshot.
  * @param[in] node Node to check. Can be NULL if @p node_path and @p node_schema are set.
  * @param[in] node_path Node path of the node to check. Can be NULL if @p node is set.
  * @param[in] node_schema Schema of the node to check. Can be NULL if @p node is set.
  * @param[in] oper Operation to check.
- * @param[in] groups Array of groups name to be checked for permissions
- * @param[in] group_count Length of @p groups
+ * @param[in] nuser Cached user with the rules to be checked.
  * @return NCAC access enum.
  */
 static enum ncac_access
-ncac_allowed_node(const struct lyd_node *node, const char *node_path, const struct lysc_node *node_schema,
-        uint8_t oper, char **groups, uint32_t group_count)
+ncac_allowed_node(const struct ncac *nacm, const struct lyd_node *node, const char *node_path,
+        const struct lysc_node *node_schema, uint8_t oper, const struct ncac_user *nuser)
 {
-    struct ncac_rule_list *rlist;
     struct ncac_rule *rule;
-    char *path;
+    char *path = NULL;
+    uint32_t i;
     enum ncac_access access = NCAC_ACCESS_DENY;
 
     enum {
@@ -1264,89 +1661,79 @@ ncac_allowed_node(const struct lyd_node *node, const char *node_path, const stru
      * ref https://tools.ietf.org/html/rfc8341#section-3.4.4
      */
 
-    /* 4) collected groups passed as argument */
+    /* 4) groups collected in the cached user */
 
-    /* 5) no groups */
-    if (!group_count) {
-        goto step10;
-    }
+    /* 5) no groups and 6) matching rule lists were resolved into the cached user rules */
 
-    /* 6) find matching rule lists */
-    for (rlist = nacm.rule_lists; rlist; rlist = rlist->next) {
-        if (!ncac_rule_group_match(rlist, groups, group_count)) {
-            /* no group match */
+    /* 7) find matching rules */
+    for (i = 0; i < nuser->rule_count; ++i) {
+        rule = nuser->rules[i];
+
+        /* access operation matching */
+        if (!(rule->operations & oper)) {
             continue;
         }
 
-        /* 7) find matching rules */
-        for (rule = rlist->rules; rule; rule = rule->next) {
-            /* access operation matching */
-            if (!(rule->operations & oper)) {
+        /* target (rule) type matching */
+        switch (rule->target_type) {
+        case NCAC_TARGET_RPC:
+            if (node_schema->nodetype != LYS_RPC) {
                 continue;
             }
-
-            /* target (rule) type matching */
-            switch (rule->target_type) {
-            case NCAC_TARGET_RPC:
-                if (node_schema->nodetype != LYS_RPC) {
-                    continue;
-                }
-                if (rule->target && (rule->target != node_schema->name)) {
-                    /* exact match needed */
-                    continue;
-                }
-                break;
-            case NCAC_TARGET_NOTIF:
-                /* only top-level notification */
-                if (node_schema->parent || (node_schema->nodetype != LYS_NOTIF)) {
-                    continue;
+            if (rule->target && (rule->target != node_schema->name)) {
+                /* exact match needed */
+                continue;
+            }
+            break;
+        case NCAC_TARGET_NOTIF:
+            /* only top-level notification */
+            if (node_schema->parent || (node_schema->nodetype != LYS_NOTIF)) {
+                continue;
+            }
+            if (rule->target && (rule->target != node_schema->name)) {
+                /* exact match needed */
+                continue;
+            }
+            break;
+        case NCAC_TARGET_DATA:
+            if (node_schema->nodetype & (LYS_RPC | LYS_NOTIF)) {
+                continue;
+            }
+        /* fallthrough */
+        case NCAC_TARGET_ANY:
+            if (rule->target) {
+                /* exact match or is a descendant (specified in RFC 8341 page 27) for full tree access */
+                if (!node_path) {
+                    path = lyd_path(node, LYD_PATH_STD, NULL, 0);
+                    path_match = ncac_allowed_path(rule->target, path);
+                    free(path);
+                } else {
+                    path_match = ncac_allowed_path(rule->target, node_path);
                 }
-                if (rule->target && (rule->target != node_schema->name)) {
-                    /* exact match needed */
+
+                if (!path_match) {
                     continue;
-                }
-                break;
-            case NCAC_TARGET_DATA:
-                if (node_schema->nodetype & (LYS_RPC | LYS_NOTIF)) {
+                } else if (path_match == 2) {
+                    /* partial match, continue searching for a full match */
+                    partial_access |= rule->action_deny ? RULE_PARTIAL_MATCH_DENY : RULE_PARTIAL_MATCH_PERMIT;
                     continue;
                 }
-            /* fallthrough */
-            case NCAC_TARGET_ANY:
-                if (rule->target) {
-                    /* exact match or is a descendant (specified in RFC 8341 page 27) for full tree access */
-                    if (!node_path) {
-                        path = lyd_path(node, LYD_PATH_STD, NULL, 0);
-                        path_match = ncac_allowed_path(rule->target, path);
-                        free(path);
-                    } else {
-                        path_match = ncac_allowed_path(rule->target, node_path);
-                    }
-
-                    if (!path_match) {
-                        continue;
-                    } else if (path_match == 2) {
-                        /* partial match, continue searching for a full match */
-                        partial_access |= rule->action_deny ? RULE_PARTIAL_MATCH_DENY : RULE_PARTIAL_MATCH_PERMIT;
-                        continue;
-                    }
-                }
-                break;
-            }
-
-            /* module name matching, after partial path matches */
-            if (rule->module_name && (rule->module_name != node_schema->module->name)) {
-                continue;
             }
+            break;
+        }
 
-            /* 8) rule matched */
-            access = rule->action_deny ? NCAC_ACCESS_DENY : NCAC_ACCESS_PERMIT;
-            goto cleanup;
+        /* module name matching, after partial path matches */
+        if (rule->module_name && (rule->module_name != node_schema->module->name)) {
+            continue;
         }
+
+        /* 8) rule matched */
+        access = rule->action_deny ? NCAC_ACCESS_DENY : NCAC_ACCESS_PERMIT;
+        goto cleanup;
     }
 
     /* 9) no matching rule found */
 
-step10:
     /* 10) check default-deny-all extension */
     LY_ARRAY_FOR(node_schema->exts, u) {
         if (!strcmp(node_schema->exts[u].def->module->name, "ietf-netconf-acm")) {
@@ -1365,7 +1752,7 @@ step10:
     /* 12) check defaults */
     switch (oper) {
     case NCAC_OP_READ:
-        if (nacm.default_read_deny) {
+        if (nacm->default_read_deny) {
             access = NCAC_ACCESS_DENY;
         } else {
             /* permit, but not by an explicit rule */
@@ -1375,7 +1762,7 @@ step10:
     case NCAC_OP_CREATE:
     case NCAC_OP_UPDATE:
     case NCAC_OP_DELETE:
-        if (nacm.default_write_deny) {
+        if (nacm->default_write_deny) {
             access = NCAC_ACCESS_DENY;
         } else {
             /* permit, but not by an explicit rule */
@@ -1383,7 +1770,7 @@ step10:
         }
         break;
     case NCAC_OP_EXEC:
-        if (nacm.default_exec_deny) {
+        if (nacm->default_exec_deny) {
             access = NCAC_ACCESS_DENY;
         } else {
             /* permit, but not by an explicit rule */
@@ -1396,6 +1783,7 @@ step10:
     }
 
 cleanup:
+    free(path);
     if ((access == NCAC_ACCESS_DENY) && (partial_access & RULE_PARTIAL_MATCH_PERMIT)) {
         /* node itself is not allowed but a rule allows access to some descendants so it may be allowed at the end */
         access = NCAC_ACCESS_PARTIAL_DENY;
@@ -1406,24 +1794,193 @@ cleanup:
     return access;
 }
 
+/**
+ * @brief Check whether a NACM access decision for a node may depend on the data instance, not just its schema node.
+ *
+ * That is the case if a rule with an instance-identifier target with predicates may match the node.
+ *
+ * @param[in] nuser Cached user with the rules.
+ * @param[in] schema Schema node of the node.
+ * @param[in] schema_path Data path of @p schema (with no predicates).
+ * @param[in] oper Operation to check.
+ * @return 0 if the decision depends only on @p schema;
+ * @return 1 if the decision may depend on the data instance;
+ * @return -1 on error.
+ */
+static int
+ncac_decision_instance_dependent(const struct ncac_user *nuser, const struct lysc_node *schema, const char *schema_path,
+        uint8_t oper)
+{
+    const struct lysc_node *parent;
+    const struct ncac_rule *rule;
+    const char *ptr;
+    char *target, *t;
+    uint32_t i;
+    int match;
+
+    for (parent = schema; parent; parent = parent->parent) {
+        if (parent->nodetype & (LYS_RPC | LYS_ACTION | LYS_NOTIF)) {
+            /* paths of nodes in operations are not generated the same way, never cache */
+            return 1;
+        }
+    }
+
+    for (i = 0; i < nuser->rule_count; ++i) {
+        rule = nuser->rules[i];
+        if (!(rule->operations & oper) || ((rule->target_type != NCAC_TARGET_DATA) &&
+                (rule->target_type != NCAC_TARGET_ANY)) || !rule->target || !strchr(rule->target, '[')) {
+            /* the rule cannot match or its match does not depend on the data instance */
+            continue;
+        }
+
+        /* remove the predicates from the target */
+        target = malloc(strlen(rule->target) + 1);
+        if (!target) {
+            EMEM;
+            return -1;
+        }
+        for (ptr = rule->target, t = target; ptr[0]; ++ptr) {
+            if (ptr[0] == '[') {
+                while (ptr && ptr[0] && (ptr[0] != ']')) {
+                    if ((ptr[0] == '\'') || (ptr[0] == '"')) {
+                        ptr = strchr(ptr + 1, ptr[0]);
+                        if (!ptr) {
+                            break;
+                        }
+                    }
+                    ++ptr;
+                }
+                if (!ptr || !ptr[0]) {
+                    /* invalid target, consider it matching */
+                    ptr = NULL;
+                    break;
+                }
+                continue;
+            }
+            *t = ptr[0];
+            ++t;
+        }
+        *t = '\0';
+
+        match = ptr ? ncac_allowed_path(target, schema_path) : 1;
+        free(target);
+        if (match) {
+            /* the rule may or may not match based on the predicates */
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Check NACM access for a single data node using the cached decisions of a user.
+ *
+ * The decisions are read and stored without any lock, a decision slot is claimed by setting its key
+ * and the decision itself is stored after that. A claimed slot is always decided, on error it is marked
+ * ::NCAC_ACCESS_INSTANCE so the decision is made for every node but never attempted to be cached again.
+ *
+ * @param[in] nacm NACM snapshot.
+ * @param[in] node Node to check.
+ * @param[in] oper Operation to check.
+ * @param[in] nuser Cached user.
+ * @return NCAC access enum.
+ */
+static enum ncac_access
+ncac_allowed_node_cached(const struct ncac *nacm, const struct lyd_node *node, uint8_t oper, struct ncac_user *nuser)
+{
+    struct ncac_decision *dec = NULL;
+    void *key, *cur;
+    uint32_t hash, access;
+    char *schema_path;
+    int r;
+
+    if (!node->schema) {
+        /* opaque node */
+        return ncac_allowed_node(nacm, node, NULL, NULL, oper, nuser);
+    }
+
+    /* schema nodes are allocated by malloc(3) so the lowest 3 bits are free for the operation index (0 - 4) */
+    key = (void *)((uintptr_t)node->schema | (uintptr_t)(ffs(oper) - 1));
+
+    /* find the decision */
+    hash = ((uint32_t)((uintptr_t)node->schema >> 4) * 31 + oper) & (NP2SRV_NACM_DECISION_CACHE_SIZE - 1);
+    while (1) {
+        cur = ATOMIC_PTR_LOAD(nuser->decisions[hash].key);
+        if (!cur) {
+            if (ATOMIC_LOAD_RELAXED(nuser->dec_count) >= (NP2SRV_NACM_DECISION_CACHE_SIZE / 4) * 3) {
+                /* cache full, do not store the decision */
+                break;
+            }
+
+            /* try to claim the empty slot */
+            cur = ATOMIC_PTR_CAS(nuser->decisions[hash].key, NULL, key);
+            if (!cur) {
+                ATOMIC_INC_RELAXED(nuser->dec_count);
+                dec = &nuser->decisions[hash];
+                break;
+            }
+        }
+
+        if (cur == key) {
+            access = ATOMIC_LOAD_RELAXED(nuser->decisions[hash].access);
+            if (!access) {
+                /* being decided by another thread, decide without storing it */
+                break;
+            } else if (access == NCAC_ACCESS_INSTANCE) {
+                /* the decision must be made for the specific node */
+                return ncac_allowed_node(nacm, node, NULL, NULL, oper, nuser);
+            }
+            return access;
+        }
+
+        hash = (hash + 1) & (NP2SRV_NACM_DECISION_CACHE_SIZE - 1);
+    }
+
+    /* decide for the schema node */
+    schema_path = lysc_path(node->schema, LYSC_PATH_DATA, NULL, 0);
+    if (!schema_path) {
+        EMEM;
+        r = -1;
+    } else {
+        r = ncac_decision_instance_dependent(nuser, node->schema, schema_path, oper);
+    }
+
+    if (r) {
+        /* depends on the data instance or not known whether it does, not cacheable */
+        access = NCAC_ACCESS_INSTANCE;
+    } else {
+        access = ncac_allowed_node(nacm, NULL, schema_path, node->schema, oper, nuser);
+    }
+    free(schema_path);
+    if (dec) {
+        ATOMIC_STORE_RELAXED(dec->access, access);
+    }
+
+    if (access == NCAC_ACCESS_INSTANCE) {
+        /* the decision must be made for the specific node */
+        return ncac_allowed_node(nacm, node, NULL, NULL, oper, nuser);
+    }
+    return access;
+}
+
 const struct lyd_node *
 ncac_check_operation(const struct lyd_node *data, const char *user)
 {
     const struct lyd_node *op = NULL;
-    char **groups = NULL;
-    uint32_t group_count = 0;
+    struct ncac *nacm;
+    struct ncac_user *nuser = NULL;
     int allowed = 0;
 
-    /* NACM LOCK */
-    pthread_mutex_lock(&nacm.lock);
+    nacm = ncac_snapshot_get();
 
     /* check access for the whole data tree first */
-    if (ncac_allowed_tree(data->schema, user)) {
+    if (ncac_allowed_tree(nacm, data->schema, user)) {
         allowed = 1;
         goto cleanup;
     }
 
-    if (ncac_collect_groups(sr_get_context(np2srv.sr_conn), user, &groups, &group_count)) {
+    if (!(nuser = ncac_user_get(nacm, user))) {
         goto cleanup;
     }
 
@@ -1465,22 +2022,21 @@ ncac_check_operation(const struct lyd_node *data, const char *user)
 
     if (op->schema->nodetype & (LYS_RPC | LYS_ACTION)) {
         /* check X access on the RPC/action */
-        if (!NCAC_ACCESS_IS_NODE_PERMIT(ncac_allowed_node(op, NULL, NULL, NCAC_OP_EXEC, groups, group_count))) {
+        if (!NCAC_ACCESS_IS_NODE_PERMIT(ncac_allowed_node(nacm, op, NULL, NULL, NCAC_OP_EXEC, nuser))) {
             goto cleanup;
         }
     } else {
         assert(op->schema->nodetype == LYS_NOTIF);
 
         /* check R access on the notification */
-        if (!NCAC_ACCESS_IS_NODE_PERMIT(ncac_allowed_node(op, NULL, NULL, NCAC_OP_READ, groups, group_count))) {
+        if (!NCAC_ACCESS_IS_NODE_PERMIT(ncac_allowed_node(nacm, op, NULL, NULL, NCAC_OP_READ, nuser))) {
             goto cleanup;
         }
     }
 
     if (op->parent) {
         /* check R access on the parents, the last parent must be enough */
-        if (!NCAC_ACCESS_IS_NODE_PERMIT(ncac_allowed_node(lyd_parent(op), NULL, NULL, NCAC_OP_READ, groups,
-                group_count))) {
+        if (!NCAC_ACCESS_IS_NODE_PERMIT(ncac_allowed_node_cached(nacm, lyd_parent(op), NCAC_OP_READ, nuser))) {
             goto cleanup;
         }
     }
@@ -1488,45 +2044,43 @@ ncac_check_operation(const struct lyd_node *data, const char *user)
     allowed = 1;
 
 cleanup:
-    ncac_free_groups(groups, group_count);
     if (allowed) {
         op = NULL;
     } else if (op) {
         if (op->schema->nodetype & (LYS_RPC | LYS_ACTION)) {
-            ++nacm.denied_operations;
+            ATOMIC_INC_RELAXED(nacm_stats.denied_operations);
         } else {
-            ++nacm.denied_notifications;
+            ATOMIC_INC_RELAXED(nacm_stats.denied_notifications);
         }
     }
 
-    /* NACM UNLOCK */
-    pthread_mutex_unlock(&nacm.lock);
+    ncac_user_put(nuser);
+    ncac_snapshot_put(nacm);
     return op;
 }
 
 /**
  * @brief Filter out any siblings for which the user does not have R access, recursively.
  *
+ * @param[in] nacm NACM snapshot.
  * @param[in,out] first First sibling to filter.
- * @param[in] user User for the NACM filtering.
- * @param[in] groups Array of collected groups.
- * @param[in] group_count Number of @p groups.
+ * @param[in] nuser Cached user for the NACM filtering.
  * @return Highest access among descendants (recursively), permit is the highest.
  */
 static enum ncac_access
-ncac_check_data_read_filter_r(struct lyd_node **first, const char *user, char **groups, uint32_t group_count)
+ncac_check_data_read_filter_r(const struct ncac *nacm, struct lyd_node **first, struct ncac_user *nuser)
 {
     struct lyd_node *next, *elem;
     enum ncac_access node_access, ret_access = NCAC_ACCESS_DENY;
 
     LY_LIST_FOR_SAFE(*first, next, elem) {
         /* check access of the node */
-        node_access = ncac_allowed_node(elem, NULL, NULL, NCAC_OP_READ, groups, group_count);
+        node_access = ncac_allowed_node_cached(nacm, elem, NCAC_OP_READ, nuser);
 
         if (node_access == NCAC_ACCESS_PARTIAL_DENY) {
             /* only partial deny access, we must check children recursively to learn whether this node is allowed or not */
             if (elem->schema->nodetype & LYD_NODE_INNER) {
-                node_access = ncac_check_data_read_filter_r(&((struct lyd_node_inner *)elem)->child, user, groups, group_count);
+                node_access = ncac_check_data_read_filter_r(nacm, &((struct lyd_node_inner *)elem)->child, nuser);
             }
 
             if (node_access != NCAC_ACCESS_PERMIT) {
@@ -1536,7 +2090,7 @@ ncac_check_data_read_filter_r(struct lyd_node **first, const char *user, char **
         } else if (node_access == NCAC_ACCESS_PARTIAL_PERMIT) {
             /* partial permit, the node will be included in the reply but we must check children as well */
             if (elem->schema->nodetype & LYD_NODE_INNER) {
-                ncac_check_data_read_filter_r(&((struct lyd_node_inner *)elem)->child, user, groups, group_count);
+                ncac_check_data_read_filter_r(nacm, &((struct lyd_node_inner *)elem)->child, nuser);
             }
             node_access = NCAC_ACCESS_PERMIT;
         }
@@ -1563,40 +2117,36 @@ ncac_check_data_read_filter_r(struct lyd_node **first, const char *user, char **
 void
 ncac_check_data_read_filter(struct lyd_node **data, const char *user)
 {
-    char **groups = NULL;
-    uint32_t group_count;
+    struct ncac *nacm;
+    struct ncac_user *nuser;
 
     assert(data);
 
-    /* NACM LOCK */
-    pthread_mutex_lock(&nacm.lock);
-
-    if (ncac_collect_groups(sr_get_context(np2srv.sr_conn), user, &groups, &group_count)) {
-        goto cleanup;
+    if (!*data) {
+        return;
     }
 
-    if (*data && !ncac_allowed_tree((*data)->schema, user)) {
-        ncac_check_data_read_filter_r(data, user, groups, group_count);
+    nacm = ncac_snapshot_get();
+
+    if (!ncac_allowed_tree(nacm, (*data)->schema, user) && (nuser = ncac_user_get(nacm, user))) {
+        ncac_check_data_read_filter_r(nacm, data, nuser);
+        ncac_user_put(nuser);
     }
 
-cleanup:
-    /* NACM UNLOCK */
-    pthread_mutex_unlock(&nacm.lock);
-    ncac_free_groups(groups, group_count);
+    ncac_snapshot_put(nacm);
 }
 
 /**
  * @brief Check whether diff node siblings can be applied by a user, recursively with children.
  *
+ * @param[in] nacm NACM snapshot.
  * @param[in] diff First diff sibling.
- * @param[in] user User for the NACM check.
  * @param[in] parent_op Inherited parent operation.
- * @param[in] groups Array of collected groups.
- * @param[in] group_count Number of @p groups.
+ * @param[in] nuser Cached user for the NACM check.
  * @return NULL if access allowed, otherwise the denied access data node.
  */
 static const struct lyd_node *
-ncac_check_diff_r(const struct lyd_node *diff, const char *user, const char *parent_op, char **groups, uint32_t group_count)
+ncac_check_diff_r(const struct ncac *nacm, const struct lyd_node *diff, const char *parent_op, struct ncac_user *nuser)
 {
     const char *op;
     struct lyd_meta *meta;
@@ -1643,14 +2193,14 @@ ncac_check_diff_r(const struct lyd_node *diff, const char *user, const char *par
         }
 
         /* check access for the node, none operation is always allowed, and partial access is relevant only for read operation */
-        if (oper && !NCAC_ACCESS_IS_NODE_PERMIT(ncac_allowed_node(diff, NULL, NULL, oper, groups, group_count))) {
+        if (oper && !NCAC_ACCESS_IS_NODE_PERMIT(ncac_allowed_node_cached(nacm, diff, oper, nuser))) {
             node = diff;
             break;
         }
 
         /* go recursively */
         if (lyd_child(diff)) {
-            node = ncac_check_diff_r(lyd_child(diff), user, op, groups, group_count);
+            node = ncac_check_diff_r(nacm, lyd_child(diff), op, nuser);
         }
     }
 
@@ -1661,28 +2211,21 @@ const struct lyd_node *
 ncac_check_diff(const struct lyd_node *diff, const char *user)
 {
     const struct lyd_node *node = NULL;
-    char **groups = NULL;
-    uint32_t group_count;
+    struct ncac *nacm;
+    struct ncac_user *nuser;
 
-    /* NACM LOCK */
-    pthread_mutex_lock(&nacm.lock);
-
-    if (ncac_collect_groups(sr_get_context(np2srv.sr_conn), user, &groups, &group_count)) {
-        goto cleanup;
-    }
+    nacm = ncac_snapshot_get();
 
     /* any node can be used in this case */
-    if (!ncac_allowed_tree(diff->schema, user)) {
-        node = ncac_check_diff_r(diff, user, NULL, groups, group_count);
+    if (!ncac_allowed_tree(nacm, diff->schema, user) && (nuser = ncac_user_get(nacm, user))) {
+        node = ncac_check_diff_r(nacm, diff, NULL, nuser);
         if (node) {
-            ++nacm.denied_data_writes;
+            ATOMIC_INC_RELAXED(nacm_stats.denied_data_writes);
         }
+        ncac_user_put(nuser);
     }
 
-cleanup:
-    /* NACM UNLOCK */
-    pthread_mutex_unlock(&nacm.lock);
-    ncac_free_groups(groups, group_count);
+    ncac_snapshot_put(nacm);
     return node;
 }
 
@@ -1690,19 +2233,24 @@ void
 ncac_check_yang_push_update_notif(const char *user, struct ly_set *set, int *all_removed)
 {
     struct lyd_node_any *ly_value;
-    struct lyd_node *ly_target, *next, *iter;
-    uint32_t i, group_count, removed = 0;
-    char **groups;
+    struct lyd_node *ly_target, *child;
+    struct ncac *nacm;
+    struct ncac_user *nuser;
+    uint32_t i, removed = 0;
 
-    if (ncac_collect_groups(sr_get_context(np2srv.sr_conn), user, &groups, &group_count)) {
-        return;
+    *all_removed = 0;
+
+    nacm = ncac_snapshot_get();
+
+    if (!(nuser = ncac_user_get(nacm, user))) {
+        goto cleanup;
     }
 
     for (i = 0; i < set->count; ++i) {
         /* check the change itself */
         lyd_find_path(set->dnodes[i], "target", 0, &ly_target);
-        if (!NCAC_ACCESS_IS_NODE_PERMIT(ncac_allowed_node(NULL, lyd_get_value(ly_target), ly_target->priv,
-                NCAC_OP_READ, groups, group_count))) {
+        if (!NCAC_ACCESS_IS_NODE_PERMIT(ncac_allowed_node(nacm, NULL, lyd_get_value(ly_target), ly_target->priv,
+                NCAC_OP_READ, nuser))) {
             /* not allowed, remove this change */
             lyd_free_tree(set->dnodes[i]);
             ++removed;
@@ -1713,15 +2261,19 @@ ncac_check_yang_push_update_notif(const char *user, struct ly_set *set, int *all
             assert(ly_value->value_type == LYD_ANYDATA_DATATREE);
 
             /* filter out any nested nodes */
-            LY_LIST_FOR_SAFE(lyd_child(ly_value->value.tree), next, iter) {
-                ncac_check_data_read_filter(&iter, user);
+            child = lyd_child(ly_value->value.tree);
+            if (child && !ncac_allowed_tree(nacm, child->schema, user)) {
+                ncac_check_data_read_filter_r(nacm, &child, nuser);
             }
         }
     }
-    ncac_free_groups(groups, group_count);
+
     if (removed == set->count) {
         *all_removed = 1;
-    } else {
-        *all_removed = 0;
     }
+
+    ncac_user_put(nuser);
+
+cleanup:
+    ncac_snapshot_put(nacm);
 }
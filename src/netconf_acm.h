@@ -19,10 +19,13 @@
 
 #include <pthread.h>
 #include <stdint.h>
+#include <time.h>
 
 #include <libyang/libyang.h>
 #include <sysrepo.h>
 
+#include "compat.h"
+
 #define NCAC_OP_CREATE 0x01 /**< NACM operation create */
 #define NCAC_OP_READ   0x02 /**< NACM operation read */
 #define NCAC_OP_UPDATE 0x04 /**< NACM operation update */
@@ -41,7 +44,32 @@ typedef enum ncac_target_type {
 } NCAC_TARGET_TYPE;
 
 /**
- * @brief Main NACM container structure.
+ * @brief Cached NACM information of a user.
+ */
+struct ncac_user {
+    char *name;                     /**< User name. */
+    char **groups;                  /**< Sorted collected groups of the user. */
+    uint32_t group_count;           /**< Number of groups. */
+    struct ncac_rule **rules;       /**< Rules of all the rule lists matching the user groups, in the order of evaluation. */
+    uint32_t rule_count;            /**< Number of rules. */
+    time_t created;                 /**< Time the cached information was collected. */
+    ATOMIC_T ref_count;             /**< Number of references to the user, the cache holds one. */
+
+    /**
+     * @brief Cached access decision for a schema node, filled without any lock.
+     */
+    struct ncac_decision {
+        ATOMIC_PTR_T(void) key;     /**< Schema node with the operation index in the lowest bits, NULL for an empty item. */
+        ATOMIC_T access;            /**< Decided access, 0 if not yet stored. */
+    } *decisions;                   /**< Hash table of decisions (open addressing), ::NP2SRV_NACM_DECISION_CACHE_SIZE items. */
+    ATOMIC_T dec_count;             /**< Number of stored decisions. */
+};
+
+/**
+ * @brief Main NACM container structure, an immutable snapshot of the NACM configuration.
+ *
+ * Any configuration change creates a new snapshot that replaces the current one. Only the cached users
+ * are modified in a published snapshot.
  */
 struct ncac {
     char enabled;                   /**< Whether NACM is enabled. */
@@ -50,10 +78,6 @@ struct ncac {
     char default_exec_deny;         /**< Whether default NACM exec action is "deny" (otherwise "permit"). */
     char enable_external_groups;    /**< Whether external (system) groups are taken into consideration for NACM. */
 
-    uint32_t denied_operations;     /**< Counter of denied operations (RPC or action). */
-    uint32_t denied_data_writes;    /**< Counter of denied data writes. */
-    uint32_t denied_notifications;  /**< Counter of denied notifications. */
-
     /**
      * @brief NACM group.
      */
@@ -89,7 +113,12 @@ struct ncac {
         struct ncac_rule_list *next;    /**< Pointer to the next rule list. */
     } *rule_lists;                  /**< List of all the rule lists. */
 
-    pthread_mutex_t lock;           /**< Lock for accessing all the NACM members. */
+    struct ncac_user **users;       /**< Cached users of this snapshot. */
+    uint32_t user_count;            /**< Number of cached users. */
+    uint16_t ctx_change_count;      /**< Context change count the cached users are valid for. */
+    pthread_mutex_t users_lock;     /**< Lock for the cached users. */
+
+    ATOMIC_T ref_count;             /**< Number of references to the snapshot, the current snapshot holds one. */
 };
 
 enum ncac_access {
@@ -116,9 +145,16 @@ int ncac_rule_list_cb(sr_session_ctx_t *session, uint32_t sub_id, const char *mo
 int ncac_rule_cb(sr_session_ctx_t *session, uint32_t sub_id, const char *module_name, const char *xpath, sr_event_t event,
         uint32_t request_id, void *private_data);
 
-void ncac_init(void);
+int ncac_init(void);
 void ncac_destroy(void);
 
+/**
+ * @brief Drop all the cached NACM information of users so that it is collected again.
+ *
+ * @return 0 on success, -1 on error.
+ */
+int ncac_user_cache_clear(void);
+
 /**
  * @brief Check whether an operation is allowed for a user.
  *
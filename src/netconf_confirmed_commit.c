@@ -19,17 +19,20 @@
 #include "netconf_confirmed_commit.h"
 
 #include <assert.h>
-#include <dirent.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <grp.h>
+#include <inttypes.h>
 #include <pwd.h>
-#include <signal.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 #include <time.h>
+#include <unistd.h>
 
 #include <libyang/libyang.h>
 #include <nc_server.h>
@@ -39,11 +42,33 @@
 #include "compat.h"
 #include "err_netconf.h"
 #include "log.h"
-
-#define META_FILE "meta"
+#include "netconf_confirmed_commit_journal.h"
+#include "timer_wheel.h"
 
 #define NCC_DIR "confirmed_commit"
 
+#define NCC_JOURNAL "journal"
+
+/**
+ * @brief Module in a confirmed commit journal.
+ */
+struct ncc_journal_mod {
+    const char *name;   /**< module name */
+    const char *diff;   /**< changes from the last record of the module */
+};
+
+/**
+ * @brief Confirmed commit journal mapped into memory.
+ */
+struct ncc_journal {
+    const char *data;   /**< mapped journal, NULL if there is none */
+    size_t size;        /**< size of the mapped journal */
+    size_t valid;       /**< length of the journal with complete records, ending with a commit record */
+
+    struct ncc_journal_mod *mods;   /**< modules in the complete records sorted by name */
+    uint32_t mod_count;             /**< number of mods */
+};
+
 /**
  * @brief Context for confirmed commits.
  *
@@ -52,18 +77,25 @@
  */
 typedef struct commit_ctx_s {
     char *persist;        /* What persist-id is expected */
-    timer_t timer;        /* POSIX timer used for rollback, zero if none */
+    struct np_timer *timer; /* timer used for rollback, NULL if none */
+    uintptr_t timer_id;   /* ID of the last scheduled timer, to ignore expirations of replaced timers */
     pthread_mutex_t lock; /* Lock mutexing this structure and access to NCC_DIR */
+
+    ATOMIC_PTR_T(sr_session_ctx_t) backup_sess; /* session applying a confirmed commit, its changes are backed up */
+    int backup_merge;     /* whether the journal of a pending confirmed commit is appended to */
+    uint32_t backup_timeout;    /* timeout of the confirmed commit being applied */
+    size_t backup_prev;   /* length of the journal before the confirmed commit being applied */
+    int backup_done;      /* whether the changes of the confirmed commit being applied were backed up */
 } commit_ctx_t;
 
-static commit_ctx_t commit_ctx = {.persist = NULL, .timer = 0, .lock = PTHREAD_MUTEX_INITIALIZER};
+static commit_ctx_t commit_ctx = {.persist = NULL, .timer = NULL, .timer_id = 0, .lock = PTHREAD_MUTEX_INITIALIZER,
+                                  .backup_sess = NULL};
 
 void
 ncc_commit_ctx_destroy(void)
 {
-    if (commit_ctx.timer) {
-        timer_delete(commit_ctx.timer);
-    }
+    np_timer_delete(commit_ctx.timer);
+    commit_ctx.timer = NULL;
     free(commit_ctx.persist);
     commit_ctx.persist = NULL;
 }
@@ -100,78 +132,543 @@ cleanup:
 }
 
 /**
- * @brief Transform filename into module name.
+ * @brief Get path to the confirmed commit journal.
+ *
+ * @param[out] path Path to the journal.
+ * @return SR_ERR_NO_MEMORY When out of memory.
+ * @return SR_ERR_OK When successful.
+ */
+static int
+ncc_journal_path(char **path)
+{
+    if (asprintf(path, "%s/%s/%s", np2srv.server_dir, NCC_DIR, NCC_JOURNAL) == -1) {
+        EMEM;
+        *path = NULL;
+        return SR_ERR_NO_MEMORY;
+    }
+    return SR_ERR_OK;
+}
+
+/**
+ * @brief Read the next record of a mapped journal and check it.
  *
- * @param[in] filename Name of the file to extract module name out of.
- * @return Module name.
+ * @param[in] jrn Mapped journal.
+ * @param[in] end Offset in the journal where the records end.
+ * @param[in,out] off Offset of the record to read, set to the offset of the next record.
+ * @param[out] type Record type.
+ * @param[out] payload Record payload.
+ * @param[out] len Record payload length.
+ * @return 1 if a valid record was read.
+ * @return 0 if there are no more valid records.
  */
-static char *
-get_module_name_from_filename(const char *filename)
+static int
+ncc_journal_next(const struct ncc_journal *jrn, size_t end, size_t *off, uint32_t *type, const char **payload,
+        uint32_t *len)
 {
-    char *point = strstr(filename, ".json");
-    char *new = NULL;
+    struct ncc_rec_hdr hdr;
+    uint32_t i, crc, str_count;
+
+    if ((*off > end) || (end - *off < sizeof hdr)) {
+        return 0;
+    }
+
+    /* the mapping is not aligned for the header */
+    memcpy(&hdr, jrn->data + *off, sizeof hdr);
+    if ((hdr.magic != NCC_JOURNAL_MAGIC) || (hdr.len > end - *off - sizeof hdr)) {
+        return 0;
+    }
+    *payload = jrn->data + *off + sizeof hdr;
+
+    crc = ncc_crc32(ncc_rec_crc_start(&hdr), *payload, hdr.len);
+    if (crc != hdr.crc) {
+        return 0;
+    }
+
+    /* check the payload */
+    switch (hdr.type) {
+    case NCC_REC_MODULE:
+        /* exactly 2 strings */
+        str_count = 0;
+        for (i = 0; i < hdr.len; ++i) {
+            if (!(*payload)[i]) {
+                ++str_count;
+            }
+        }
+        if ((str_count != 2) || (*payload)[hdr.len - 1]) {
+            return 0;
+        }
+        break;
+    case NCC_REC_META:
+        if (hdr.len != sizeof(struct ncc_rec_meta)) {
+            return 0;
+        }
+        break;
+    case NCC_REC_COMMIT:
+        break;
+    default:
+        return 0;
+    }
+
+    *off += sizeof hdr + hdr.len;
+    *type = hdr.type;
+    *len = hdr.len;
+    return 1;
+}
+
+/**
+ * @brief Unmap a confirmed commit journal.
+ *
+ * @param[in] jrn Mapped journal.
+ */
+static void
+ncc_journal_close(struct ncc_journal *jrn)
+{
+    if (jrn->size) {
+        munmap((void *)jrn->data, jrn->size);
+    }
+    free(jrn->mods);
+    memset(jrn, 0, sizeof *jrn);
+}
+
+/**
+ * @brief Compare journal modules by their name and then by their record order.
+ *
+ * @param[in] ptr1 First module.
+ * @param[in] ptr2 Second module.
+ * @return Comparison result.
+ */
+static int
+ncc_journal_mod_cmp(const void *ptr1, const void *ptr2)
+{
+    const struct ncc_journal_mod *mod1 = ptr1, *mod2 = ptr2;
+    int r;
+
+    if ((r = strcmp(mod1->name, mod2->name))) {
+        return r;
+    }
+
+    /* later records are mapped after the previous ones */
+    if (mod1->diff < mod2->diff) {
+        return -1;
+    }
+    return (mod1->diff > mod2->diff) ? 1 : 0;
+}
+
+/**
+ * @brief Index the modules of the complete records of a journal, only the last record of each module is kept.
+ *
+ * @param[in,out] jrn Mapped journal.
+ * @return SR_ERR_NO_MEMORY When out of memory.
+ * @return SR_ERR_OK When successful.
+ */
+static int
+ncc_journal_index(struct ncc_journal *jrn)
+{
+    const char *payload;
+    size_t off = 0;
+    uint32_t i, count = 0, type, len;
+    void *mem;
+
+    while (ncc_journal_next(jrn, jrn->valid, &off, &type, &payload, &len)) {
+        if (type != NCC_REC_MODULE) {
+            continue;
+        }
+
+        mem = realloc(jrn->mods, (count + 1) * sizeof *jrn->mods);
+        if (!mem) {
+            EMEM;
+            return SR_ERR_NO_MEMORY;
+        }
+        jrn->mods = mem;
+        jrn->mods[count].name = payload;
+        jrn->mods[count].diff = payload + strlen(payload) + 1;
+        ++count;
+    }
+    if (!count) {
+        return SR_ERR_OK;
+    }
+
+    /* sort and keep only the last record of every module */
+    qsort(jrn->mods, count, sizeof *jrn->mods, ncc_journal_mod_cmp);
+    for (i = 1; i < count; ++i) {
+        if (!strcmp(jrn->mods[jrn->mod_count].name, jrn->mods[i].name)) {
+            jrn->mods[jrn->mod_count] = jrn->mods[i];
+        } else {
+            jrn->mods[++jrn->mod_count] = jrn->mods[i];
+        }
+    }
+    ++jrn->mod_count;
 
-    if (!point) {
+    return SR_ERR_OK;
+}
+
+/**
+ * @brief Map the confirmed commit journal into memory and learn its complete records.
+ *
+ * @param[out] jrn Mapped journal, its data are NULL if there is no journal.
+ * @return SR_ERR_SYS When mapping the journal failed.
+ * @return SR_ERR_NO_MEMORY When out of memory.
+ * @return SR_ERR_OK When successful.
+ */
+static int
+ncc_journal_open(struct ncc_journal *jrn)
+{
+    int rc = SR_ERR_OK, fd = -1;
+    char *path = NULL;
+    const char *payload;
+    struct stat st;
+    size_t off = 0;
+    uint32_t type, len;
+    void *data;
+
+    memset(jrn, 0, sizeof *jrn);
+
+    if ((rc = ncc_journal_path(&path))) {
+        goto cleanup;
+    }
+    fd = open(path, O_RDONLY);
+    if (fd == -1) {
+        if (errno != ENOENT) {
+            ERR("Failed opening confirmed commit journal \"%s\" (%s).", path, strerror(errno));
+            rc = SR_ERR_SYS;
+        } /* else does not exist */
+        goto cleanup;
+    }
+    if (fstat(fd, &st) == -1) {
+        ERR("Failed getting size of confirmed commit journal \"%s\" (%s).", path, strerror(errno));
+        rc = SR_ERR_SYS;
+        goto cleanup;
+    }
+    if (!st.st_size) {
+        /* an empty mapping would fail, use an empty string */
+        jrn->data = "";
         goto cleanup;
     }
 
-    new = strndup(filename, point - filename);
-    if (!new) {
-        EMEM;
+    data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED) {
+        ERR("Failed mapping confirmed commit journal \"%s\" (%s).", path, strerror(errno));
+        rc = SR_ERR_SYS;
         goto cleanup;
     }
+    jrn->data = data;
+    jrn->size = st.st_size;
+
+    /* records after the last commit record were not written completely */
+    while (ncc_journal_next(jrn, jrn->size, &off, &type, &payload, &len)) {
+        if (type == NCC_REC_COMMIT) {
+            jrn->valid = off;
+        }
+    }
+
+    rc = ncc_journal_index(jrn);
 
 cleanup:
-    return new;
+    if (fd > -1) {
+        close(fd);
+    }
+    if (rc) {
+        ncc_journal_close(jrn);
+    }
+    free(path);
+    return rc;
 }
 
 /**
- * @brief Rename a file if restore failed.
+ * @brief Find the changes of a module in a journal.
  *
- * @param[in] filename Name of the file to create new name from.
- * @param[in] path Absolute path to the file.
+ * @param[in] jrn Mapped journal.
+ * @param[in] name Module name.
+ * @return Changes reverting the commit of the module from the last record of the module, NULL if there are none.
  */
-static void
-rename_failed_file(const char *filename, const char *path)
+static const char *
+ncc_journal_find_module(const struct ncc_journal *jrn, const char *name)
 {
-    char *new = NULL;
+    uint32_t lo = 0, hi = jrn->mod_count, mid;
+    int r;
+
+    /* binary search, the names are unique in the index */
+    while (lo < hi) {
+        mid = lo + (hi - lo) / 2;
+        if (!(r = strcmp(name, jrn->mods[mid].name))) {
+            return jrn->mods[mid].diff;
+        } else if (r < 0) {
+            hi = mid;
+        } else {
+            lo = mid + 1;
+        }
+    }
+
+    return NULL;
+}
 
-    if (asprintf(&new, "%s/%s/%s-%ld.failed", np2srv.server_dir, NCC_DIR, filename, time(NULL)) == -1) {
+/**
+ * @brief Find the metadata in a journal.
+ *
+ * @param[in] jrn Mapped journal.
+ * @param[out] meta Metadata from the last meta record.
+ * @return Whether any metadata were found.
+ */
+static int
+ncc_journal_find_meta(const struct ncc_journal *jrn, struct ncc_rec_meta *meta)
+{
+    const char *payload;
+    size_t off = 0;
+    uint32_t type, len;
+    int found = 0;
+
+    while (ncc_journal_next(jrn, jrn->valid, &off, &type, &payload, &len)) {
+        if (type == NCC_REC_META) {
+            memcpy(meta, payload, sizeof *meta);
+            found = 1;
+        }
+    }
+
+    return found;
+}
+
+/**
+ * @brief Write a buffer into a file.
+ *
+ * @param[in] fd File descriptor.
+ * @param[in] buf Buffer to write.
+ * @param[in] len Length of @p buf.
+ * @return SR_ERR_SYS When writing failed.
+ * @return SR_ERR_OK When successful.
+ */
+static int
+ncc_write(int fd, const void *buf, size_t len)
+{
+    const char *ptr = buf;
+    ssize_t ret;
+
+    while (len) {
+        ret = write(fd, ptr, len);
+        if (ret == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            ERR("Failed writing confirmed commit journal (%s).", strerror(errno));
+            return SR_ERR_SYS;
+        }
+        ptr += ret;
+        len -= ret;
+    }
+
+    return SR_ERR_OK;
+}
+
+/**
+ * @brief Append a record to the journal.
+ *
+ * @param[in] fd File descriptor of the journal.
+ * @param[in] type Record type.
+ * @param[in] parts Parts of the record payload.
+ * @param[in] part_count Number of @p parts.
+ * @return SR_ERR_INVAL_ARG When the record is too large.
+ * @return SR_ERR_SYS When writing failed.
+ * @return SR_ERR_OK When successful.
+ */
+static int
+ncc_journal_append(int fd, enum ncc_rec_type type, const struct iovec *parts, uint32_t part_count)
+{
+    int rc;
+    struct ncc_rec_hdr hdr;
+    size_t len = 0;
+    uint32_t i;
+
+    for (i = 0; i < part_count; ++i) {
+        if (parts[i].iov_len > UINT32_MAX - len) {
+            ERR("Confirmed commit journal record too large.");
+            return SR_ERR_INVAL_ARG;
+        }
+        len += parts[i].iov_len;
+    }
+
+    hdr.magic = NCC_JOURNAL_MAGIC;
+    hdr.type = type;
+    hdr.len = len;
+    hdr.crc = ncc_rec_crc_start(&hdr);
+    for (i = 0; i < part_count; ++i) {
+        hdr.crc = ncc_crc32(hdr.crc, parts[i].iov_base, parts[i].iov_len);
+    }
+
+    if ((rc = ncc_write(fd, &hdr, sizeof hdr))) {
+        return rc;
+    }
+    for (i = 0; i < part_count; ++i) {
+        if ((rc = ncc_write(fd, parts[i].iov_base, parts[i].iov_len))) {
+            return rc;
+        }
+    }
+
+    return SR_ERR_OK;
+}
+
+/**
+ * @brief Synchronize the journal directory so that creating, renaming, or removing the journal persists.
+ *
+ * @return SR_ERR_NO_MEMORY When out of memory.
+ * @return SR_ERR_SYS When synchronizing failed.
+ * @return SR_ERR_OK When successful.
+ */
+static int
+ncc_journal_dir_sync(void)
+{
+    int rc = SR_ERR_OK, fd = -1;
+    char *path = NULL;
+
+    if (asprintf(&path, "%s/%s", np2srv.server_dir, NCC_DIR) == -1) {
         EMEM;
+        path = NULL;
+        rc = SR_ERR_NO_MEMORY;
+        goto cleanup;
+    }
+
+    fd = open(path, O_RDONLY | O_DIRECTORY);
+    if ((fd == -1) || (fsync(fd) == -1)) {
+        ERR("Failed synchronizing confirmed commit directory \"%s\" (%s).", path, strerror(errno));
+        rc = SR_ERR_SYS;
+        goto cleanup;
+    }
+
+cleanup:
+    if (fd > -1) {
+        close(fd);
+    }
+    free(path);
+    return rc;
+}
+
+/**
+ * @brief Remove the journal.
+ */
+static void
+ncc_journal_remove(void)
+{
+    char *path;
+
+    if (ncc_journal_path(&path)) {
+        return;
+    }
+    if (unlink(path) == -1) {
+        if (errno != ENOENT) {
+            ERR("Failed removing confirmed commit journal \"%s\" (%s).", path, strerror(errno));
+        }
+    } else {
+        /* the journal must not reappear after a crash to be restored again */
+        ncc_journal_dir_sync();
+    }
+    free(path);
+}
+
+/**
+ * @brief Rename the journal if restore failed.
+ */
+static void
+ncc_journal_fail(void)
+{
+    char *path = NULL, *new = NULL;
+
+    if (ncc_journal_path(&path)) {
         return;
     }
+    if (asprintf(&new, "%s-%ld.failed", path, (long)time(NULL)) == -1) {
+        EMEM;
+        goto cleanup;
+    }
 
     if (rename(path, new)) {
-        ERR("Renaming \"%s\" failed (%s).", filename, strerror(errno));
+        ERR("Renaming \"%s\" failed (%s).", path, strerror(errno));
         goto cleanup;
     }
+    ncc_journal_dir_sync();
 
 cleanup:
+    free(path);
     free(new);
 }
 
 /**
- * @brief Read a backup file located on @p path and parse it
+ * @brief Revert the journal to its length before a confirmed commit that was not applied.
  *
- * @param[in] ctx Libyang context used for parsing.
- * @param[in] path Path where the backup file is located.
- * @param[out] node Parsed backup file into lyd_node.
- * @return SR_ERR_LY When failed parsing.
- * @return SR_ERR_OK When successful.
+ * @param[in] len Length of the journal to keep, it is removed if 0.
+ */
+static void
+ncc_journal_truncate(size_t len)
+{
+    char *path;
+    int fd;
+
+    if (!len) {
+        ncc_journal_remove();
+        return;
+    }
+
+    if (ncc_journal_path(&path)) {
+        return;
+    }
+    fd = open(path, O_WRONLY);
+    if ((fd == -1) || (ftruncate(fd, len) == -1) || (fsync(fd) == -1)) {
+        ERR("Failed truncating confirmed commit journal \"%s\" (%s).", path, strerror(errno));
+    }
+    if (fd > -1) {
+        close(fd);
+    }
+    free(path);
+}
+
+/**
+ * @brief Get configuration data of a module.
+ *
+ * @param[in] session Sysrepo session with the datastore to read.
+ * @param[in] module Module whose data to get.
+ * @param[out] data Data of the module, NULL if there are none.
+ * @return Sysrepo error value.
  */
 static int
-get_running_backup(const struct ly_ctx *ctx, const char *path, struct lyd_node **node)
+ncc_get_module_data(sr_session_ctx_t *session, const struct lys_module *module, struct lyd_node **data)
 {
-    int ret = SR_ERR_OK;
+    int rc = SR_ERR_OK;
+    char *xpath = NULL;
+
+    *data = NULL;
+
+    if (asprintf(&xpath, "/%s:*", module->name) == -1) {
+        EMEM;
+        rc = SR_ERR_NO_MEMORY;
+        goto cleanup;
+    }
 
-    if (lyd_parse_data_path(ctx, path, LYD_JSON, LYD_PARSE_ORDERED | LYD_PARSE_STRICT | LYD_PARSE_ONLY, 0, node)) {
-        ERR("Failed parsing confirmed commit backup of running for file \"%s\" (%s).", path, ly_errmsg(ctx));
-        ret = SR_ERR_LY;
+    if ((rc = sr_get_data(session, xpath, 0, 0, 0, data))) {
+        ERR("Failed getting configuration of %s for module \"%s\" (%s).",
+                sr_session_get_ds(session) == SR_DS_RUNNING ? "running" : "candidate", module->name, sr_strerror(rc));
         goto cleanup;
     }
 
 cleanup:
-    return ret;
+    free(xpath);
+    return rc;
+}
+
+/**
+ * @brief Parse changes of a module from the journal.
+ *
+ * @param[in] module Module of the changes.
+ * @param[in] str Changes printed in the journal, may be empty.
+ * @param[out] diff Parsed changes.
+ * @return SR_ERR_LY When failed parsing.
+ * @return SR_ERR_OK When successful.
+ */
+static int
+ncc_parse_module_diff(const struct lys_module *module, const char *str, struct lyd_node **diff)
+{
+    *diff = NULL;
+    if (str[0] && lyd_parse_data_mem(module->ctx, str, LYD_JSON, LYD_PARSE_ORDERED | LYD_PARSE_STRICT | LYD_PARSE_ONLY, 0, diff)) {
+        ERR("Failed parsing confirmed commit backup of module \"%s\" (%s).", module->name, ly_errmsg(module->ctx));
+        return SR_ERR_LY;
+    }
+    return SR_ERR_OK;
 }
 
 /**
@@ -303,28 +800,155 @@ cleanup:
 }
 
 /**
- * @brief Restore running using the backup files.
- * Thread run after the timer in commit_ctx_s runs out.
+ * @brief Free all the default descendants of a node.
+ *
+ * @param[in] parent Parent node.
  */
 static void
-changes_rollback(union sigval UNUSED(sev))
+ncc_free_dflt_r(struct lyd_node *parent)
 {
-    int rc;
-    struct lyd_node *node = NULL;
+    struct lyd_node *node, *next;
+
+    LY_LIST_FOR_SAFE(lyd_child_no_keys(parent), next, node) {
+        if (node->flags & LYD_DEFAULT) {
+            lyd_free_tree(node);
+        } else {
+            ncc_free_dflt_r(node);
+        }
+    }
+}
+
+/**
+ * @brief Add an edit of a top-level node to a rollback edit.
+ *
+ * @param[in] node Top-level node to remove or to replace with, including its descendants.
+ * @param[in] remove Whether to remove the node or replace it.
+ * @param[in,out] edit Rollback edit to add to.
+ * @return SR_ERR_LY When creating the edit failed.
+ * @return SR_ERR_OK When successful.
+ */
+static int
+ncc_rollback_edit_add(const struct lyd_node *node, int remove, struct lyd_node **edit)
+{
+    struct lyd_node *dup = NULL;
+
+    if (remove) {
+        /* keys of a list are duplicated, too */
+        if (lyd_dup_single(node, NULL, LYD_DUP_NO_META, &dup)) {
+            goto error;
+        }
+    } else {
+        /* only explicit nodes are restored, defaults are created by sysrepo */
+        if (lyd_dup_single(node, NULL, LYD_DUP_RECURSIVE | LYD_DUP_NO_META | LYD_DUP_WITH_FLAGS, &dup)) {
+            goto error;
+        }
+        ncc_free_dflt_r(dup);
+    }
+    if (lyd_new_meta(LYD_CTX(node), dup, NULL, "ietf-netconf:operation", remove ? "remove" : "replace", 0, NULL)) {
+        goto error;
+    }
+    if (lyd_insert_sibling(*edit, dup, edit)) {
+        goto error;
+    }
+
+    return SR_ERR_OK;
+
+error:
+    ERR("Failed creating confirmed commit rollback edit (%s).", ly_errmsg(LYD_CTX(node)));
+    lyd_free_tree(dup);
+    return SR_ERR_LY;
+}
+
+/**
+ * @brief Create an edit restoring running of a module using its changes from the journal.
+ *
+ * Every top-level node changed by the changes is replaced by the restored node or removed. If the changes
+ * cannot be applied because running was changed meanwhile, the rollback fails.
+ *
+ * @param[in] session Sysrepo session used to get running data of the module.
+ * @param[in] module Module to restore.
+ * @param[in] str Changes of the module reverting the commit from the journal.
+ * @param[in,out] edit Rollback edit to add to.
+ * @return SR_ERR_OPERATION_FAILED When the changes conflict with the current running data.
+ * @return Sysrepo error value.
+ */
+static int
+ncc_rollback_module_edit(sr_session_ctx_t *session, const struct lys_module *module, const char *str,
+        struct lyd_node **edit)
+{
+    int rc = SR_ERR_OK;
+    struct lyd_node *data = NULL, *diff = NULL, *root, *match;
+    struct lyd_meta *meta;
+
+    /* get and apply the backup changes to the current data */
+    if ((rc = ncc_parse_module_diff(module, str, &diff))) {
+        goto cleanup;
+    }
+    if ((rc = ncc_get_module_data(session, module, &data))) {
+        goto cleanup;
+    }
+    if (lyd_diff_apply_module(&data, diff, module, NULL, NULL)) {
+        /* running was changed meanwhile, do not guess what to restore */
+        ERR("Failed applying backup changes of module \"%s\" (%s).", module->name, ly_errmsg(module->ctx));
+        rc = SR_ERR_OPERATION_FAILED;
+        goto cleanup;
+    }
+
+    LY_LIST_FOR(diff, root) {
+        meta = lyd_find_meta(root->meta, NULL, "yang:operation");
+        if (meta && !strcmp(lyd_get_meta_value(meta), "delete")) {
+            /* top-level node removed */
+            rc = ncc_rollback_edit_add(root, 1, edit);
+        } else if (lyd_find_sibling_first(data, root, &match)) {
+            EINT;
+            rc = SR_ERR_INTERNAL;
+        } else {
+            /* top-level node created or changed, remove it if there are no explicit nodes left */
+            rc = ncc_rollback_edit_add(match, (match->flags & LYD_DEFAULT) ? 1 : 0, edit);
+        }
+        if (rc) {
+            goto cleanup;
+        }
+    }
+
+cleanup:
+    lyd_free_siblings(data);
+    lyd_free_siblings(diff);
+    return rc;
+}
+
+/**
+ * @brief Restore running using the journal.
+ *
+ * All the modules are restored in a single sysrepo transaction, nothing is restored on any error.
+ */
+static void
+changes_rollback(void)
+{
+    int rc, failed = 0;
+    struct lyd_node *edit = NULL;
     const struct ly_ctx *ctx = NULL;
-    struct lys_module *module = NULL;
-    sr_session_ctx_t *session;
-    char *path = NULL, *module_name = NULL, *meta = NULL, *srv_path = NULL;
-    uint32_t nc_id;
-    DIR *dir = NULL;
-    struct dirent *dirent = NULL;
+    const struct lys_module *module = NULL;
+    sr_session_ctx_t *session = NULL;
+    struct ncc_journal jrn;
+    const char *mod_diff;
+    uint32_t i, nc_id;
 
     VRB("Confirmed commit timeout reached. Restoring previous running.");
     ctx = sr_get_context(np2srv.sr_conn);
 
+    if (ncc_journal_open(&jrn)) {
+        return;
+    }
+    if (!jrn.data) {
+        /* nothing to restore */
+        return;
+    }
+
     /* Start a session */
     if ((rc = sr_session_start(np2srv.sr_conn, SR_DS_RUNNING, &session))) {
         ERR("Failed starting a sysrepo session (%s).", sr_strerror(rc));
+        failed = 1;
         goto cleanup;
     }
     /* set session attributes for diff_check_cb to skip NACM check */
@@ -335,197 +959,166 @@ changes_rollback(union sigval UNUSED(sev))
     /* username */
     sr_session_push_orig_data(session, 1, "");
 
-    if ((rc = ncc_check_dir())) {
-        goto cleanup;
-    }
-    /* Iterate over all files in backup directory */
-    if (asprintf(&srv_path, "%s/%s", np2srv.server_dir, NCC_DIR) == -1) {
-        EMEM;
-        goto cleanup;
-    }
-    dir = opendir(srv_path);
-    if (!dir) {
-        ERR("Failed opening netopeer2 server directory \"%s\".", srv_path);
+    if (!jrn.valid) {
+        ERR("Confirmed commit journal is corrupted.");
+        failed = 1;
         goto cleanup;
     }
-    while ((dirent = readdir(dir))) {
-        if (!strcmp(dirent->d_name, ".") || !strcmp(dirent->d_name, "..") || !strcmp(dirent->d_name, META_FILE)) {
-            continue;
-        }
 
-        /* try to find the module that corresponds with the file */
-        free(module_name);
-        module_name = get_module_name_from_filename(dirent->d_name);
-        if (!module_name) {
-            /* Skipping files that do not match the expected format */
+    /* Iterate over the modules in the journal and create an edit for all of them */
+    for (i = 0; i < jrn.mod_count; ++i) {
+        mod_diff = jrn.mods[i].diff;
+        if (!mod_diff[0]) {
+            /* nothing to revert */
             continue;
         }
-        free(path);
-        path = NULL;
-        if (asprintf(&path, "%s/%s/%s", np2srv.server_dir, NCC_DIR, dirent->d_name) == -1) {
-            EMEM;
-            goto cleanup;
-        }
-        module = ly_ctx_get_module_implemented(ctx, module_name);
+
+        module = ly_ctx_get_module_implemented(ctx, jrn.mods[i].name);
         if (!module) {
-            ERR("Module \"%s\" does not exist/not implemented.", module_name);
-            rename_failed_file(module_name, path);
-            continue;
+            ERR("Module \"%s\" does not exist/not implemented.", jrn.mods[i].name);
+            failed = 1;
+            goto cleanup;
         }
 
-        /* get, restore and delete the backup */
         VRB("Rolling back module \"%s\"", module->name);
-        if (get_running_backup(ctx, path, &node)) {
-            rename_failed_file(module_name, path);
-            continue;
-        }
-        if ((rc = sr_replace_config(session, module->name, node, np2srv.sr_timeout))) {
-            ERR("Failed restoring backup for module \"%s\".", module->name);
-            rename_failed_file(module_name, path);
-            continue;
-        }
-        if (unlink(path) == -1) {
-            ERR("Failed removing backup file \"%s\" (%s).", path, strerror(errno));
+        if (ncc_rollback_module_edit(session, module, mod_diff, &edit)) {
+            failed = 1;
             goto cleanup;
         }
     }
 
-    if (asprintf(&meta, "%s/%s/%s", np2srv.server_dir, NCC_DIR, META_FILE) < 0) {
-        EMEM;
+    if (!edit) {
+        /* nothing was changed */
         goto cleanup;
     }
-    if (unlink(meta) == -1) {
-        ERR("Failed removing confirmed commit meta file (%s).", strerror(errno));
+
+    /* restore all the modules at once */
+    if ((rc = sr_edit_batch(session, edit, "merge"))) {
+        ERR("Failed restoring backup (%s).", sr_strerror(rc));
+        failed = 1;
+        goto cleanup;
+    }
+    if ((rc = sr_apply_changes(session, np2srv.sr_timeout))) {
+        ERR("Failed restoring backup (%s).", sr_strerror(rc));
+        sr_discard_changes(session);
+        failed = 1;
         goto cleanup;
     }
 
 cleanup:
-    closedir(dir);
     sr_session_stop(session);
-    free(path);
-    free(srv_path);
-    free(meta);
-    free(module_name);
+    lyd_free_siblings(edit);
+    ncc_journal_close(&jrn);
+
+    /* keep the journal if it could not be restored */
+    if (failed) {
+        ncc_journal_fail();
+    } else {
+        ncc_journal_remove();
+    }
 }
 
 /**
- * @brief Remove all the backup files not marked as failed.
+ * @brief Callback run after the timer in commit_ctx_s runs out.
+ *
+ * @param[in] arg ID of the timer.
  */
 static void
-clean_backup_directory(void)
+changes_rollback_cb(void *arg)
 {
-    DIR *dir = NULL;
-    struct dirent *dirent;
-    char *path = NULL, *ncc_path = NULL;
-
-    if (asprintf(&ncc_path, "%s/%s", np2srv.server_dir, NCC_DIR) == -1) {
-        EMEM;
-        return;
-    }
-
-    dir = opendir(ncc_path);
-    if (!dir) {
-        ERR("Could not open netopeer2 server directory \"%s\" (%s).", ncc_path, strerror(errno));
-        goto cleanup;
-    }
-    while ((dirent = readdir(dir))) {
-        if (!strcmp(dirent->d_name, ".") || !strcmp(dirent->d_name, "..") ||
-                !strstr(".json", dirent->d_name) || strcmp(META_FILE, dirent->d_name)) {
-            /* If some unexpected file, just skip */
-            continue;
-        }
+    /* LOCK */
+    pthread_mutex_lock(&commit_ctx.lock);
 
-        if (asprintf(&path, "%s/%s", ncc_path, dirent->d_name) == -1) {
-            EMEM;
-            goto cleanup;
-        }
+    if ((uintptr_t)arg == commit_ctx.timer_id) {
+        changes_rollback();
 
-        if (unlink(path) == -1) {
-            ERR("Could not remove backup file \"%s\" (%s).", path, strerror(errno));
-            goto cleanup;
-        }
-        free(path);
-        path = NULL;
-    }
+        /* no confirmed commit is pending anymore */
+        np_timer_delete(commit_ctx.timer);
+        commit_ctx.timer = NULL;
+    } /* else the timer was replaced by a follow-up confirmed commit or deleted meanwhile */
 
-cleanup:
-    closedir(dir);
-    free(path);
-    free(ncc_path);
+    /* UNLOCK */
+    pthread_mutex_unlock(&commit_ctx.lock);
 }
 
 /**
- * @brief Confirm pending commit. Clear the timer. Clean the directory.
+ * @brief Confirm pending commit. Clear the timer. Remove the journal.
  */
 static void
 ncc_commit_confirmed(void)
 {
-    timer_delete(commit_ctx.timer);
-    commit_ctx.timer = 0;
-    clean_backup_directory();
+    np_timer_delete(commit_ctx.timer);
+    commit_ctx.timer = NULL;
+    ++commit_ctx.timer_id;
+    ncc_journal_remove();
 }
 
 /**
- * @brief Cancel pending commit. Rollback running from backup.
+ * @brief Cancel pending commit. Rollback running from the journal.
  */
 static void
 ncc_commit_cancel(void)
 {
-    changes_rollback((union sigval)0);
+    changes_rollback();
     ncc_commit_confirmed();
 }
 
 /**
- * @brief Backup a module into a file
+ * @brief Backup a module into the journal. Only the changes reverting running after the commit of candidate are
+ * stored.
  *
- * @param[in] session Sysrepo session used to get data of the module.
  * @param[in] module Module to backup.
+ * @param[in,out] diff Changes of the module reverting the commit, merged with the previous changes.
+ * @param[in] prev_jrn Journal of a pending confirmed commit to merge the changes with so that they revert running
+ * to its state before the first confirmed commit, NULL if there is none.
+ * @param[in] fd File descriptor of the journal to append to.
  *
- * @return SR_ERR_LY When printing into the file failed.
+ * @return SR_ERR_LY When printing the changes failed.
  * @return SR_ERR_NO_MEMORY When memory ran during allocation
  * @return SR_ERR_OK On success
  */
 static int
-backup_module(sr_session_ctx_t *session, const struct lys_module *module)
+backup_module(const struct lys_module *module, struct lyd_node **diff, const struct ncc_journal *prev_jrn, int fd)
 {
     int rc = SR_ERR_OK;
-    char *path = NULL, *xpath = NULL, *ncc_path = NULL;
-    struct lyd_node *node = NULL;
-
-    if (asprintf(&ncc_path, "%s/%s", np2srv.server_dir, NCC_DIR) == -1) {
-        EMEM;
-        rc = SR_ERR_NO_MEMORY;
-        goto cleanup;
-    }
-    VRB("Backing up module \"%s\".", module->name);
-
-    if (asprintf(&xpath, "/%s:*", module->name) == -1) {
-        EMEM;
-        rc = SR_ERR_NO_MEMORY;
-        goto cleanup;
+    char *str = NULL;
+    const char *prev_str;
+    struct lyd_node *prev_diff = NULL;
+    struct iovec parts[2];
+
+    if (prev_jrn && (prev_str = ncc_journal_find_module(prev_jrn, module->name)) && prev_str[0]) {
+        /* the changes of the previous confirmed commit */
+        if ((rc = ncc_parse_module_diff(module, prev_str, &prev_diff))) {
+            goto cleanup;
+        }
     }
 
-    if ((rc = sr_get_data(session, xpath, 0, 0, 0, &node))) {
-        ERR("Failed getting configuration of running for module \"%s\" (%s).", module->name, sr_strerror(rc));
-        goto cleanup;
+    if (prev_diff) {
+        /* append the changes reverting the previous confirmed commit */
+        if (lyd_diff_merge_all(diff, prev_diff, 0)) {
+            ERR("Failed merging changes of module \"%s\" (%s).", module->name, ly_errmsg(module->ctx));
+            rc = SR_ERR_LY;
+            goto cleanup;
+        }
     }
 
-    if (asprintf(&path, "%s/%s.json", ncc_path, module->name) == -1) {
-        EMEM;
-        rc = SR_ERR_NO_MEMORY;
-        goto cleanup;
-    }
-    if (lyd_print_path(path, node, LYD_JSON, LY_PRINT_SHRINK)) {
-        ERR("Failed backing up node of module \"%s\" into file \"%s\" (%s).",
-                module->name, path, ly_errmsg(LYD_CTX(node)));
+    VRB("Backing up module \"%s\".", module->name);
+    if (*diff && lyd_print_mem(&str, *diff, LYD_JSON, LY_PRINT_SHRINK | LYD_PRINT_WITHSIBLINGS)) {
+        ERR("Failed printing changes of module \"%s\" (%s).", module->name, ly_errmsg(module->ctx));
         rc = SR_ERR_LY;
         goto cleanup;
     }
 
+    /* empty changes if the merged changes cancelled each other */
+    parts[0].iov_base = (void *)module->name;
+    parts[0].iov_len = strlen(module->name) + 1;
+    parts[1].iov_base = str ? str : "";
+    parts[1].iov_len = str ? strlen(str) + 1 : 1;
+    rc = ncc_journal_append(fd, NCC_REC_MODULE, parts, 2);
+
 cleanup:
-    lyd_free_tree(node);
-    free(path);
-    free(xpath);
+    lyd_free_siblings(prev_diff);
+    free(str);
     return rc;
 }
 
@@ -534,101 +1127,61 @@ cleanup:
  *
  * @param[in] timeout_s Time (in seconnds) after which the timer will start the rollback.
  *
- * @return SR_ERR_SYS When creating the timer fails.
+ * @return SR_ERR_NO_MEMORY When creating the timer fails.
  * @return SR_ERR_OK When succeeded.
  */
 static int
 ncc_commit_timeout_schedule(uint32_t timeout_s)
 {
-    struct sigevent sev = {0};
-    struct itimerspec its = {0};
-    timer_t timer_id;
+    struct np_timer *timer;
+    struct timespec expire;
+    int rc;
 
     /* create and arm the timer */
-    sev.sigev_notify = SIGEV_THREAD;
-    sev.sigev_notify_function = changes_rollback;
-    its.it_value.tv_sec = timeout_s;
-    if (timer_create(CLOCK_REALTIME, &sev, &timer_id) == -1) {
-        ERR("Could not create a timer for confirmed commit rollback (%s).", strerror(errno));
-        return SR_ERR_SYS;
+    if ((rc = np_timer_create(changes_rollback_cb, (void *)(commit_ctx.timer_id + 1), &timer))) {
+        ERR("Could not create a timer for confirmed commit rollback.");
+        return rc;
     }
-    if (timer_settime(timer_id, 0, &its, NULL) == -1) {
-        ERR("Could not set time in timer for confirmed commit rollback (%s).", strerror(errno));
-        return SR_ERR_SYS;
-    }
-    commit_ctx.timer = timer_id;
+    expire = np_gettimespec(1);
+    expire.tv_sec += timeout_s;
+    np_timer_set(timer, &expire, 0);
 
-    return SR_ERR_OK;
-}
+    /* replace any previous timer */
+    np_timer_delete(commit_ctx.timer);
+    commit_ctx.timer = timer;
+    ++commit_ctx.timer_id;
 
-/**
- * @brief Get information from meta file and remove it.
- *
- * @param[out] time When the confirmed commit was called.
- * @param[out] timeout_s What was the timeout (seconds) supposed to be.
- * @return SR_ERR_SYS When reading file failed;
- * @return SR_ERR_OK When successful. If time is zero no meta file existed.
- */
-static int
-read_meta_file(time_t *time, uint32_t *timeout_s)
-{
-    int rc = SR_ERR_OK;
-    FILE *file = NULL;
-    char *meta = NULL;
-
-    *time = 0;
-    *timeout_s = 0;
-
-    /* Check for file */
-    if (asprintf(&meta, "%s/%s/%s", np2srv.server_dir, NCC_DIR, META_FILE) < 0) {
-        EMEM;
-        rc = SR_ERR_NO_MEMORY;
-        goto cleanup;
-    }
-
-    file = fopen(meta, "r");
-    if (!file) {
-        if (errno != ENOENT) {
-            ERR("Confirmed commit meta file opening failed (%s).", strerror(errno));
-            rc = SR_ERR_SYS;
-        } /* else does not exist */
-        goto cleanup;
-    }
-
-    if (fscanf(file, "%ld\n%" SCNu32 "\n", (long *)time, timeout_s) != 2) {
-        ERR("Malformed confirmed commit meta file. Could not recover.");
-        *time = 0;
-        *timeout_s = 0;
-        rc = SR_ERR_SYS;
-        goto cleanup;
-    }
-
-cleanup:
-    if (file) {
-        fclose(file);
-    }
-    free(meta);
-    return rc;
+    return SR_ERR_OK;
 }
 
 void
 ncc_try_restore(void)
 {
-    time_t timestamp = 0, end_time = 0, current = 0;
-    uint32_t timeout = 0, new_timeout = 0;
+    time_t end_time = 0, current = 0;
+    uint32_t new_timeout = 0;
+    struct ncc_journal jrn;
+    struct ncc_rec_meta meta;
+    int found;
 
     /* In theory it should be under a mutex, but since it is called in init it is not needed */
 
-    if (read_meta_file(&timestamp, &timeout)) {
+    if (ncc_journal_open(&jrn)) {
         return;
     }
-    if (!timestamp) {
-        /* No meta file existed */
+    if (!jrn.data) {
+        /* No journal existed */
+        return;
+    }
+    found = ncc_journal_find_meta(&jrn, &meta);
+    ncc_journal_close(&jrn);
+    if (!found) {
+        ERR("Malformed confirmed commit journal. Could not recover.");
+        ncc_journal_fail();
         return;
     }
 
     /* Check when the confirmed commit was supposed to timeout */
-    end_time = timestamp + timeout;
+    end_time = meta.time + meta.timeout_s;
     current = time(NULL);
     if (end_time > current) {
         /* In the future -> compute the remaining time */
@@ -641,88 +1194,149 @@ ncc_try_restore(void)
 }
 
 /**
- * @brief Create backup files for all implemented modules
+ * @brief Write the journal with the backup of all the modules changed by the commit of candidate.
  *
+ * @param[in] diff Changes of running made by the commit, NULL if there are none.
+ * @param[in] merge Whether a confirmed commit is pending and its journal should be appended to.
+ * @param[in] timeout_s Timeout (in seconds) that is used for the confirmed commit.
+ * @param[out] prev_len Length of the journal before it was written, to revert it if the commit fails.
  * @return SR_ERR_OK When successful.
  */
 static int
-set_running_backup(void)
+set_running_backup(const struct lyd_node *diff, int merge, uint32_t timeout_s, size_t *prev_len)
 {
-    int rc = SR_ERR_OK, read = 0, write = 0;
-    const struct ly_ctx *ctx;
-    struct sr_session_ctx_s *session;
-    struct lys_module *module;
-    sr_conn_ctx_t *conn;
-    uint32_t index = 0;
+    int rc = SR_ERR_OK, fd = -1;
+    const struct lys_module *module;
+    struct lyd_node *rev = NULL, *mod_diff = NULL, *root, *next;
+    struct ncc_journal prev_jrn = {0};
+    struct ncc_rec_meta meta = {0};
+    struct iovec part;
+    char *path = NULL;
 
-    if ((rc = sr_session_start(np2srv.sr_conn, SR_DS_RUNNING, &session))) {
-        ERR("Failed starting a sysrepo session (%s).", sr_strerror(rc));
-        goto cleanup;
-    }
+    *prev_len = 0;
 
-    /* Iterate over all implemented modules */
-    conn = sr_session_get_connection(session);
-    ctx = sr_get_context(conn);
     if ((rc = ncc_check_dir())) {
         goto cleanup;
     }
-    while ((module = ly_ctx_get_module_iter(ctx, &index))) {
-        /* check if module should and can be backed up */
-        if (!module->implemented) {
-            continue;
-        }
-        if (!np_ly_mod_has_data(module, LYS_CONFIG_W)) {
-            continue;
-        }
+    if ((rc = ncc_journal_path(&path))) {
+        goto cleanup;
+    }
 
-        /* Check if has both read and write permission for module in sysrepo */
-        if ((rc = sr_check_module_ds_access(conn, "edit1", SR_DS_RUNNING, &read, &write))) {
-            ERR("Failed getting permissions of module \"%s\".", module->name);
+    if (merge) {
+        if ((rc = ncc_journal_open(&prev_jrn))) {
             goto cleanup;
         }
-        if (!read || !write) {
-            continue;
+    } else if (!access(path, F_OK)) {
+        WRN("Confirmed commit journal of a previous commit was not restored.");
+        ncc_journal_fail();
+    }
+    *prev_len = prev_jrn.valid;
+
+    /* append after the complete records, an incomplete previous append is discarded */
+    fd = open(path, O_WRONLY | O_CREAT, S_IRUSR | S_IWUSR);
+    if (fd == -1) {
+        ERR("Failed opening confirmed commit journal \"%s\" (%s).", path, strerror(errno));
+        rc = SR_ERR_SYS;
+        goto cleanup;
+    }
+    if ((ftruncate(fd, prev_jrn.valid) == -1) || (lseek(fd, prev_jrn.valid, SEEK_SET) == -1)) {
+        ERR("Failed truncating confirmed commit journal \"%s\" (%s).", path, strerror(errno));
+        rc = SR_ERR_SYS;
+        goto cleanup;
+    }
+
+    /* the changes reverting the commit */
+    if (diff && lyd_diff_reverse_all(diff, &rev)) {
+        ERR("Failed reversing confirmed commit changes (%s).", ly_errmsg(LYD_CTX(diff)));
+        rc = SR_ERR_LY;
+        goto cleanup;
+    }
+
+    /* backup only the modules changed by the commit */
+    while (rev) {
+        module = lyd_owner_module(rev);
+
+        /* move all the top-level nodes of the module into its changes */
+        for (root = rev; root; root = next) {
+            next = root->next;
+            if (lyd_owner_module(root) != module) {
+                continue;
+            }
+
+            if (root == rev) {
+                rev = next;
+            }
+            lyd_unlink_tree(root);
+            if (lyd_insert_sibling(mod_diff, root, &mod_diff)) {
+                ERR("Failed learning changes of module \"%s\" (%s).", module->name, ly_errmsg(module->ctx));
+                lyd_free_tree(root);
+                rc = SR_ERR_LY;
+                goto cleanup;
+            }
         }
 
         /* Create the backup */
-        if ((rc = backup_module(session, module))) {
+        if ((rc = backup_module(module, &mod_diff, merge ? &prev_jrn : NULL, fd))) {
             ERR("Failed creating backup of module \"%s\".", module->name);
             goto cleanup;
         }
+        lyd_free_siblings(mod_diff);
+        mod_diff = NULL;
+    }
+
+    /* metadata used when restoring after crash, the timeout is restarted by every confirmed commit */
+    meta.time = time(NULL);
+    meta.timeout_s = timeout_s;
+    part.iov_base = &meta;
+    part.iov_len = sizeof meta;
+    if ((rc = ncc_journal_append(fd, NCC_REC_META, &part, 1))) {
+        goto cleanup;
+    }
+
+    /* the records are complete once the commit record is stored */
+    if ((rc = ncc_journal_append(fd, NCC_REC_COMMIT, NULL, 0))) {
+        goto cleanup;
+    }
+    if (fsync(fd) == -1) {
+        ERR("Failed synchronizing confirmed commit journal \"%s\" (%s).", path, strerror(errno));
+        rc = SR_ERR_SYS;
+        goto cleanup;
+    }
+
+    /* the journal may have just been created */
+    if ((rc = ncc_journal_dir_sync())) {
+        goto cleanup;
     }
 
 cleanup:
-    sr_session_stop(session);
+    if (fd > -1) {
+        close(fd);
+    }
+    lyd_free_siblings(rev);
+    lyd_free_siblings(mod_diff);
+    ncc_journal_close(&prev_jrn);
+    free(path);
     return rc;
 }
 
-/**
- * @brief Create a file containing metadata about confirmed commit. Used when restoring after crash.
- *
- * @param[in] timeout_s Timeout (in seconds) that was used for the confirmed commit.
- */
-static void
-create_meta_file(uint32_t timeout_s)
+int
+ncc_diff_check(sr_session_ctx_t *session, const struct lyd_node *diff)
 {
-    FILE *file = NULL;
-    char *meta;
+    int rc;
 
-    if (asprintf(&meta, "%s/%s/%s", np2srv.server_dir, NCC_DIR, META_FILE) < 0) {
-        EMEM;
-        goto cleanup;
-    }
-    file = fopen(meta, "w");
-    if (!file) {
-        WRN("Failed creating confirmed commit meta file. Changes will not recover in case the server is stopped.");
-        goto cleanup;
+    if (ATOMIC_PTR_LOAD(commit_ctx.backup_sess) != session) {
+        /* not a confirmed commit */
+        return SR_ERR_OK;
     }
-    fprintf(file, "%ld\n%" PRIu32 "\n", (long)time(NULL), timeout_s);
 
-cleanup:
-    if (file) {
-        fclose(file);
+    /* called by the confirmed commit itself while holding the lock */
+    if ((rc = set_running_backup(diff, commit_ctx.backup_merge, commit_ctx.backup_timeout, &commit_ctx.backup_prev))) {
+        ERR("Failed creating confirmed commit backup.");
+        return rc;
     }
-    free(meta);
+    commit_ctx.backup_done = 1;
+
+    return SR_ERR_OK;
 }
 
 /**
@@ -773,14 +1387,12 @@ np2srv_confirmed_commit_cb(sr_session_ctx_t *session, const struct lyd_node *inp
         goto cleanup;
     }
 
-    /* create and store the backup */
     if ((rc = sr_session_switch_ds(user_sess->sess, SR_DS_RUNNING))) {
         goto cleanup;
     }
-    if (set_running_backup()) {
-        goto cleanup;
-    }
-    create_meta_file(timeout);
+    commit_ctx.backup_merge = commit_ctx.timer ? 1 : 0;
+    commit_ctx.backup_timeout = timeout;
+    commit_ctx.backup_done = 0;
 
     /* Set persist and start timer thread for rollback */
     if (persist) {
@@ -792,8 +1404,15 @@ np2srv_confirmed_commit_cb(sr_session_ctx_t *session, const struct lyd_node *inp
         goto cleanup;
     }
 
-    /* sysrepo API */
+    /* sysrepo API, the changes are backed up by the diff check callback before they are stored */
+    ATOMIC_PTR_STORE(commit_ctx.backup_sess, user_sess->sess);
     rc = sr_copy_config(user_sess->sess, NULL, SR_DS_CANDIDATE, np2srv.sr_timeout);
+    ATOMIC_PTR_STORE(commit_ctx.backup_sess, NULL);
+    if (rc && commit_ctx.backup_done) {
+        /* nothing was committed */
+        ncc_journal_truncate(commit_ctx.backup_prev);
+    }
+
     if ((rc == SR_ERR_LOCKED) && NP_IS_ORIG_NP(session)) {
         /* NETCONF error */
         sr_session_get_error(user_sess->sess, &err_info);
@@ -804,6 +1423,11 @@ np2srv_confirmed_commit_cb(sr_session_ctx_t *session, const struct lyd_node *inp
         goto cleanup;
     }
 
+    if (!rc && !commit_ctx.backup_done) {
+        /* there were no changes, only restart the timeout */
+        rc = set_running_backup(NULL, commit_ctx.backup_merge, timeout, &commit_ctx.backup_prev);
+    }
+
 cleanup:
     np_release_user_sess(user_sess);
     return rc;
@@ -31,6 +31,18 @@ void ncc_commit_ctx_destroy(void);
  */
 void ncc_try_restore(void);
 
+/**
+ * @brief Back up the changes of a confirmed commit before they are stored.
+ *
+ * Meant to be called from the sysrepo diff check callback, backs up only the changes of the session applying
+ * a confirmed commit.
+ *
+ * @param[in] session Sysrepo session applying the changes.
+ * @param[in] diff Changes to be stored.
+ * @return SR error value, the changes must not be stored on error.
+ */
+int ncc_diff_check(sr_session_ctx_t *session, const struct lyd_node *diff);
+
 int np2srv_rpc_commit_cb(sr_session_ctx_t *session, uint32_t sub_id, const char *op_path,
         const struct lyd_node *input, sr_event_t event, uint32_t request_id,
         struct lyd_node *output, void *private_data);
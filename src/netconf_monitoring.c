@@ -16,6 +16,8 @@
 
 #include "netconf_monitoring.h"
 
+#include <ctype.h>
+#include <inttypes.h>
 #include <pthread.h>
 #include <stdint.h>
 #include <stdlib.h>
@@ -35,29 +37,70 @@ void
 ncm_init(void)
 {
     stats.netconf_start_time = time(NULL);
-    pthread_mutex_init(&stats.lock, NULL);
+    pthread_rwlock_init(&stats.lock, NULL);
+    pthread_mutex_init(&stats.static_lock, NULL);
 }
 
 void
 ncm_destroy(void)
 {
+    struct ncm_session *msess, *next;
+    uint32_t i;
+
+    for (i = 0; i < stats.session_size; ++i) {
+        for (msess = stats.sessions[i]; msess; msess = next) {
+            next = msess->next;
+            np_release_user_sess(msess->user_sess);
+            free(msess);
+        }
+    }
     free(stats.sessions);
-    free(stats.session_stats);
-    pthread_mutex_destroy(&stats.lock);
+    pthread_rwlock_destroy(&stats.lock);
+
+    lyd_free_siblings(stats.static_data);
+    pthread_mutex_destroy(&stats.static_lock);
 }
 
-static uint32_t
-find_session_idx(struct nc_session *session)
+/**
+ * @brief Get the hash table bucket of a session.
+ *
+ * @param[in] nc_id NC ID of the session.
+ * @param[in] size Size of the hash table, power of 2.
+ * @return Bucket index.
+ */
+#define NCM_SESSION_BUCKET(nc_id, size) ((nc_id) & ((size) - 1))
+
+/**
+ * @brief Enlarge the hash table of monitored sessions. Lock is expected to be held for writing.
+ *
+ * @return 0 on success, -1 on error.
+ */
+static int
+ncm_session_ht_enlarge(void)
 {
-    uint32_t i;
+    struct ncm_session **sessions, *msess, *next;
+    uint32_t i, size, bucket;
+
+    size = stats.session_size ? stats.session_size * 2 : 64;
+    sessions = calloc(size, sizeof *sessions);
+    if (!sessions) {
+        EMEM;
+        return -1;
+    }
 
-    for (i = 0; i < stats.session_count; ++i) {
-        if (nc_session_get_id(stats.sessions[i]) == nc_session_get_id(session)) {
-            return i;
+    /* rehash */
+    for (i = 0; i < stats.session_size; ++i) {
+        for (msess = stats.sessions[i]; msess; msess = next) {
+            next = msess->next;
+            bucket = NCM_SESSION_BUCKET(nc_session_get_id(msess->session), size);
+            msess->next = sessions[bucket];
+            sessions[bucket] = msess;
         }
     }
 
-    EINT;
+    free(stats.sessions);
+    stats.sessions = sessions;
+    stats.session_size = size;
     return 0;
 }
 
@@ -81,70 +124,81 @@ ncm_is_monitored(struct nc_session *session)
     return 0;
 }
 
+/**
+ * @brief Get session counters of a monitored session.
+ *
+ * @param[in] session NC session.
+ * @return Session counters, NULL if the session is not monitored.
+ */
+static struct ncm_session_stats *
+ncm_get_session_stats(struct nc_session *session)
+{
+    struct np2_user_sess *user_sess;
+
+    if (!ncm_is_monitored(session) || !(user_sess = nc_session_get_data(session))) {
+        return NULL;
+    }
+
+    return &user_sess->stats;
+}
+
 void
 ncm_session_rpc(struct nc_session *session)
 {
-    if (!ncm_is_monitored(session)) {
+    struct ncm_session_stats *sess_stats;
+
+    if (!(sess_stats = ncm_get_session_stats(session))) {
         return;
     }
 
-    pthread_mutex_lock(&stats.lock);
-
-    ++stats.session_stats[find_session_idx(session)].in_rpcs;
-    ++stats.global_stats.in_rpcs;
-
-    pthread_mutex_unlock(&stats.lock);
+    ATOMIC_INC_RELAXED(sess_stats->in_rpcs);
+    ATOMIC_INC_RELAXED(stats.global_stats.in_rpcs);
 }
 
 void
 ncm_session_bad_rpc(struct nc_session *session)
 {
-    if (!ncm_is_monitored(session)) {
+    struct ncm_session_stats *sess_stats;
+
+    if (!(sess_stats = ncm_get_session_stats(session))) {
         return;
     }
 
-    pthread_mutex_lock(&stats.lock);
-
-    ++stats.session_stats[find_session_idx(session)].in_bad_rpcs;
-    ++stats.global_stats.in_bad_rpcs;
-
-    pthread_mutex_unlock(&stats.lock);
+    ATOMIC_INC_RELAXED(sess_stats->in_bad_rpcs);
+    ATOMIC_INC_RELAXED(stats.global_stats.in_bad_rpcs);
 }
 
 void
 ncm_session_rpc_reply_error(struct nc_session *session)
 {
-    if (!ncm_is_monitored(session)) {
+    struct ncm_session_stats *sess_stats;
+
+    if (!(sess_stats = ncm_get_session_stats(session))) {
         return;
     }
 
-    pthread_mutex_lock(&stats.lock);
-
-    ++stats.session_stats[find_session_idx(session)].out_rpc_errors;
-    ++stats.global_stats.out_rpc_errors;
-
-    pthread_mutex_unlock(&stats.lock);
+    ATOMIC_INC_RELAXED(sess_stats->out_rpc_errors);
+    ATOMIC_INC_RELAXED(stats.global_stats.out_rpc_errors);
 }
 
 void
 ncm_session_notification(struct nc_session *session)
 {
-    if (!ncm_is_monitored(session)) {
+    struct ncm_session_stats *sess_stats;
+
+    if (!(sess_stats = ncm_get_session_stats(session))) {
         return;
     }
 
-    pthread_mutex_lock(&stats.lock);
-
-    ++stats.session_stats[find_session_idx(session)].out_notifications;
-    ++stats.global_stats.out_notifications;
-
-    pthread_mutex_unlock(&stats.lock);
+    ATOMIC_INC_RELAXED(sess_stats->out_notifications);
+    ATOMIC_INC_RELAXED(stats.global_stats.out_notifications);
 }
 
 void
 ncm_session_add(struct nc_session *session)
 {
-    void *new;
+    struct ncm_session *msess;
+    uint32_t bucket;
 
     if (!ncm_is_monitored(session)) {
         WRN("Session %d uses a transport protocol not supported by ietf-netconf-monitoring, will not be monitored.",
@@ -152,58 +206,77 @@ ncm_session_add(struct nc_session *session)
         return;
     }
 
-    pthread_mutex_lock(&stats.lock);
-
-    ++stats.in_sessions;
+    ATOMIC_INC_RELAXED(stats.in_sessions);
 
-    ++stats.session_count;
-    new = realloc(stats.sessions, stats.session_count * sizeof *stats.sessions);
-    if (!new) {
+    msess = malloc(sizeof *msess);
+    if (!msess) {
         EMEM;
-        goto cleanup;
+        return;
     }
-    stats.sessions = new;
-    new = realloc(stats.session_stats, stats.session_count * sizeof *stats.session_stats);
-    if (!new) {
-        EMEM;
-        goto cleanup;
+    msess->session = session;
+
+    /* keep the user session with the counters while the session is monitored */
+    msess->user_sess = nc_session_get_data(session);
+    ATOMIC_INC_RELAXED(msess->user_sess->ref_count);
+
+    /* WRITE LOCK */
+    pthread_rwlock_wrlock(&stats.lock);
+
+    if ((stats.session_count >= stats.session_size) && ncm_session_ht_enlarge()) {
+        pthread_rwlock_unlock(&stats.lock);
+        np_release_user_sess(msess->user_sess);
+        free(msess);
+        return;
     }
-    stats.session_stats = new;
 
-    stats.sessions[stats.session_count - 1] = session;
-    memset(&stats.session_stats[stats.session_count - 1], 0, sizeof *stats.session_stats);
+    bucket = NCM_SESSION_BUCKET(nc_session_get_id(session), stats.session_size);
+    msess->next = stats.sessions[bucket];
+    stats.sessions[bucket] = msess;
+    ++stats.session_count;
 
-cleanup:
-    pthread_mutex_unlock(&stats.lock);
+    /* UNLOCK */
+    pthread_rwlock_unlock(&stats.lock);
 }
 
 void
 ncm_session_del(struct nc_session *session)
 {
-    uint32_t i;
+    struct ncm_session **msess_p, *msess = NULL;
 
     if (!ncm_is_monitored(session)) {
         return;
     }
 
-    pthread_mutex_lock(&stats.lock);
-
     if (!nc_session_get_term_reason(session)) {
         EINT;
     }
 
     if (nc_session_get_term_reason(session) != NC_SESSION_TERM_CLOSED) {
-        ++stats.dropped_sessions;
+        ATOMIC_INC_RELAXED(stats.dropped_sessions);
     }
 
-    i = find_session_idx(session);
-    --stats.session_count;
-    if (stats.session_count && (i < stats.session_count)) {
-        memmove(&stats.sessions[i], &stats.sessions[i + 1], (stats.session_count - i) * sizeof *stats.sessions);
-        memmove(&stats.session_stats[i], &stats.session_stats[i + 1], (stats.session_count - i) * sizeof *stats.session_stats);
+    /* WRITE LOCK */
+    pthread_rwlock_wrlock(&stats.lock);
+
+    if (stats.session_size) {
+        msess_p = &stats.sessions[NCM_SESSION_BUCKET(nc_session_get_id(session), stats.session_size)];
+        for ( ; *msess_p; msess_p = &(*msess_p)->next) {
+            if ((*msess_p)->session == session) {
+                msess = *msess_p;
+                *msess_p = msess->next;
+                --stats.session_count;
+                break;
+            }
+        }
     }
 
-    pthread_mutex_unlock(&stats.lock);
+    /* UNLOCK */
+    pthread_rwlock_unlock(&stats.lock);
+
+    if (msess) {
+        np_release_user_sess(msess->user_sess);
+        free(msess);
+    }
 }
 
 void
@@ -213,29 +286,19 @@ ncm_bad_hello(struct nc_session *session)
         return;
     }
 
-    pthread_mutex_lock(&stats.lock);
-
-    ++stats.in_bad_hellos;
-
-    pthread_mutex_unlock(&stats.lock);
+    ATOMIC_INC_RELAXED(stats.in_bad_hellos);
 }
 
 uint32_t
 ncm_session_get_notification(struct nc_session *session)
 {
-    uint32_t count;
+    struct ncm_session_stats *sess_stats;
 
-    if (!ncm_is_monitored(session)) {
+    if (!(sess_stats = ncm_get_session_stats(session))) {
         return 0;
     }
 
-    pthread_mutex_lock(&stats.lock);
-
-    count = stats.session_stats[find_session_idx(session)].out_notifications;
-
-    pthread_mutex_unlock(&stats.lock);
-
-    return count;
+    return ATOMIC_LOAD_RELAXED(sess_stats->out_notifications);
 }
 
 static void
@@ -266,22 +329,21 @@ ncm_data_add_ds_lock(sr_conn_ctx_t *conn, const char *ds_str, sr_datastore_t ds,
     }
 }
 
-int
-np2srv_ncm_oper_cb(sr_session_ctx_t *session, uint32_t UNUSED(sub_id), const char *UNUSED(module_name),
-        const char *UNUSED(path), const char *UNUSED(request_xpath), uint32_t UNUSED(request_id),
-        struct lyd_node **parent, void *UNUSED(private_data))
+/**
+ * @brief Create the netconf-state data that change only with the context, capabilities and schemas.
+ *
+ * @param[in] ly_ctx libyang context.
+ * @param[out] data Created netconf-state container.
+ * @return 0 on success, -1 on error.
+ */
+static int
+ncm_static_data_create(struct ly_ctx *ly_ctx, struct lyd_node **data)
 {
     struct lyd_node *root = NULL, *cont, *list;
     const struct lys_module *mod;
-    sr_conn_ctx_t *conn;
-    struct ly_ctx *ly_ctx;
     const char **cpblts;
-    char *time_str, buf[11];
     uint32_t i;
 
-    conn = sr_session_get_connection(session);
-    ly_ctx = (struct ly_ctx *)sr_get_context(conn);
-
     if (lyd_new_path(NULL, ly_ctx, "/ietf-netconf-monitoring:netconf-state", NULL, 0, &root)) {
         goto error;
     }
@@ -300,12 +362,6 @@ np2srv_ncm_oper_cb(sr_session_ctx_t *session, uint32_t UNUSED(sub_id), const cha
     }
     free(cpblts);
 
-    /* datastore locks */
-    lyd_new_inner(root, NULL, "datastores", 0, &cont);
-    ncm_data_add_ds_lock(conn, "running", SR_DS_RUNNING, cont);
-    ncm_data_add_ds_lock(conn, "startup", SR_DS_STARTUP, cont);
-    ncm_data_add_ds_lock(conn, "candidate", SR_DS_CANDIDATE, cont);
-
     /* schemas */
     lyd_new_inner(root, NULL, "schemas", 0, &cont);
 
@@ -320,76 +376,221 @@ np2srv_ncm_oper_cb(sr_session_ctx_t *session, uint32_t UNUSED(sub_id), const cha
         lyd_new_term(list, NULL, "location", "NETCONF", 0, NULL);
     }
 
+    if (lyd_validate_all(&root, NULL, LYD_VALIDATE_PRESENT, NULL)) {
+        goto error;
+    }
+
+    *data = root;
+    return 0;
+
+error:
+    lyd_free_tree(root);
+    return -1;
+}
+
+/**
+ * @brief Append a copy of a cached netconf-state container, recreate the cache if the context changed.
+ *
+ * @param[in] ly_ctx libyang context.
+ * @param[in] name Name of the cached container to append.
+ * @param[in] root netconf-state container to append to.
+ * @return 0 on success, -1 on error.
+ */
+static int
+ncm_static_data_append(struct ly_ctx *ly_ctx, const char *name, struct lyd_node *root)
+{
+    struct lyd_node *node;
+    int rc = 0;
+
+    /* STATIC LOCK */
+    pthread_mutex_lock(&stats.static_lock);
+
+    if (!stats.static_data || (stats.static_ctx_change != ly_ctx_get_change_count(ly_ctx))) {
+        /* context changed, modules and capabilities may have as well */
+        lyd_free_siblings(stats.static_data);
+        stats.static_data = NULL;
+        if (ncm_static_data_create(ly_ctx, &stats.static_data)) {
+            rc = -1;
+            goto cleanup;
+        }
+        stats.static_ctx_change = ly_ctx_get_change_count(ly_ctx);
+    }
+
+    LY_LIST_FOR(lyd_child(stats.static_data), node) {
+        if (!strcmp(LYD_NAME(node), name)) {
+            if (lyd_dup_single(node, (struct lyd_node_inner *)root, LYD_DUP_RECURSIVE, NULL)) {
+                rc = -1;
+            }
+            break;
+        }
+    }
+
+cleanup:
+    /* STATIC UNLOCK */
+    pthread_mutex_unlock(&stats.static_lock);
+    return rc;
+}
+
+/**
+ * @brief Learn which netconf-state container is requested.
+ *
+ * Only a single path expression without predicates is narrowed. A union (of several subtree filters) may select more
+ * containers and a predicate may refer to any other container so it must be evaluated on the whole data.
+ *
+ * @param[in] request_xpath Request XPath.
+ * @param[out] len Length of the returned container name.
+ * @return Name of the requested container, not terminated;
+ * @return NULL if the whole netconf-state may be requested.
+ */
+static const char *
+ncm_requested_container(const char *request_xpath, int *len)
+{
+    const char *prefix = "/ietf-netconf-monitoring:netconf-state/", *name;
+
+    if (!request_xpath || strncmp(request_xpath, prefix, strlen(prefix)) || strpbrk(request_xpath, "|[")) {
+        return NULL;
+    }
+    name = request_xpath + strlen(prefix);
+    if (!strncmp(name, "ietf-netconf-monitoring:", 24)) {
+        name += 24;
+    }
+
+    *len = 0;
+    while (isalpha(name[*len]) || (name[*len] == '-')) {
+        ++(*len);
+    }
+    if (!*len || (name[*len] && (name[*len] != '/'))) {
+        /* not a simple node name */
+        return NULL;
+    }
+
+    return name;
+}
+
+int
+np2srv_ncm_oper_cb(sr_session_ctx_t *session, uint32_t UNUSED(sub_id), const char *UNUSED(module_name),
+        const char *UNUSED(path), const char *request_xpath, uint32_t UNUSED(request_id),
+        struct lyd_node **parent, void *UNUSED(private_data))
+{
+    struct lyd_node *root = NULL, *cont, *list;
+    struct ncm_session *msess;
+    struct ncm_session_stats *sess_stats;
+    sr_conn_ctx_t *conn;
+    struct ly_ctx *ly_ctx;
+    const char *req;
+    char *time_str, buf[11];
+    uint32_t i;
+    int req_len;
+
+#define NCM_REQUESTED(name) (!req || ((req_len == (int)strlen(name)) && !strncmp(req, name, req_len)))
+
+    conn = sr_session_get_connection(session);
+    ly_ctx = (struct ly_ctx *)sr_get_context(conn);
+
+    /* build only the requested subtree, if possible */
+    req = ncm_requested_container(request_xpath, &req_len);
+
+    if (lyd_new_path(NULL, ly_ctx, "/ietf-netconf-monitoring:netconf-state", NULL, 0, &root)) {
+        goto error;
+    }
+
+    /* datastore locks */
+    if (NCM_REQUESTED("datastores")) {
+        lyd_new_inner(root, NULL, "datastores", 0, &cont);
+        ncm_data_add_ds_lock(conn, "running", SR_DS_RUNNING, cont);
+        ncm_data_add_ds_lock(conn, "startup", SR_DS_STARTUP, cont);
+        ncm_data_add_ds_lock(conn, "candidate", SR_DS_CANDIDATE, cont);
+    }
+
     /* sessions */
-    pthread_mutex_lock(&stats.lock);
+    if (NCM_REQUESTED("sessions")) {
+        /* READ LOCK */
+        pthread_rwlock_rdlock(&stats.lock);
 
-    if (stats.session_count) {
-        lyd_new_inner(root, NULL, "sessions", 0, &cont);
+        if (stats.session_count) {
+            lyd_new_inner(root, NULL, "sessions", 0, &cont);
 
-        for (i = 0; i < stats.session_count; ++i) {
-            sprintf(buf, "%u", nc_session_get_id(stats.sessions[i]));
-            lyd_new_list(cont, NULL, "session", 0, &list, buf);
+            for (i = 0; i < stats.session_size; ++i) {
+                for (msess = stats.sessions[i]; msess; msess = msess->next) {
+                    sprintf(buf, "%u", nc_session_get_id(msess->session));
+                    lyd_new_list(cont, NULL, "session", 0, &list, buf);
 
-            switch (nc_session_get_ti(stats.sessions[i])) {
+                    switch (nc_session_get_ti(msess->session)) {
 #ifdef NC_ENABLED_SSH
-            case NC_TI_LIBSSH:
-                lyd_new_term(list, NULL, "transport", "netconf-ssh", 0, NULL);
-                break;
+                    case NC_TI_LIBSSH:
+                        lyd_new_term(list, NULL, "transport", "netconf-ssh", 0, NULL);
+                        break;
 #endif
 #ifdef NC_ENABLED_TLS
-            case NC_TI_OPENSSL:
-                lyd_new_term(list, NULL, "transport", "netconf-tls", 0, NULL);
-                break;
+                    case NC_TI_OPENSSL:
+                        lyd_new_term(list, NULL, "transport", "netconf-tls", 0, NULL);
+                        break;
 #endif
-            default: /* NC_TI_FD, NC_TI_NONE */
-                ERR("ietf-netconf-monitoring unsupported session transport type.");
-                pthread_mutex_unlock(&stats.lock);
-                goto error;
+                    default: /* NC_TI_FD, NC_TI_NONE */
+                        ERR("ietf-netconf-monitoring unsupported session transport type.");
+                        pthread_rwlock_unlock(&stats.lock);
+                        goto error;
+                    }
+                    lyd_new_term(list, NULL, "username", nc_session_get_username(msess->session), 0, NULL);
+                    lyd_new_term(list, NULL, "source-host", nc_session_get_host(msess->session), 0, NULL);
+                    ly_time_time2str(nc_session_get_start_time(msess->session), NULL, &time_str);
+                    lyd_new_term(list, NULL, "login-time", time_str, 0, NULL);
+                    free(time_str);
+
+                    sess_stats = &msess->user_sess->stats;
+                    sprintf(buf, "%" PRIu32, (uint32_t)ATOMIC_LOAD_RELAXED(sess_stats->in_rpcs));
+                    lyd_new_term(list, NULL, "in-rpcs", buf, 0, NULL);
+                    sprintf(buf, "%" PRIu32, (uint32_t)ATOMIC_LOAD_RELAXED(sess_stats->in_bad_rpcs));
+                    lyd_new_term(list, NULL, "in-bad-rpcs", buf, 0, NULL);
+                    sprintf(buf, "%" PRIu32, (uint32_t)ATOMIC_LOAD_RELAXED(sess_stats->out_rpc_errors));
+                    lyd_new_term(list, NULL, "out-rpc-errors", buf, 0, NULL);
+                    sprintf(buf, "%" PRIu32, (uint32_t)ATOMIC_LOAD_RELAXED(sess_stats->out_notifications));
+                    lyd_new_term(list, NULL, "out-notifications", buf, 0, NULL);
+                }
             }
-            lyd_new_term(list, NULL, "username", nc_session_get_username(stats.sessions[i]), 0, NULL);
-            lyd_new_term(list, NULL, "source-host", nc_session_get_host(stats.sessions[i]), 0, NULL);
-            ly_time_time2str(nc_session_get_start_time(stats.sessions[i]), NULL, &time_str);
-            lyd_new_term(list, NULL, "login-time", time_str, 0, NULL);
-            free(time_str);
-
-            sprintf(buf, "%u", stats.session_stats[i].in_rpcs);
-            lyd_new_term(list, NULL, "in-rpcs", buf, 0, NULL);
-            sprintf(buf, "%u", stats.session_stats[i].in_bad_rpcs);
-            lyd_new_term(list, NULL, "in-bad-rpcs", buf, 0, NULL);
-            sprintf(buf, "%u", stats.session_stats[i].out_rpc_errors);
-            lyd_new_term(list, NULL, "out-rpc-errors", buf, 0, NULL);
-            sprintf(buf, "%u", stats.session_stats[i].out_notifications);
-            lyd_new_term(list, NULL, "out-notifications", buf, 0, NULL);
         }
+
+        /* UNLOCK */
+        pthread_rwlock_unlock(&stats.lock);
     }
 
     /* statistics */
-    lyd_new_inner(root, NULL, "statistics", 0, &cont);
-
-    ly_time_time2str(stats.netconf_start_time, NULL, &time_str);
-    lyd_new_term(cont, NULL, "netconf-start-time", time_str, 0, NULL);
-    free(time_str);
-    sprintf(buf, "%u", stats.in_bad_hellos);
-    lyd_new_term(cont, NULL, "in-bad-hellos", buf, 0, NULL);
-    sprintf(buf, "%u", stats.in_sessions);
-    lyd_new_term(cont, NULL, "in-sessions", buf, 0, NULL);
-    sprintf(buf, "%u", stats.dropped_sessions);
-    lyd_new_term(cont, NULL, "dropped-sessions", buf, 0, NULL);
-    sprintf(buf, "%u", stats.global_stats.in_rpcs);
-    lyd_new_term(cont, NULL, "in-rpcs", buf, 0, NULL);
-    sprintf(buf, "%u", stats.global_stats.in_bad_rpcs);
-    lyd_new_term(cont, NULL, "in-bad-rpcs", buf, 0, NULL);
-    sprintf(buf, "%u", stats.global_stats.out_rpc_errors);
-    lyd_new_term(cont, NULL, "out-rpc-errors", buf, 0, NULL);
-    sprintf(buf, "%u", stats.global_stats.out_notifications);
-    lyd_new_term(cont, NULL, "out-notifications", buf, 0, NULL);
-
-    pthread_mutex_unlock(&stats.lock);
+    if (NCM_REQUESTED("statistics")) {
+        lyd_new_inner(root, NULL, "statistics", 0, &cont);
+
+        ly_time_time2str(stats.netconf_start_time, NULL, &time_str);
+        lyd_new_term(cont, NULL, "netconf-start-time", time_str, 0, NULL);
+        free(time_str);
+        sprintf(buf, "%" PRIu32, (uint32_t)ATOMIC_LOAD_RELAXED(stats.in_bad_hellos));
+        lyd_new_term(cont, NULL, "in-bad-hellos", buf, 0, NULL);
+        sprintf(buf, "%" PRIu32, (uint32_t)ATOMIC_LOAD_RELAXED(stats.in_sessions));
+        lyd_new_term(cont, NULL, "in-sessions", buf, 0, NULL);
+        sprintf(buf, "%" PRIu32, (uint32_t)ATOMIC_LOAD_RELAXED(stats.dropped_sessions));
+        lyd_new_term(cont, NULL, "dropped-sessions", buf, 0, NULL);
+        sprintf(buf, "%" PRIu32, (uint32_t)ATOMIC_LOAD_RELAXED(stats.global_stats.in_rpcs));
+        lyd_new_term(cont, NULL, "in-rpcs", buf, 0, NULL);
+        sprintf(buf, "%" PRIu32, (uint32_t)ATOMIC_LOAD_RELAXED(stats.global_stats.in_bad_rpcs));
+        lyd_new_term(cont, NULL, "in-bad-rpcs", buf, 0, NULL);
+        sprintf(buf, "%" PRIu32, (uint32_t)ATOMIC_LOAD_RELAXED(stats.global_stats.out_rpc_errors));
+        lyd_new_term(cont, NULL, "out-rpc-errors", buf, 0, NULL);
+        sprintf(buf, "%" PRIu32, (uint32_t)ATOMIC_LOAD_RELAXED(stats.global_stats.out_notifications));
+        lyd_new_term(cont, NULL, "out-notifications", buf, 0, NULL);
+    }
 
     if (lyd_validate_all(&root, NULL, LYD_VALIDATE_PRESENT, NULL)) {
         goto error;
     }
 
+    /* capabilities and schemas, cached and already valid */
+    if (NCM_REQUESTED("capabilities") && ncm_static_data_append(ly_ctx, "capabilities", root)) {
+        goto error;
+    }
+    if (NCM_REQUESTED("schemas") && ncm_static_data_append(ly_ctx, "schemas", root)) {
+        goto error;
+    }
+
+#undef NCM_REQUESTED
+
     *parent = root;
     return SR_ERR_OK;
 
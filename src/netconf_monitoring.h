@@ -18,29 +18,44 @@
 #define NP2SRV_NETCONF_MONITORING_H_
 
 #include <pthread.h>
+#include <time.h>
 
 #include <nc_server.h>
 #include <sysrepo.h>
 
+#include "compat.h"
+
+struct np2_user_sess;
+
 struct ncm_session_stats {
-    uint32_t in_rpcs;
-    uint32_t in_bad_rpcs;
-    uint32_t out_rpc_errors;
-    uint32_t out_notifications;
+    ATOMIC_T in_rpcs;
+    ATOMIC_T in_bad_rpcs;
+    ATOMIC_T out_rpc_errors;
+    ATOMIC_T out_notifications;
 };
 
 struct ncm {
-    struct nc_session **sessions;
-    struct ncm_session_stats *session_stats;
+    /* monitored sessions hash table by NC ID */
+    struct ncm_session {
+        struct nc_session *session;
+        struct np2_user_sess *user_sess;    /**< referenced user session with the session counters */
+        struct ncm_session *next;
+    } **sessions;
+    uint32_t session_size;
     uint32_t session_count;
 
     time_t netconf_start_time;
-    uint32_t in_bad_hellos;
-    uint32_t in_sessions;
-    uint32_t dropped_sessions;
+    ATOMIC_T in_bad_hellos;
+    ATOMIC_T in_sessions;
+    ATOMIC_T dropped_sessions;
     struct ncm_session_stats global_stats;
 
-    pthread_mutex_t lock;
+    pthread_rwlock_t lock;  /**< lock for the monitored sessions, counters are atomic */
+
+    /* cached data that change only with the context */
+    struct lyd_node *static_data;   /**< netconf-state with capabilities and schemas */
+    uint16_t static_ctx_change;     /**< context change count the cached data were created for */
+    pthread_mutex_t static_lock;    /**< lock for the cached data */
 };
 
 void ncm_init(void);
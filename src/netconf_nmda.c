@@ -133,7 +133,7 @@ np2srv_rpc_getdata_cb(sr_session_ctx_t *session, uint32_t UNUSED(sub_id), const
         ds = SR_DS_OPERATIONAL;
     } else {
         rc = SR_ERR_INVAL_ARG;
-        sr_session_set_error_message(session, "Datastore \"%s\" is not supported.", lyd_get_value(&leaf->node));
+        np_set_error_message(session, "Datastore \"%s\" is not supported.", lyd_get_value(&leaf->node));
         goto cleanup;
     }
 
@@ -218,6 +218,10 @@ np2srv_rpc_getdata_cb(sr_session_ctx_t *session, uint32_t UNUSED(sub_id), const
         goto cleanup;
     }
 
+    /* free the unused data right away, the reply may be large */
+    lyd_free_siblings(select_data);
+    select_data = NULL;
+
     /* origin filter */
     lyd_find_xpath(input, "origin-filter | negated-origin-filter", &nodeset);
     for (i = 0; i < nodeset->count; ++i) {
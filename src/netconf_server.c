@@ -19,8 +19,10 @@
 #include "netconf_server.h"
 
 #include <assert.h>
+#include <pthread.h>
 #include <stdbool.h>
 #include <stdint.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include <libyang/libyang.h>
@@ -31,43 +33,489 @@
 #include "compat.h"
 #include "log.h"
 
-int
-np2srv_sr_get_privkey(const struct lyd_node *asym_key, char **privkey_data, NC_SSH_KEY_TYPE *privkey_type)
+/**
+ * @brief Cache of keystore and truststore data used by the SSH and TLS callbacks, reloaded on every change.
+ */
+static struct {
+    struct np2srv_ks_key {
+        char *name;                 /**< asymmetric key name */
+        char *alg;                  /**< private key algorithm */
+        char *privkey_data;         /**< private key data, NULL if there is none */
+        NC_SSH_KEY_TYPE privkey_type;   /**< private key type, NC_SSH_KEY_UNKNOWN if the algorithm is not supported */
+        struct np2srv_ks_cert {
+            char *name;             /**< certificate name */
+            char *data;             /**< certificate data */
+        } *certs;                   /**< certificates of the key */
+        uint32_t cert_count;        /**< number of certificates */
+    } *keys;                        /**< keystore asymmetric keys */
+    uint32_t key_count;             /**< number of keys */
+
+    struct np2srv_ts_bag {
+        char *name;                 /**< certificate bag name */
+        char **certs;               /**< data of all the certificates in the bag */
+        uint32_t cert_count;        /**< number of certificates */
+    } *bags;                        /**< truststore certificate bags */
+    uint32_t bag_count;             /**< number of bags */
+
+    pthread_rwlock_t lock;          /**< lock for accessing the cache */
+} ks_cache = {.lock = PTHREAD_RWLOCK_INITIALIZER};
+
+/**
+ * @brief Erase a cached keystore key.
+ *
+ * @param[in] key Key to erase.
+ */
+static void
+ks_cache_key_erase(struct np2srv_ks_key *key)
+{
+    uint32_t i;
+
+    for (i = 0; i < key->cert_count; ++i) {
+        free(key->certs[i].name);
+        free(key->certs[i].data);
+    }
+    free(key->certs);
+    free(key->name);
+    free(key->alg);
+    free(key->privkey_data);
+    memset(key, 0, sizeof *key);
+}
+
+/**
+ * @brief Erase a cached truststore certificate bag.
+ *
+ * @param[in] bag Bag to erase.
+ */
+static void
+ks_cache_bag_erase(struct np2srv_ts_bag *bag)
+{
+    uint32_t i;
+
+    for (i = 0; i < bag->cert_count; ++i) {
+        free(bag->certs[i]);
+    }
+    free(bag->certs);
+    free(bag->name);
+    memset(bag, 0, sizeof *bag);
+}
+
+/**
+ * @brief Free cached keystore keys.
+ *
+ * @param[in] keys Keys to free.
+ * @param[in] key_count Number of @p keys.
+ */
+static void
+ks_cache_keys_free(struct np2srv_ks_key *keys, uint32_t key_count)
+{
+    uint32_t i;
+
+    for (i = 0; i < key_count; ++i) {
+        ks_cache_key_erase(&keys[i]);
+    }
+    free(keys);
+}
+
+/**
+ * @brief Free cached truststore certificate bags.
+ *
+ * @param[in] bags Bags to free.
+ * @param[in] bag_count Number of @p bags.
+ */
+static void
+ks_cache_bags_free(struct np2srv_ts_bag *bags, uint32_t bag_count)
+{
+    uint32_t i;
+
+    for (i = 0; i < bag_count; ++i) {
+        ks_cache_bag_erase(&bags[i]);
+    }
+    free(bags);
+}
+
+/**
+ * @brief Load an asymmetric key into the cache.
+ *
+ * @param[in] asym_key Keystore asymmetric key.
+ * @param[out] key Key to fill.
+ * @return 0 on success;
+ * @return -1 on error.
+ */
+static int
+ks_cache_key_load(const struct lyd_node *asym_key, struct np2srv_ks_key *key)
 {
     struct lyd_node_term *alg = NULL;
-    struct lyd_node *node, *privkey = NULL;
+    struct lyd_node *node, *privkey = NULL, *certs = NULL, *cert;
+    void *mem;
+
+    memset(key, 0, sizeof *key);
 
     /* find the nodes */
     LY_LIST_FOR(lyd_child(asym_key), node) {
-        if (!strcmp(node->schema->name, "algorithm")) {
+        if (!strcmp(node->schema->name, "name")) {
+            key->name = strdup(lyd_get_value(node));
+            if (!key->name) {
+                goto emem;
+            }
+        } else if (!strcmp(node->schema->name, "algorithm")) {
             alg = (struct lyd_node_term *)node;
         } else if (!strcmp(node->schema->name, "private-key")) {
             privkey = node;
+        } else if (!strcmp(node->schema->name, "certificates")) {
+            certs = node;
         }
     }
-    if (!alg || !privkey) {
-        ERR("Failed to find asymmetric key information.");
-        return -1;
+
+    if (alg && privkey) {
+        /* algorithm */
+        if (!strncmp(alg->value.ident->name, "rsa", 3)) {
+            key->privkey_type = NC_SSH_KEY_RSA;
+        } else if (!strncmp(alg->value.ident->name, "secp", 4)) {
+            key->privkey_type = NC_SSH_KEY_ECDSA;
+        } else {
+            key->privkey_type = NC_SSH_KEY_UNKNOWN;
+        }
+        key->alg = strdup(lyd_get_value(&alg->node));
+        if (!key->alg) {
+            goto emem;
+        }
+
+        /* data */
+        key->privkey_data = strdup(lyd_get_value(privkey));
+        if (!key->privkey_data) {
+            goto emem;
+        }
     }
 
-    /* set algorithm */
-    if (!strncmp(alg->value.ident->name, "rsa", 3)) {
-        *privkey_type = NC_SSH_KEY_RSA;
-    } else if (!strncmp(alg->value.ident->name, "secp", 4)) {
-        *privkey_type = NC_SSH_KEY_ECDSA;
-    } else {
-        ERR("Unknown private key algorithm \"%s\".", lyd_get_value(&alg->node));
-        return -1;
+    /* certificates */
+    LY_LIST_FOR(lyd_child(certs), cert) {
+        if (lyd_find_path(cert, "cert", 0, &node)) {
+            /* no cert data */
+            continue;
+        }
+
+        mem = realloc(key->certs, (key->cert_count + 1) * sizeof *key->certs);
+        if (!mem) {
+            goto emem;
+        }
+        key->certs = mem;
+        memset(&key->certs[key->cert_count], 0, sizeof *key->certs);
+        ++key->cert_count;
+
+        key->certs[key->cert_count - 1].name = strdup(lyd_get_value(lyd_child(cert)));
+        key->certs[key->cert_count - 1].data = strdup(lyd_get_value(node));
+        if (!key->certs[key->cert_count - 1].name || !key->certs[key->cert_count - 1].data) {
+            goto emem;
+        }
+    }
+
+    return 0;
+
+emem:
+    EMEM;
+    ks_cache_key_erase(key);
+    return -1;
+}
+
+/**
+ * @brief Load a certificate bag into the cache.
+ *
+ * @param[in] certificates Truststore certificate bag.
+ * @param[out] bag Bag to fill.
+ * @return 0 on success;
+ * @return -1 on error.
+ */
+static int
+ks_cache_bag_load(const struct lyd_node *certificates, struct np2srv_ts_bag *bag)
+{
+    struct lyd_node *node, *cert;
+    void *mem;
+
+    memset(bag, 0, sizeof *bag);
+
+    LY_LIST_FOR(lyd_child(certificates), node) {
+        if (!strcmp(node->schema->name, "name")) {
+            bag->name = strdup(lyd_get_value(node));
+            if (!bag->name) {
+                goto emem;
+            }
+        } else if (!strcmp(node->schema->name, "certificate") && !lyd_find_path(node, "cert", 0, &cert)) {
+            mem = realloc(bag->certs, (bag->cert_count + 1) * sizeof *bag->certs);
+            if (!mem) {
+                goto emem;
+            }
+            bag->certs = mem;
+
+            bag->certs[bag->cert_count] = strdup(lyd_get_value(cert));
+            if (!bag->certs[bag->cert_count]) {
+                goto emem;
+            }
+            ++bag->cert_count;
+        }
+    }
+
+    return 0;
+
+emem:
+    EMEM;
+    ks_cache_bag_erase(bag);
+    return -1;
+}
+
+/* /ietf-keystore:keystore/asymmetric-keys */
+int
+np2srv_keystore_cb(sr_session_ctx_t *session, uint32_t UNUSED(sub_id), const char *UNUSED(module_name),
+        const char *xpath, sr_event_t UNUSED(event), uint32_t UNUSED(request_id), void *UNUSED(private_data))
+{
+    struct lyd_node *data = NULL, *node;
+    struct np2srv_ks_key *keys = NULL;
+    uint32_t key_count = 0, count;
+    void *mem;
+    int rc;
+
+    /* load all the keys without holding the lock */
+    if ((rc = sr_get_data(session, xpath, 0, 0, 0, &data))) {
+        ERR("Getting keystore data failed (%s).", sr_strerror(rc));
+        return rc;
+    }
+    LY_LIST_FOR(data ? lyd_child(lyd_child(data)) : NULL, node) {
+        mem = realloc(keys, (key_count + 1) * sizeof *keys);
+        if (!mem) {
+            EMEM;
+            rc = SR_ERR_NO_MEMORY;
+            goto cleanup;
+        }
+        keys = mem;
+
+        if (ks_cache_key_load(node, &keys[key_count])) {
+            rc = SR_ERR_NO_MEMORY;
+            goto cleanup;
+        }
+        ++key_count;
+    }
+
+    /* KS CACHE WRITE LOCK */
+    pthread_rwlock_wrlock(&ks_cache.lock);
+
+    /* swap the keys, the previous ones are freed */
+    mem = ks_cache.keys;
+    ks_cache.keys = keys;
+    keys = mem;
+    count = ks_cache.key_count;
+    ks_cache.key_count = key_count;
+    key_count = count;
+
+    /* KS CACHE UNLOCK */
+    pthread_rwlock_unlock(&ks_cache.lock);
+
+cleanup:
+    ks_cache_keys_free(keys, key_count);
+    lyd_free_siblings(data);
+    return rc;
+}
+
+/* /ietf-truststore:truststore/certificates */
+int
+np2srv_truststore_cb(sr_session_ctx_t *session, uint32_t UNUSED(sub_id), const char *UNUSED(module_name),
+        const char *xpath, sr_event_t UNUSED(event), uint32_t UNUSED(request_id), void *UNUSED(private_data))
+{
+    struct lyd_node *data = NULL, *node;
+    struct np2srv_ts_bag *bags = NULL;
+    uint32_t bag_count = 0, count;
+    void *mem;
+    int rc;
+
+    /* load all the certificate bags without holding the lock */
+    if ((rc = sr_get_data(session, xpath, 0, 0, 0, &data))) {
+        ERR("Getting truststore data failed (%s).", sr_strerror(rc));
+        return rc;
     }
+    LY_LIST_FOR(data ? lyd_child(data) : NULL, node) {
+        if (strcmp(node->schema->name, "certificates")) {
+            continue;
+        }
 
-    /* set data */
-    *privkey_data = strdup(lyd_get_value(privkey));
+        mem = realloc(bags, (bag_count + 1) * sizeof *bags);
+        if (!mem) {
+            EMEM;
+            rc = SR_ERR_NO_MEMORY;
+            goto cleanup;
+        }
+        bags = mem;
+
+        if (ks_cache_bag_load(node, &bags[bag_count])) {
+            rc = SR_ERR_NO_MEMORY;
+            goto cleanup;
+        }
+        ++bag_count;
+    }
+
+    /* KS CACHE WRITE LOCK */
+    pthread_rwlock_wrlock(&ks_cache.lock);
+
+    /* swap the bags, the previous ones are freed */
+    mem = ks_cache.bags;
+    ks_cache.bags = bags;
+    bags = mem;
+    count = ks_cache.bag_count;
+    ks_cache.bag_count = bag_count;
+    bag_count = count;
+
+    /* KS CACHE UNLOCK */
+    pthread_rwlock_unlock(&ks_cache.lock);
+
+cleanup:
+    ks_cache_bags_free(bags, bag_count);
+    lyd_free_siblings(data);
+    return rc;
+}
+
+int
+np2srv_ks_get_privkey(const char *key_name, const char *cert_name, char **privkey_data,
+        NC_SSH_KEY_TYPE *privkey_type, char **cert_data)
+{
+    struct np2srv_ks_key *key = NULL;
+    const char *cert = NULL;
+    uint32_t i, j;
+    int rc = 0;
+
+    assert((key_name && !cert_name) || (!key_name && cert_name && cert_data));
+
+    /* KS CACHE READ LOCK */
+    pthread_rwlock_rdlock(&ks_cache.lock);
+
+    /* find the key */
+    for (i = 0; !key && (i < ks_cache.key_count); ++i) {
+        if (key_name) {
+            if (!strcmp(ks_cache.keys[i].name, key_name)) {
+                key = &ks_cache.keys[i];
+            }
+            continue;
+        }
+
+        for (j = 0; j < ks_cache.keys[i].cert_count; ++j) {
+            if (!strcmp(ks_cache.keys[i].certs[j].name, cert_name)) {
+                key = &ks_cache.keys[i];
+                cert = key->certs[j].data;
+                break;
+            }
+        }
+    }
+    if (!key) {
+        rc = 1;
+        goto cleanup;
+    }
+
+    /* check the private key */
+    if (!key->privkey_data) {
+        ERR("Failed to find asymmetric key information.");
+        rc = -1;
+        goto cleanup;
+    } else if (key->privkey_type == NC_SSH_KEY_UNKNOWN) {
+        ERR("Unknown private key algorithm \"%s\".", key->alg);
+        rc = -1;
+        goto cleanup;
+    }
+
+    /* copy the data */
+    *privkey_type = key->privkey_type;
+    *privkey_data = strdup(key->privkey_data);
     if (!*privkey_data) {
         EMEM;
-        return -1;
+        rc = -1;
+        goto cleanup;
+    }
+    if (cert) {
+        *cert_data = strdup(cert);
+        if (!*cert_data) {
+            EMEM;
+            free(*privkey_data);
+            *privkey_data = NULL;
+            rc = -1;
+            goto cleanup;
+        }
     }
 
-    return 0;
+cleanup:
+    /* KS CACHE UNLOCK */
+    pthread_rwlock_unlock(&ks_cache.lock);
+    return rc;
+}
+
+int
+np2srv_ts_get_certs(const char *name, char ***cert_data, int *cert_data_count)
+{
+    struct np2srv_ts_bag *bag = NULL;
+    uint32_t i;
+    int rc = 0;
+
+    *cert_data = NULL;
+    *cert_data_count = 0;
+
+    /* KS CACHE READ LOCK */
+    pthread_rwlock_rdlock(&ks_cache.lock);
+
+    /* find the bag */
+    for (i = 0; i < ks_cache.bag_count; ++i) {
+        if (!strcmp(ks_cache.bags[i].name, name)) {
+            bag = &ks_cache.bags[i];
+            break;
+        }
+    }
+    if (!bag) {
+        rc = 1;
+        goto cleanup;
+    } else if (!bag->cert_count) {
+        goto cleanup;
+    }
+
+    /* copy all the cert data */
+    *cert_data = malloc(bag->cert_count * sizeof **cert_data);
+    if (!*cert_data) {
+        EMEM;
+        rc = -1;
+        goto cleanup;
+    }
+    for (i = 0; i < bag->cert_count; ++i) {
+        (*cert_data)[i] = strdup(bag->certs[i]);
+        if (!(*cert_data)[i]) {
+            EMEM;
+            rc = -1;
+            goto cleanup;
+        }
+        ++(*cert_data_count);
+    }
+
+cleanup:
+    /* KS CACHE UNLOCK */
+    pthread_rwlock_unlock(&ks_cache.lock);
+
+    if (rc == -1) {
+        for (i = 0; i < (uint32_t)*cert_data_count; ++i) {
+            free((*cert_data)[i]);
+        }
+        free(*cert_data);
+        *cert_data = NULL;
+        *cert_data_count = 0;
+    }
+    return rc;
+}
+
+void
+np2srv_ks_cache_clear(void)
+{
+    /* KS CACHE WRITE LOCK */
+    pthread_rwlock_wrlock(&ks_cache.lock);
+
+    ks_cache_keys_free(ks_cache.keys, ks_cache.key_count);
+    ks_cache.keys = NULL;
+    ks_cache.key_count = 0;
+    ks_cache_bags_free(ks_cache.bags, ks_cache.bag_count);
+    ks_cache.bags = NULL;
+    ks_cache.bag_count = 0;
+
+    /* KS CACHE UNLOCK */
+    pthread_rwlock_unlock(&ks_cache.lock);
 }
 
 /* /ietf-netconf-server:netconf-server/listen/idle-timeout */
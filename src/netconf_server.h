@@ -20,7 +20,43 @@
 #include <nc_server.h>
 #include <sysrepo.h>
 
-int np2srv_sr_get_privkey(const struct lyd_node *asym_key, char **privkey_data, NC_SSH_KEY_TYPE *privkey_type);
+/**
+ * @brief Get a private key from the keystore cache.
+ *
+ * @param[in] key_name Name of the asymmetric key, if set @p cert_name must be NULL.
+ * @param[in] cert_name Name of a certificate of the asymmetric key, if set @p key_name must be NULL.
+ * @param[out] privkey_data Private key data.
+ * @param[out] privkey_type Private key type.
+ * @param[out] cert_data Certificate data of @p cert_name.
+ * @return 0 on success;
+ * @return 1 if the key was not found;
+ * @return -1 on error.
+ */
+int np2srv_ks_get_privkey(const char *key_name, const char *cert_name, char **privkey_data,
+        NC_SSH_KEY_TYPE *privkey_type, char **cert_data);
+
+/**
+ * @brief Get all the certificates of a certificate bag from the truststore cache.
+ *
+ * @param[in] name Name of the certificate bag.
+ * @param[out] cert_data Data of all the certificates.
+ * @param[out] cert_data_count Number of @p cert_data.
+ * @return 0 on success;
+ * @return 1 if the certificate bag was not found;
+ * @return -1 on error.
+ */
+int np2srv_ts_get_certs(const char *name, char ***cert_data, int *cert_data_count);
+
+/**
+ * @brief Clear the keystore and truststore cache.
+ */
+void np2srv_ks_cache_clear(void);
+
+int np2srv_keystore_cb(sr_session_ctx_t *session, uint32_t sub_id, const char *module_name, const char *xpath,
+        sr_event_t event, uint32_t request_id, void *private_data);
+
+int np2srv_truststore_cb(sr_session_ctx_t *session, uint32_t sub_id, const char *module_name, const char *xpath,
+        sr_event_t event, uint32_t request_id, void *private_data);
 
 int np2srv_idle_timeout_cb(sr_session_ctx_t *session, uint32_t sub_id, const char *module_name, const char *xpath,
         sr_event_t event, uint32_t request_id, void *private_data);
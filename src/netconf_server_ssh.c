@@ -23,10 +23,13 @@
 #include <assert.h>
 #include <ctype.h>
 #include <errno.h>
+#include <pthread.h>
 #include <pwd.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
 #include <sys/types.h>
 
 #include <libssh/libssh.h>
@@ -44,92 +47,189 @@ int
 np2srv_hostkey_cb(const char *name, void *UNUSED(user_data), char **UNUSED(privkey_path), char **privkey_data,
         NC_SSH_KEY_TYPE *privkey_type)
 {
-    sr_session_ctx_t *sr_sess;
-    char *xpath;
-    struct lyd_node *data = NULL;
-    int r, rc = -1;
+    int r;
 
-    r = sr_session_start(np2srv.sr_conn, SR_DS_RUNNING, &sr_sess);
-    if (r != SR_ERR_OK) {
-        return -1;
+    /* get hostkey data from the keystore cache */
+    r = np2srv_ks_get_privkey(name, NULL, privkey_data, privkey_type, NULL);
+    if (r == 1) {
+        ERR("Hostkey \"%s\" not found.", name);
     }
 
-    /* get hostkey data from sysrepo */
-    if (asprintf(&xpath, "/ietf-keystore:keystore/asymmetric-keys/asymmetric-key[name='%s']", name) == -1) {
-        EMEM;
-        goto cleanup;
+    return r ? -1 : 0;
+}
+
+/**
+ * @brief Cache of parsed authorized_keys files of users, an entry is valid while its file does not change.
+ */
+static struct {
+    struct np2srv_authkeys {
+        char *user;                 /**< user name */
+        char *path;                 /**< path to the authorized_keys file */
+        dev_t dev;                  /**< device of the loaded file */
+        ino_t ino;                  /**< inode of the loaded file */
+        struct timespec mtime;      /**< modification time of the loaded file */
+        off_t file_size;            /**< size of the loaded file */
+
+        struct np2srv_authkey {
+            unsigned char *hash;    /**< key fingerprint */
+            size_t hash_len;        /**< length of the fingerprint */
+            ssh_key key;            /**< imported key */
+            struct np2srv_authkey *next;    /**< next key in the bucket */
+        } *keys;                    /**< all the keys from the file */
+        struct np2srv_authkey **buckets;    /**< keys by their fingerprint */
+        uint32_t key_count;         /**< number of keys */
+        uint32_t size;              /**< number of buckets, power of 2 */
+    } *entries;                     /**< entries from the oldest */
+    uint32_t count;                 /**< number of entries */
+    pthread_mutex_t lock;           /**< lock for accessing the cache */
+} authkeys_cache = {.lock = PTHREAD_MUTEX_INITIALIZER};
+
+/**
+ * @brief Get the bucket of a key fingerprint, it is uniformly distributed so its first bytes are used.
+ *
+ * @param[in] entry Authorized keys cache entry.
+ * @param[in] hash Key fingerprint.
+ * @param[in] hash_len Length of @p hash.
+ * @return Bucket index.
+ */
+static uint32_t
+authkeys_bucket(const struct np2srv_authkeys *entry, const unsigned char *hash, size_t hash_len)
+{
+    uint32_t b = 0;
+    size_t i;
+
+    for (i = 0; (i < hash_len) && (i < sizeof b); ++i) {
+        b = (b << 8) | hash[i];
     }
-    r = sr_get_subtree(sr_sess, xpath, 0, &data);
-    free(xpath);
-    if (r != SR_ERR_OK) {
-        goto cleanup;
-    } else if (!data) {
-        ERR("Hostkey \"%s\" not found.", name);
-        goto cleanup;
+    return b & (entry->size - 1);
+}
+
+/**
+ * @brief Erase an authorized keys cache entry.
+ *
+ * @param[in] entry Entry to erase.
+ */
+static void
+authkeys_entry_erase(struct np2srv_authkeys *entry)
+{
+    uint32_t i;
+
+    for (i = 0; i < entry->key_count; ++i) {
+        ssh_clean_pubkey_hash(&entry->keys[i].hash);
+        ssh_key_free(entry->keys[i].key);
     }
+    free(entry->keys);
+    free(entry->buckets);
+    free(entry->user);
+    free(entry->path);
+    memset(entry, 0, sizeof *entry);
+}
 
-    /* parse private key values */
-    if (np2srv_sr_get_privkey(data, privkey_data, privkey_type)) {
-        goto cleanup;
+/**
+ * @brief Check whether an authorized keys cache entry was loaded from a file.
+ *
+ * @param[in] entry Entry to check.
+ * @param[in] path Path to the file.
+ * @param[in] st Current file stats.
+ * @return Whether the entry is valid.
+ */
+static int
+authkeys_entry_valid(const struct np2srv_authkeys *entry, const char *path, const struct stat *st)
+{
+    return !strcmp(entry->path, path) && (entry->dev == st->st_dev) && (entry->ino == st->st_ino) &&
+           (entry->mtime.tv_sec == st->st_mtim.tv_sec) && (entry->mtime.tv_nsec == st->st_mtim.tv_nsec) &&
+           (entry->file_size == st->st_size);
+}
+
+/**
+ * @brief Find a key in an authorized keys cache entry.
+ *
+ * @param[in] entry Entry to search.
+ * @param[in] key Key to find.
+ * @param[in] hash Fingerprint of @p key.
+ * @param[in] hash_len Length of @p hash.
+ * @return Whether the key was found.
+ */
+static int
+authkeys_entry_match(const struct np2srv_authkeys *entry, ssh_key key, const unsigned char *hash, size_t hash_len)
+{
+    const struct np2srv_authkey *item;
+
+    if (!entry->size) {
+        return 0;
     }
 
-    /* success */
-    rc = 0;
+    for (item = entry->buckets[authkeys_bucket(entry, hash, hash_len)]; item; item = item->next) {
+        if ((item->hash_len == hash_len) && !memcmp(item->hash, hash, hash_len) &&
+                !ssh_key_cmp(key, item->key, SSH_KEY_CMP_PUBLIC)) {
+            return 1;
+        }
+    }
 
-cleanup:
-    lyd_free_siblings(data);
-    sr_session_stop(sr_sess);
-    return rc;
+    return 0;
 }
 
-int
-np2srv_pubkey_auth_cb(const struct nc_session *session, ssh_key key, void *UNUSED(user_data))
+/**
+ * @brief Load an authorized_keys file of a user.
+ *
+ * @param[in] user User name.
+ * @param[in] path Path to the authorized_keys file.
+ * @param[out] entry Entry to fill.
+ * @return 0 on success;
+ * @return 1 if there is no file;
+ * @return -1 on error.
+ */
+static int
+authkeys_entry_load(const char *user, const char *path, struct np2srv_authkeys *entry)
 {
     FILE *f = NULL;
-    struct passwd *pwd;
     ssh_key pub_key = NULL;
     enum ssh_keytypes_e ktype;
-    const char *username;
+    struct np2srv_authkey *item;
+    struct stat st;
     char *line = NULL, *ptr, *ptr2;
-    size_t n;
-    int r, ret = 1, line_num = 0;
-
-    username = nc_session_get_username(session);
-
-    errno = 0;
-    pwd = getpwnam(username);
-    if (!pwd) {
-        ERR("Failed to find user entry for \"%s\" (%s).", username, errno ? strerror(errno) : "User not found");
-        goto cleanup;
-    }
-
-    /* check any authorized keys */
-    r = asprintf(&line, NP2SRV_SSH_AUTHORIZED_KEYS_PATTERN, NP2SRV_SSH_AUTHORIZED_KEYS_ARG_IS_USERNAME ? pwd->pw_name : pwd->pw_dir);
-    if (r == -1) {
+    size_t n = 0;
+    int r, rc = -1, line_num = 0;
+    uint32_t i, b;
+    void *mem;
+
+    memset(entry, 0, sizeof *entry);
+    entry->user = strdup(user);
+    entry->path = strdup(path);
+    if (!entry->user || !entry->path) {
         EMEM;
-        line = NULL;
         goto cleanup;
     }
-    n = r;
 
-    f = fopen(line, "r");
+    f = fopen(path, "r");
     if (!f) {
         if (errno == ENOENT) {
-            VRB("User \"%s\" has no authorized_keys file.", username);
+            VRB("User \"%s\" has no authorized_keys file.", user);
+            rc = 1;
         } else {
-            ERR("Failed to open \"%s\" authorized_keys file (%s).", line, strerror(errno));
+            ERR("Failed to open \"%s\" authorized_keys file (%s).", path, strerror(errno));
         }
         goto cleanup;
     }
 
+    /* identification of the file actually read */
+    if (fstat(fileno(f), &st) == -1) {
+        ERR("Failed to get stats of \"%s\" authorized_keys file (%s).", path, strerror(errno));
+        goto cleanup;
+    }
+    entry->dev = st.st_dev;
+    entry->ino = st.st_ino;
+    entry->mtime = st.st_mtim;
+    entry->file_size = st.st_size;
+
     while (getline(&line, &n, f) > -1) {
         ++line_num;
 
         /* separate key type */
         ptr = line;
-        for (ptr2 = ptr; !isspace(ptr2[0]); ++ptr2) {}
+        for (ptr2 = ptr; ptr2[0] && !isspace(ptr2[0]); ++ptr2) {}
         if (ptr2[0] == '\0') {
-            WRN("Invalid authorized key format of \"%s\" (line %d).", username, line_num);
+            WRN("Invalid authorized key format of \"%s\" (line %d).", user, line_num);
             continue;
         }
         ptr2[0] = '\0';
@@ -143,33 +243,57 @@ np2srv_pubkey_auth_cb(const struct nc_session *session, ssh_key key, void *UNUSE
 
         /* separate key data */
         ptr = ptr2 + 1;
-        for (ptr2 = ptr; !isspace(ptr2[0]); ++ptr2) {}
+        for (ptr2 = ptr; ptr2[0] && !isspace(ptr2[0]); ++ptr2) {}
         ptr2[0] = '\0';
 
         r = ssh_pki_import_pubkey_base64(ptr, ktype, &pub_key);
         if (r != SSH_OK) {
             WRN("Failed to import authorized key of \"%s\" (%s, line %d).",
-                    username, r == SSH_EOF ? "Unexpected end-of-file" : "SSH error", line_num);
+                    user, r == SSH_EOF ? "Unexpected end-of-file" : "SSH error", line_num);
             continue;
         }
 
-        /* compare public keys */
-        if (!ssh_key_cmp(key, pub_key, SSH_KEY_CMP_PUBLIC)) {
-            /* key matches */
-            ret = 0;
+        /* store the key with its fingerprint */
+        mem = realloc(entry->keys, (entry->key_count + 1) * sizeof *entry->keys);
+        if (!mem) {
+            EMEM;
             goto cleanup;
         }
-
-        /* not a match, next key */
-        ssh_key_free(pub_key);
+        entry->keys = mem;
+        item = &entry->keys[entry->key_count];
+        memset(item, 0, sizeof *item);
+        if (ssh_get_publickey_hash(pub_key, SSH_PUBLICKEY_HASH_SHA1, &item->hash, &item->hash_len)) {
+            WRN("Failed to get fingerprint of authorized key of \"%s\" (line %d).", user, line_num);
+            ssh_key_free(pub_key);
+            pub_key = NULL;
+            continue;
+        }
+        item->key = pub_key;
         pub_key = NULL;
+        ++entry->key_count;
     }
     if (!feof(f)) {
-        WRN("Failed reading from authorized_keys file of \"%s\".", username);
+        WRN("Failed reading from authorized_keys file of \"%s\".", user);
         goto cleanup;
     }
 
-    /* no match */
+    /* index the keys */
+    if (entry->key_count) {
+        for (entry->size = 1; entry->size < entry->key_count; entry->size *= 2) {}
+        entry->buckets = calloc(entry->size, sizeof *entry->buckets);
+        if (!entry->buckets) {
+            EMEM;
+            goto cleanup;
+        }
+        for (i = 0; i < entry->key_count; ++i) {
+            b = authkeys_bucket(entry, entry->keys[i].hash, entry->keys[i].hash_len);
+            entry->keys[i].next = entry->buckets[b];
+            entry->buckets[b] = &entry->keys[i];
+        }
+    }
+
+    /* success */
+    rc = 0;
 
 cleanup:
     if (f) {
@@ -177,6 +301,166 @@ cleanup:
     }
     free(line);
     ssh_key_free(pub_key);
+    if (rc) {
+        authkeys_entry_erase(entry);
+    }
+    return rc;
+}
+
+/**
+ * @brief Find an authorized keys cache entry of a user. Authorized keys cache lock is expected to be held.
+ *
+ * @param[in] user User name.
+ * @return Found entry, NULL if not cached.
+ */
+static struct np2srv_authkeys *
+authkeys_cache_find(const char *user)
+{
+    uint32_t i;
+
+    for (i = 0; i < authkeys_cache.count; ++i) {
+        if (!strcmp(authkeys_cache.entries[i].user, user)) {
+            return &authkeys_cache.entries[i];
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Store a loaded entry into the authorized keys cache, replacing any previous entry of the user.
+ * Authorized keys cache lock is expected to be held.
+ *
+ * @param[in] entry Loaded entry to store, is spent.
+ */
+static void
+authkeys_cache_store(struct np2srv_authkeys *entry)
+{
+    struct np2srv_authkeys *cur;
+    void *mem;
+
+    if ((cur = authkeys_cache_find(entry->user))) {
+        /* replace the outdated entry */
+        authkeys_entry_erase(cur);
+        *cur = *entry;
+        return;
+    }
+
+    if (authkeys_cache.count == NP2SRV_AUTHKEYS_CACHE_SIZE) {
+        /* evict the oldest entry */
+        authkeys_entry_erase(&authkeys_cache.entries[0]);
+        --authkeys_cache.count;
+        memmove(&authkeys_cache.entries[0], &authkeys_cache.entries[1],
+                authkeys_cache.count * sizeof *authkeys_cache.entries);
+    } else {
+        mem = realloc(authkeys_cache.entries, (authkeys_cache.count + 1) * sizeof *authkeys_cache.entries);
+        if (!mem) {
+            /* just do not cache it */
+            authkeys_entry_erase(entry);
+            return;
+        }
+        authkeys_cache.entries = mem;
+    }
+
+    authkeys_cache.entries[authkeys_cache.count] = *entry;
+    ++authkeys_cache.count;
+}
+
+void
+np2srv_authkeys_cache_clear(void)
+{
+    uint32_t i;
+
+    /* AUTHKEYS CACHE LOCK */
+    pthread_mutex_lock(&authkeys_cache.lock);
+
+    for (i = 0; i < authkeys_cache.count; ++i) {
+        authkeys_entry_erase(&authkeys_cache.entries[i]);
+    }
+    free(authkeys_cache.entries);
+    authkeys_cache.entries = NULL;
+    authkeys_cache.count = 0;
+
+    /* AUTHKEYS CACHE UNLOCK */
+    pthread_mutex_unlock(&authkeys_cache.lock);
+}
+
+int
+np2srv_pubkey_auth_cb(const struct nc_session *session, ssh_key key, void *UNUSED(user_data))
+{
+    struct np2srv_authkeys *cur, entry;
+    struct stat st;
+    const char *username;
+    unsigned char *hash = NULL;
+    size_t hash_len;
+    char *path = NULL, *home = NULL;
+    int r, ret = 1;
+
+    username = nc_session_get_username(session);
+
+    /* cached passwd entry */
+    r = np_user_getpw(username, NULL, NULL, &home);
+    if (r) {
+        if (r == 1) {
+            ERR("Failed to find user entry for \"%s\" (User not found).", username);
+        }
+        goto cleanup;
+    }
+
+    /* check any authorized keys */
+    if (asprintf(&path, NP2SRV_SSH_AUTHORIZED_KEYS_PATTERN, NP2SRV_SSH_AUTHORIZED_KEYS_ARG_IS_USERNAME ? username : home) == -1) {
+        EMEM;
+        path = NULL;
+        goto cleanup;
+    }
+    if (stat(path, &st) == -1) {
+        if (errno == ENOENT) {
+            VRB("User \"%s\" has no authorized_keys file.", username);
+        } else {
+            ERR("Failed to open \"%s\" authorized_keys file (%s).", path, strerror(errno));
+        }
+        goto cleanup;
+    }
+
+    /* fingerprint of the key */
+    if (ssh_get_publickey_hash(key, SSH_PUBLICKEY_HASH_SHA1, &hash, &hash_len)) {
+        ERR("Failed to get fingerprint of the public key of \"%s\".", username);
+        goto cleanup;
+    }
+
+    /* AUTHKEYS CACHE LOCK */
+    pthread_mutex_lock(&authkeys_cache.lock);
+
+    cur = authkeys_cache_find(username);
+    if (cur && authkeys_entry_valid(cur, path, &st)) {
+        ret = authkeys_entry_match(cur, key, hash, hash_len) ? 0 : 1;
+
+        /* AUTHKEYS CACHE UNLOCK */
+        pthread_mutex_unlock(&authkeys_cache.lock);
+        goto cleanup;
+    }
+
+    /* AUTHKEYS CACHE UNLOCK */
+    pthread_mutex_unlock(&authkeys_cache.lock);
+
+    /* parse the file without holding the lock, it may be large */
+    if (authkeys_entry_load(username, path, &entry)) {
+        goto cleanup;
+    }
+    ret = authkeys_entry_match(&entry, key, hash, hash_len) ? 0 : 1;
+
+    /* AUTHKEYS CACHE LOCK */
+    pthread_mutex_lock(&authkeys_cache.lock);
+
+    authkeys_cache_store(&entry);
+
+    /* AUTHKEYS CACHE UNLOCK */
+    pthread_mutex_unlock(&authkeys_cache.lock);
+
+cleanup:
+    ssh_clean_pubkey_hash(&hash);
+    free(path);
+    free(home);
     return ret;
 }
 
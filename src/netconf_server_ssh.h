@@ -25,6 +25,11 @@ int np2srv_hostkey_cb(const char *name, void *user_data, char **privkey_path, ch
 
 int np2srv_pubkey_auth_cb(const struct nc_session *session, ssh_key key, void *user_data);
 
+/**
+ * @brief Clear the cache of parsed authorized_keys files.
+ */
+void np2srv_authkeys_cache_clear(void);
+
 int np2srv_endpt_ssh_cb(sr_session_ctx_t *session, uint32_t sub_id, const char *module_name, const char *xpath,
         sr_event_t event, uint32_t request_id, void *private_data);
 
@@ -36,135 +36,32 @@ int
 np2srv_cert_cb(const char *name, void *UNUSED(user_data), char **UNUSED(cert_path), char **cert_data,
         char **UNUSED(privkey_path), char **privkey_data, NC_SSH_KEY_TYPE *privkey_type)
 {
-    sr_session_ctx_t *sr_sess;
-    char *xpath;
-    struct lyd_node *data = NULL;
-    int r, rc = -1;
+    int r;
 
-    r = sr_session_start(np2srv.sr_conn, SR_DS_RUNNING, &sr_sess);
-    if (r != SR_ERR_OK) {
-        return -1;
-    }
-
-    /* get private key data from sysrepo */
-    if (asprintf(&xpath, "/ietf-keystore:keystore/asymmetric-keys/asymmetric-key[certificates/certificate/name='%s']", name) == -1) {
-        EMEM;
-        goto cleanup;
-    }
-    r = sr_get_subtree(sr_sess, xpath, 0, &data);
-    free(xpath);
-    if (r != SR_ERR_OK) {
-        goto cleanup;
-    } else if (!data) {
-        ERR("Server certificate \"%s\" not found.", name);
-        goto cleanup;
-    }
-
-    /* parse private key values */
-    if (np2srv_sr_get_privkey(data, privkey_data, privkey_type)) {
-        goto cleanup;
-    }
-
-    /* get cert data from sysrepo */
-    if (asprintf(&xpath, "/ietf-keystore:keystore/asymmetric-keys/asymmetric-key/certificates/"
-            "certificate[name='%s']/cert", name) == -1) {
-        EMEM;
-        goto cleanup;
-    }
-    lyd_free_siblings(data);
-    r = sr_get_subtree(sr_sess, xpath, 0, &data);
-    free(xpath);
-    if (r != SR_ERR_OK) {
-        goto cleanup;
-    } else if (!data) {
+    /* get private key and cert data from the keystore cache */
+    r = np2srv_ks_get_privkey(NULL, name, privkey_data, privkey_type, cert_data);
+    if (r == 1) {
         ERR("Server certificate \"%s\" not found.", name);
-        goto cleanup;
     }
 
-    /* set cert data */
-    *cert_data = strdup(lyd_get_value(data));
-    if (!*cert_data) {
-        EMEM;
-        goto cleanup;
-    }
-
-    /* success */
-    rc = 0;
-
-cleanup:
-    lyd_free_siblings(data);
-    sr_session_stop(sr_sess);
-    return rc;
+    return r ? -1 : 0;
 }
 
 int
 np2srv_cert_list_cb(const char *name, void *UNUSED(user_data), char ***UNUSED(cert_paths), int *UNUSED(cert_path_count),
         char ***cert_data, int *cert_data_count)
 {
-    sr_session_ctx_t *sr_sess;
-    char *xpath;
-    struct lyd_node *data = NULL;
-    struct ly_set *set = NULL;
-    int r, rc = -1;
-    uint32_t i, j;
+    int r;
 
-    r = sr_session_start(np2srv.sr_conn, SR_DS_RUNNING, &sr_sess);
-    if (r != SR_ERR_OK) {
-        return -1;
-    }
-
-    /* get cert list data from sysrepo */
-    if (asprintf(&xpath, "/ietf-truststore:truststore/certificates[name='%s']", name) == -1) {
-        EMEM;
-        goto cleanup;
-    }
-    r = sr_get_subtree(sr_sess, xpath, 0, &data);
-    free(xpath);
-    if (r != SR_ERR_OK) {
-        goto cleanup;
-    } else if (!data) {
+    /* get cert list data from the truststore cache */
+    r = np2srv_ts_get_certs(name, cert_data, cert_data_count);
+    if (r == 1) {
         ERR("Certificate list \"%s\" not found.", name);
-        goto cleanup;
-    }
-
-    /* find all certificates */
-    if (lyd_find_xpath(data, "certificate/cert", &set)) {
-        /* libyang error printed */
-        goto cleanup;
-    } else if (!set->count) {
-        WRN("Certificate list \"%s\" does not define any actual certificates.");
-        rc = 0;
-        goto cleanup;
-    }
-
-    *cert_data = malloc(set->count * sizeof **cert_data);
-    if (!*cert_data) {
-        EMEM;
-        goto cleanup;
+    } else if (!r && !*cert_data_count) {
+        WRN("Certificate list \"%s\" does not define any actual certificates.", name);
     }
 
-    /* collect all cert data */
-    for (i = 0; i < set->count; ++i) {
-        (*cert_data)[i] = strdup(lyd_get_value(set->dnodes[i]));
-        if (!(*cert_data)[i]) {
-            EMEM;
-            for (j = 0; j < i - 1; ++j) {
-                free((*cert_data)[i]);
-            }
-            free(*cert_data);
-            goto cleanup;
-        }
-    }
-    *cert_data_count = set->count;
-
-    /* success */
-    rc = 0;
-
-cleanup:
-    lyd_free_siblings(data);
-    ly_set_free(set, NULL);
-    sr_session_stop(sr_sess);
-    return rc;
+    return r ? -1 : 0;
 }
 
 /* /ietf-netconf-server:netconf-server/listen/endpoint/tls */
@@ -39,132 +39,277 @@
 #include "subscribed_notifications.h"
 #include "yang_push.h"
 
-static struct np2srv_sub_ntf_info info = {
-    .lock = PTHREAD_RWLOCK_INITIALIZER
-};
+static struct np2srv_sub_ntf_info info;
 
 static ATOMIC_T new_nc_sub_id = 1;
 
-#define INFO_RLOCK if ((r = pthread_rwlock_rdlock(&info.lock))) ELOCK(r)
-#define INFO_WLOCK if ((r = pthread_rwlock_wrlock(&info.lock))) ELOCK(r)
-#define INFO_UNLOCK if ((r = pthread_rwlock_unlock(&info.lock))) EUNLOCK(r)
+#define SHARD(nc_sub_id) (&info.shards[(nc_sub_id) % NP2SRV_SUB_NTF_SHARD_COUNT])
+
+#define SHARD_RLOCK(shard) if ((r = pthread_rwlock_rdlock(&(shard)->lock))) ELOCK(r)
+#define SHARD_WLOCK(shard) if ((r = pthread_rwlock_wrlock(&(shard)->lock))) ELOCK(r)
+#define SHARD_UNLOCK(shard) if ((r = pthread_rwlock_unlock(&(shard)->lock))) EUNLOCK(r)
+
+#define SUB_RLOCK(sub) if ((r = pthread_rwlock_rdlock(&(sub)->lock))) ELOCK(r)
+#define SUB_WLOCK(sub) if ((r = pthread_rwlock_wrlock(&(sub)->lock))) ELOCK(r)
+#define SUB_UNLOCK(sub) if ((r = pthread_rwlock_unlock(&(sub)->lock))) EUNLOCK(r)
+
+/**
+ * @brief Release a reference of a subscription, free it if it was the last one.
+ *
+ * @param[in] sub Subscription to release.
+ */
+static void
+sub_ntf_unref(struct np2srv_sub_ntf *sub)
+{
+    if (ATOMIC_DEC_RELAXED(sub->refs) == 1) {
+        /* nobody can find it anymore */
+        assert(!sub->linked);
+        pthread_rwlock_destroy(&sub->lock);
+        free(sub);
+    }
+}
 
 /**
- * @brief Find an internal subscription structure.
+ * @brief Find an internal subscription structure and reference it.
  *
  * @param[in] nc_sub_id NETCONF sub ID.
  * @param[in] nc_id Optional NETCONF ID of the specific subscriber.
- * @param[in] wlock Whether to write-lock subscriptions when a subscription was found or not.
- * @param[in] rlock Whether to read-lock subscriptions when a subscription was found or not.
- * @return Found subscription.
+ * @return Found subscription, release with sub_ntf_unref().
  */
 static struct np2srv_sub_ntf *
-sub_ntf_find(uint32_t nc_sub_id, uint32_t nc_id, int wlock, int rlock)
+sub_ntf_find_ref(uint32_t nc_sub_id, uint32_t nc_id)
 {
-    uint32_t i;
+    struct np2srv_sub_ntf_shard *shard = SHARD(nc_sub_id);
+    struct np2srv_sub_ntf *sub;
     int r;
 
-    assert(!wlock || !rlock);
+    /* SHARD READ LOCK */
+    SHARD_RLOCK(shard);
 
-    if (wlock) {
-        /* WRITE LOCK */
-        INFO_WLOCK;
-    } else if (rlock) {
-        /* READ LOCK */
-        INFO_RLOCK;
+    for (sub = shard->first; sub && (sub->nc_sub_id < nc_sub_id); sub = sub->next) {}
+    if (sub && ((sub->nc_sub_id != nc_sub_id) || (nc_id && (sub->nc_id != nc_id)))) {
+        sub = NULL;
+    }
+    if (sub) {
+        ATOMIC_INC_RELAXED(sub->refs);
     }
 
-    for (i = 0; i < info.count; ++i) {
-        if (nc_id && (info.subs[i].nc_id != nc_id)) {
-            continue;
-        }
+    /* SHARD UNLOCK */
+    SHARD_UNLOCK(shard);
 
-        if (info.subs[i].nc_sub_id == nc_sub_id) {
-            return &info.subs[i];
-        }
-    }
+    return sub;
+}
 
-    if (wlock || rlock) {
-        /* UNLOCK */
-        INFO_UNLOCK;
-    }
-    return NULL;
+/**
+ * @brief Remove a subscription from the registry, releasing its reference.
+ *
+ * @param[in] sub Subscription to remove, the caller must be holding another reference.
+ */
+static void
+sub_ntf_unlink(struct np2srv_sub_ntf *sub)
+{
+    struct np2srv_sub_ntf_shard *shard = SHARD(sub->nc_sub_id);
+    struct np2srv_sub_ntf **sub_p;
+    int r;
+
+    /* SHARD WRITE LOCK */
+    SHARD_WLOCK(shard);
+
+    for (sub_p = &shard->first; *sub_p != sub; sub_p = &(*sub_p)->next) {}
+    *sub_p = sub->next;
+    sub->linked = 0;
+
+    /* SHARD UNLOCK */
+    SHARD_UNLOCK(shard);
+
+    sub_ntf_unref(sub);
 }
 
-struct np2srv_sub_ntf *
-sub_ntf_find_lock(uint32_t nc_sub_id, uint32_t sub_id, int write)
+/**
+ * @brief Find an internal subscription structure and lock it, if possible.
+ *
+ * @param[in] nc_sub_id NETCONF sub ID.
+ * @param[in] nc_id Optional NETCONF ID of the specific subscriber.
+ * @param[in] sub_id SR subscription ID in a callback, 0 if not in callback.
+ * @param[in] write Whether to write or read-lock.
+ * @return Found subscription, unlock with sub_ntf_unlock().
+ * @return NULL if subscription was not found or it is terminating.
+ */
+static struct np2srv_sub_ntf *
+sub_ntf_find_nc_lock(uint32_t nc_sub_id, uint32_t nc_id, uint32_t sub_id, int write)
 {
     struct np2srv_sub_ntf *sub;
     int r;
 
+    sub = sub_ntf_find_ref(nc_sub_id, nc_id);
+    if (!sub) {
+        /* not found */
+        return NULL;
+    }
+
     /* LOCK */
-    if (!sub_id || (ATOMIC_LOAD_RELAXED(info.sub_id_lock) != sub_id)) {
+    if (!sub_id || (ATOMIC_LOAD_RELAXED(sub->sub_id_lock) != sub_id)) {
         if (write) {
-            INFO_WLOCK;
+            SUB_WLOCK(sub);
         } else {
-            INFO_RLOCK;
+            SUB_RLOCK(sub);
         }
     }
 
-    sub = sub_ntf_find(nc_sub_id, 0, 0, 0);
-    if (!sub) {
-        /* not found */
-        goto error;
-    }
-
     if (sub->terminating) {
         /* this subscription cannot be used */
-        goto error;
+        sub_ntf_unlock(sub, sub_id);
+        return NULL;
     }
 
     return sub;
+}
 
-error:
-    /* UNLOCK */
-    if (!sub_id || (ATOMIC_LOAD_RELAXED(info.sub_id_lock) != sub_id)) {
-        INFO_UNLOCK;
-    }
-    return NULL;
+struct np2srv_sub_ntf *
+sub_ntf_find_lock(uint32_t nc_sub_id, uint32_t sub_id, int write)
+{
+    return sub_ntf_find_nc_lock(nc_sub_id, 0, sub_id, write);
 }
 
 void
-sub_ntf_unlock(uint32_t sub_id)
+sub_ntf_unlock(struct np2srv_sub_ntf *sub, uint32_t sub_id)
 {
     int r;
 
     /* UNLOCK */
-    if (!sub_id || (ATOMIC_LOAD_RELAXED(info.sub_id_lock) != sub_id)) {
-        INFO_UNLOCK;
+    if (!sub_id || (ATOMIC_LOAD_RELAXED(sub->sub_id_lock) != sub_id)) {
+        SUB_UNLOCK(sub);
     }
+
+    sub_ntf_unref(sub);
+}
+
+/**
+ * @brief Find the next matching subscription and lock it.
+ *
+ * @param[in] last Last found locked subscription, is unlocked, NULL on first call.
+ * @param[in] write Whether to write or read-lock.
+ * @param[in] sub_ntf_match_cb Optional callback for deciding a subscription match, called with the subscription locked.
+ * @param[in] match_data Data passed to @p sub_ntf_match_cb based on which a match is decided.
+ * @return Next matching locked subscription.
+ * @return NULL if no more matching subscriptions found.
+ */
+static struct np2srv_sub_ntf *
+sub_ntf_next_lock(struct np2srv_sub_ntf *last, int write,
+        int (*sub_ntf_match_cb)(struct np2srv_sub_ntf *sub, const void *match_data), const void *match_data)
+{
+    struct np2srv_sub_ntf_shard *shard;
+    struct np2srv_sub_ntf *sub, *prev = NULL;
+    uint32_t shard_idx = 0;
+    int r;
+
+    if (last) {
+        /* UNLOCK, keep the reference until the next subscription is found */
+        SUB_UNLOCK(last);
+        prev = last;
+        shard_idx = SHARD(last->nc_sub_id) - info.shards;
+    }
+
+    while (shard_idx < NP2SRV_SUB_NTF_SHARD_COUNT) {
+        shard = &info.shards[shard_idx];
+
+        /* SHARD READ LOCK */
+        SHARD_RLOCK(shard);
+
+        if (!prev) {
+            sub = shard->first;
+        } else if (prev->linked) {
+            sub = prev->next;
+        } else {
+            /* removed meanwhile, find the following one */
+            for (sub = shard->first; sub && (sub->nc_sub_id <= prev->nc_sub_id); sub = sub->next) {}
+        }
+        if (sub) {
+            ATOMIC_INC_RELAXED(sub->refs);
+        }
+
+        /* SHARD UNLOCK */
+        SHARD_UNLOCK(shard);
+
+        if (prev) {
+            sub_ntf_unref(prev);
+        }
+        prev = sub;
+
+        if (!sub) {
+            /* next shard */
+            ++shard_idx;
+            continue;
+        }
+
+        /* LOCK */
+        if (write) {
+            SUB_WLOCK(sub);
+        } else {
+            SUB_RLOCK(sub);
+        }
+
+        if (!sub->terminating && (!sub_ntf_match_cb || sub_ntf_match_cb(sub, match_data))) {
+            return sub;
+        }
+
+        /* UNLOCK */
+        SUB_UNLOCK(sub);
+    }
+
+    return NULL;
 }
 
 struct np2srv_sub_ntf *
 sub_ntf_find_next(struct np2srv_sub_ntf *last, int (*sub_ntf_match_cb)(struct np2srv_sub_ntf *sub, const void *match_data),
         const void *match_data)
 {
-    uint32_t i, last_idx = last ? (((char *)last) - ((char *)info.subs)) / sizeof *last : 0;
+    return sub_ntf_next_lock(last, 1, sub_ntf_match_cb, match_data);
+}
 
-    for (i = last ? last_idx + 1 : 0; i < info.count; ++i) {
-        if (sub_ntf_match_cb(&info.subs[i], match_data)) {
-            return &info.subs[i];
-        }
+/**
+ * @brief Queue a subscription-suspended notification for a subscription.
+ *
+ * @param[in] ncs NETCONF session of the subscription.
+ * @param[in] nc_sub_id NC sub ID of the subscription.
+ * @return Sysrepo error value.
+ */
+static int
+sub_ntf_send_notif_suspended(struct nc_session *ncs, uint32_t nc_sub_id)
+{
+    struct lyd_node *ly_ntf = NULL;
+    struct np_ntf *ntf;
+    struct timespec ts;
+    char buf[11];
+    int rc;
+
+    sprintf(buf, "%" PRIu32, nc_sub_id);
+    if (lyd_new_path(NULL, sr_get_context(np2srv.sr_conn), "/ietf-subscribed-notifications:subscription-suspended/id",
+            buf, 0, &ly_ntf)) {
+        return SR_ERR_LY;
+    }
+    if (lyd_new_path(ly_ntf, NULL, "reason", "ietf-subscribed-notifications:insufficient-resources", 0, NULL)) {
+        lyd_free_tree(ly_ntf);
+        return SR_ERR_LY;
     }
 
-    return NULL;
+    ts = np_gettimespec(1);
+    if ((rc = np_ntf_new(ly_ntf, &ts, &ntf))) {
+        return rc;
+    }
+
+    /* state change notifications are never dropped */
+    return np_ntf_queue_push(ncs, nc_sub_id, ntf, 1);
 }
 
 int
-sub_ntf_send_notif(struct nc_session *ncs, uint32_t nc_sub_id, struct timespec timestamp, struct lyd_node **ly_ntf,
-        int use_ntf)
+sub_ntf_send_notif(struct nc_session *ncs, uint32_t nc_sub_id, struct np_ntf *ntf)
 {
     struct np2srv_sub_ntf *sub;
-    struct nc_server_notif *nc_ntf = NULL;
-    NC_MSG_TYPE msg_type;
-    char *datetime = NULL;
-    int rc = SR_ERR_OK;
+    int state_change, rc = SR_ERR_OK;
 
     /* find the subscription structure */
-    sub = sub_ntf_find(nc_sub_id, nc_session_get_id(ncs), 0, 0);
+    sub = sub_ntf_find_ref(nc_sub_id, nc_session_get_id(ncs));
     if (!sub) {
         EINT;
         rc = SR_ERR_INTERNAL;
@@ -172,7 +317,7 @@ sub_ntf_send_notif(struct nc_session *ncs, uint32_t nc_sub_id, struct timespec t
     }
 
     /* check NACM of the notification itself */
-    if (ncac_check_operation(*ly_ntf, nc_session_get_username(ncs))) {
+    if (ncac_check_operation(ntf->ly_ntf, nc_session_get_username(ncs))) {
         /* denied */
         ATOMIC_INC_RELAXED(sub->denied_count);
 
@@ -180,53 +325,52 @@ sub_ntf_send_notif(struct nc_session *ncs, uint32_t nc_sub_id, struct timespec t
         goto cleanup;
     }
 
-    /* create the notification object */
-    ly_time_ts2str(&timestamp, &datetime);
-    if (use_ntf) {
-        /* take ownership of the objects */
-        nc_ntf = nc_server_notif_new(*ly_ntf, datetime, NC_PARAMTYPE_FREE);
-        *ly_ntf = NULL;
-        datetime = NULL;
-    } else {
-        /* objects const, their lifetime must last until the notif is sent */
-        nc_ntf = nc_server_notif_new(*ly_ntf, datetime, NC_PARAMTYPE_CONST);
+    /* subscription state change notifications must always be sent */
+    state_change = !strcmp(ntf->ly_ntf->schema->module->name, "ietf-subscribed-notifications");
+    if (!state_change && ATOMIC_LOAD_RELAXED(sub->suspended)) {
+        /* dropped until the subscription is resumed */
+        ATOMIC_INC_RELAXED(sub->dropped_count);
+        goto cleanup;
     }
 
-    /* send the notification */
-    msg_type = nc_server_notif_send(ncs, nc_ntf, NP2SRV_NOTIF_SEND_TIMEOUT);
-    if ((msg_type == NC_MSG_ERROR) || (msg_type == NC_MSG_WOULDBLOCK)) {
-        ERR("Sending a notification to session %d %s.", nc_session_get_id(ncs),
-                msg_type == NC_MSG_ERROR ? "failed" : "timed out");
-        rc = (msg_type == NC_MSG_ERROR) ? SR_ERR_OPERATION_FAILED : SR_ERR_TIME_OUT;
-        goto cleanup;
-    } else {
-        ncm_session_notification(ncs);
-        ATOMIC_INC_RELAXED(sub->sent_count);
+    /* queue the notification, the reference is passed to the queue */
+    rc = np_ntf_queue_push(ncs, nc_sub_id, ntf, state_change);
+    ntf = NULL;
+    if (rc == SR_ERR_OPERATION_FAILED) {
+        /* queue full, suspend the subscription until it is resumed by the writer */
+        ATOMIC_INC_RELAXED(sub->dropped_count);
+        rc = SR_ERR_OK;
+        if (!ATOMIC_INC_RELAXED(sub->suspended)) {
+            if (np_ntf_queue_suspend(ncs)) {
+                rc = sub_ntf_send_notif_suspended(ncs, nc_sub_id);
+            } else {
+                /* no longer full */
+                ATOMIC_STORE_RELAXED(sub->suspended, 0);
+            }
+        }
     }
 
 cleanup:
-    if (use_ntf) {
-        lyd_free_tree(*ly_ntf);
-        *ly_ntf = NULL;
+    np_ntf_unref(ntf);
+    if (sub) {
+        sub_ntf_unref(sub);
     }
-    free(datetime);
-    nc_server_notif_free(nc_ntf);
     return rc;
 }
 
 void
-sub_ntf_cb_lock_pass(uint32_t sub_id)
+sub_ntf_cb_lock_pass(struct np2srv_sub_ntf *sub, uint32_t sub_id)
 {
-    ATOMIC_STORE_RELAXED(info.sub_id_lock, sub_id);
+    ATOMIC_STORE_RELAXED(sub->sub_id_lock, sub_id);
 }
 
 void
-sub_ntf_cb_lock_clear(uint32_t sub_id)
+sub_ntf_cb_lock_clear(struct np2srv_sub_ntf *sub, uint32_t sub_id)
 {
-    assert(ATOMIC_LOAD_RELAXED(info.sub_id_lock) == sub_id);
+    assert(ATOMIC_LOAD_RELAXED(sub->sub_id_lock) == sub_id);
     (void)sub_id;
 
-    ATOMIC_STORE_RELAXED(info.sub_id_lock, 0);
+    ATOMIC_STORE_RELAXED(sub->sub_id_lock, 0);
 }
 
 void
@@ -234,13 +378,88 @@ sub_ntf_inc_denied(uint32_t nc_sub_id)
 {
     struct np2srv_sub_ntf *sub;
 
-    sub = sub_ntf_find(nc_sub_id, 0, 0, 0);
+    sub = sub_ntf_find_ref(nc_sub_id, 0);
     if (!sub) {
         EINT;
         return;
     }
 
     ATOMIC_INC_RELAXED(sub->denied_count);
+    sub_ntf_unref(sub);
+}
+
+void
+sub_ntf_inc_sent(uint32_t nc_sub_id)
+{
+    struct np2srv_sub_ntf *sub;
+
+    sub = sub_ntf_find_ref(nc_sub_id, 0);
+    if (!sub) {
+        /* terminated meanwhile */
+        return;
+    }
+
+    ATOMIC_INC_RELAXED(sub->sent_count);
+    sub_ntf_unref(sub);
+}
+
+void
+sub_ntf_inc_dropped(uint32_t nc_sub_id)
+{
+    struct np2srv_sub_ntf *sub;
+
+    sub = sub_ntf_find_ref(nc_sub_id, 0);
+    if (!sub) {
+        /* terminated meanwhile */
+        return;
+    }
+
+    ATOMIC_INC_RELAXED(sub->dropped_count);
+    sub_ntf_unref(sub);
+}
+
+/**
+ * @brief Suspended subscription of a NETCONF session match callback.
+ */
+static int
+sub_ntf_suspended_match_cb(struct np2srv_sub_ntf *sub, const void *match_data)
+{
+    const uint32_t *nc_id = match_data;
+
+    return (sub->nc_id == *nc_id) && ATOMIC_LOAD_RELAXED(sub->suspended);
+}
+
+void
+sub_ntf_resume_session(uint32_t nc_id)
+{
+    struct np2srv_sub_ntf *sub = NULL;
+    struct lyd_node *ly_ntf;
+    struct np_ntf *ntf;
+    struct nc_session *ncs;
+    struct timespec ts;
+    char buf[11];
+
+    if (np_get_nc_sess_by_id(0, nc_id, &ncs)) {
+        /* session being freed */
+        return;
+    }
+
+    /* WRITE LOCK on each */
+    while ((sub = sub_ntf_find_next(sub, sub_ntf_suspended_match_cb, &nc_id))) {
+        ATOMIC_STORE_RELAXED(sub->suspended, 0);
+
+        /* send the subscription-resumed notification */
+        sprintf(buf, "%" PRIu32, sub->nc_sub_id);
+        if (lyd_new_path(NULL, sr_get_context(np2srv.sr_conn), "/ietf-subscribed-notifications:subscription-resumed/id",
+                buf, 0, &ly_ntf)) {
+            continue;
+        }
+        ts = np_gettimespec(1);
+        if (np_ntf_new(ly_ntf, &ts, &ntf)) {
+            continue;
+        }
+        sub_ntf_send_notif(ncs, sub->nc_sub_id, ntf);
+    }
 }
 
 /**
@@ -251,7 +470,7 @@ sub_ntf_inc_denied(uint32_t nc_sub_id)
  * @param[in] term_reason Default termination reason.
  * @param[in] stop_time Subscription stop time.
  * @param[in] type Subscription type.
- * @param[out] sub_p Created subscription.
+ * @param[out] sub_p Created WRITE-locked subscription, unlock with sub_ntf_unlock().
  * @return 0 on success.
  * @return -1 on error.
  */
@@ -259,85 +478,122 @@ static int
 sub_ntf_new(uint32_t nc_id, uint32_t nc_sub_id, const char *term_reason, struct timespec stop_time, enum sub_ntf_type type,
         struct np2srv_sub_ntf **sub_p)
 {
-    void *mem;
-    struct np2srv_sub_ntf *sub;
+    struct np2srv_sub_ntf_shard *shard = SHARD(nc_sub_id);
+    struct np2srv_sub_ntf *sub, **sub_p2;
+    int r;
 
-    mem = realloc(info.subs, (info.count + 1) * sizeof *info.subs);
-    if (!mem) {
+    sub = calloc(1, sizeof *sub);
+    if (!sub) {
         return -1;
     }
-    info.subs = mem;
-    sub = &info.subs[info.count];
-    memset(sub, 0, sizeof *sub);
 
     /* fill known members */
+    pthread_rwlock_init(&sub->lock, NULL);
+    ATOMIC_STORE_RELAXED(sub->refs, 2);
     sub->nc_id = nc_id;
     sub->nc_sub_id = nc_sub_id;
     sub->term_reason = term_reason;
     sub->stop_time = stop_time;
     sub->type = type;
 
-    ++info.count;
-    *sub_p = sub;
+    /* WRITE LOCK, until it is fully created */
+    SUB_WLOCK(sub);
+
+    /* SHARD WRITE LOCK */
+    SHARD_WLOCK(shard);
+
+    /* add it into the shard, ordered */
+    for (sub_p2 = &shard->first; *sub_p2 && ((*sub_p2)->nc_sub_id < nc_sub_id); sub_p2 = &(*sub_p2)->next) {}
+    sub->next = *sub_p2;
+    *sub_p2 = sub;
+    sub->linked = 1;
 
+    /* SHARD UNLOCK */
+    SHARD_UNLOCK(shard);
+
+    *sub_p = sub;
     return 0;
 }
 
+/**
+ * @brief NETCONF session match callback.
+ */
+static int
+sub_ntf_nc_id_match_cb(struct np2srv_sub_ntf *sub, const void *match_data)
+{
+    const uint32_t *nc_id = match_data;
+
+    return sub->nc_id == *nc_id;
+}
+
 void
-np2srv_sub_ntf_session_destroy(struct nc_session *ncs)
+np2srv_sub_ntf_init(void)
 {
-    int r;
     uint32_t i;
 
-    /* WRITE LOCK */
-    INFO_WLOCK;
-
-    for (i = 0; i < info.count; ++i) {
-        if (info.subs[i].nc_id == nc_session_get_id(ncs)) {
-            /* terminate the subscription */
-            sub_ntf_terminate_sub(&info.subs[i], ncs);
-        }
+    for (i = 0; i < NP2SRV_SUB_NTF_SHARD_COUNT; ++i) {
+        pthread_rwlock_init(&info.shards[i].lock, NULL);
     }
+}
 
-    /* UNLOCK */
-    INFO_UNLOCK;
+void
+np2srv_sub_ntf_session_destroy(struct nc_session *ncs)
+{
+    struct np2srv_sub_ntf *sub = NULL;
+    uint32_t nc_id = nc_session_get_id(ncs);
+
+    /* WRITE LOCK on each */
+    while ((sub = sub_ntf_next_lock(sub, 1, sub_ntf_nc_id_match_cb, &nc_id))) {
+        /* terminate the subscription */
+        sub_ntf_terminate_sub(sub, ncs);
+    }
 }
 
 void
 np2srv_sub_ntf_destroy(void)
 {
-    int r;
+    struct np2srv_sub_ntf_shard *shard;
+    struct np2srv_sub_ntf *sub, *next;
     uint32_t i;
+    int r;
 
-    /* WRITE LOCK */
-    INFO_WLOCK;
+    for (i = 0; i < NP2SRV_SUB_NTF_SHARD_COUNT; ++i) {
+        shard = &info.shards[i];
 
-    for (i = 0; i < info.count; ++i) {
-        switch (info.subs[i].type) {
-        case SUB_TYPE_SUB_NTF:
-            sub_ntf_terminate_async(info.subs[i].data);
-            break;
-        case SUB_TYPE_YANG_PUSH:
-            yang_push_terminate_async(info.subs[i].data);
-            break;
-        }
+        /* SHARD WRITE LOCK */
+        SHARD_WLOCK(shard);
 
-        free(info.subs[i].sub_ids);
-        switch (info.subs[i].type) {
-        case SUB_TYPE_SUB_NTF:
-            sub_ntf_data_destroy(info.subs[i].data);
-            break;
-        case SUB_TYPE_YANG_PUSH:
-            yang_push_data_destroy(info.subs[i].data);
-            break;
+        for (sub = shard->first; sub; sub = next) {
+            next = sub->next;
+
+            switch (sub->type) {
+            case SUB_TYPE_SUB_NTF:
+                sub_ntf_terminate_async(sub->data);
+                break;
+            case SUB_TYPE_YANG_PUSH:
+                yang_push_terminate_async(sub->data);
+                break;
+            }
+
+            free(sub->sub_ids);
+            switch (sub->type) {
+            case SUB_TYPE_SUB_NTF:
+                sub_ntf_data_destroy(sub->data);
+                break;
+            case SUB_TYPE_YANG_PUSH:
+                yang_push_data_destroy(sub->data);
+                break;
+            }
+
+            pthread_rwlock_destroy(&sub->lock);
+            free(sub);
         }
-    }
-    free(info.subs);
-    info.subs = NULL;
-    info.count = 0;
+        shard->first = NULL;
 
-    /* UNLOCK */
-    INFO_UNLOCK;
+        /* SHARD UNLOCK */
+        SHARD_UNLOCK(shard);
+        pthread_rwlock_destroy(&shard->lock);
+    }
 }
 
 int
@@ -350,7 +606,7 @@ np2srv_rpc_establish_sub_cb(sr_session_ctx_t *session, uint32_t UNUSED(sub_id),
     struct np2srv_sub_ntf *sub;
     char id_str[11];
     struct timespec stop = {0};
-    int r, rc, ntf_status = 0;
+    int rc, ntf_status = 0;
     uint32_t nc_sub_id, *nc_id;
     enum sub_ntf_type type;
 
@@ -396,14 +652,11 @@ np2srv_rpc_establish_sub_cb(sr_session_ctx_t *session, uint32_t UNUSED(sub_id),
     /* get new NC sub ID */
     nc_sub_id = ATOMIC_INC_RELAXED(new_nc_sub_id);
 
-    /* WRITE LOCK */
-    INFO_WLOCK;
-
-    /* allocate a new subscription */
+    /* allocate a new subscription, WRITE LOCK */
     sr_session_get_orig_data(session, 0, NULL, (const void **)&nc_id);
     if (sub_ntf_new(*nc_id, nc_sub_id, "ietf-subscribed-notifications:no-such-subscription", stop, type, &sub)) {
         rc = SR_ERR_INTERNAL;
-        goto error_unlock;
+        goto error;
     }
 
     /* create sysrepo subscriptions and type-specific data */
@@ -420,7 +673,7 @@ np2srv_rpc_establish_sub_cb(sr_session_ctx_t *session, uint32_t UNUSED(sub_id),
     }
 
     /* UNLOCK */
-    INFO_UNLOCK;
+    sub_ntf_unlock(sub, 0);
 
     /* generate output */
     sprintf(id_str, "%" PRIu32, nc_sub_id);
@@ -433,14 +686,16 @@ np2srv_rpc_establish_sub_cb(sr_session_ctx_t *session, uint32_t UNUSED(sub_id),
     return SR_ERR_OK;
 
 error_unlock:
-    --info.count;
+    /* anyone waiting for the subscription will not use it */
+    sub->terminating = 1;
+    sub_ntf_unlink(sub);
 
     /* UNLOCK */
-    INFO_UNLOCK;
+    sub_ntf_unlock(sub, 0);
 
 error:
     if (ntf_status) {
-        nc_session_dec_notif_status(ncs);
+        np_ntf_queue_notif_status_dec(ncs);
     }
     return rc;
 }
@@ -451,7 +706,9 @@ sub_ntf_send_notif_modified(const struct np2srv_sub_ntf *sub)
     int rc = SR_ERR_OK;
     char buf[11], *datetime = NULL;
     struct lyd_node *ly_ntf = NULL;
+    struct np_ntf *ntf;
     struct nc_session *ncs;
+    struct timespec ts;
 
     if (lyd_new_path(NULL, sr_get_context(np2srv.sr_conn), "/ietf-subscribed-notifications:subscription-modified", NULL,
             0, &ly_ntf)) {
@@ -494,7 +751,13 @@ sub_ntf_send_notif_modified(const struct np2srv_sub_ntf *sub)
     }
 
     /* send the notification */
-    rc = sub_ntf_send_notif(ncs, sub->nc_sub_id, np_gettimespec(1), &ly_ntf, 1);
+    ts = np_gettimespec(1);
+    rc = np_ntf_new(ly_ntf, &ts, &ntf);
+    ly_ntf = NULL;
+    if (rc != SR_ERR_OK) {
+        goto cleanup;
+    }
+    rc = sub_ntf_send_notif(ncs, sub->nc_sub_id, ntf);
     if (rc != SR_ERR_OK) {
         goto cleanup;
     }
@@ -514,7 +777,7 @@ np2srv_rpc_modify_sub_cb(sr_session_ctx_t *session, uint32_t UNUSED(sub_id), con
     struct np2srv_sub_ntf *sub;
     char *xp = NULL, *message;
     struct timespec stop = {0};
-    int r, rc = SR_ERR_OK;
+    int rc = SR_ERR_OK;
     uint32_t nc_sub_id, *nc_id;
 
     if (NP_IGNORE_RPC(session, event)) {
@@ -534,7 +797,7 @@ np2srv_rpc_modify_sub_cb(sr_session_ctx_t *session, uint32_t UNUSED(sub_id), con
 
     sr_session_get_orig_data(session, 0, NULL, (const void **)&nc_id);
     /* WRITE LOCK */
-    sub = sub_ntf_find(nc_sub_id, *nc_id, 1, 0);
+    sub = sub_ntf_find_nc_lock(nc_sub_id, *nc_id, 0, 1);
     if (!sub) {
         if (asprintf(&message, "Subscription with ID %" PRIu32 " for the current receiver does not exist.", nc_sub_id) == -1) {
             rc = SR_ERR_NO_MEMORY;
@@ -572,7 +835,7 @@ np2srv_rpc_modify_sub_cb(sr_session_ctx_t *session, uint32_t UNUSED(sub_id), con
 
 cleanup_unlock:
     /* UNLOCK */
-    INFO_UNLOCK;
+    sub_ntf_unlock(sub, 0);
 
 cleanup:
     free(xp);
@@ -583,7 +846,9 @@ int
 sub_ntf_terminate_sub(struct np2srv_sub_ntf *sub, struct nc_session *ncs)
 {
     int r, rc = SR_ERR_OK;
-    struct lyd_node *ly_ntf;
+    struct lyd_node *ly_ntf = NULL;
+    struct np_ntf *ntf;
+    struct timespec ts;
     char buf[11];
     uint32_t idx, sub_id_count, sub_id;
     enum sub_ntf_type sub_type = sub->type;
@@ -595,25 +860,23 @@ sub_ntf_terminate_sub(struct np2srv_sub_ntf *sub, struct nc_session *ncs)
         for (idx = 0; idx < sub_id_count; ++idx) {
             /* pass the lock to the notification CB, which removes its sub ID, the final one the whole sub */
             sub_id = sub->sub_ids[0];
-            sub_ntf_cb_lock_pass(sub_id);
+            sub_ntf_cb_lock_pass(sub, sub_id);
             r = sr_unsubscribe_sub(np2srv.sr_notif_sub, sub_id);
-            sub_ntf_cb_lock_clear(sub_id);
+            sub_ntf_cb_lock_clear(sub, sub_id);
             if (r != SR_ERR_OK) {
                 rc = r;
             }
         }
 
         if (sub_id_count) {
-            /* this subscription item was already freed as part of unsubscribe terminate notification */
+            /* this subscription was already terminated as part of unsubscribe terminate notification */
             return rc;
         }
         break;
     case SUB_TYPE_YANG_PUSH:
-        for (idx = 0; idx < ATOMIC_LOAD_RELAXED(sub->sub_id_count); ++idx) {
-            r = sr_unsubscribe_sub(np2srv.sr_data_sub, sub->sub_ids[idx]);
-            if (r != SR_ERR_OK) {
-                rc = r;
-            }
+        r = yang_push_sr_unsubscribe(sub->data);
+        if (r != SR_ERR_OK) {
+            rc = r;
         }
         break;
     }
@@ -632,13 +895,13 @@ sub_ntf_terminate_sub(struct np2srv_sub_ntf *sub, struct nc_session *ncs)
     sub->terminating = 1;
 
     /* UNLOCK */
-    INFO_UNLOCK;
+    SUB_UNLOCK(sub);
 
     /* give the tasks a chance to wake up */
     np_sleep(NP2SRV_SUB_NTF_TERMINATE_YIELD_SLEEP);
 
     /* WRITE LOCK */
-    INFO_WLOCK;
+    SUB_WLOCK(sub);
 
     if (nc_session_get_status(ncs) == NC_STATUS_RUNNING) {
         /* send the subscription-terminated notification */
@@ -647,19 +910,21 @@ sub_ntf_terminate_sub(struct np2srv_sub_ntf *sub, struct nc_session *ncs)
                 buf, 0, &ly_ntf);
         lyd_new_path(ly_ntf, NULL, "reason", sub->term_reason, 0, NULL);
 
-        r = sub_ntf_send_notif(ncs, sub->nc_sub_id, np_gettimespec(1), &ly_ntf, 1);
+        ts = np_gettimespec(1);
+        if (!(r = np_ntf_new(ly_ntf, &ts, &ntf))) {
+            r = sub_ntf_send_notif(ncs, sub->nc_sub_id, ntf);
+        }
         if (r != SR_ERR_OK) {
             rc = r;
         }
     }
 
-    /* subscription terminated */
-    nc_session_dec_notif_status(ncs);
-
-    /* free the sub */
-    idx = (((char *)sub) - ((char *)info.subs)) / sizeof *sub;
+    /* subscription terminated once all its notifications are sent */
+    np_ntf_queue_notif_status_dec(ncs);
 
+    /* free the sub data */
     free(sub->sub_ids);
+    sub->sub_ids = NULL;
     switch (sub->type) {
     case SUB_TYPE_SUB_NTF:
         sub_ntf_data_destroy(sub->data);
@@ -668,14 +933,10 @@ sub_ntf_terminate_sub(struct np2srv_sub_ntf *sub, struct nc_session *ncs)
         yang_push_data_destroy(sub->data);
         break;
     }
+    sub->data = NULL;
 
-    --info.count;
-    if (idx < info.count) {
-        memmove(sub, sub + 1, (info.count - idx) * sizeof *sub);
-    } else if (!info.count) {
-        free(info.subs);
-        info.subs = NULL;
-    }
+    /* remove the sub, it is freed once unlocked */
+    sub_ntf_unlink(sub);
 
     return rc;
 }
@@ -689,7 +950,7 @@ np2srv_rpc_delete_sub_cb(sr_session_ctx_t *session, uint32_t UNUSED(sub_id), con
     struct np2srv_sub_ntf *sub;
     struct nc_session *ncs;
     char *message;
-    int r, rc = SR_ERR_OK;
+    int rc = SR_ERR_OK;
     uint32_t nc_sub_id, *nc_id;
 
     if (NP_IGNORE_RPC(session, event)) {
@@ -703,7 +964,7 @@ np2srv_rpc_delete_sub_cb(sr_session_ctx_t *session, uint32_t UNUSED(sub_id), con
 
     sr_session_get_orig_data(session, 0, NULL, (const void **)&nc_id);
     /* WRITE LOCK */
-    sub = sub_ntf_find(nc_sub_id, *nc_id, 1, 0);
+    sub = sub_ntf_find_nc_lock(nc_sub_id, *nc_id, 0, 1);
     if (!sub) {
         if (asprintf(&message, "Subscription with ID %" PRIu32 " for the current receiver does not exist.", nc_sub_id) == -1) {
             return SR_ERR_NO_MEMORY;
@@ -726,7 +987,7 @@ np2srv_rpc_delete_sub_cb(sr_session_ctx_t *session, uint32_t UNUSED(sub_id), con
 
 cleanup_unlock:
     /* UNLOCK */
-    INFO_UNLOCK;
+    sub_ntf_unlock(sub, 0);
 
     return rc;
 }
@@ -740,7 +1001,7 @@ np2srv_rpc_kill_sub_cb(sr_session_ctx_t *session, uint32_t UNUSED(sub_id), const
     struct np2srv_sub_ntf *sub;
     struct nc_session *ncs;
     char *message;
-    int r, rc = SR_ERR_OK;
+    int rc = SR_ERR_OK;
     uint32_t nc_sub_id;
 
     if (NP_IGNORE_RPC(session, event)) {
@@ -753,7 +1014,7 @@ np2srv_rpc_kill_sub_cb(sr_session_ctx_t *session, uint32_t UNUSED(sub_id), const
     nc_sub_id = ((struct lyd_node_term *)node)->value.uint32;
 
     /* WRITE LOCK */
-    sub = sub_ntf_find(nc_sub_id, 0, 1, 0);
+    sub = sub_ntf_find_nc_lock(nc_sub_id, 0, 0, 1);
     if (!sub) {
         if (asprintf(&message, "Subscription with ID %" PRIu32 " for the current receiver does not exist.", nc_sub_id) == -1) {
             return SR_ERR_NO_MEMORY;
@@ -776,7 +1037,7 @@ np2srv_rpc_kill_sub_cb(sr_session_ctx_t *session, uint32_t UNUSED(sub_id), const
 
 cleanup_unlock:
     /* WRITE UNLOCK */
-    INFO_UNLOCK;
+    sub_ntf_unlock(sub, 0);
 
     return rc;
 }
@@ -790,10 +1051,7 @@ np2srv_config_sub_ntf_filters_cb(sr_session_ctx_t *session, uint32_t UNUSED(sub_
     const struct lyd_node *node;
     int r, rc = SR_ERR_OK;
 
-    /* WRITE LOCK */
-    INFO_WLOCK;
-
-    /* subscribed-notifications */
+    /* subscribed-notifications, subscriptions are locked while iterated */
     rc = sr_get_changes_iter(session, "/ietf-subscribed-notifications:filters/stream-filter/*", &iter);
     if (rc != SR_ERR_OK) {
         ERR("Getting changes iter failed (%s).", sr_strerror(rc));
@@ -835,10 +1093,6 @@ np2srv_config_sub_ntf_filters_cb(sr_session_ctx_t *session, uint32_t UNUSED(sub_
     }
 
 cleanup:
-    ATOMIC_STORE_RELAXED(info.sub_id_lock, 0);
-    /* UNLOCK */
-    INFO_UNLOCK;
-
     sr_free_change_iter(iter);
     return rc;
 }
@@ -936,26 +1190,24 @@ np2srv_oper_sub_ntf_subscriptions_cb(sr_session_ctx_t *session, uint32_t UNUSED(
         struct lyd_node **parent, void *UNUSED(private_data))
 {
     const struct ly_ctx *ly_ctx;
+    const struct lys_module *np_mod;
     struct lyd_node *list, *receiver, *root;
-    struct np2srv_sub_ntf *sub;
+    struct np2srv_sub_ntf *sub = NULL;
+    struct nc_session *ncs;
     char buf[26], *path = NULL, *datetime = NULL;
-    uint32_t i, excluded_count = 0;
-    int r, rc = SR_ERR_OK;
+    uint32_t excluded_count = 0;
+    int rc = SR_ERR_OK;
 
     ly_ctx = sr_get_context(sr_session_get_connection(session));
-
-    /* READ LOCK */
-    INFO_RLOCK;
+    np_mod = ly_ctx_get_module_implemented(ly_ctx, "netopeer2-server");
 
     if (lyd_new_path(NULL, ly_ctx, "/ietf-subscribed-notifications:subscriptions", NULL, 0, &root)) {
         rc = SR_ERR_LY;
         goto cleanup;
     }
 
-    /* go through all the subscriptions */
-    for (i = 0; i < info.count; ++i) {
-        sub = &info.subs[i];
-
+    /* go through all the subscriptions, READ LOCK on each */
+    while ((sub = sub_ntf_next_lock(sub, 0, NULL, NULL))) {
         /* subscription with id */
         sprintf(buf, "%" PRIu32, sub->nc_sub_id);
         if (lyd_new_list(root, NULL, "subscription", 0, &list, buf)) {
@@ -1026,15 +1278,36 @@ np2srv_oper_sub_ntf_subscriptions_cb(sr_session_ctx_t *session, uint32_t UNUSED(
         }
 
         /* state */
-        if (lyd_new_term(receiver, NULL, "state", "active", 0, NULL)) {
+        if (lyd_new_term(receiver, NULL, "state", ATOMIC_LOAD_RELAXED(sub->suspended) ? "suspended" : "active", 0,
+                NULL)) {
             rc = SR_ERR_LY;
             goto cleanup;
         }
+
+        if (np_mod) {
+            /* queue-depth, netopeer2-server augment */
+            if (!np_get_nc_sess_by_id(0, sub->nc_id, &ncs)) {
+                sprintf(buf, "%" PRIu32, np_ntf_queue_depth(ncs));
+                if (lyd_new_term(receiver, np_mod, "queue-depth", buf, 0, NULL)) {
+                    rc = SR_ERR_LY;
+                    goto cleanup;
+                }
+            }
+
+            /* dropped-event-records */
+            sprintf(buf, "%" PRIu32, (uint32_t)ATOMIC_LOAD_RELAXED(sub->dropped_count));
+            if (lyd_new_term(receiver, np_mod, "dropped-event-records", buf, 0, NULL)) {
+                rc = SR_ERR_LY;
+                goto cleanup;
+            }
+        }
     }
 
 cleanup:
-    /* UNLOCK */
-    INFO_UNLOCK;
+    if (sub) {
+        /* UNLOCK */
+        sub_ntf_unlock(sub, 0);
+    }
 
     free(datetime);
     if (rc) {
@@ -31,29 +31,41 @@ enum sub_ntf_type {
 };
 
 /**
- * @brief Complete operational information about the subscriptions.
+ * @brief Subscription, all the members except for the locking ones may be accessed only with its lock held.
  */
-struct np2srv_sub_ntf_info {
+struct np2srv_sub_ntf {
     pthread_rwlock_t lock;
     ATOMIC_T sub_id_lock;   /* subscription ID that holds the lock, if a notification callback is called with this ID,
                                it must not attempt locking and can access this structure directly */
+    ATOMIC_T refs;          /* references, the structure is freed when there are none */
+    int linked;             /* whether in the registry, protected by the shard lock */
+    struct np2srv_sub_ntf *next;    /* next subscription in the shard, protected by the shard lock */
+
+    uint32_t nc_id;
+    uint32_t nc_sub_id;
+    uint32_t *sub_ids;
+    ATOMIC_T sub_id_count;
+    const char *term_reason;
+    struct timespec stop_time;
+
+    int terminating;        /* set flag means the lock for this subscription will not be granted */
+    ATOMIC_T sent_count;    /* sent notifications counter */
+    ATOMIC_T denied_count;  /* counter of notifications denied by NACM */
+    ATOMIC_T dropped_count; /* counter of notifications dropped because of a full session queue */
+    ATOMIC_T suspended;     /* whether suspended because of a full session queue */
+
+    enum sub_ntf_type type;
+    void *data;
+};
 
-    struct np2srv_sub_ntf {
-        uint32_t nc_id;
-        uint32_t nc_sub_id;
-        uint32_t *sub_ids;
-        ATOMIC_T sub_id_count;
-        const char *term_reason;
-        struct timespec stop_time;
-
-        int terminating;        /* set flag means the WRITE lock for this subscription will not be granted */
-        ATOMIC_T sent_count;    /* sent notifications counter */
-        ATOMIC_T denied_count;  /* counter of notifications denied by NACM */
-
-        enum sub_ntf_type type;
-        void *data;
-    } *subs;
-    uint32_t count;
+/**
+ * @brief Complete operational information about the subscriptions, sharded by their NC sub ID.
+ */
+struct np2srv_sub_ntf_info {
+    struct np2srv_sub_ntf_shard {
+        pthread_rwlock_t lock;          /* lock for the subscription list, not the subscriptions themselves */
+        struct np2srv_sub_ntf *first;   /* subscriptions ordered by their NC sub ID */
+    } shards[NP2SRV_SUB_NTF_SHARD_COUNT];
 };
 
 /*
@@ -61,25 +73,28 @@ struct np2srv_sub_ntf_info {
  */
 
 /**
- * @brief Lock the sub-ntf lock, if possible, and return a subscription.
+ * @brief Find a subscription and lock it, if possible.
  *
  * @param[in] nc_sub_id NC sub ID of the subscription.
  * @param[in] sub_id SR subscription ID in a callback, 0 if not in callback.
  * @param[in] write Whether to write or read-lock.
- * @return Found subscription.
+ * @return Found subscription, unlock with sub_ntf_unlock().
  * @return NULL if subscription was not found or it is terminating.
  */
 struct np2srv_sub_ntf *sub_ntf_find_lock(uint32_t nc_sub_id, uint32_t sub_id, int write);
 
 /**
- * @brief Unlock the sub-ntf lock.
+ * @brief Unlock a subscription, it may be freed afterwards.
  *
+ * @param[in] sub Locked subscription.
  * @param[in] sub_id SR subscription ID in a callback, 0 if not in callback.
  */
-void sub_ntf_unlock(uint32_t sub_id);
+void sub_ntf_unlock(struct np2srv_sub_ntf *sub, uint32_t sub_id);
 
 /**
- * @brief Find the next matching sub-ntf subscription structure.
+ * @brief Find the next matching sub-ntf subscription structure and WRITE-lock it.
+ *
+ * The previously found subscription is unlocked so all the subscriptions must always be iterated.
  *
  * @param[in] last Last found structure, NULL on first call.
  * @param[in] sub_ntf_match_cb Callback for deciding a subscription match.
@@ -91,33 +106,32 @@ struct np2srv_sub_ntf *sub_ntf_find_next(struct np2srv_sub_ntf *last,
         int (*sub_ntf_match_cb)(struct np2srv_sub_ntf *sub, const void *match_data), const void *match_data);
 
 /**
- * @brief Send a notification.
+ * @brief Queue a notification to be sent, the subscription is suspended if the session queue overflows.
  *
  * @param[in] ncs NETCONF session to use.
  * @param[in] nc_sub_id NETCONF sub ID of the subscription.
- * @param[in] timestamp Timestamp to use.
- * @param[in,out] ly_ntf Notification to send.
- * @param[in] use_ntf Whether to free @p ly_ntf and set to NULL or leave unchanged.
+ * @param[in] ntf Notification to send, its reference is always consumed.
  * @return Sysrepo error value.
  */
-int sub_ntf_send_notif(struct nc_session *ncs, uint32_t nc_sub_id, struct timespec timestamp, struct lyd_node **ly_ntf,
-        int use_ntf);
+int sub_ntf_send_notif(struct nc_session *ncs, uint32_t nc_sub_id, struct np_ntf *ntf);
 
 /**
- * @brief If holding the sub-ntf lock, pass it to another callback that will be called by some following code.
+ * @brief If holding the subscription lock, pass it to another callback that will be called by some following code.
  *
  * Clear with sub_ntf_cb_lock_clear().
  *
+ * @param[in] sub Locked subscription.
  * @param[in] sub_id Sysrepo subscription ID obtained in the callback.
  */
-void sub_ntf_cb_lock_pass(uint32_t sub_id);
+void sub_ntf_cb_lock_pass(struct np2srv_sub_ntf *sub, uint32_t sub_id);
 
 /**
- * @brief Clear the passed sub-ntf lock.
+ * @brief Clear the passed subscription lock.
  *
+ * @param[in] sub Locked subscription.
  * @param[in] sub_id Sysrepo subscription ID that the lock was passed to.
  */
-void sub_ntf_cb_lock_clear(uint32_t sub_id);
+void sub_ntf_cb_lock_clear(struct np2srv_sub_ntf *sub, uint32_t sub_id);
 
 /**
  * @brief Increase denied notification count for a subscription.
@@ -126,11 +140,33 @@ void sub_ntf_cb_lock_clear(uint32_t sub_id);
  */
 void sub_ntf_inc_denied(uint32_t nc_sub_id);
 
+/**
+ * @brief Increase sent notification count for a subscription.
+ *
+ * @param[in] nc_sub_id NETCONF sub ID of the subscription.
+ */
+void sub_ntf_inc_sent(uint32_t nc_sub_id);
+
+/**
+ * @brief Increase dropped notification count for a subscription.
+ *
+ * @param[in] nc_sub_id NETCONF sub ID of the subscription.
+ */
+void sub_ntf_inc_dropped(uint32_t nc_sub_id);
+
+/**
+ * @brief Resume all the subscriptions of a session suspended because of its full notification queue.
+ *
+ * @param[in] nc_id NETCONF session ID.
+ */
+void sub_ntf_resume_session(uint32_t nc_id);
+
 /**
  * @brief Correctly terminate a ntf-sub subscription.
- * ntf-sub lock is expected to be held.
+ * Subscription WRITE lock is expected to be held.
  *
- * @param[in] sub Subscription to terminate, is freed.
+ * @param[in] sub Subscription to terminate, its data are freed and it is removed from the subscriptions, the structure
+ * itself is freed once unlocked.
  * @param[in] ncs NETCONF session.
  * @return Sysrepo error value.
  */
@@ -147,6 +183,8 @@ int sub_ntf_send_notif_modified(const struct np2srv_sub_ntf *sub);
 /*
  * for main.c
  */
+void np2srv_sub_ntf_init(void);
+
 void np2srv_sub_ntf_session_destroy(struct nc_session *ncs);
 
 void np2srv_sub_ntf_destroy(void);
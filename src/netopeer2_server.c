@@ -0,0 +1,131 @@
+/**
+ * @file netopeer2_server.c
+ * @author agent <agent@local>
+ * @brief netopeer2-server internal state callbacks
+ *
+ * @copyright
+ * Copyright (c) 2026 CESNET, z.s.p.o.
+ *
+ * This source code is licensed under BSD 3-Clause License (the "License").
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://opensource.org/licenses/BSD-3-Clause
+ */
+
+#define _GNU_SOURCE
+
+#include "netopeer2_server.h"
+
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include <libyang/libyang.h>
+#include <sysrepo.h>
+
+#include "common.h"
+#include "compat.h"
+#include "log.h"
+#include "netconf_acm.h"
+#include "timer_wheel.h"
+
+int
+np2srv_stats_oper_cb(sr_session_ctx_t *session, uint32_t UNUSED(sub_id), const char *UNUSED(module_name),
+        const char *UNUSED(path), const char *UNUSED(request_xpath), uint32_t UNUSED(request_id),
+        struct lyd_node **parent, void *UNUSED(private_data))
+{
+    struct lyd_node *root = NULL, *cont;
+    const struct ly_ctx *ly_ctx;
+    uint64_t hits, misses, fired;
+    uint32_t entries, armed, lag_avg, lag_max;
+    char buf[21];
+
+    ly_ctx = sr_get_context(sr_session_get_connection(session));
+
+    if (lyd_new_path(NULL, ly_ctx, "/netopeer2-server:server-stats", NULL, 0, &root)) {
+        goto error;
+    }
+
+    /* filter cache */
+    op_filter_cache_stats(&entries, &hits, &misses);
+    if (lyd_new_inner(root, NULL, "filter-cache", 0, &cont)) {
+        goto error;
+    }
+    sprintf(buf, "%" PRIu32, entries);
+    if (lyd_new_term(cont, NULL, "entries", buf, 0, NULL)) {
+        goto error;
+    }
+    sprintf(buf, "%" PRIu64, hits);
+    if (lyd_new_term(cont, NULL, "hits", buf, 0, NULL)) {
+        goto error;
+    }
+    sprintf(buf, "%" PRIu64, misses);
+    if (lyd_new_term(cont, NULL, "misses", buf, 0, NULL)) {
+        goto error;
+    }
+
+    /* user cache */
+    np_user_cache_stats(&entries, &hits, &misses);
+    if (lyd_new_inner(root, NULL, "user-cache", 0, &cont)) {
+        goto error;
+    }
+    sprintf(buf, "%" PRIu32, entries);
+    if (lyd_new_term(cont, NULL, "entries", buf, 0, NULL)) {
+        goto error;
+    }
+    sprintf(buf, "%" PRIu64, hits);
+    if (lyd_new_term(cont, NULL, "hits", buf, 0, NULL)) {
+        goto error;
+    }
+    sprintf(buf, "%" PRIu64, misses);
+    if (lyd_new_term(cont, NULL, "misses", buf, 0, NULL)) {
+        goto error;
+    }
+
+    /* timers */
+    np_timer_wheel_stats(&armed, &fired, &lag_avg, &lag_max);
+    if (lyd_new_inner(root, NULL, "timers", 0, &cont)) {
+        goto error;
+    }
+    sprintf(buf, "%" PRIu32, armed);
+    if (lyd_new_term(cont, NULL, "armed", buf, 0, NULL)) {
+        goto error;
+    }
+    sprintf(buf, "%" PRIu64, fired);
+    if (lyd_new_term(cont, NULL, "fired", buf, 0, NULL)) {
+        goto error;
+    }
+    sprintf(buf, "%" PRIu32, lag_avg);
+    if (lyd_new_term(cont, NULL, "lag-average", buf, 0, NULL)) {
+        goto error;
+    }
+    sprintf(buf, "%" PRIu32, lag_max);
+    if (lyd_new_term(cont, NULL, "lag-max", buf, 0, NULL)) {
+        goto error;
+    }
+
+    *parent = root;
+    return SR_ERR_OK;
+
+error:
+    lyd_free_tree(root);
+    return SR_ERR_INTERNAL;
+}
+
+int
+np2srv_rpc_clear_user_cache_cb(sr_session_ctx_t *UNUSED(session), uint32_t UNUSED(sub_id), const char *UNUSED(op_path),
+        const struct lyd_node *UNUSED(input), sr_event_t UNUSED(event), uint32_t UNUSED(request_id),
+        struct lyd_node *UNUSED(output), void *UNUSED(private_data))
+{
+    /* system users */
+    np_user_cache_clear();
+
+    /* NACM information derived from them */
+    if (ncac_user_cache_clear()) {
+        return SR_ERR_NO_MEMORY;
+    }
+
+    VRB("Cached system users cleared.");
+    return SR_ERR_OK;
+}
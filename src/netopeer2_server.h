@@ -0,0 +1,28 @@
+/**
+ * @file netopeer2_server.h
+ * @author agent <agent@local>
+ * @brief netopeer2-server internal state callbacks header
+ *
+ * @copyright
+ * Copyright (c) 2026 CESNET, z.s.p.o.
+ *
+ * This source code is licensed under BSD 3-Clause License (the "License").
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://opensource.org/licenses/BSD-3-Clause
+ */
+
+#ifndef NP2SRV_NETOPEER2_SERVER_H_
+#define NP2SRV_NETOPEER2_SERVER_H_
+
+#include <libyang/libyang.h>
+#include <sysrepo.h>
+
+int np2srv_stats_oper_cb(sr_session_ctx_t *session, uint32_t sub_id, const char *module_name, const char *path,
+        const char *request_xpath, uint32_t request_id, struct lyd_node **parent, void *private_data);
+
+int np2srv_rpc_clear_user_cache_cb(sr_session_ctx_t *session, uint32_t sub_id, const char *op_path,
+        const struct lyd_node *input, sr_event_t event, uint32_t request_id, struct lyd_node *output, void *private_data);
+
+#endif /* NP2SRV_NETOPEER2_SERVER_H_ */
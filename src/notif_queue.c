@@ -0,0 +1,553 @@
+/**
+ * @file notif_queue.c
+ * @author agent <agent@local>
+ * @brief netopeer2-server asynchronous notification send queues
+ *
+ * @copyright
+ * Copyright (c) 2026 CESNET, z.s.p.o.
+ *
+ * This source code is licensed under BSD 3-Clause License (the "License").
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://opensource.org/licenses/BSD-3-Clause
+ */
+
+#define _GNU_SOURCE
+
+#include "notif_queue.h"
+
+#include <assert.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <nc_server.h>
+#include <sysrepo.h>
+
+#include "common.h"
+#include "compat.h"
+#include "config.h"
+#include "log.h"
+#include "netconf_monitoring.h"
+#include "netconf_subscribed_notifications.h"
+
+static struct {
+    pthread_mutex_t lock;           /* lock for the ready queues */
+    pthread_cond_t cond;            /* signalled when a queue is ready */
+    int stop;
+
+    struct np_ntf_queue *first;     /* queues waiting for a writer */
+    struct np_ntf_queue *last;
+
+    pthread_t tids[NP2SRV_NOTIF_WRITER_COUNT];
+    uint32_t thread_count;
+} writers = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .cond = PTHREAD_COND_INITIALIZER
+};
+
+int
+np_ntf_new(struct lyd_node *ly_ntf, const struct timespec *timestamp, struct np_ntf **ntf)
+{
+    *ntf = calloc(1, sizeof **ntf);
+    if (!*ntf) {
+        EMEM;
+        lyd_free_tree(ly_ntf);
+        return SR_ERR_NO_MEMORY;
+    }
+    ATOMIC_STORE_RELAXED((*ntf)->refs, 1);
+    (*ntf)->ly_ntf = ly_ntf;
+
+    /* encode the event time once */
+    if (ly_time_ts2str(timestamp, &(*ntf)->datetime)) {
+        np_ntf_unref(*ntf);
+        *ntf = NULL;
+        return SR_ERR_LY;
+    }
+
+    /* all the members must exist until the notification is sent to all the sessions */
+    (*ntf)->nc_ntf = nc_server_notif_new((*ntf)->ly_ntf, (*ntf)->datetime, NC_PARAMTYPE_CONST);
+    if (!(*ntf)->nc_ntf) {
+        np_ntf_unref(*ntf);
+        *ntf = NULL;
+        return SR_ERR_INTERNAL;
+    }
+
+    return SR_ERR_OK;
+}
+
+void
+np_ntf_unref(struct np_ntf *ntf)
+{
+    if (!ntf) {
+        return;
+    }
+
+    if (ATOMIC_DEC(ntf->refs) > 1) {
+        /* still referenced */
+        return;
+    }
+
+    nc_server_notif_free(ntf->nc_ntf);
+    lyd_free_tree(ntf->ly_ntf);
+    free(ntf->datetime);
+    free(ntf);
+}
+
+/**
+ * @brief Get the queue of a NETCONF session.
+ *
+ * @param[in] ncs NETCONF session.
+ * @return Session queue.
+ */
+static struct np_ntf_queue *
+np_ntf_queue_get(struct nc_session *ncs)
+{
+    struct np2_user_sess *user_sess = nc_session_get_data(ncs);
+
+    return &user_sess->ntf_queue;
+}
+
+/**
+ * @brief Add a queue with notifications to be sent at the end of the ready queues.
+ * Queue lock is expected to be held, writers lock must not be.
+ *
+ * @param[in] queue Queue to add.
+ */
+static void
+np_ntf_queue_ready(struct np_ntf_queue *queue)
+{
+    if (!queue->first) {
+        /* nothing to send */
+        return;
+    }
+
+    /* LOCK */
+    pthread_mutex_lock(&writers.lock);
+
+    if (!queue->ready && !queue->busy && !queue->closed) {
+        /* a busy queue is added by its writer once it finishes */
+        queue->ready_next = NULL;
+        if (writers.last) {
+            writers.last->ready_next = queue;
+        } else {
+            writers.first = queue;
+        }
+        writers.last = queue;
+        queue->ready = 1;
+
+        pthread_cond_signal(&writers.cond);
+    }
+
+    /* UNLOCK */
+    pthread_mutex_unlock(&writers.lock);
+}
+
+/**
+ * @brief Free a queued item.
+ *
+ * @param[in] item Item to free.
+ * @param[in] dropped Whether the notification was dropped instead of sent.
+ */
+static void
+np_ntf_item_free(struct np_ntf_item *item, int dropped)
+{
+    if (dropped && item->nc_sub_id) {
+        sub_ntf_inc_dropped(item->nc_sub_id);
+    }
+
+    np_ntf_unref(item->ntf);
+    free(item);
+}
+
+/**
+ * @brief Writer thread, sends a single notification of a ready queue at a time so that the sessions take turns.
+ *
+ * Lock order is queue lock -> writers lock so the queue lock is never acquired while holding the writers lock.
+ *
+ * @param[in] arg Unused.
+ * @return NULL.
+ */
+static void *
+np_ntf_writer_thread(void *UNUSED(arg))
+{
+    struct np_ntf_queue *queue;
+    struct np_ntf_item *item;
+    NC_MSG_TYPE msg_type;
+    uint32_t nc_id;
+    int resume;
+
+    while (1) {
+        /* LOCK */
+        pthread_mutex_lock(&writers.lock);
+
+        while (!writers.stop && !writers.first) {
+            pthread_cond_wait(&writers.cond, &writers.lock);
+        }
+        if (writers.stop) {
+            /* UNLOCK */
+            pthread_mutex_unlock(&writers.lock);
+            break;
+        }
+
+        /* take the first ready queue, the session cannot be freed while busy */
+        queue = writers.first;
+        writers.first = queue->ready_next;
+        if (!writers.first) {
+            writers.last = NULL;
+        }
+        queue->ready_next = NULL;
+        queue->ready = 0;
+        queue->busy = 1;
+
+        /* UNLOCK */
+        pthread_mutex_unlock(&writers.lock);
+
+        /* QUEUE LOCK */
+        pthread_mutex_lock(&queue->lock);
+
+        /* dequeue */
+        item = queue->first;
+        if (item) {
+            queue->first = item->next;
+            if (!queue->first) {
+                queue->last = NULL;
+            }
+            --queue->depth;
+
+            /* wake up anyone waiting for space */
+            pthread_cond_signal(&queue->space);
+        }
+
+        /* QUEUE UNLOCK */
+        pthread_mutex_unlock(&queue->lock);
+
+        nc_id = nc_session_get_id(queue->ncs);
+        if (item && !item->ntf) {
+            /* all the previous notifications of the subscription were sent */
+            nc_session_dec_notif_status(queue->ncs);
+            np_ntf_item_free(item, 0);
+        } else if (item) {
+            /* send the notification */
+            msg_type = nc_server_notif_send(queue->ncs, item->ntf->nc_ntf, NP2SRV_NOTIF_SEND_TIMEOUT);
+            if ((msg_type == NC_MSG_ERROR) || (msg_type == NC_MSG_WOULDBLOCK)) {
+                ERR("Sending a notification to session %d %s.", nc_id, msg_type == NC_MSG_ERROR ? "failed" : "timed out");
+                np_ntf_item_free(item, 1);
+            } else {
+                ncm_session_notification(queue->ncs);
+                if (item->nc_sub_id) {
+                    sub_ntf_inc_sent(item->nc_sub_id);
+                }
+                np_ntf_item_free(item, 0);
+            }
+        }
+
+        /* QUEUE LOCK */
+        pthread_mutex_lock(&queue->lock);
+
+        /* resume the subscriptions once there is enough space */
+        resume = 0;
+        if (queue->suspended && (queue->depth <= np2srv.ntf_queue_depth / 2)) {
+            queue->suspended = 0;
+            resume = 1;
+        }
+
+        /* LOCK */
+        pthread_mutex_lock(&writers.lock);
+
+        /* wake up anyone closing the queue, who then waits for the queue lock to be released */
+        queue->busy = 0;
+        pthread_cond_broadcast(&queue->cond);
+
+        /* UNLOCK */
+        pthread_mutex_unlock(&writers.lock);
+
+        /* give the other sessions a turn */
+        np_ntf_queue_ready(queue);
+
+        /* QUEUE UNLOCK */
+        pthread_mutex_unlock(&queue->lock);
+
+        if (resume) {
+            sub_ntf_resume_session(nc_id);
+        }
+    }
+
+    return NULL;
+}
+
+int
+np_ntf_queue_init(void)
+{
+    int r;
+
+    writers.stop = 0;
+    for (writers.thread_count = 0; writers.thread_count < NP2SRV_NOTIF_WRITER_COUNT; ++writers.thread_count) {
+        if ((r = pthread_create(&writers.tids[writers.thread_count], NULL, np_ntf_writer_thread, NULL))) {
+            ERR("Creating notification writer thread failed (%s).", strerror(r));
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+void
+np_ntf_queue_destroy(void)
+{
+    uint32_t i;
+
+    /* LOCK */
+    pthread_mutex_lock(&writers.lock);
+
+    writers.stop = 1;
+    pthread_cond_broadcast(&writers.cond);
+
+    /* UNLOCK */
+    pthread_mutex_unlock(&writers.lock);
+
+    for (i = 0; i < writers.thread_count; ++i) {
+        pthread_join(writers.tids[i], NULL);
+    }
+    writers.thread_count = 0;
+}
+
+void
+np_ntf_queue_session_init(struct np_ntf_queue *queue, struct nc_session *ncs)
+{
+    memset(queue, 0, sizeof *queue);
+    pthread_mutex_init(&queue->lock, NULL);
+    pthread_cond_init(&queue->cond, NULL);
+    pthread_cond_init(&queue->space, NULL);
+    queue->ncs = ncs;
+}
+
+void
+np_ntf_queue_session_close(struct np_ntf_queue *queue)
+{
+    struct np_ntf_queue *iter, *prev;
+    struct np_ntf_item *item, *next;
+
+    /* QUEUE LOCK */
+    pthread_mutex_lock(&queue->lock);
+
+    /* LOCK */
+    pthread_mutex_lock(&writers.lock);
+
+    queue->closed = 1;
+
+    if (queue->ready) {
+        /* remove from the ready queues */
+        prev = NULL;
+        for (iter = writers.first; iter != queue; iter = iter->ready_next) {
+            prev = iter;
+        }
+        if (prev) {
+            prev->ready_next = queue->ready_next;
+        } else {
+            writers.first = queue->ready_next;
+        }
+        if (writers.last == queue) {
+            writers.last = prev;
+        }
+        queue->ready_next = NULL;
+        queue->ready = 0;
+    }
+
+    /* UNLOCK */
+    pthread_mutex_unlock(&writers.lock);
+
+    /* drop all the notifications */
+    item = queue->first;
+    queue->first = NULL;
+    queue->last = NULL;
+    queue->depth = 0;
+
+    /* wait for anyone waiting for space to stop using the queue */
+    pthread_cond_broadcast(&queue->space);
+    while (queue->blocked) {
+        pthread_cond_wait(&queue->space, &queue->lock);
+    }
+
+    /* QUEUE UNLOCK */
+    pthread_mutex_unlock(&queue->lock);
+
+    for ( ; item; item = next) {
+        next = item->next;
+        np_ntf_item_free(item, 1);
+    }
+
+    /* LOCK */
+    pthread_mutex_lock(&writers.lock);
+
+    /* wait for the writer */
+    while (queue->busy) {
+        pthread_cond_wait(&queue->cond, &writers.lock);
+    }
+
+    /* UNLOCK */
+    pthread_mutex_unlock(&writers.lock);
+
+    /* the writer clears busy while still holding the queue lock, it must release it before the queue is freed */
+    /* QUEUE LOCK */
+    pthread_mutex_lock(&queue->lock);
+
+    /* QUEUE UNLOCK */
+    pthread_mutex_unlock(&queue->lock);
+}
+
+void
+np_ntf_queue_session_destroy(struct np_ntf_queue *queue)
+{
+    assert(!queue->first && !queue->busy && !queue->ready && !queue->blocked);
+
+    pthread_mutex_destroy(&queue->lock);
+    pthread_cond_destroy(&queue->cond);
+    pthread_cond_destroy(&queue->space);
+}
+
+int
+np_ntf_queue_push(struct nc_session *ncs, uint32_t nc_sub_id, struct np_ntf *ntf, int force)
+{
+    struct np_ntf_queue *queue = np_ntf_queue_get(ncs);
+    struct np_ntf_item *item, *dropped = NULL, *prev;
+    int rc = SR_ERR_OK;
+
+    item = malloc(sizeof *item);
+    if (!item) {
+        EMEM;
+        np_ntf_unref(ntf);
+        return SR_ERR_NO_MEMORY;
+    }
+    item->ntf = ntf;
+    item->nc_sub_id = nc_sub_id;
+    item->next = NULL;
+
+    /* QUEUE LOCK */
+    pthread_mutex_lock(&queue->lock);
+
+    if (queue->closed) {
+        /* session is being freed */
+        dropped = item;
+        goto cleanup;
+    }
+
+    if (!force && (queue->depth >= np2srv.ntf_queue_depth)) {
+        /* queue full */
+        switch (np2srv.ntf_overflow) {
+        case NP_NTF_OVERFLOW_BLOCK:
+            /* wait for a writer to dequeue a notification */
+            ++queue->blocked;
+            while (!queue->closed && (queue->depth >= np2srv.ntf_queue_depth)) {
+                pthread_cond_wait(&queue->space, &queue->lock);
+            }
+            --queue->blocked;
+
+            if (queue->closed) {
+                /* session is being freed, let it know the queue is no longer used */
+                pthread_cond_broadcast(&queue->space);
+                dropped = item;
+                goto cleanup;
+            }
+            break;
+        case NP_NTF_OVERFLOW_DROP_OLDEST:
+            /* find the oldest notification, the notification status must always be decreased */
+            prev = NULL;
+            for (dropped = queue->first; dropped && !dropped->ntf; dropped = dropped->next) {
+                prev = dropped;
+            }
+            if (!dropped) {
+                break;
+            }
+
+            if (prev) {
+                prev->next = dropped->next;
+            } else {
+                queue->first = dropped->next;
+            }
+            if (queue->last == dropped) {
+                queue->last = prev;
+            }
+            --queue->depth;
+            break;
+        case NP_NTF_OVERFLOW_SUSPEND:
+            if (nc_sub_id) {
+                /* the caller suspends the subscription */
+                rc = SR_ERR_OPERATION_FAILED;
+            }
+        /* fallthrough */
+        case NP_NTF_OVERFLOW_DROP_NEWEST:
+            dropped = item;
+            goto cleanup;
+        }
+    }
+
+    /* enqueue */
+    if (queue->last) {
+        queue->last->next = item;
+    } else {
+        queue->first = item;
+    }
+    queue->last = item;
+    ++queue->depth;
+
+    /* wake up a writer */
+    np_ntf_queue_ready(queue);
+
+cleanup:
+    /* QUEUE UNLOCK */
+    pthread_mutex_unlock(&queue->lock);
+
+    if (dropped) {
+        /* a suspended subscription counts the notification itself */
+        np_ntf_item_free(dropped, rc == SR_ERR_OK);
+    }
+    return rc;
+}
+
+void
+np_ntf_queue_notif_status_dec(struct nc_session *ncs)
+{
+    /* forced so that it is never dropped */
+    np_ntf_queue_push(ncs, 0, NULL, 1);
+}
+
+int
+np_ntf_queue_suspend(struct nc_session *ncs)
+{
+    struct np_ntf_queue *queue = np_ntf_queue_get(ncs);
+    int suspended = 0;
+
+    /* QUEUE LOCK */
+    pthread_mutex_lock(&queue->lock);
+
+    if (queue->depth > np2srv.ntf_queue_depth / 2) {
+        /* a writer resumes the subscriptions once the queue is emptied enough */
+        queue->suspended = 1;
+        suspended = 1;
+    }
+
+    /* QUEUE UNLOCK */
+    pthread_mutex_unlock(&queue->lock);
+
+    return suspended;
+}
+
+uint32_t
+np_ntf_queue_depth(struct nc_session *ncs)
+{
+    struct np_ntf_queue *queue = np_ntf_queue_get(ncs);
+    uint32_t depth;
+
+    /* QUEUE LOCK */
+    pthread_mutex_lock(&queue->lock);
+
+    depth = queue->depth;
+
+    /* QUEUE UNLOCK */
+    pthread_mutex_unlock(&queue->lock);
+
+    return depth;
+}
@@ -0,0 +1,168 @@
+/**
+ * @file notif_queue.h
+ * @author agent <agent@local>
+ * @brief netopeer2-server asynchronous notification send queues header
+ *
+ * @copyright
+ * Copyright (c) 2026 CESNET, z.s.p.o.
+ *
+ * This source code is licensed under BSD 3-Clause License (the "License").
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://opensource.org/licenses/BSD-3-Clause
+ */
+
+#ifndef NP2SRV_NOTIF_QUEUE_H_
+#define NP2SRV_NOTIF_QUEUE_H_
+
+#include <pthread.h>
+#include <stdint.h>
+#include <time.h>
+
+#include <libyang/libyang.h>
+#include <nc_server.h>
+
+#include "compat.h"
+
+/**
+ * @brief Policy applied when a notification is to be sent to a session with a full queue.
+ */
+enum np_ntf_overflow {
+    NP_NTF_OVERFLOW_BLOCK,          /**< wait until a notification is dequeued, like a synchronous send */
+    NP_NTF_OVERFLOW_DROP_OLDEST,    /**< drop the oldest queued notification */
+    NP_NTF_OVERFLOW_DROP_NEWEST,    /**< drop the new notification */
+    NP_NTF_OVERFLOW_SUSPEND         /**< drop the new notification and suspend its subscription, if any */
+};
+
+/**
+ * @brief Notification encoded for sending, referenced by every queue item and writer using it.
+ */
+struct np_ntf {
+    ATOMIC_T refs;                  /**< references, freed when there are none */
+    struct nc_server_notif *nc_ntf; /**< notification object referencing the members below */
+    struct lyd_node *ly_ntf;        /**< notification data */
+    char *datetime;                 /**< notification event time */
+};
+
+/**
+ * @brief Outbound notification queue of a NETCONF session.
+ */
+struct np_ntf_queue {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;            /**< signalled when a writer stops writing into the session, used with the writers lock */
+    pthread_cond_t space;           /**< signalled when a notification is dequeued or the queue closed */
+    struct nc_session *ncs;         /**< NETCONF session */
+
+    struct np_ntf_item {
+        struct np_ntf *ntf;             /**< notification to send, NULL to decrease the notification status */
+        uint32_t nc_sub_id;             /**< NC sub ID of the subscription, 0 if not a sub-ntf subscription */
+        struct np_ntf_item *next;
+    } *first, *last;                /**< queued notifications */
+    uint32_t depth;                 /**< number of queued notifications */
+
+    int suspended;                  /**< whether a subscription was suspended because the queue was full */
+    uint32_t blocked;               /**< number of threads waiting for space in the queue */
+
+    /* protected by the writers lock */
+    int ready;                      /**< whether waiting for a writer */
+    int busy;                       /**< whether a writer is sending a notification of this queue */
+    int closed;                     /**< whether no more notifications can be queued, set also with the queue lock */
+    struct np_ntf_queue *ready_next;    /**< next queue waiting for a writer */
+};
+
+/**
+ * @brief Create a new notification to send.
+ *
+ * @param[in] ly_ntf Top-level notification data, are always consumed.
+ * @param[in] timestamp Notification timestamp.
+ * @param[out] ntf Created notification with a single reference.
+ * @return Sysrepo error value.
+ */
+int np_ntf_new(struct lyd_node *ly_ntf, const struct timespec *timestamp, struct np_ntf **ntf);
+
+/**
+ * @brief Release a notification reference, free it if not referenced anymore.
+ *
+ * @param[in] ntf Notification to release, may be NULL.
+ */
+void np_ntf_unref(struct np_ntf *ntf);
+
+/**
+ * @brief Start the notification writer threads.
+ *
+ * @return 0 on success, -1 on error.
+ */
+int np_ntf_queue_init(void);
+
+/**
+ * @brief Stop the notification writer threads.
+ */
+void np_ntf_queue_destroy(void);
+
+/**
+ * @brief Initialize a session queue.
+ *
+ * @param[in] queue Queue to initialize.
+ * @param[in] ncs NETCONF session of the queue.
+ */
+void np_ntf_queue_session_init(struct np_ntf_queue *queue, struct nc_session *ncs);
+
+/**
+ * @brief Close a session queue, drop all the queued notifications and wait for a writer using the session.
+ *
+ * @param[in] queue Queue to close.
+ */
+void np_ntf_queue_session_close(struct np_ntf_queue *queue);
+
+/**
+ * @brief Free the resources of a closed session queue.
+ *
+ * @param[in] queue Queue to destroy.
+ */
+void np_ntf_queue_session_destroy(struct np_ntf_queue *queue);
+
+/**
+ * @brief Queue a notification to be sent to a session.
+ *
+ * If the queue is full and the overflow policy is ::NP_NTF_OVERFLOW_BLOCK, waits until there is space in it.
+ *
+ * @param[in] ncs NETCONF session to send to.
+ * @param[in] nc_sub_id NC sub ID of the subscription, 0 if not a sub-ntf subscription.
+ * @param[in] ntf Notification to send, its reference is always consumed. NULL only decreases the notification status.
+ * @param[in] force Whether to queue the notification even if the queue is full.
+ * @return SR_ERR_OK if the notification was queued or dropped based on the overflow policy.
+ * @return SR_ERR_OPERATION_FAILED if the notification was dropped and its subscription should be suspended
+ * using np_ntf_queue_suspend().
+ * @return Sysrepo error value on another error.
+ */
+int np_ntf_queue_push(struct nc_session *ncs, uint32_t nc_sub_id, struct np_ntf *ntf, int force);
+
+/**
+ * @brief Decrease the notification status of a session once all the notifications queued so far are sent.
+ *
+ * Must be used instead of nc_session_dec_notif_status() for a session with queued notifications.
+ *
+ * @param[in] ncs NETCONF session.
+ */
+void np_ntf_queue_notif_status_dec(struct nc_session *ncs);
+
+/**
+ * @brief Learn whether a subscription of a session with a full queue should be suspended.
+ *
+ * If so, once the queue is half-empty, sub_ntf_resume_session() is called by the writer.
+ *
+ * @param[in] ncs NETCONF session.
+ * @return Whether to suspend the subscription, otherwise the queue was emptied meanwhile.
+ */
+int np_ntf_queue_suspend(struct nc_session *ncs);
+
+/**
+ * @brief Get the number of notifications queued for a session.
+ *
+ * @param[in] ncs NETCONF session.
+ * @return Number of queued notifications.
+ */
+uint32_t np_ntf_queue_depth(struct nc_session *ncs);
+
+#endif /* NP2SRV_NOTIF_QUEUE_H_ */
@@ -85,6 +85,7 @@ np2srv_rpc_establish_sub_ntf_cb(sr_session_ctx_t *UNUSED(session), uint32_t sub_
 {
     struct sub_ntf_cb_arg *arg = private_data;
     struct lyd_node *ly_ntf = NULL;
+    struct np_ntf *ntf;
     struct np2srv_sub_ntf *sub;
     char buf[26];
 
@@ -113,7 +114,7 @@ np2srv_rpc_establish_sub_ntf_cb(sr_session_ctx_t *UNUSED(session), uint32_t sub_
         }
 
         /* UNLOCK */
-        sub_ntf_unlock(sub_id);
+        sub_ntf_unlock(sub, sub_id);
 
         /* finish, subscription-terminated notif was already sent */
         goto cleanup;
@@ -131,8 +132,18 @@ np2srv_rpc_establish_sub_ntf_cb(sr_session_ctx_t *UNUSED(session), uint32_t sub_
         notif = lyd_parent(notif);
     }
 
+    /* the notification is sent asynchronously so it must own its data, sysrepo frees the original */
+    if (!ly_ntf && lyd_dup_single(notif, NULL, LYD_DUP_RECURSIVE, &ly_ntf)) {
+        goto cleanup;
+    }
+    if (np_ntf_new(ly_ntf, timestamp, &ntf)) {
+        ly_ntf = NULL;
+        goto cleanup;
+    }
+    ly_ntf = NULL;
+
     /* send the notification */
-    sub_ntf_send_notif(arg->ncs, arg->nc_sub_id, *timestamp, (struct lyd_node **)&notif, 0);
+    sub_ntf_send_notif(arg->ncs, arg->nc_sub_id, ntf);
 
 cleanup:
     lyd_free_all(ly_ntf);
@@ -523,9 +534,9 @@ sub_ntf_rpc_modify_sub(sr_session_ctx_t *ev_sess, const struct lyd_node *rpc, st
         /* update the filter */
         for (i = 0; i < sub->sub_id_count; ++i) {
             /* "pass" the lock to the callback */
-            sub_ntf_cb_lock_pass(sub->sub_ids[i]);
+            sub_ntf_cb_lock_pass(sub, sub->sub_ids[i]);
             rc = sr_event_notif_sub_modify_xpath(np2srv.sr_notif_sub, sub->sub_ids[i], xp);
-            sub_ntf_cb_lock_clear(sub->sub_ids[i]);
+            sub_ntf_cb_lock_clear(sub, sub->sub_ids[i]);
             if (rc != SR_ERR_OK) {
                 goto cleanup;
             }
@@ -535,9 +546,9 @@ sub_ntf_rpc_modify_sub(sr_session_ctx_t *ev_sess, const struct lyd_node *rpc, st
         /* update stop time */
         for (i = 0; i < sub->sub_id_count; ++i) {
             /* "pass" the lock to the callback */
-            sub_ntf_cb_lock_pass(sub->sub_ids[i]);
+            sub_ntf_cb_lock_pass(sub, sub->sub_ids[i]);
             rc = sr_notif_sub_modify_stop_time(np2srv.sr_notif_sub, sub->sub_ids[i], stop.tv_sec ? &stop : NULL);
-            sub_ntf_cb_lock_clear(sub->sub_ids[i]);
+            sub_ntf_cb_lock_clear(sub, sub->sub_ids[i]);
             if (rc != SR_ERR_OK) {
                 goto cleanup;
             }
@@ -656,8 +667,9 @@ sub_ntf_config_filters(const struct lyd_node *filter, sr_change_oper_t op)
         sub = NULL;
         while ((sub = sub_ntf_find_next(sub, sub_ntf_stream_filter_match_cb, lyd_get_value(lyd_child(filter))))) {
             /* get NETCONF session */
-            if ((rc = np_get_nc_sess_by_id(0, sub->nc_id, &ncs))) {
-                return rc;
+            if ((r = np_get_nc_sess_by_id(0, sub->nc_id, &ncs))) {
+                rc = r;
+                continue;
             }
 
             /* terminate the subscription with the specific term reason */
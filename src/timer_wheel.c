@@ -0,0 +1,573 @@
+/**
+ * @file timer_wheel.c
+ * @author agent <agent@local>
+ * @brief netopeer2-server hierarchical timer wheel
+ *
+ * @copyright
+ * Copyright (c) 2026 CESNET, z.s.p.o.
+ *
+ * This source code is licensed under BSD 3-Clause License (the "License").
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://opensource.org/licenses/BSD-3-Clause
+ */
+
+#define _GNU_SOURCE
+
+#include "timer_wheel.h"
+
+#include <assert.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <sysrepo.h>
+
+#include "common.h"
+#include "config.h"
+#include "log.h"
+
+/* number of wheel levels, each level has slots for ticks of the lower level wrap */
+#define TW_LEVELS 4
+#define TW_SLOT_BITS 6
+#define TW_SLOTS (1 << TW_SLOT_BITS)
+#define TW_SLOT_MASK (TW_SLOTS - 1)
+
+/* number of ticks covered by a level */
+#define TW_LEVEL_RANGE(level) ((uint64_t)1 << (TW_SLOT_BITS * ((level) + 1)))
+
+struct np_timer {
+    np_timer_cb cb;
+    void *arg;
+
+    uint64_t expire;        /* tick of the next expiration */
+    uint32_t interval;      /* interval in ticks, 0 for a single expiration */
+    struct np_timer **slot; /* wheel slot the timer is in, NULL if not armed */
+    struct np_timer *prev;  /* wheel slot list */
+    struct np_timer *next;
+
+    int queued;             /* whether in the dispatch queue */
+    uint64_t fire_tick;     /* tick the queued expiration happened in */
+    struct np_timer *qnext; /* dispatch queue list */
+
+    int running;            /* whether the callback is being executed */
+    int deleted;            /* free once the callback returns */
+};
+
+static struct {
+    pthread_mutex_t lock;           /* lock for everything */
+    pthread_cond_t tick_cond;       /* wheel thread waiting for the next tick or an armed timer */
+    pthread_cond_t dispatch_cond;   /* dispatcher threads waiting for an expiration */
+    int stop;
+
+    struct timespec base;           /* time of tick 0 */
+    uint64_t tick;                  /* last processed tick */
+    struct np_timer *slots[TW_LEVELS][TW_SLOTS];
+    struct np_timer *queue_first;   /* expired timers to dispatch */
+    struct np_timer *queue_last;
+
+    pthread_t wheel_tid;
+    pthread_t dispatch_tids[NP2SRV_TIMER_THREAD_COUNT];
+    uint32_t thread_count;
+
+    /* statistics */
+    uint32_t armed;
+    uint64_t fired;
+    uint64_t lag_total;
+    uint32_t lag_max;
+} tw = {
+    .lock = PTHREAD_MUTEX_INITIALIZER
+};
+
+/**
+ * @brief Get the current tick.
+ *
+ * @return Current tick.
+ */
+static uint64_t
+tw_now_tick(void)
+{
+    struct timespec ts;
+
+    clock_gettime(NP_CLOCK_ID, &ts);
+    return np_difftimespec(&tw.base, &ts) / NP2SRV_TIMER_TICK;
+}
+
+/**
+ * @brief Add a timer into its wheel slot. Lock is expected to be held.
+ *
+ * @param[in] timer Timer to add, with its expiration set.
+ */
+static void
+tw_slot_add(struct np_timer *timer)
+{
+    struct np_timer **slot;
+    uint64_t index_tick;
+    uint32_t level;
+
+    assert(!timer->slot);
+
+    if (timer->expire <= tw.tick) {
+        /* already due, expire on the next processed tick */
+        timer->expire = tw.tick + 1;
+    }
+
+    /* find the level */
+    for (level = 0; level < TW_LEVELS - 1; ++level) {
+        if (timer->expire - tw.tick < TW_LEVEL_RANGE(level)) {
+            break;
+        }
+    }
+
+    index_tick = timer->expire;
+    if (index_tick - tw.tick >= TW_LEVEL_RANGE(TW_LEVELS - 1)) {
+        /* too far in the future, will be added again once the last slot is reached */
+        index_tick = tw.tick + TW_LEVEL_RANGE(TW_LEVELS - 1) - 1;
+    }
+
+    slot = &tw.slots[level][(index_tick >> (TW_SLOT_BITS * level)) & TW_SLOT_MASK];
+    timer->prev = NULL;
+    timer->next = *slot;
+    if (*slot) {
+        (*slot)->prev = timer;
+    }
+    *slot = timer;
+
+    timer->slot = slot;
+    ++tw.armed;
+}
+
+/**
+ * @brief Remove a timer from its wheel slot. Lock is expected to be held.
+ *
+ * @param[in] timer Armed timer to remove.
+ */
+static void
+tw_slot_del(struct np_timer *timer)
+{
+    if (timer->prev) {
+        timer->prev->next = timer->next;
+    } else {
+        *timer->slot = timer->next;
+    }
+    if (timer->next) {
+        timer->next->prev = timer->prev;
+    }
+    timer->prev = NULL;
+    timer->next = NULL;
+
+    timer->slot = NULL;
+    --tw.armed;
+}
+
+/**
+ * @brief Disarm a timer and cancel its pending expiration. Lock is expected to be held.
+ *
+ * @param[in] timer Timer to disarm.
+ */
+static void
+tw_timer_disarm(struct np_timer *timer)
+{
+    struct np_timer *iter, *prev;
+
+    if (timer->slot) {
+        tw_slot_del(timer);
+    }
+
+    if (timer->queued) {
+        prev = NULL;
+        for (iter = tw.queue_first; iter != timer; iter = iter->qnext) {
+            prev = iter;
+        }
+        if (prev) {
+            prev->qnext = timer->qnext;
+        } else {
+            tw.queue_first = timer->qnext;
+        }
+        if (tw.queue_last == timer) {
+            tw.queue_last = prev;
+        }
+        timer->qnext = NULL;
+        timer->queued = 0;
+    }
+}
+
+/**
+ * @brief Timer expired, queue it for dispatching and schedule its next expiration. Lock is expected to be held.
+ *
+ * @param[in] timer Expired timer, not in any slot.
+ */
+static void
+tw_timer_expire(struct np_timer *timer)
+{
+    if (!timer->running && !timer->queued) {
+        /* queue it */
+        timer->fire_tick = tw.tick;
+        timer->qnext = NULL;
+        if (tw.queue_last) {
+            tw.queue_last->qnext = timer;
+        } else {
+            tw.queue_first = timer;
+        }
+        tw.queue_last = timer;
+        timer->queued = 1;
+
+        pthread_cond_signal(&tw.dispatch_cond);
+    } /* else the previous expiration was not handled yet, skip this one */
+
+    if (timer->interval) {
+        /* next expiration, skip any missed */
+        do {
+            timer->expire += timer->interval;
+        } while (timer->expire <= tw.tick);
+        tw_slot_add(timer);
+    }
+}
+
+/**
+ * @brief Process a single tick. Lock is expected to be held.
+ *
+ * @param[in] tick Tick to process, following the last processed one.
+ */
+static void
+tw_tick_process(uint64_t tick)
+{
+    struct np_timer *timer, *next;
+    uint32_t level, max_level;
+
+    assert(tick == tw.tick + 1);
+    tw.tick = tick;
+
+    /* learn which higher levels wrapped */
+    for (max_level = 0; (max_level < TW_LEVELS - 1) && !(tick & (TW_LEVEL_RANGE(max_level) - 1)); ++max_level) {}
+
+    /* cascade the timers of the current slots of these levels down */
+    for (level = max_level; level > 0; --level) {
+        timer = tw.slots[level][(tick >> (TW_SLOT_BITS * level)) & TW_SLOT_MASK];
+        tw.slots[level][(tick >> (TW_SLOT_BITS * level)) & TW_SLOT_MASK] = NULL;
+        for ( ; timer; timer = next) {
+            next = timer->next;
+            timer->slot = NULL;
+            --tw.armed;
+            timer->prev = NULL;
+            timer->next = NULL;
+            if (timer->expire <= tick) {
+                tw_timer_expire(timer);
+            } else {
+                tw_slot_add(timer);
+            }
+        }
+    }
+
+    /* expire the timers of the current slot */
+    timer = tw.slots[0][tick & TW_SLOT_MASK];
+    tw.slots[0][tick & TW_SLOT_MASK] = NULL;
+    for ( ; timer; timer = next) {
+        next = timer->next;
+        timer->slot = NULL;
+        --tw.armed;
+        timer->prev = NULL;
+        timer->next = NULL;
+        if (timer->expire <= tick) {
+            tw_timer_expire(timer);
+        } else {
+            tw_slot_add(timer);
+        }
+    }
+}
+
+/**
+ * @brief Wheel thread, processes ticks.
+ *
+ * @param[in] arg Unused.
+ * @return NULL.
+ */
+static void *
+tw_wheel_thread(void *UNUSED(arg))
+{
+    struct timespec ts;
+    uint64_t now_tick;
+
+    /* LOCK */
+    pthread_mutex_lock(&tw.lock);
+
+    while (!tw.stop) {
+        /* process all the elapsed ticks */
+        now_tick = tw_now_tick();
+        if (!tw.armed) {
+            tw.tick = now_tick;
+        }
+        while (tw.tick < now_tick) {
+            tw_tick_process(tw.tick + 1);
+        }
+
+        if (!tw.armed) {
+            /* wait for an armed timer */
+            pthread_cond_wait(&tw.tick_cond, &tw.lock);
+        } else {
+            /* wait for the next tick */
+            clock_gettime(NP_CLOCK_ID, &ts);
+            np_addtimespec(&ts, NP2SRV_TIMER_TICK - np_difftimespec(&tw.base, &ts) % NP2SRV_TIMER_TICK);
+            pthread_cond_timedwait(&tw.tick_cond, &tw.lock, &ts);
+        }
+    }
+
+    /* UNLOCK */
+    pthread_mutex_unlock(&tw.lock);
+
+    return NULL;
+}
+
+/**
+ * @brief Dispatcher thread, executes the callbacks of expired timers.
+ *
+ * @param[in] arg Unused.
+ * @return NULL.
+ */
+static void *
+tw_dispatch_thread(void *UNUSED(arg))
+{
+    struct np_timer *timer;
+    uint64_t lag;
+
+    /* LOCK */
+    pthread_mutex_lock(&tw.lock);
+
+    while (1) {
+        while (!tw.stop && !tw.queue_first) {
+            pthread_cond_wait(&tw.dispatch_cond, &tw.lock);
+        }
+        if (tw.stop) {
+            break;
+        }
+
+        /* dequeue */
+        timer = tw.queue_first;
+        tw.queue_first = timer->qnext;
+        if (!tw.queue_first) {
+            tw.queue_last = NULL;
+        }
+        timer->qnext = NULL;
+        timer->queued = 0;
+
+        /* statistics */
+        lag = (tw_now_tick() - timer->fire_tick) * NP2SRV_TIMER_TICK;
+        ++tw.fired;
+        tw.lag_total += lag;
+        if (lag > tw.lag_max) {
+            tw.lag_max = lag;
+        }
+
+        timer->running = 1;
+
+        /* UNLOCK */
+        pthread_mutex_unlock(&tw.lock);
+
+        timer->cb(timer->arg);
+
+        /* LOCK */
+        pthread_mutex_lock(&tw.lock);
+
+        timer->running = 0;
+        if (timer->deleted) {
+            /* deleted while running */
+            free(timer);
+        }
+    }
+
+    /* UNLOCK */
+    pthread_mutex_unlock(&tw.lock);
+
+    return NULL;
+}
+
+int
+np_timer_wheel_init(void)
+{
+    pthread_condattr_t attr;
+    int r;
+
+    /* conditions use the wheel clock */
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, NP_CLOCK_ID);
+    pthread_cond_init(&tw.tick_cond, &attr);
+    pthread_condattr_destroy(&attr);
+    pthread_cond_init(&tw.dispatch_cond, NULL);
+
+    clock_gettime(NP_CLOCK_ID, &tw.base);
+    tw.tick = 0;
+    tw.stop = 0;
+
+    /* start the threads */
+    if ((r = pthread_create(&tw.wheel_tid, NULL, tw_wheel_thread, NULL))) {
+        ERR("Creating timer wheel thread failed (%s).", strerror(r));
+        return -1;
+    }
+    for (tw.thread_count = 0; tw.thread_count < NP2SRV_TIMER_THREAD_COUNT; ++tw.thread_count) {
+        if ((r = pthread_create(&tw.dispatch_tids[tw.thread_count], NULL, tw_dispatch_thread, NULL))) {
+            ERR("Creating timer dispatcher thread failed (%s).", strerror(r));
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+void
+np_timer_wheel_destroy(void)
+{
+    struct np_timer *timer, *next;
+    uint32_t level, i;
+
+    /* LOCK */
+    pthread_mutex_lock(&tw.lock);
+
+    tw.stop = 1;
+    pthread_cond_signal(&tw.tick_cond);
+    pthread_cond_broadcast(&tw.dispatch_cond);
+
+    /* UNLOCK */
+    pthread_mutex_unlock(&tw.lock);
+
+    /* wait for the threads */
+    if (tw.wheel_tid) {
+        pthread_join(tw.wheel_tid, NULL);
+    }
+    for (i = 0; i < tw.thread_count; ++i) {
+        pthread_join(tw.dispatch_tids[i], NULL);
+    }
+    tw.thread_count = 0;
+
+    /* disarm any timers left, they are still owned and deleted by their users */
+    for (level = 0; level < TW_LEVELS; ++level) {
+        for (i = 0; i < TW_SLOTS; ++i) {
+            for (timer = tw.slots[level][i]; timer; timer = next) {
+                next = timer->next;
+                timer->prev = NULL;
+                timer->next = NULL;
+                timer->slot = NULL;
+            }
+            tw.slots[level][i] = NULL;
+        }
+    }
+    for (timer = tw.queue_first; timer; timer = next) {
+        next = timer->qnext;
+        timer->qnext = NULL;
+        timer->queued = 0;
+    }
+    tw.queue_first = NULL;
+    tw.queue_last = NULL;
+    tw.armed = 0;
+
+    pthread_cond_destroy(&tw.tick_cond);
+    pthread_cond_destroy(&tw.dispatch_cond);
+}
+
+int
+np_timer_create(np_timer_cb cb, void *arg, struct np_timer **timer)
+{
+    *timer = calloc(1, sizeof **timer);
+    if (!*timer) {
+        EMEM;
+        return SR_ERR_NO_MEMORY;
+    }
+
+    (*timer)->cb = cb;
+    (*timer)->arg = arg;
+    return SR_ERR_OK;
+}
+
+void
+np_timer_set(struct np_timer *timer, const struct timespec *expire, uint32_t interval_ms)
+{
+    struct timespec cur_time;
+    int64_t expire_ms;
+    uint64_t now_tick;
+
+    /* LOCK */
+    pthread_mutex_lock(&tw.lock);
+
+    /* disarm */
+    tw_timer_disarm(timer);
+
+    if (expire->tv_sec || expire->tv_nsec) {
+        now_tick = tw_now_tick();
+        if (!tw.armed) {
+            /* wheel is empty, no need to process the elapsed ticks */
+            tw.tick = now_tick;
+        }
+
+        /* learn the expiration tick, rounded up */
+        cur_time = np_gettimespec(1);
+        expire_ms = np_difftimespec(&cur_time, expire);
+        if (expire_ms < 0) {
+            expire_ms = 0;
+        }
+        timer->expire = now_tick + (expire_ms + NP2SRV_TIMER_TICK - 1) / NP2SRV_TIMER_TICK;
+        timer->interval = interval_ms ? (interval_ms + NP2SRV_TIMER_TICK - 1) / NP2SRV_TIMER_TICK : 0;
+
+        /* arm */
+        tw_slot_add(timer);
+        pthread_cond_signal(&tw.tick_cond);
+    }
+
+    /* UNLOCK */
+    pthread_mutex_unlock(&tw.lock);
+}
+
+int
+np_timer_is_armed(struct np_timer *timer)
+{
+    int armed;
+
+    /* LOCK */
+    pthread_mutex_lock(&tw.lock);
+
+    armed = timer->slot || timer->queued;
+
+    /* UNLOCK */
+    pthread_mutex_unlock(&tw.lock);
+
+    return armed;
+}
+
+void
+np_timer_delete(struct np_timer *timer)
+{
+    if (!timer) {
+        return;
+    }
+
+    /* LOCK */
+    pthread_mutex_lock(&tw.lock);
+
+    tw_timer_disarm(timer);
+    if (timer->running) {
+        /* freed by the dispatcher thread once the callback returns */
+        timer->deleted = 1;
+        timer = NULL;
+    }
+
+    /* UNLOCK */
+    pthread_mutex_unlock(&tw.lock);
+
+    free(timer);
+}
+
+void
+np_timer_wheel_stats(uint32_t *armed, uint64_t *fired, uint32_t *lag_avg, uint32_t *lag_max)
+{
+    /* LOCK */
+    pthread_mutex_lock(&tw.lock);
+
+    *armed = tw.armed;
+    *fired = tw.fired;
+    *lag_avg = tw.fired ? tw.lag_total / tw.fired : 0;
+    *lag_max = tw.lag_max;
+
+    /* UNLOCK */
+    pthread_mutex_unlock(&tw.lock);
+}
@@ -0,0 +1,92 @@
+/**
+ * @file timer_wheel.h
+ * @author agent <agent@local>
+ * @brief netopeer2-server hierarchical timer wheel header
+ *
+ * @copyright
+ * Copyright (c) 2026 CESNET, z.s.p.o.
+ *
+ * This source code is licensed under BSD 3-Clause License (the "License").
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://opensource.org/licenses/BSD-3-Clause
+ */
+
+#ifndef NP2SRV_TIMER_WHEEL_H_
+#define NP2SRV_TIMER_WHEEL_H_
+
+#include <stdint.h>
+#include <time.h>
+
+/**
+ * @brief Timer driven by the timer wheel.
+ */
+struct np_timer;
+
+/**
+ * @brief Timer callback, called by one of the dispatcher threads.
+ *
+ * @param[in] arg Timer argument.
+ */
+typedef void (*np_timer_cb)(void *arg);
+
+/**
+ * @brief Start the timer wheel and its dispatcher threads.
+ *
+ * @return 0 on success, -1 on error.
+ */
+int np_timer_wheel_init(void);
+
+/**
+ * @brief Stop the timer wheel and its dispatcher threads, waiting for any callbacks being executed.
+ * All the timers are disarmed but must still be deleted.
+ */
+void np_timer_wheel_destroy(void);
+
+/**
+ * @brief Create a new disarmed timer.
+ *
+ * @param[in] cb Timer callback.
+ * @param[in] arg Argument for @p cb.
+ * @param[out] timer Created timer.
+ * @return Sysrepo error value.
+ */
+int np_timer_create(np_timer_cb cb, void *arg, struct np_timer **timer);
+
+/**
+ * @brief Arm or disarm a timer, disarming also cancels any expiration not yet dispatched.
+ *
+ * @param[in] timer Timer to set.
+ * @param[in] expire Absolute realtime of the (first) expiration, zero time to disarm the timer.
+ * @param[in] interval_ms Interval of the following expirations, 0 for a single expiration.
+ */
+void np_timer_set(struct np_timer *timer, const struct timespec *expire, uint32_t interval_ms);
+
+/**
+ * @brief Learn whether a timer is armed and waiting for its expiration.
+ *
+ * @param[in] timer Timer to examine.
+ * @return Whether the timer is armed.
+ */
+int np_timer_is_armed(struct np_timer *timer);
+
+/**
+ * @brief Disarm and free a timer. It may be called from its own callback, a callback being executed in another thread
+ * is not waited for.
+ *
+ * @param[in] timer Timer to delete, may be NULL.
+ */
+void np_timer_delete(struct np_timer *timer);
+
+/**
+ * @brief Get timer wheel statistics.
+ *
+ * @param[out] armed Number of armed timers.
+ * @param[out] fired Number of dispatched timer expirations.
+ * @param[out] lag_avg Average delay of a callback after its expiration (ms).
+ * @param[out] lag_max Maximum delay of a callback after its expiration (ms).
+ */
+void np_timer_wheel_stats(uint32_t *armed, uint64_t *fired, uint32_t *lag_avg, uint32_t *lag_max);
+
+#endif /* NP2SRV_TIMER_WHEEL_H_ */
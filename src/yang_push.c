@@ -19,7 +19,7 @@
 #include "yang_push.h"
 
 #include <assert.h>
-#include <signal.h>
+#include <pthread.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
@@ -34,6 +34,63 @@
 #include "netconf_acm.h"
 #include "netconf_subscribed_notifications.h"
 
+/**
+ * @brief Sysrepo on-change subscriptions shared by all the yang-push subscriptions with the same datastore and filter.
+ */
+struct yang_push_shared {
+    sr_datastore_t datastore;
+    char *xpath;
+    sr_session_ctx_t *sess; /* server session of the sysrepo subscriptions, not bound to any NETCONF session */
+    uint32_t *sub_ids;
+    uint32_t sub_id_count;
+
+    pthread_mutex_t lock;   /* lock for the subscribers */
+    struct yang_push_data **subscribers;
+    uint32_t subscriber_count;
+
+    struct yang_push_shared *next;
+};
+
+/* all the shared sysrepo on-change subscriptions */
+static struct {
+    struct yang_push_shared *first;
+    pthread_mutex_t lock;
+} yp_shared = {
+    .lock = PTHREAD_MUTEX_INITIALIZER
+};
+
+/**
+ * @brief Data snapshot shared by all the periodic yang-push subscriptions with the same datastore, filter,
+ * period, and anchor, retrieved only once in every period.
+ */
+struct yang_push_snapshot {
+    sr_datastore_t datastore;
+    char *xpath;
+    uint32_t period_ms;
+    struct timespec tick_anchor;
+
+    pthread_mutex_t lock;   /* lock for the data */
+    int valid;              /* whether the data were retrieved in tick */
+    int64_t tick;           /* period the data were retrieved in */
+    struct lyd_node *data;  /* retrieved data */
+    struct yang_push_snapshot_user {
+        char *username;
+        struct lyd_node *data;  /* data filtered by NACM for the user */
+    } *users;
+    uint32_t user_count;
+
+    uint32_t subscriber_count;
+    struct yang_push_snapshot *next;
+};
+
+/* all the shared periodic data snapshots */
+static struct {
+    struct yang_push_snapshot *first;
+    pthread_mutex_t lock;
+} yp_snapshots = {
+    .lock = PTHREAD_MUTEX_INITIALIZER
+};
+
 /**
  * @brief Transform yang-push operation into string.
  *
@@ -166,25 +223,186 @@ yang_push_op_sr2yp(sr_change_oper_t op, const struct lyd_node *node)
     return 0;
 }
 
+/**
+ * @brief Hash an edit target (Jenkins one-at-a-time hash).
+ *
+ * @param[in] target Edit target.
+ * @return Target hash.
+ */
+static uint32_t
+yang_push_edit_hash(const char *target)
+{
+    uint32_t hash = 0;
+
+    for ( ; *target; ++target) {
+        hash += *target;
+        hash += (hash << 10);
+        hash ^= (hash >> 6);
+    }
+    hash += (hash << 3);
+    hash ^= (hash >> 11);
+    hash += (hash << 15);
+
+    return hash;
+}
+
+/**
+ * @brief Learn whether an edit item is used.
+ *
+ * @param[in] edits Indexed edits.
+ * @param[in] i Index of the item.
+ * @return Whether the item is used.
+ */
+static int
+yang_push_edits_used(const struct yang_push_edits *edits, uint32_t i)
+{
+    return edits->edits[i].edit && (edits->edits[i].gen == edits->gen);
+}
+
+/**
+ * @brief Find the edit of a target.
+ *
+ * @param[in] edits Indexed edits.
+ * @param[in] target Edit target.
+ * @param[in] hash Hash of @p target.
+ * @return Found edit item.
+ * @return NULL if there is no edit of the target.
+ */
+static struct yang_push_edit *
+yang_push_edits_find(const struct yang_push_edits *edits, const char *target, uint32_t hash)
+{
+    uint32_t i;
+
+    if (!edits->count) {
+        return NULL;
+    }
+
+    for (i = hash & (edits->size - 1); yang_push_edits_used(edits, i); i = (i + 1) & (edits->size - 1)) {
+        if ((edits->edits[i].hash == hash) && !strcmp(edits->edits[i].target, target)) {
+            return &edits->edits[i];
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Index a new edit, there must be no edit of its target.
+ *
+ * @param[in] edits Indexed edits.
+ * @param[in] edit Edit to add.
+ * @param[in] target Target of @p edit, owned by it.
+ * @param[in] hash Hash of @p target.
+ * @return Sysrepo error value.
+ */
+static int
+yang_push_edits_insert(struct yang_push_edits *edits, struct lyd_node *edit, const char *target, uint32_t hash)
+{
+    struct yang_push_edit *old_edits;
+    uint32_t i, old_size;
+
+    if ((edits->count + 1) * 4 > edits->size * 3) {
+        /* enlarge and rehash */
+        old_edits = edits->edits;
+        old_size = edits->size;
+
+        edits->size = old_size ? old_size * 2 : 64;
+        edits->edits = calloc(edits->size, sizeof *edits->edits);
+        if (!edits->edits) {
+            edits->edits = old_edits;
+            edits->size = old_size;
+            EMEM;
+            return SR_ERR_NO_MEMORY;
+        }
+        edits->count = 0;
+
+        for (i = 0; i < old_size; ++i) {
+            if (old_edits[i].edit && (old_edits[i].gen == edits->gen)) {
+                yang_push_edits_insert(edits, old_edits[i].edit, old_edits[i].target, old_edits[i].hash);
+            }
+        }
+        free(old_edits);
+    }
+
+    for (i = hash & (edits->size - 1); yang_push_edits_used(edits, i); i = (i + 1) & (edits->size - 1)) {}
+    edits->edits[i].edit = edit;
+    edits->edits[i].target = target;
+    edits->edits[i].hash = hash;
+    edits->edits[i].gen = edits->gen;
+    ++edits->count;
+
+    return SR_ERR_OK;
+}
+
+/**
+ * @brief Replace any previous edit of a target by a new edit or index the new edit.
+ *
+ * @param[in] edits Indexed edits.
+ * @param[in] prev Previous edit item of the target, if any.
+ * @param[in] edit New edit, already in the YANG patch.
+ * @param[in] target Target of @p edit, owned by it.
+ * @param[in] hash Hash of @p target.
+ * @return Sysrepo error value.
+ */
+static int
+yang_push_edits_set(struct yang_push_edits *edits, struct yang_push_edit *prev, struct lyd_node *edit,
+        const char *target, uint32_t hash)
+{
+    struct lyd_node *prev_edit;
+
+    if (!prev) {
+        return yang_push_edits_insert(edits, edit, target, hash);
+    }
+
+    /* remove the previous change of this target */
+    prev_edit = prev->edit;
+    prev->edit = edit;
+    prev->target = target;
+    lyd_free_tree(prev_edit);
+
+    return SR_ERR_OK;
+}
+
+/**
+ * @brief Forget all the indexed edits, when their YANG patch is freed.
+ *
+ * @param[in] edits Indexed edits.
+ */
+static void
+yang_push_edits_clear(struct yang_push_edits *edits)
+{
+    if (!edits->count) {
+        return;
+    }
+
+    /* all the items are freed by starting a new generation */
+    if (!++edits->gen) {
+        /* wrapped, items of an old generation could be considered used */
+        memset(edits->edits, 0, edits->size * sizeof *edits->edits);
+    }
+    edits->count = 0;
+}
+
 /**
  * @brief Append a new edit (change) to a YANG patch.
  *
  * @param[in] ly_yp YANG patch node to append to.
+ * @param[in] edits Indexed edits of @p ly_yp.
  * @param[in] yp_op yang-push operation.
  * @param[in] node Changed node.
  * @param[in] prev_value Previous leaf-list value, if any.
  * @param[in] prev_list Previous list value, if any.
- * @param[in] yp_data yang-push data.
+ * @param[in] edit_id Edit ID of the new edit.
  * @return Sysrepo error value.
  */
 static int
-yang_push_notif_change_edit_append(struct lyd_node *ly_yp, enum yang_push_op yp_op, const struct lyd_node *node,
-        const char *prev_value, const char *prev_list, struct yang_push_data *yp_data)
+yang_push_notif_change_edit_append(struct lyd_node *ly_yp, struct yang_push_edits *edits, enum yang_push_op yp_op,
+        const struct lyd_node *node, const char *prev_value, const char *prev_list, uint32_t edit_id)
 {
     struct lyd_node *ly_edit, *ly_target, *value_tree;
-    struct ly_set *set = NULL;
-    char buf[26], *path = NULL, *point = NULL, *xpath = NULL;
-    uint32_t edit_id;
+    struct yang_push_edit *prev;
+    char buf[26], *path = NULL, *point = NULL;
+    uint32_t hash;
     int rc = SR_ERR_OK;
 
     /* get the edit target path */
@@ -194,22 +412,9 @@ yang_push_notif_change_edit_append(struct lyd_node *ly_yp, enum yang_push_op yp_
         goto cleanup;
     }
 
-    /* remove any previous change of this target */
-    if (asprintf(&xpath, "/ietf-yang-push:push-change-update/datastore-changes/yang-patch/edit[target='%s']", path) == -1) {
-        rc = SR_ERR_NO_MEMORY;
-        goto cleanup;
-    }
-    if (lyd_find_xpath(ly_yp, xpath, &set)) {
-        rc = SR_ERR_LY;
-        goto cleanup;
-    }
-    assert((set->count == 0) || (set->count == 1));
-    if (set->count) {
-        lyd_free_tree(set->dnodes[0]);
-    }
-
-    /* generate new edit ID */
-    edit_id = ATOMIC_INC_RELAXED(yp_data->edit_id);
+    /* find any previous change of this target */
+    hash = yang_push_edit_hash(path);
+    prev = yang_push_edits_find(edits, path, hash);
 
     /* edit with edit-id */
     sprintf(buf, "edit-%" PRIu32, edit_id);
@@ -233,6 +438,11 @@ yang_push_notif_change_edit_append(struct lyd_node *ly_yp, enum yang_push_op yp_
     /* remember the node schema */
     ly_target->priv = (void *)node->schema;
 
+    /* replace the previous change of this target */
+    if ((rc = yang_push_edits_set(edits, prev, ly_edit, lyd_get_value(ly_target), hash))) {
+        goto cleanup;
+    }
+
     if ((yp_op == YP_OP_INSERT) || (yp_op == YP_OP_MOVE)) {
         /* point */
         if (node->schema->nodetype == LYS_LEAFLIST) {
@@ -286,8 +496,6 @@ yang_push_notif_change_edit_append(struct lyd_node *ly_yp, enum yang_push_op yp_
     }
 
 cleanup:
-    ly_set_free(set, NULL);
-    free(xpath);
     free(path);
     free(point);
     return rc;
@@ -305,6 +513,8 @@ static int
 yang_push_notif_change_send(struct nc_session *ncs, struct yang_push_data *yp_data, uint32_t nc_sub_id)
 {
     struct ly_set *set = NULL;
+    struct np_ntf *ntf;
+    struct timespec ts;
     int all_removed = 0;
     int rc = SR_ERR_OK;
 
@@ -324,7 +534,12 @@ yang_push_notif_change_send(struct nc_session *ncs, struct yang_push_data *yp_da
     }
 
     /* send the notification */
-    rc = sub_ntf_send_notif(ncs, nc_sub_id, np_gettimespec(1), &yp_data->ly_change_ntf, 1);
+    ts = np_gettimespec(1);
+    rc = np_ntf_new(yp_data->ly_change_ntf, &ts, &ntf);
+    yp_data->ly_change_ntf = NULL;
+    if (rc == SR_ERR_OK) {
+        rc = sub_ntf_send_notif(ncs, nc_sub_id, ntf);
+    }
 
     if (rc == SR_ERR_OK) {
         /* set last_notif timestamp */
@@ -335,6 +550,7 @@ cleanup:
     ly_set_free(set, NULL);
     lyd_free_tree(yp_data->ly_change_ntf);
     yp_data->ly_change_ntf = NULL;
+    yang_push_edits_clear(&yp_data->change_edits);
     return rc;
 }
 
@@ -342,12 +558,14 @@ cleanup:
  * @brief Timer callback for dampened on-change yang-push changes.
  */
 static void
-yang_push_damp_timer_cb(union sigval sval)
+yang_push_damp_timer_cb(void *cb_arg)
 {
-    struct yang_push_cb_arg *arg = sval.sival_ptr;
+    struct yang_push_cb_arg *arg = cb_arg;
+    struct np2srv_sub_ntf *sub;
 
     /* READ LOCK */
-    if (!sub_ntf_find_lock(arg->nc_sub_id, 0, 0)) {
+    sub = sub_ntf_find_lock(arg->nc_sub_id, 0, 0);
+    if (!sub) {
         return;
     }
 
@@ -361,7 +579,7 @@ yang_push_damp_timer_cb(union sigval sval)
     pthread_mutex_unlock(&arg->yp_data->notif_lock);
 
     /* UNLOCK */
-    sub_ntf_unlock(0);
+    sub_ntf_unlock(sub, 0);
 }
 
 /**
@@ -376,7 +594,6 @@ yang_push_notif_change_ready(struct yang_push_data *yp_data, int *ready)
 {
     struct timespec next_notif, cur_time;
     int32_t next_notif_in;
-    struct itimerspec trspec;
 
     if (!yp_data->dampening_period_ms) {
         /* always ready */
@@ -385,10 +602,7 @@ yang_push_notif_change_ready(struct yang_push_data *yp_data, int *ready)
     }
 
     /* check current timer */
-    if (timer_gettime(yp_data->damp_timer, &trspec) == -1) {
-        return SR_ERR_SYS;
-    }
-    if (trspec.it_value.tv_sec || trspec.it_value.tv_nsec) {
+    if (np_timer_is_armed(yp_data->damp_timer)) {
         /* timer is already set */
         *ready = 0;
         return SR_ERR_OK;
@@ -407,34 +621,137 @@ yang_push_notif_change_ready(struct yang_push_data *yp_data, int *ready)
     }
 
     /* schedule the notification */
-    trspec.it_value = next_notif;
-    if (timer_settime(yp_data->damp_timer, TIMER_ABSTIME, &trspec, NULL) == -1) {
-        return SR_ERR_SYS;
-    }
+    np_timer_set(yp_data->damp_timer, &next_notif, 0);
 
     *ready = 0;
     return SR_ERR_OK;
 }
 
+/**
+ * @brief Create a new pending on-change push-change-update notification.
+ *
+ * @param[in] yp_data yang-push data to create the notification in.
+ * @param[in] nc_sub_id NC sub ID of the subscription.
+ * @return Sysrepo error value.
+ */
+static int
+yang_push_notif_change_new(struct yang_push_data *yp_data, uint32_t nc_sub_id)
+{
+    char buf[26];
+    uint32_t patch_id;
+
+    assert(!yp_data->ly_change_ntf);
+
+    /* create basic structure for push-change-update notification */
+    sprintf(buf, "%" PRIu32, nc_sub_id);
+    if (lyd_new_path(NULL, sr_get_context(np2srv.sr_conn), "/ietf-yang-push:push-change-update/id", buf, 0,
+            &yp_data->ly_change_ntf)) {
+        return SR_ERR_LY;
+    }
+
+    /* generate a new patch-id */
+    patch_id = ATOMIC_INC_RELAXED(yp_data->patch_id);
+    sprintf(buf, "patch-%" PRIu32, patch_id);
+    if (lyd_new_path(yp_data->ly_change_ntf, NULL, "datastore-changes/yang-patch/patch-id", buf, 0, NULL)) {
+        lyd_free_tree(yp_data->ly_change_ntf);
+        yp_data->ly_change_ntf = NULL;
+        return SR_ERR_LY;
+    }
+
+    /* initialize edit-id */
+    ATOMIC_STORE_RELAXED(yp_data->edit_id, 1);
+
+    return SR_ERR_OK;
+}
+
+/**
+ * @brief Merge edits of a shared YANG patch into the pending notification of a subscription.
+ *
+ * @param[in] yp_data yang-push data of the subscription.
+ * @param[in] nc_sub_id NC sub ID of the subscription.
+ * @param[in] ly_patch Shared push-change-update with the YANG patch of all the changes.
+ * @return Sysrepo error value.
+ */
+static int
+yang_push_notif_change_merge(struct yang_push_data *yp_data, uint32_t nc_sub_id, const struct lyd_node *ly_patch)
+{
+    const struct lyd_node *edit, *child;
+    struct lyd_node *node, *ly_yp, *ly_edit, *ly_target = NULL, *dup;
+    struct yang_push_edit *prev;
+    enum yang_push_op yp_op;
+    char buf[26];
+    uint32_t edit_id, hash;
+    int rc;
+
+    LY_LIST_FOR(lyd_child(lyd_child(lyd_child(ly_patch))), edit) {
+        /* learn yang-push operation */
+        lyd_find_path(edit, "operation", 0, &node);
+        yp_op = yang_push_str2op(lyd_get_value(node));
+        if (yp_data->excluded_change[yp_op]) {
+            /* excluded */
+            ATOMIC_INC_RELAXED(yp_data->excluded_op_count);
+            continue;
+        }
+
+        /* there is a change */
+        if (!yp_data->ly_change_ntf && (rc = yang_push_notif_change_new(yp_data, nc_sub_id))) {
+            return rc;
+        }
+        ly_yp = lyd_child(lyd_child(yp_data->ly_change_ntf)->next);
+
+        /* find any previous change of this target */
+        lyd_find_path(edit, "target", 0, &node);
+        hash = yang_push_edit_hash(lyd_get_value(node));
+        prev = yang_push_edits_find(&yp_data->change_edits, lyd_get_value(node), hash);
+
+        /* edit with a new edit-id */
+        edit_id = ATOMIC_INC_RELAXED(yp_data->edit_id);
+        sprintf(buf, "edit-%" PRIu32, edit_id);
+        if (lyd_new_list(ly_yp, NULL, "edit", 0, &ly_edit, buf)) {
+            return SR_ERR_LY;
+        }
+
+        /* copy the rest of the edit, with the remembered target node schema */
+        LY_LIST_FOR(lyd_child(edit)->next, child) {
+            if (lyd_dup_single(child, (struct lyd_node_inner *)ly_edit, LYD_DUP_RECURSIVE, &dup)) {
+                return SR_ERR_LY;
+            }
+            dup->priv = child->priv;
+            if (child == node) {
+                ly_target = dup;
+            }
+        }
+
+        /* replace the previous change of this target */
+        if ((rc = yang_push_edits_set(&yp_data->change_edits, prev, ly_edit, lyd_get_value(ly_target), hash))) {
+            return rc;
+        }
+    }
+
+    return SR_ERR_OK;
+}
+
 /**
  * @brief Module change callback for yang-push changes.
+ *
+ * Changes are iterated only once for all the subscriptions sharing the sysrepo subscription and then merged
+ * into the notifications of each subscription.
  */
 static int
 np2srv_change_yang_push_cb(sr_session_ctx_t *session, uint32_t UNUSED(sub_id), const char *module_name,
         const char *xpath, sr_event_t UNUSED(event), uint32_t UNUSED(request_id), void *private_data)
 {
-    struct yang_push_cb_arg *arg = private_data;
-    char *xp = NULL, buf[26];
+    struct yang_push_shared *shared = private_data;
+    struct yang_push_cb_arg *arg;
+    char *xp = NULL;
     sr_change_iter_t *iter = NULL;
     sr_change_oper_t op;
     const struct lyd_node *node;
-    struct lyd_node *ly_yp = NULL;
+    struct lyd_node *ly_patch = NULL, *ly_yp = NULL;
+    struct yang_push_edits edits = {0};
     const char *prev_value, *prev_list;
-    enum yang_push_op yp_op;
+    uint32_t i, edit_id = 1;
     int ready, r;
-    uint32_t patch_id;
-
-    assert(!arg->yp_data->periodic);
 
     if (xpath) {
         r = asprintf(&xp, "%s//.", xpath);
@@ -449,69 +766,71 @@ np2srv_change_yang_push_cb(sr_session_ctx_t *session, uint32_t UNUSED(sub_id), c
         goto cleanup;
     }
 
-    /* NOTIF LOCK */
-    pthread_mutex_lock(&arg->yp_data->notif_lock);
-
+    /* create the YANG patch once, with all the changes */
     while (sr_get_change_tree_next(session, iter, &op, &node, &prev_value, &prev_list, NULL) == SR_ERR_OK) {
-        /* learn yang-push operation */
-        yp_op = yang_push_op_sr2yp(op, node);
-        if (arg->yp_data->excluded_change[yp_op]) {
-            /* excluded */
-            ATOMIC_INC_RELAXED(arg->yp_data->excluded_op_count);
-            continue;
-        }
-
-        /* there is a change */
-        if (!arg->yp_data->ly_change_ntf) {
-            /* create basic structure for push-change-update notification */
-            sprintf(buf, "%" PRIu32, arg->nc_sub_id);
-            if (lyd_new_path(NULL, sr_get_context(np2srv.sr_conn), "/ietf-yang-push:push-change-update/id", buf, 0,
-                    &arg->yp_data->ly_change_ntf)) {
-                goto cleanup_unlock;
-            }
-
-            /* generate a new patch-id */
-            patch_id = ATOMIC_INC_RELAXED(arg->yp_data->patch_id);
-            sprintf(buf, "patch-%" PRIu32, patch_id);
-            if (lyd_new_path(arg->yp_data->ly_change_ntf, NULL, "datastore-changes/yang-patch/patch-id", buf, 0, NULL)) {
-                goto cleanup_unlock;
+        if (!ly_patch) {
+            if (lyd_new_path(NULL, sr_get_context(np2srv.sr_conn), "/ietf-yang-push:push-change-update/datastore-changes/"
+                    "yang-patch", NULL, 0, &ly_patch)) {
+                goto cleanup;
             }
-
-            /* initialize edit-id */
-            ATOMIC_STORE_RELAXED(arg->yp_data->edit_id, 1);
-        }
-        if (!ly_yp) {
-            ly_yp = lyd_child(lyd_child(arg->yp_data->ly_change_ntf)->next);
+            ly_yp = lyd_child(lyd_child(ly_patch));
         }
 
         /* append a new edit */
-        if (yang_push_notif_change_edit_append(ly_yp, yp_op, node, prev_value, prev_list, arg->yp_data)) {
-            goto cleanup_unlock;
+        if (yang_push_notif_change_edit_append(ly_yp, &edits, yang_push_op_sr2yp(op, node), node, prev_value,
+                prev_list, edit_id++)) {
+            goto cleanup;
         }
     }
 
-    if (!arg->yp_data->ly_change_ntf) {
+    if (!ly_patch) {
         /* there are actually no changes */
-        goto cleanup_unlock;
+        goto cleanup;
     }
 
-    /* check whether the notification can be sent now */
-    if (yang_push_notif_change_ready(arg->yp_data, &ready)) {
-        goto cleanup_unlock;
-    }
+    /* SHARED LOCK */
+    pthread_mutex_lock(&shared->lock);
 
-    /* send the notification */
-    if (ready && yang_push_notif_change_send(arg->ncs, arg->yp_data, arg->nc_sub_id)) {
-        goto cleanup_unlock;
+    for (i = 0; i < shared->subscriber_count; ++i) {
+        arg = &shared->subscribers[i]->cb_arg;
+        assert(!arg->yp_data->periodic);
+
+        /* NOTIF LOCK */
+        pthread_mutex_lock(&arg->yp_data->notif_lock);
+
+        /* add the changes into the notification of this subscription */
+        if (yang_push_notif_change_merge(arg->yp_data, arg->nc_sub_id, ly_patch)) {
+            goto next_unlock;
+        }
+
+        if (!arg->yp_data->ly_change_ntf) {
+            /* all the changes were excluded */
+            goto next_unlock;
+        }
+
+        /* check whether the notification can be sent now */
+        if (yang_push_notif_change_ready(arg->yp_data, &ready)) {
+            goto next_unlock;
+        }
+
+        /* send the notification */
+        if (ready) {
+            yang_push_notif_change_send(arg->ncs, arg->yp_data, arg->nc_sub_id);
+        }
+
+next_unlock:
+        /* NOTIF UNLOCK */
+        pthread_mutex_unlock(&arg->yp_data->notif_lock);
     }
 
-cleanup_unlock:
-    /* NOTIF UNLOCK */
-    pthread_mutex_unlock(&arg->yp_data->notif_lock);
+    /* SHARED UNLOCK */
+    pthread_mutex_unlock(&shared->lock);
 
 cleanup:
     free(xp);
     sr_free_change_iter(iter);
+    lyd_free_tree(ly_patch);
+    free(edits.edits);
 
     /* return value is ignored anyway */
     return SR_ERR_OK;
@@ -524,7 +843,7 @@ cleanup:
  * @param[in] user_sess User sysrepo session.
  * @param[in] xpath XPath filter to use.
  * @param[in] private_data Private data to set for the callback.
- * @param[in] ev_sess Event sysrepo session for errors.
+ * @param[in] ev_sess Optional event sysrepo session for errors.
  * @param[in,out] sub_ids Array of SR sub IDs to add to.
  * @param[in,out] sub_id_count Number of items in @p sub_ids.
  * @return Sysrepo error value.
@@ -549,8 +868,10 @@ yang_push_sr_subscribe_mod(const struct lys_module *ly_mod, sr_session_ctx_t *us
     rc = sr_module_change_subscribe(user_sess, ly_mod->name, xpath, np2srv_change_yang_push_cb, private_data,
             0, SR_SUBSCR_CTX_REUSE | SR_SUBSCR_PASSIVE | SR_SUBSCR_DONE_ONLY, &np2srv.sr_data_sub);
     if (rc != SR_ERR_OK) {
-        sr_session_get_error(user_sess, &err_info);
-        sr_session_set_error_message(ev_sess, err_info->err[0].message);
+        if (ev_sess) {
+            sr_session_get_error(user_sess, &err_info);
+            sr_session_set_error_message(ev_sess, err_info->err[0].message);
+        }
         return rc;
     }
 
@@ -630,7 +951,7 @@ cleanup:
  * @param[in] start Replay start time.
  * @param[in] stop Subscription stop time.
  * @param[in] private_data User data to set when subscribing.
- * @param[in] ev_sess Event session for reporting errors.
+ * @param[in] ev_sess Optional event session for reporting errors.
  * @param[out] sub_ids Generated sysrepo subscription IDs, the first one is used as sub-ntf subscription ID.
  * @param[out] sub_id_count Number of @p sub_ids.
  * @return Sysrepo error value.
@@ -674,29 +995,223 @@ yang_push_sr_subscribe(sr_session_ctx_t *user_sess, sr_datastore_t ds, const cha
             goto error;
         }
 
-        for (idx = 0; idx < mod_set->count; ++idx) {
-            /* subscribe to the module */
-            rc = yang_push_sr_subscribe_mod(mod_set->objs[idx], user_sess, xpath, private_data, ev_sess, sub_ids,
-                    sub_id_count);
-            if (rc != SR_ERR_OK) {
-                goto error;
+        for (idx = 0; idx < mod_set->count; ++idx) {
+            /* subscribe to the module */
+            rc = yang_push_sr_subscribe_mod(mod_set->objs[idx], user_sess, xpath, private_data, ev_sess, sub_ids,
+                    sub_id_count);
+            if (rc != SR_ERR_OK) {
+                goto error;
+            }
+        }
+    }
+
+    ly_set_free(mod_set, NULL);
+    return SR_ERR_OK;
+
+error:
+    ly_set_free(mod_set, NULL);
+
+    for (idx = 0; idx < *sub_id_count; ++idx) {
+        sr_unsubscribe_sub(np2srv.sr_data_sub, (*sub_ids)[idx]);
+    }
+    free(*sub_ids);
+    *sub_ids = NULL;
+    *sub_id_count = 0;
+    return rc;
+}
+
+/**
+ * @brief Free shared sysrepo subscriptions.
+ *
+ * @param[in] shared Shared subscriptions to free, with no subscribers.
+ * @param[in] unsubscribe Whether to unsubscribe the sysrepo subscriptions or the whole subscription context
+ * was already destroyed.
+ * @return Sysrepo error value.
+ */
+static int
+yang_push_shared_free(struct yang_push_shared *shared, int unsubscribe)
+{
+    uint32_t i;
+    int r, rc = SR_ERR_OK;
+
+    assert(!shared->subscriber_count);
+
+    if (unsubscribe) {
+        /* waits for any callbacks in progress */
+        for (i = 0; i < shared->sub_id_count; ++i) {
+            r = sr_unsubscribe_sub(np2srv.sr_data_sub, shared->sub_ids[i]);
+            if (r != SR_ERR_OK) {
+                rc = r;
+            }
+        }
+    }
+
+    sr_session_stop(shared->sess);
+    free(shared->sub_ids);
+    free(shared->xpath);
+    free(shared->subscribers);
+    pthread_mutex_destroy(&shared->lock);
+    free(shared);
+    return rc;
+}
+
+/**
+ * @brief Add an on-change yang-push subscription into the shared sysrepo subscriptions for its datastore and filter,
+ * subscribe to sysrepo if there are none yet.
+ *
+ * The sysrepo subscriptions are created on a separate session so that they are kept until the last subscriber
+ * leaves regardless of the NETCONF session that created them.
+ *
+ * @param[in] yp_data yang-push data of the subscription.
+ * @param[in] ev_sess Optional event session for reporting errors.
+ * @return Sysrepo error value.
+ */
+static int
+yang_push_shared_join(struct yang_push_data *yp_data, sr_session_ctx_t *ev_sess)
+{
+    struct yang_push_shared *shared;
+    void *mem;
+    int rc = SR_ERR_OK;
+
+    assert(!yp_data->periodic && !yp_data->shared);
+
+    /* SHARED LIST LOCK */
+    pthread_mutex_lock(&yp_shared.lock);
+
+    /* find shared subscriptions with the same datastore and filter */
+    for (shared = yp_shared.first; shared; shared = shared->next) {
+        if ((shared->datastore == yp_data->datastore) && ((!shared->xpath && !yp_data->xpath) ||
+                (shared->xpath && yp_data->xpath && !strcmp(shared->xpath, yp_data->xpath)))) {
+            break;
+        }
+    }
+
+    if (shared) {
+        /* SHARED LOCK */
+        pthread_mutex_lock(&shared->lock);
+
+        /* add the subscriber */
+        mem = realloc(shared->subscribers, (shared->subscriber_count + 1) * sizeof *shared->subscribers);
+        if (!mem) {
+            EMEM;
+            rc = SR_ERR_NO_MEMORY;
+        } else {
+            shared->subscribers = mem;
+            shared->subscribers[shared->subscriber_count] = yp_data;
+            ++shared->subscriber_count;
+        }
+
+        /* SHARED UNLOCK */
+        pthread_mutex_unlock(&shared->lock);
+
+        if (rc) {
+            goto cleanup;
+        }
+    } else {
+        /* create new shared subscriptions with this subscriber */
+        shared = calloc(1, sizeof *shared);
+        if (!shared) {
+            EMEM;
+            rc = SR_ERR_NO_MEMORY;
+            goto cleanup;
+        }
+        pthread_mutex_init(&shared->lock, NULL);
+        shared->datastore = yp_data->datastore;
+        shared->xpath = yp_data->xpath ? strdup(yp_data->xpath) : NULL;
+        shared->subscribers = malloc(sizeof *shared->subscribers);
+        if ((yp_data->xpath && !shared->xpath) || !shared->subscribers) {
+            EMEM;
+            yang_push_shared_free(shared, 0);
+            rc = SR_ERR_NO_MEMORY;
+            goto cleanup;
+        }
+
+        shared->subscribers[0] = yp_data;
+        shared->subscriber_count = 1;
+
+        /* subscribe to sysrepo module data changes */
+        rc = sr_session_start(np2srv.sr_conn, shared->datastore, &shared->sess);
+        if (rc != SR_ERR_OK) {
+            shared->subscriber_count = 0;
+            yang_push_shared_free(shared, 0);
+            goto cleanup;
+        }
+        rc = yang_push_sr_subscribe(shared->sess, shared->datastore, shared->xpath, shared, ev_sess, &shared->sub_ids,
+                &shared->sub_id_count);
+        if (rc != SR_ERR_OK) {
+            shared->subscriber_count = 0;
+            yang_push_shared_free(shared, 0);
+            goto cleanup;
+        }
+
+        shared->next = yp_shared.first;
+        yp_shared.first = shared;
+    }
+
+    yp_data->shared = shared;
+
+cleanup:
+    /* SHARED LIST UNLOCK */
+    pthread_mutex_unlock(&yp_shared.lock);
+    return rc;
+}
+
+/**
+ * @brief Remove an on-change yang-push subscription from its shared sysrepo subscriptions, free them
+ * if it was the last subscriber.
+ *
+ * @param[in] yp_data yang-push data of the subscription.
+ * @param[in] unsubscribe Whether to unsubscribe the sysrepo subscriptions or the whole subscription context
+ * was already destroyed.
+ * @return Sysrepo error value.
+ */
+static int
+yang_push_shared_leave(struct yang_push_data *yp_data, int unsubscribe)
+{
+    struct yang_push_shared *shared = yp_data->shared, **prev;
+    uint32_t i;
+
+    if (!shared) {
+        return SR_ERR_OK;
+    }
+    yp_data->shared = NULL;
+
+    /* SHARED LIST LOCK */
+    pthread_mutex_lock(&yp_shared.lock);
+
+    /* SHARED LOCK, waits for any callback using the subscriber */
+    pthread_mutex_lock(&shared->lock);
+
+    /* remove the subscriber */
+    for (i = 0; i < shared->subscriber_count; ++i) {
+        if (shared->subscribers[i] == yp_data) {
+            --shared->subscriber_count;
+            if (i < shared->subscriber_count) {
+                shared->subscribers[i] = shared->subscribers[shared->subscriber_count];
             }
+            break;
         }
     }
 
-    ly_set_free(mod_set, NULL);
-    return SR_ERR_OK;
+    /* SHARED UNLOCK */
+    pthread_mutex_unlock(&shared->lock);
 
-error:
-    ly_set_free(mod_set, NULL);
+    if (!shared->subscriber_count) {
+        /* unlink, no other subscription can join */
+        for (prev = &yp_shared.first; *prev != shared; prev = &(*prev)->next) {}
+        *prev = shared->next;
+    } else {
+        shared = NULL;
+    }
 
-    for (idx = 0; idx < *sub_id_count; ++idx) {
-        sr_unsubscribe_sub(np2srv.sr_data_sub, (*sub_ids)[idx]);
+    /* SHARED LIST UNLOCK */
+    pthread_mutex_unlock(&yp_shared.lock);
+
+    if (shared) {
+        /* last subscriber, not holding any locks the callbacks may wait for */
+        return yang_push_shared_free(shared, unsubscribe);
     }
-    free(*sub_ids);
-    *sub_ids = NULL;
-    *sub_id_count = 0;
-    return rc;
+    return SR_ERR_OK;
 }
 
 /**
@@ -821,6 +1336,325 @@ cleanup:
     return rc;
 }
 
+/**
+ * @brief Free the data of a snapshot.
+ *
+ * @param[in] snapshot Snapshot to clear.
+ */
+static void
+yang_push_snapshot_clear(struct yang_push_snapshot *snapshot)
+{
+    uint32_t i;
+
+    for (i = 0; i < snapshot->user_count; ++i) {
+        free(snapshot->users[i].username);
+        lyd_free_siblings(snapshot->users[i].data);
+    }
+    free(snapshot->users);
+    snapshot->users = NULL;
+    snapshot->user_count = 0;
+
+    lyd_free_siblings(snapshot->data);
+    snapshot->data = NULL;
+    snapshot->valid = 0;
+}
+
+/**
+ * @brief Use the snapshot shared by periodic yang-push subscriptions with the same parameters, create it if needed.
+ *
+ * @param[in] yp_data yang-push data of a periodic subscription.
+ * @return Sysrepo error value.
+ */
+static int
+yang_push_snapshot_join(struct yang_push_data *yp_data)
+{
+    struct yang_push_snapshot *snapshot;
+    int rc = SR_ERR_OK;
+
+    assert(yp_data->periodic && !yp_data->snapshot);
+
+    /* SNAPSHOTS LOCK */
+    pthread_mutex_lock(&yp_snapshots.lock);
+
+    /* find a snapshot with the same parameters */
+    for (snapshot = yp_snapshots.first; snapshot; snapshot = snapshot->next) {
+        if ((snapshot->datastore == yp_data->datastore) && (snapshot->period_ms == yp_data->period_ms) &&
+                !memcmp(&snapshot->tick_anchor, &yp_data->tick_anchor, sizeof snapshot->tick_anchor) &&
+                ((!snapshot->xpath && !yp_data->xpath) ||
+                (snapshot->xpath && yp_data->xpath && !strcmp(snapshot->xpath, yp_data->xpath)))) {
+            break;
+        }
+    }
+
+    if (!snapshot) {
+        /* create a new snapshot */
+        snapshot = calloc(1, sizeof *snapshot);
+        if (!snapshot) {
+            EMEM;
+            rc = SR_ERR_NO_MEMORY;
+            goto cleanup;
+        }
+        snapshot->datastore = yp_data->datastore;
+        if (yp_data->xpath && !(snapshot->xpath = strdup(yp_data->xpath))) {
+            EMEM;
+            free(snapshot);
+            rc = SR_ERR_NO_MEMORY;
+            goto cleanup;
+        }
+        snapshot->period_ms = yp_data->period_ms;
+        snapshot->tick_anchor = yp_data->tick_anchor;
+        pthread_mutex_init(&snapshot->lock, NULL);
+
+        snapshot->next = yp_snapshots.first;
+        yp_snapshots.first = snapshot;
+    }
+
+    ++snapshot->subscriber_count;
+    yp_data->snapshot = snapshot;
+
+cleanup:
+    /* SNAPSHOTS UNLOCK */
+    pthread_mutex_unlock(&yp_snapshots.lock);
+    return rc;
+}
+
+/**
+ * @brief Stop using a shared snapshot, free it if it was the last subscription using it.
+ *
+ * @param[in] yp_data yang-push data of a periodic subscription.
+ */
+static void
+yang_push_snapshot_leave(struct yang_push_data *yp_data)
+{
+    struct yang_push_snapshot *snapshot = yp_data->snapshot, **prev;
+
+    if (!snapshot) {
+        return;
+    }
+    yp_data->snapshot = NULL;
+
+    /* SNAPSHOTS LOCK */
+    pthread_mutex_lock(&yp_snapshots.lock);
+
+    if (--snapshot->subscriber_count) {
+        snapshot = NULL;
+    } else {
+        /* unlink */
+        for (prev = &yp_snapshots.first; *prev != snapshot; prev = &(*prev)->next) {}
+        *prev = snapshot->next;
+    }
+
+    /* SNAPSHOTS UNLOCK */
+    pthread_mutex_unlock(&yp_snapshots.lock);
+
+    if (snapshot) {
+        yang_push_snapshot_clear(snapshot);
+        pthread_mutex_destroy(&snapshot->lock);
+        free(snapshot->xpath);
+        free(snapshot);
+    }
+}
+
+/**
+ * @brief Get the data of a periodic update from the shared snapshot, retrieve them if not yet done in this period.
+ *
+ * @param[in] yp_data yang-push data of a periodic subscription.
+ * @param[in] user_sess User sysrepo session to use for retrieving the data.
+ * @param[in] username Name of the user to filter the data for.
+ * @param[out] data Data filtered by NACM.
+ * @return Sysrepo error value.
+ */
+static int
+yang_push_snapshot_get(struct yang_push_data *yp_data, sr_session_ctx_t *user_sess, const char *username,
+        struct lyd_node **data)
+{
+    struct yang_push_snapshot *snapshot = yp_data->snapshot;
+    struct yang_push_snapshot_user *suser = NULL;
+    struct timespec cur_time;
+    int64_t elapsed, tick;
+    uint32_t i;
+    void *mem;
+    int rc = SR_ERR_OK;
+
+    /* learn the current period, the updates of a period are not scheduled exactly at the same time */
+    cur_time = np_gettimespec(1);
+    elapsed = np_difftimespec(&snapshot->tick_anchor, &cur_time);
+    if (elapsed < 0) {
+        tick = -((-elapsed + snapshot->period_ms / 2) / snapshot->period_ms);
+    } else {
+        tick = (elapsed + snapshot->period_ms / 2) / snapshot->period_ms;
+    }
+
+    /* SNAPSHOT LOCK */
+    pthread_mutex_lock(&snapshot->lock);
+
+    if (!snapshot->valid || (snapshot->tick != tick)) {
+        /* retrieve the data of this period */
+        yang_push_snapshot_clear(snapshot);
+
+        sr_session_switch_ds(user_sess, snapshot->datastore);
+        rc = sr_get_data(user_sess, snapshot->xpath ? snapshot->xpath : "/*", 0, np2srv.sr_timeout, 0, &snapshot->data);
+        if (rc != SR_ERR_OK) {
+            goto cleanup;
+        }
+        snapshot->valid = 1;
+        snapshot->tick = tick;
+    }
+
+    /* find the data filtered for the user */
+    for (i = 0; i < snapshot->user_count; ++i) {
+        if (!strcmp(snapshot->users[i].username, username)) {
+            suser = &snapshot->users[i];
+            break;
+        }
+    }
+
+    if (!suser) {
+        /* filter the data for the user */
+        mem = realloc(snapshot->users, (snapshot->user_count + 1) * sizeof *snapshot->users);
+        if (!mem) {
+            EMEM;
+            rc = SR_ERR_NO_MEMORY;
+            goto cleanup;
+        }
+        snapshot->users = mem;
+        suser = &snapshot->users[snapshot->user_count];
+        memset(suser, 0, sizeof *suser);
+
+        if (!(suser->username = strdup(username))) {
+            EMEM;
+            rc = SR_ERR_NO_MEMORY;
+            goto cleanup;
+        }
+        if (snapshot->data && lyd_dup_siblings(snapshot->data, NULL, LYD_DUP_RECURSIVE, &suser->data)) {
+            free(suser->username);
+            rc = SR_ERR_LY;
+            goto cleanup;
+        }
+        ++snapshot->user_count;
+
+        /* NACM filter */
+        ncac_check_data_read_filter(&suser->data, username);
+    }
+
+    /* copy of the filtered data */
+    *data = NULL;
+    if (suser->data && lyd_dup_siblings(suser->data, NULL, LYD_DUP_RECURSIVE, data)) {
+        rc = SR_ERR_LY;
+        goto cleanup;
+    }
+
+cleanup:
+    /* SNAPSHOT UNLOCK */
+    pthread_mutex_unlock(&snapshot->lock);
+    return rc;
+}
+
+/**
+ * @brief Send a push-change-update yang-push notification with the differences from the last periodic update.
+ *
+ * @param[in] ncs NETCONF session.
+ * @param[in] yp_data yang-push data of a periodic subscription.
+ * @param[in] nc_sub_id NC sub ID of the subscription.
+ * @param[in] data Data of this periodic update.
+ * @return Sysrepo error value.
+ */
+static int
+yang_push_notif_delta_send(struct nc_session *ncs, struct yang_push_data *yp_data, uint32_t nc_sub_id,
+        const struct lyd_node *data)
+{
+    struct lyd_node *diff = NULL, *ly_ntf = NULL, *ly_yp, *root, *node, *cur;
+    struct lyd_meta *meta;
+    struct np_ntf *ntf;
+    struct timespec ts;
+    struct yang_push_edits edits = {0};
+    enum yang_push_op yp_op;
+    const char *op;
+    char buf[26], *path;
+    uint32_t edit_id = 1;
+    int rc = SR_ERR_OK;
+
+    /* learn the differences */
+    if (lyd_diff_siblings(yp_data->last_data, data, 0, &diff)) {
+        rc = SR_ERR_LY;
+        goto cleanup;
+    }
+    if (!diff) {
+        /* no changes, nothing to send */
+        goto cleanup;
+    }
+
+    /* create the notification */
+    sprintf(buf, "%" PRIu32, nc_sub_id);
+    if (lyd_new_path(NULL, sr_get_context(np2srv.sr_conn), "/ietf-yang-push:push-change-update/id", buf, 0, &ly_ntf)) {
+        rc = SR_ERR_LY;
+        goto cleanup;
+    }
+    sprintf(buf, "patch-%" PRIu32, yp_data->update_count);
+    if (lyd_new_path(ly_ntf, NULL, "datastore-changes/yang-patch/patch-id", buf, 0, NULL)) {
+        rc = SR_ERR_LY;
+        goto cleanup;
+    }
+    ly_yp = lyd_child(lyd_child(ly_ntf)->next);
+
+    /* an edit for every changed subtree */
+    LY_LIST_FOR(diff, root) {
+        LYD_TREE_DFS_BEGIN(root, node) {
+            meta = lyd_find_meta(node->meta, NULL, "yang:operation");
+            op = meta ? lyd_get_meta_value(meta) : "none";
+            if (strcmp(op, "none")) {
+                if (!strcmp(op, "create")) {
+                    yp_op = YP_OP_CREATE;
+                } else if (!strcmp(op, "delete")) {
+                    yp_op = YP_OP_DELETE;
+                } else {
+                    yp_op = YP_OP_REPLACE;
+                }
+
+                cur = node;
+                if ((yp_op == YP_OP_REPLACE) && !(node->schema->nodetype & LYD_NODE_TERM)) {
+                    /* moved user-ordered instance, the whole current value is needed */
+                    path = lyd_path(node, LYD_PATH_STD, NULL, 0);
+                    if (!path) {
+                        rc = SR_ERR_LY;
+                        goto cleanup;
+                    }
+                    lyd_find_path(data, path, 0, &cur);
+                    free(path);
+                    if (!cur) {
+                        EINT;
+                        rc = SR_ERR_INTERNAL;
+                        goto cleanup;
+                    }
+                }
+
+                if ((rc = yang_push_notif_change_edit_append(ly_yp, &edits, yp_op, cur, NULL, NULL, edit_id++))) {
+                    goto cleanup;
+                }
+
+                /* the whole subtree is in the edit */
+                LYD_TREE_DFS_continue = 1;
+            }
+
+            LYD_TREE_DFS_END(root, node);
+        }
+    }
+
+    /* send the notification, the data were already filtered by NACM */
+    ts = np_gettimespec(1);
+    rc = np_ntf_new(ly_ntf, &ts, &ntf);
+    ly_ntf = NULL;
+    if (rc == SR_ERR_OK) {
+        rc = sub_ntf_send_notif(ncs, nc_sub_id, ntf);
+    }
+
+cleanup:
+    lyd_free_siblings(diff);
+    lyd_free_tree(ly_ntf);
+    free(edits.edits);
+    return rc;
+}
+
 /**
  * @brief Send a push-update yang-push notification.
  *
@@ -834,24 +1668,61 @@ yang_push_notif_update_send(struct nc_session *ncs, struct yang_push_data *yp_da
 {
     struct np2_user_sess *user_sess;
     struct lyd_node *data = NULL, *ly_ntf = NULL;
+    struct np_ntf *ntf;
+    struct timespec ts;
     char buf[11];
-    int rc = SR_ERR_OK;
+    int rc = SR_ERR_OK, delta = 0;
 
     /* get user session from NETCONF session */
     user_sess = nc_session_get_data(ncs);
     ATOMIC_INC_RELAXED(user_sess->ref_count);
 
-    /* switch to the datastore */
-    sr_session_switch_ds(user_sess->sess, yp_data->datastore);
+    if (yp_data->periodic && yp_data->snapshot) {
+        /* UPDATE LOCK */
+        pthread_mutex_lock(&yp_data->update_lock);
 
-    /* get the data from sysrepo */
-    rc = sr_get_data(user_sess->sess, yp_data->xpath ? yp_data->xpath : "/*", 0, np2srv.sr_timeout, 0, &data);
-    if (rc != SR_ERR_OK) {
-        goto cleanup;
-    }
+        /* get the data, retrieved only once for all the subscriptions updated in this period */
+        rc = yang_push_snapshot_get(yp_data, user_sess->sess, nc_session_get_username(ncs), &data);
+        if (rc != SR_ERR_OK) {
+            goto cleanup_unlock;
+        }
+
+        delta = np2srv.yp_full_update_periods && (yp_data->update_count % np2srv.yp_full_update_periods);
+        ++yp_data->update_count;
+        if (delta) {
+            /* send only the differences */
+            rc = yang_push_notif_delta_send(ncs, yp_data, nc_sub_id, data);
+        }
+
+        if (np2srv.yp_full_update_periods) {
+            /* remember the data for the following updates */
+            lyd_free_siblings(yp_data->last_data);
+            yp_data->last_data = NULL;
+            if (data && lyd_dup_siblings(data, NULL, LYD_DUP_RECURSIVE, &yp_data->last_data)) {
+                yp_data->update_count = 0;
+            }
+        }
+
+cleanup_unlock:
+        /* UPDATE UNLOCK */
+        pthread_mutex_unlock(&yp_data->update_lock);
 
-    /* NACM filter */
-    ncac_check_data_read_filter(&data, nc_session_get_username(ncs));
+        if ((rc != SR_ERR_OK) || delta) {
+            goto cleanup;
+        }
+    } else {
+        /* switch to the datastore */
+        sr_session_switch_ds(user_sess->sess, yp_data->datastore);
+
+        /* get the data from sysrepo */
+        rc = sr_get_data(user_sess->sess, yp_data->xpath ? yp_data->xpath : "/*", 0, np2srv.sr_timeout, 0, &data);
+        if (rc != SR_ERR_OK) {
+            goto cleanup;
+        }
+
+        /* NACM filter */
+        ncac_check_data_read_filter(&data, nc_session_get_username(ncs));
+    }
 
     /* create the notification */
     sprintf(buf, "%" PRIu32, nc_sub_id);
@@ -868,7 +1739,13 @@ yang_push_notif_update_send(struct nc_session *ncs, struct yang_push_data *yp_da
     data = NULL;
 
     /* send the notification */
-    rc = sub_ntf_send_notif(ncs, nc_sub_id, np_gettimespec(1), &ly_ntf, 1);
+    ts = np_gettimespec(1);
+    rc = np_ntf_new(ly_ntf, &ts, &ntf);
+    ly_ntf = NULL;
+    if (rc != SR_ERR_OK) {
+        goto cleanup;
+    }
+    rc = sub_ntf_send_notif(ncs, nc_sub_id, ntf);
     if (rc != SR_ERR_OK) {
         goto cleanup;
     }
@@ -884,12 +1761,14 @@ cleanup:
  * @brief Timer callback for push-update notification of periodic yang-push subscriptions.
  */
 static void
-yang_push_update_timer_cb(union sigval sval)
+yang_push_update_timer_cb(void *cb_arg)
 {
-    struct yang_push_cb_arg *arg = sval.sival_ptr;
+    struct yang_push_cb_arg *arg = cb_arg;
+    struct np2srv_sub_ntf *sub;
 
     /* READ LOCK */
-    if (!sub_ntf_find_lock(arg->nc_sub_id, 0, 0)) {
+    sub = sub_ntf_find_lock(arg->nc_sub_id, 0, 0);
+    if (!sub) {
         return;
     }
 
@@ -897,16 +1776,16 @@ yang_push_update_timer_cb(union sigval sval)
     yang_push_notif_update_send(arg->ncs, arg->yp_data, arg->nc_sub_id);
 
     /* UNLOCK */
-    sub_ntf_unlock(0);
+    sub_ntf_unlock(sub, 0);
 }
 
 /**
  * @brief Timer callback for stopping yang-push subscriptions.
  */
 static void
-yang_push_stop_timer_cb(union sigval sval)
+yang_push_stop_timer_cb(void *cb_arg)
 {
-    struct yang_push_cb_arg *arg = sval.sival_ptr;
+    struct yang_push_cb_arg *arg = cb_arg;
     struct np2srv_sub_ntf *sub;
 
     /* WRITE LOCK */
@@ -919,37 +1798,7 @@ yang_push_stop_timer_cb(union sigval sval)
     sub_ntf_terminate_sub(sub, arg->ncs);
 
     /* UNLOCK */
-    sub_ntf_unlock(0);
-}
-
-/**
- * @brief Create a new function timer.
- *
- * @param[in] cb Callback to be called.
- * @param[in] arg Argument for @p cb.
- * @param[in] force_real Whether to force realtime clock ID or can be monotonic if available.
- * @param[out] timer_id Created timer ID.
- * @return Sysrepo error value.
- */
-static int
-yang_push_create_timer(void (*cb)(union sigval), void *arg, int force_real, timer_t *timer_id)
-{
-    struct sigevent sevp = {0};
-
-    sevp.sigev_notify = SIGEV_THREAD;
-    sevp.sigev_value.sival_ptr = arg;
-    sevp.sigev_notify_function = cb;
-    if (force_real) {
-        if (timer_create(CLOCK_REALTIME, &sevp, timer_id) == -1) {
-            return SR_ERR_SYS;
-        }
-    } else {
-        if (timer_create(NP_CLOCK_ID, &sevp, timer_id) == -1) {
-            return SR_ERR_SYS;
-        }
-    }
-
-    return SR_ERR_OK;
+    sub_ntf_unlock(sub, 0);
 }
 
 int
@@ -963,11 +1812,10 @@ yang_push_rpc_establish_sub(sr_session_ctx_t *ev_sess, const struct lyd_node *rp
     const char *selection_filter_ref = NULL, *datastore_xpath_filter = NULL;
     sr_datastore_t datastore;
     char *xp = NULL;
-    uint32_t i, period, dampening_period, sub_id_count;
+    uint32_t i, period, dampening_period;
     int64_t anchor_msec;
     int rc = SR_ERR_OK, periodic, sync_on_start, excluded_change[YP_OP_OPERATION_COUNT] = {0};
-    struct itimerspec trspec = {0};
-    struct timespec anchor_time = {0};
+    struct timespec anchor_time = {0}, first_update;
 
     /* get the NETCONF session and user session */
     if ((rc = np_get_user_sess(ev_sess, &ncs, &user_sess))) {
@@ -1056,6 +1904,7 @@ yang_push_rpc_establish_sub(sr_session_ctx_t *ev_sess, const struct lyd_node *rp
     if (periodic) {
         yp_data->period_ms = period * 10;
         yp_data->anchor_time = anchor_time;
+        pthread_mutex_init(&yp_data->update_lock, NULL);
     } else {
         yp_data->dampening_period_ms = dampening_period * 10;
         yp_data->sync_on_start = sync_on_start;
@@ -1065,7 +1914,7 @@ yang_push_rpc_establish_sub(sr_session_ctx_t *ev_sess, const struct lyd_node *rp
         ATOMIC_STORE_RELAXED(yp_data->patch_id, 1);
         if (yp_data->dampening_period_ms) {
             /* create dampening timer */
-            rc = yang_push_create_timer(yang_push_damp_timer_cb, &yp_data->cb_arg, 1, &yp_data->damp_timer);
+            rc = np_timer_create(yang_push_damp_timer_cb, &yp_data->cb_arg, &yp_data->damp_timer);
             if (rc != SR_ERR_OK) {
                 goto cleanup;
             }
@@ -1080,42 +1929,38 @@ yang_push_rpc_establish_sub(sr_session_ctx_t *ev_sess, const struct lyd_node *rp
 
     if (sub->stop_time.tv_sec) {
         /* create stop timer */
-        rc = yang_push_create_timer(yang_push_stop_timer_cb, &yp_data->cb_arg, 1, &yp_data->stop_timer);
+        rc = np_timer_create(yang_push_stop_timer_cb, &yp_data->cb_arg, &yp_data->stop_timer);
         if (rc != SR_ERR_OK) {
             goto cleanup;
         }
 
         /* schedule subscription stop */
-        trspec.it_value = sub->stop_time;
-        if (timer_settime(yp_data->stop_timer, TIMER_ABSTIME, &trspec, NULL) == -1) {
-            rc = SR_ERR_SYS;
-            goto cleanup;
-        }
+        np_timer_set(yp_data->stop_timer, &sub->stop_time, 0);
     }
 
     if (periodic) {
         /* create update timer */
-        rc = yang_push_create_timer(yang_push_update_timer_cb, &yp_data->cb_arg, 1, &yp_data->update_timer);
+        rc = np_timer_create(yang_push_update_timer_cb, &yp_data->cb_arg, &yp_data->update_timer);
         if (rc != SR_ERR_OK) {
             goto cleanup;
         }
 
         /* schedule the periodic updates */
-        trspec.it_value = np_gettimespec(1);
+        first_update = np_gettimespec(1);
         if (yp_data->anchor_time.tv_sec) {
-            /* first update at nearest anchor time on period */
-            anchor_msec = np_difftimespec(&yp_data->anchor_time, &trspec.it_value);
+            /* first update at the nearest following anchor time on period */
+            anchor_msec = np_difftimespec(&first_update, &yp_data->anchor_time) % yp_data->period_ms;
             if (anchor_msec < 0) {
-                anchor_msec *= -1;
+                anchor_msec += yp_data->period_ms;
             }
-            anchor_msec %= yp_data->period_ms;
-            np_addtimespec(&trspec.it_value, anchor_msec);
+            np_addtimespec(&first_update, anchor_msec);
         }
-        trspec.it_interval.tv_sec = yp_data->period_ms / 1000;
-        trspec.it_interval.tv_nsec = (yp_data->period_ms % 1000) * 1000000;
+        np_timer_set(yp_data->update_timer, &first_update, yp_data->period_ms);
 
-        if (timer_settime(yp_data->update_timer, TIMER_ABSTIME, &trspec, NULL) == -1) {
-            rc = SR_ERR_SYS;
+        /* share the data with subscriptions updated at the same time */
+        yp_data->tick_anchor = np_modtimespec(&first_update, yp_data->period_ms);
+        rc = yang_push_snapshot_join(yp_data);
+        if (rc != SR_ERR_OK) {
             goto cleanup;
         }
     } else {
@@ -1127,11 +1972,8 @@ yang_push_rpc_establish_sub(sr_session_ctx_t *ev_sess, const struct lyd_node *rp
             }
         }
 
-        /* subscribe to sysrepo module data changes */
-        sub_id_count = 0;
-        rc = yang_push_sr_subscribe(user_sess->sess, datastore, yp_data->xpath, &yp_data->cb_arg, ev_sess, &sub->sub_ids,
-                &sub_id_count);
-        ATOMIC_STORE_RELAXED(sub->sub_id_count, sub_id_count);
+        /* subscribe to sysrepo module data changes, shared with other subscriptions with the same filter */
+        rc = yang_push_shared_join(yp_data, ev_sess);
         if (rc != SR_ERR_OK) {
             goto cleanup;
         }
@@ -1155,11 +1997,10 @@ yang_push_rpc_modify_sub(sr_session_ctx_t *ev_sess, const struct lyd_node *rpc,
     struct yang_push_data *yp_data = sub->data;
     sr_datastore_t datastore;
     const char *selection_filter_ref = NULL, *datastore_xpath_filter = NULL;
-    struct itimerspec trspec;
     char *xp = NULL, *datetime = NULL;
-    struct timespec anchor_time, next_notif;
+    struct timespec anchor_time, next_notif, next_update;
     int rc = SR_ERR_OK;
-    uint32_t i, period, dampening_period;
+    uint32_t period, dampening_period;
 
     /* get the user session */
     if ((rc = np_get_user_sess(ev_sess, NULL, &user_sess))) {
@@ -1206,16 +2047,12 @@ yang_push_rpc_modify_sub(sr_session_ctx_t *ev_sess, const struct lyd_node *rpc,
 
             /* update the period */
             if (yp_data->anchor_time.tv_sec) {
-                trspec.it_value = np_modtimespec(&yp_data->anchor_time, yp_data->period_ms);
+                next_update = np_modtimespec(&yp_data->anchor_time, yp_data->period_ms);
             } else {
-                trspec.it_value = np_gettimespec(1);
-            }
-            trspec.it_interval.tv_sec = yp_data->period_ms / 1000;
-            trspec.it_interval.tv_nsec = (yp_data->period_ms % 1000) * 1000000;
-            if (timer_settime(yp_data->update_timer, TIMER_ABSTIME, &trspec, NULL) == -1) {
-                rc = SR_ERR_SYS;
-                goto cleanup;
+                next_update = np_gettimespec(1);
             }
+            np_timer_set(yp_data->update_timer, &next_update, yp_data->period_ms);
+            yp_data->tick_anchor = np_modtimespec(&next_update, yp_data->period_ms);
         }
 
         /* anchor-time */
@@ -1226,13 +2063,9 @@ yang_push_rpc_modify_sub(sr_session_ctx_t *ev_sess, const struct lyd_node *rpc,
                 yp_data->anchor_time = anchor_time;
 
                 /* update the anchor */
-                trspec.it_value = np_modtimespec(&yp_data->anchor_time, yp_data->period_ms);
-                trspec.it_interval.tv_sec = yp_data->period_ms / 1000;
-                trspec.it_interval.tv_nsec = (yp_data->period_ms % 1000) * 1000000;
-                if (timer_settime(yp_data->update_timer, TIMER_ABSTIME, &trspec, NULL) == -1) {
-                    rc = SR_ERR_SYS;
-                    goto cleanup;
-                }
+                next_update = np_modtimespec(&yp_data->anchor_time, yp_data->period_ms);
+                np_timer_set(yp_data->update_timer, &next_update, yp_data->period_ms);
+                yp_data->tick_anchor = np_modtimespec(&next_update, yp_data->period_ms);
             }
         }
     }
@@ -1255,7 +2088,7 @@ yang_push_rpc_modify_sub(sr_session_ctx_t *ev_sess, const struct lyd_node *rpc,
         if (dampening_period * 10 != yp_data->dampening_period_ms) {
             if (!yp_data->dampening_period_ms) {
                 /* create dampening timer */
-                rc = yang_push_create_timer(yang_push_damp_timer_cb, &yp_data->cb_arg, 1, &yp_data->damp_timer);
+                rc = np_timer_create(yang_push_damp_timer_cb, &yp_data->cb_arg, &yp_data->damp_timer);
                 if (rc != SR_ERR_OK) {
                     goto cleanup;
                 }
@@ -1265,24 +2098,17 @@ yang_push_rpc_modify_sub(sr_session_ctx_t *ev_sess, const struct lyd_node *rpc,
 
             if (!yp_data->dampening_period_ms) {
                 /* delete the dampening timer */
-                timer_delete(yp_data->damp_timer);
+                np_timer_delete(yp_data->damp_timer);
+                yp_data->damp_timer = NULL;
             } else {
                 /* update the dampening timer, if set */
-                if (timer_gettime(yp_data->damp_timer, &trspec) == -1) {
-                    rc = SR_ERR_SYS;
-                    goto cleanup;
-                }
-                if (trspec.it_value.tv_sec || trspec.it_value.tv_nsec) {
+                if (np_timer_is_armed(yp_data->damp_timer)) {
                     /* learn when the next notification is due */
                     next_notif = yp_data->last_notif;
                     np_addtimespec(&next_notif, yp_data->dampening_period_ms);
 
                     /* schedule the notification */
-                    trspec.it_value = next_notif;
-                    if (timer_settime(yp_data->damp_timer, TIMER_ABSTIME, &trspec, NULL) == -1) {
-                        rc = SR_ERR_SYS;
-                        goto cleanup;
-                    }
+                    np_timer_set(yp_data->damp_timer, &next_notif, 0);
                 }
             }
         }
@@ -1303,8 +2129,10 @@ yang_push_rpc_modify_sub(sr_session_ctx_t *ev_sess, const struct lyd_node *rpc,
         yp_data->xpath = xp;
         xp = NULL;
 
-        for (i = 0; i < sub->sub_id_count; ++i) {
-            rc = sr_module_change_sub_modify_xpath(np2srv.sr_data_sub, sub->sub_ids[i], yp_data->xpath);
+        if (!yp_data->periodic) {
+            /* move to the shared subscriptions of the new filter */
+            yang_push_shared_leave(yp_data, 1);
+            rc = yang_push_shared_join(yp_data, ev_sess);
             if (rc != SR_ERR_OK) {
                 goto cleanup;
             }
@@ -1336,19 +2164,26 @@ yang_push_rpc_modify_sub(sr_session_ctx_t *ev_sess, const struct lyd_node *rpc,
     if (stop.tv_sec && memcmp(&stop, &sub->stop_time, sizeof stop)) {
         if (!sub->stop_time.tv_sec) {
             /* create stop timer */
-            rc = yang_push_create_timer(yang_push_stop_timer_cb, &yp_data->cb_arg, 1, &yp_data->stop_timer);
+            rc = np_timer_create(yang_push_stop_timer_cb, &yp_data->cb_arg, &yp_data->stop_timer);
             if (rc != SR_ERR_OK) {
                 goto cleanup;
             }
         }
 
         /* schedule subscription stop */
-        memset(&trspec, 0, sizeof trspec);
-        trspec.it_value = stop;
-        if (timer_settime(yp_data->stop_timer, TIMER_ABSTIME, &trspec, NULL) == -1) {
-            rc = SR_ERR_SYS;
+        np_timer_set(yp_data->stop_timer, &stop, 0);
+    }
+
+    if (yp_data->periodic) {
+        /* the filter or period may have changed, share the data with the matching subscriptions */
+        yang_push_snapshot_leave(yp_data);
+        rc = yang_push_snapshot_join(yp_data);
+        if (rc != SR_ERR_OK) {
             goto cleanup;
         }
+
+        /* next update is complete, updates are not being sent while holding the sub-ntf WRITE lock */
+        yp_data->update_count = 0;
     }
 
 cleanup:
@@ -1478,7 +2313,6 @@ yang_push_config_filters(const struct lyd_node *filter, sr_change_oper_t op)
     struct np2srv_sub_ntf *sub;
     struct nc_session *ncs;
     char *xp;
-    uint32_t i;
 
     if (op == SR_OP_MODIFIED) {
         /* construct the new filter */
@@ -1496,13 +2330,20 @@ yang_push_config_filters(const struct lyd_node *filter, sr_change_oper_t op)
             free(yp_data->xpath);
             yp_data->xpath = strdup(xp);
 
-            if (!yp_data->periodic) {
-                /* modify the filter of the subscription(s) */
-                for (i = 0; i < sub->sub_id_count; ++i) {
-                    r = sr_module_change_sub_modify_xpath(np2srv.sr_data_sub, sub->sub_ids[i], yp_data->xpath);
-                    if (r != SR_ERR_OK) {
-                        rc = r;
-                    }
+            if (yp_data->periodic) {
+                /* share the data with the subscriptions with the new filter */
+                yang_push_snapshot_leave(yp_data);
+                r = yang_push_snapshot_join(yp_data);
+                if (r != SR_ERR_OK) {
+                    rc = r;
+                }
+                yp_data->update_count = 0;
+            } else {
+                /* move to the shared subscriptions of the new filter */
+                yang_push_shared_leave(yp_data, 1);
+                r = yang_push_shared_join(yp_data, NULL);
+                if (r != SR_ERR_OK) {
+                    rc = r;
                 }
             }
 
@@ -1519,8 +2360,9 @@ yang_push_config_filters(const struct lyd_node *filter, sr_change_oper_t op)
         sub = NULL;
         while ((sub = sub_ntf_find_next(sub, yang_push_datastore_filter_match_cb, lyd_get_value(lyd_child(filter))))) {
             /* get NETCONF session */
-            if ((rc = np_get_nc_sess_by_id(0, sub->nc_id, &ncs))) {
-                return rc;
+            if ((r = np_get_nc_sess_by_id(0, sub->nc_id, &ncs))) {
+                rc = r;
+                continue;
             }
 
             /* terminate the subscription with the specific term reason */
@@ -1632,14 +2474,16 @@ uint32_t
 yang_push_oper_receiver_excluded(struct np2srv_sub_ntf *sub)
 {
     struct yang_push_data *yp_data = sub->data;
+    struct yang_push_shared *shared;
     uint32_t i, excluded_count = 0, filtered_out;
     int r;
 
     if (!yp_data->periodic) {
-        /* excluded-event-records */
-        for (i = 0; i < ATOMIC_LOAD_RELAXED(sub->sub_id_count); ++i) {
+        /* excluded-event-records, of the shared subscriptions */
+        shared = yp_data->shared;
+        for (i = 0; shared && (i < shared->sub_id_count); ++i) {
             /* get filter-out count for the subscription */
-            r = sr_module_change_sub_get_info(np2srv.sr_data_sub, sub->sub_ids[i], NULL, NULL, NULL, &filtered_out);
+            r = sr_module_change_sub_get_info(np2srv.sr_data_sub, shared->sub_ids[i], NULL, NULL, NULL, &filtered_out);
             if (r != SR_ERR_OK) {
                 return 0;
             }
@@ -1657,19 +2501,32 @@ void
 yang_push_terminate_async(void *data)
 {
     struct yang_push_data *yp_data = data;
-    struct itimerspec tspec = {0};
+    struct timespec disarm = {0};
 
     /* disarm all timers */
     if (yp_data->periodic) {
-        timer_settime(yp_data->update_timer, TIMER_ABSTIME, &tspec, NULL);
+        np_timer_set(yp_data->update_timer, &disarm, 0);
     } else {
         if (yp_data->dampening_period_ms) {
-            timer_settime(yp_data->damp_timer, TIMER_ABSTIME, &tspec, NULL);
+            np_timer_set(yp_data->damp_timer, &disarm, 0);
         }
     }
     if (yp_data->stop_timer) {
-        timer_settime(yp_data->stop_timer, TIMER_ABSTIME, &tspec, NULL);
+        np_timer_set(yp_data->stop_timer, &disarm, 0);
+    }
+}
+
+int
+yang_push_sr_unsubscribe(void *data)
+{
+    struct yang_push_data *yp_data = data;
+
+    if (!yp_data || yp_data->periodic) {
+        /* no sysrepo subscriptions */
+        return SR_ERR_OK;
     }
+
+    return yang_push_shared_leave(yp_data, 1);
 }
 
 void
@@ -1682,17 +2539,23 @@ yang_push_data_destroy(void *data)
         lyd_free_tree(yp_data->datastore_subtree_filter);
         free(yp_data->datastore_xpath_filter);
         if (yp_data->periodic) {
-            timer_delete(yp_data->update_timer);
+            np_timer_delete(yp_data->update_timer);
+            yang_push_snapshot_leave(yp_data);
+            pthread_mutex_destroy(&yp_data->update_lock);
+            lyd_free_siblings(yp_data->last_data);
         } else {
+            /* sysrepo subscription context was already destroyed if still subscribed */
+            yang_push_shared_leave(yp_data, 0);
             pthread_mutex_destroy(&yp_data->notif_lock);
             lyd_free_tree(yp_data->ly_change_ntf);
+            free(yp_data->change_edits.edits);
             if (yp_data->dampening_period_ms) {
-                timer_delete(yp_data->damp_timer);
+                np_timer_delete(yp_data->damp_timer);
             }
         }
         free(yp_data->xpath);
         if (yp_data->stop_timer) {
-            timer_delete(yp_data->stop_timer);
+            np_timer_delete(yp_data->stop_timer);
         }
 
         free(yp_data);
@@ -1741,7 +2604,7 @@ np2srv_rpc_resync_sub_cb(sr_session_ctx_t *session, uint32_t UNUSED(sub_id), con
 
 cleanup_unlock:
     /* UNLOCK */
-    sub_ntf_unlock(0);
+    sub_ntf_unlock(sub, 0);
 
     return rc;
 }
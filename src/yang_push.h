@@ -23,8 +23,11 @@
 #include <sysrepo.h>
 
 #include "common.h"
+#include "timer_wheel.h"
 
 struct np2srv_sub_ntf;
+struct yang_push_shared;
+struct yang_push_snapshot;
 
 /**
  * @brief Operations supported by yang-push.
@@ -47,6 +50,21 @@ struct yang_push_cb_arg {
     uint32_t nc_sub_id;
 };
 
+/**
+ * @brief Edits of a YANG patch indexed by their target, for coalescing changes of the same target.
+ */
+struct yang_push_edits {
+    struct yang_push_edit {
+        struct lyd_node *edit;  /* edit in the YANG patch */
+        const char *target;     /* target of the edit, owned by the edit */
+        uint32_t hash;          /* hash of the target */
+        uint32_t gen;           /* generation of the edits the item belongs to */
+    } *edits;
+    uint32_t size;              /* size of edits (power of 2), open addressing */
+    uint32_t count;             /* number of edits */
+    uint32_t gen;               /* current generation, items of the previous ones are free */
+};
+
 struct yang_push_data {
     /* parameters */
     sr_datastore_t datastore;
@@ -61,7 +79,12 @@ struct yang_push_data {
             struct timespec anchor_time;
 
             /* internal data */
-            timer_t update_timer;
+            struct np_timer *update_timer;
+            struct timespec tick_anchor;            /* time of any periodic update */
+            struct yang_push_snapshot *snapshot;    /* data snapshot shared in a period */
+            pthread_mutex_t update_lock;            /* lock for the last update */
+            uint32_t update_count;                  /* periodic updates since the last modification */
+            struct lyd_node *last_data;             /* data of the last update, in the delta mode */
         };
         struct {
             /* parameters */
@@ -72,18 +95,20 @@ struct yang_push_data {
             /* internal data */
             pthread_mutex_t notif_lock;
             struct lyd_node *ly_change_ntf;
+            struct yang_push_edits change_edits;    /* edits of ly_change_ntf */
             ATOMIC_T patch_id;
             ATOMIC_T edit_id;
             struct timespec last_notif;
-            timer_t damp_timer;
+            struct np_timer *damp_timer;
             ATOMIC_T excluded_op_count; /* explicitly excluded changes */
+            struct yang_push_shared *shared;    /* shared sysrepo subscription */
         };
     };
 
     /* internal data */
     char *xpath;
     struct yang_push_cb_arg cb_arg;
-    timer_t stop_timer;
+    struct np_timer *stop_timer;
 };
 
 /* for documentation, see subscribed_notifications.h */
@@ -102,6 +127,15 @@ uint32_t yang_push_oper_receiver_excluded(struct np2srv_sub_ntf *sub);
 
 void yang_push_terminate_async(void *data);
 
+/**
+ * @brief Stop receiving changes for an on-change yang-push subscription, unsubscribe the shared
+ * sysrepo subscriptions if it was the last subscription using them.
+ *
+ * @param[in] data yang-push data.
+ * @return Sysrepo error value.
+ */
+int yang_push_sr_unsubscribe(void *data);
+
 void yang_push_data_destroy(void *data);
 
 /*
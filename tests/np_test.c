@@ -130,6 +130,12 @@ cleanup:
 
 int
 np_glob_setup_np2(void **state, const char *test_name)
+{
+    return np_glob_setup_np2_arg(state, test_name, NULL);
+}
+
+int
+np_glob_setup_np2_arg(void **state, const char *test_name, const char *server_arg)
 {
     struct np_test *st;
     pid_t pid;
@@ -218,7 +224,7 @@ np_glob_setup_np2(void **state, const char *test_name)
         /* exec server listening on a unix socket */
         sprintf(str, "-p%s/%s/%s", NP_TEST_DIR, test_name, NP_PID_FILE);
         execl(NP_BINARY_DIR "/netopeer2-server", NP_BINARY_DIR "/netopeer2-server", "-d", "-v3", str, sockparam,
-                "-m 600", "-f", serverdir, (char *)NULL);
+                "-m 600", "-f", serverdir, server_arg, (char *)NULL);
 
 child_error:
         printf("Child execution failed\n");
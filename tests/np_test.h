@@ -216,6 +216,8 @@ int np_glob_setup_env(const char *test_name);
 
 int np_glob_setup_np2(void **state, const char *test_name);
 
+int np_glob_setup_np2_arg(void **state, const char *test_name, const char *server_arg);
+
 int np_glob_teardown(void **state);
 
 void parse_arg(int argc, char **argv);
@@ -20,14 +20,18 @@
 #include <errno.h>
 #include <setjmp.h>
 #include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include <unistd.h>
 
 #include <cmocka.h>
 #include <libyang/libyang.h>
 #include <nc_client.h>
 
+#include "netconf_confirmed_commit_journal.h"
 #include "np_test.h"
 #include "np_test_config.h"
 
@@ -460,42 +464,106 @@ test_wrong_persist_id(void **state)
 }
 
 static int
-setup_test_failed_file(void **state)
+write_journal_rec(FILE *file, enum ncc_rec_type type, const void *payload, uint32_t len, int corrupt)
 {
-    struct np_test *st = *state;
-    char *test_name, *file_name;
-    FILE *file;
+    struct ncc_rec_hdr hdr;
+
+    hdr.magic = NCC_JOURNAL_MAGIC;
+    hdr.type = type;
+    hdr.len = len;
+    hdr.crc = ncc_crc32(ncc_rec_crc_start(&hdr), payload, len);
+    if (corrupt) {
+        ++hdr.crc;
+    }
 
-    /* get test backup directory */
-    test_name = strdup(st->path);
-    free(st->path);
-    if (!test_name) {
+    if (fwrite(&hdr, sizeof hdr, 1, file) != 1) {
         return 1;
     }
-    if (asprintf(&st->path, "%s/%s/confirmed_commit", NP_TEST_DIR, test_name) == -1) {
+    if (len && (fwrite(payload, len, 1, file) != 1)) {
         return 1;
     }
-    if (asprintf(&file_name, "%s/bogus.json", st->path) == -1) {
+    return 0;
+}
+
+static int
+write_journal(const char *dir, int corrupt)
+{
+    struct ncc_rec_meta meta = {0};
+    char *file_name;
+    FILE *file;
+    int ret;
+
+    /* journal of a confirmed commit without any changes, optionally with the checksum of the meta record broken */
+    if (asprintf(&file_name, "%s/journal", dir) == -1) {
         return 1;
     }
-    file = fopen(file_name, "w+");
+    file = fopen(file_name, "w");
     if (!file) {
         printf("Could not create file \"%s\" (%s).\n", file_name, strerror(errno));
+        free(file_name);
         return 1;
     }
     free(file_name);
+
+    meta.time = time(NULL);
+    meta.timeout_s = 1;
+    ret = write_journal_rec(file, NCC_REC_META, &meta, sizeof meta, corrupt);
+    if (!ret) {
+        ret = write_journal_rec(file, NCC_REC_COMMIT, NULL, 0, 0);
+    }
+    if (fclose(file)) {
+        ret = 1;
+    }
+    return ret;
+}
+
+static int
+count_failed_files(const char *path)
+{
+    struct dirent *file = NULL;
+    int found = 0;
+    DIR *dir = NULL;
+
+    dir = opendir(path);
+    assert_non_null(dir);
+    while ((file = readdir(dir))) {
+        if (!strcmp("..", file->d_name) || !strcmp(".", file->d_name)) {
+            continue;
+        }
+        if (strstr(file->d_name, ".failed")) {
+            found += 1;
+        }
+    }
+    closedir(dir);
+    return found;
+}
+
+static int
+setup_test_failed_file(void **state)
+{
+    struct np_test *st = *state;
+    char *test_name;
+
+    /* get test backup directory */
+    test_name = strdup(st->path);
+    free(st->path);
+    if (!test_name) {
+        return 1;
+    }
+    if (asprintf(&st->path, "%s/%s/confirmed_commit", NP_TEST_DIR, test_name) == -1) {
+        free(test_name);
+        return 1;
+    }
     free(test_name);
-    fclose(file);
-    return 0;
+
+    /* journal not belonging to any pending confirmed commit */
+    return write_journal(st->path, 0);
 }
 
 static void
 test_failed_file(void **state)
 {
     struct np_test *st = *state;
-    struct dirent *file = NULL;
-    int found = 0;
-    DIR *dir = NULL;
 
     /* Prior to the test running should be empty */
     ASSERT_EMPTY_CONFIG(st);
@@ -513,18 +581,7 @@ test_failed_file(void **state)
     sleep(2);
 
     /* Try and find the .failed file, should be exactly one */
-    dir = opendir(st->path);
-    assert_non_null(dir);
-    while ((file = readdir(dir))) {
-        if (!strcmp("..", file->d_name) || !strcmp(".", file->d_name)) {
-            continue;
-        }
-        if (strstr(file->d_name, ".failed")) {
-            found += 1;
-        }
-    }
-    closedir(dir);
-    assert_int_equal(found, 1);
+    assert_int_equal(count_failed_files(st->path), 1);
 }
 
 static int
@@ -555,6 +612,114 @@ teardown_test_failed_file(void **state)
     return 0;
 }
 
+static void
+test_journal(struct np_test *st, int corrupt)
+{
+    const char *expected;
+
+    /* Prior to the test running should be empty */
+    ASSERT_EMPTY_CONFIG(st);
+
+    /* Send a confirmed-commit rpc with 1s timeout */
+    st->rpc = nc_rpc_commit(1, 1, NULL, NULL, NC_PARAMTYPE_CONST);
+    st->msgtype = nc_send_rpc(st->nc_sess, st->rpc, 1000, &st->msgid);
+    assert_int_equal(st->msgtype, NC_MSG_RPC);
+
+    /* Check if received an OK reply */
+    ASSERT_OK_REPLY(st);
+    FREE_TEST_VARS(st);
+
+    /* Replace the journal with one that has no changes to revert */
+    assert_int_equal(write_journal(st->path, corrupt), 0);
+
+    /* Wait for the duration of the timeout */
+    sleep(2);
+
+    /* Running was not reverted in either case */
+    GET_CONFIG(st);
+    expected =
+            "<get-config xmlns=\"urn:ietf:params:xml:ns:netconf:base:1.0\">\n"
+            "  <data>\n"
+            "    <first xmlns=\"ed1\">Test</first>\n"
+            "  </data>\n"
+            "</get-config>\n";
+    assert_string_equal(st->str, expected);
+    FREE_TEST_VARS(st);
+
+    /* Only a journal failing the checksum is kept */
+    assert_int_equal(count_failed_files(st->path), corrupt ? 1 : 0);
+}
+
+static void
+test_journal_valid(void **state)
+{
+    test_journal(*state, 0);
+}
+
+static void
+test_journal_corrupted(void **state)
+{
+    test_journal(*state, 1);
+}
+
+static void
+test_timeout_runout_conflict(void **state)
+{
+    struct np_test *st = *state;
+    const char *expected, *data;
+
+    /* Running has a value removed by the commit */
+    data = "<first xmlns=\"ed1\">Orig</first>";
+    SR_EDIT_SESSION(st, st->sr_sess, data);
+    FREE_TEST_VARS(st);
+    data = "<first xmlns=\"ed1\" xmlns:xc=\"urn:ietf:params:xml:ns:netconf:base:1.0\" xc:operation=\"remove\"/>";
+    SR_EDIT_SESSION(st, st->sr_sess2, data);
+    FREE_TEST_VARS(st);
+
+    /* Send a confirmed-commit rpc with 1s timeout */
+    st->rpc = nc_rpc_commit(1, 1, NULL, NULL, NC_PARAMTYPE_CONST);
+    st->msgtype = nc_send_rpc(st->nc_sess, st->rpc, 1000, &st->msgid);
+    assert_int_equal(st->msgtype, NC_MSG_RPC);
+
+    /* Check if received an OK reply */
+    ASSERT_OK_REPLY(st);
+    FREE_TEST_VARS(st);
+
+    /* Running should now be same as candidate */
+    ASSERT_EMPTY_CONFIG(st);
+
+    /* Create the value again so that the commit changes cannot be reverted */
+    data = "<first xmlns=\"ed1\">Other</first>";
+    SR_EDIT_SESSION(st, st->sr_sess, data);
+    FREE_TEST_VARS(st);
+
+    /* wait for the duration of the timeout */
+    sleep(2);
+
+    /* The rollback failed and running was left as it is */
+    GET_CONFIG(st);
+    expected =
+            "<get-config xmlns=\"urn:ietf:params:xml:ns:netconf:base:1.0\">\n"
+            "  <data>\n"
+            "    <first xmlns=\"ed1\">Other</first>\n"
+            "  </data>\n"
+            "</get-config>\n";
+    assert_string_equal(st->str, expected);
+    FREE_TEST_VARS(st);
+
+    /* The journal is kept */
+    assert_int_equal(count_failed_files(st->path), 1);
+}
+
+static int
+teardown_journal(void **state)
+{
+    if (teardown_common(state)) {
+        return 1;
+    }
+    return teardown_test_failed_file(state);
+}
+
 int
 main(int argc, char **argv)
 {
@@ -569,6 +734,9 @@ main(int argc, char **argv)
         cmocka_unit_test_setup_teardown(test_cancel_persist, setup_common, teardown_common),
         cmocka_unit_test_setup_teardown(test_wrong_persist_id, setup_common, teardown_common),
         cmocka_unit_test_setup_teardown(test_failed_file, setup_test_failed_file, teardown_test_failed_file),
+        cmocka_unit_test_setup_teardown(test_journal_valid, setup_common, teardown_journal),
+        cmocka_unit_test_setup_teardown(test_journal_corrupted, setup_common, teardown_journal),
+        cmocka_unit_test_setup_teardown(test_timeout_runout_conflict, setup_common, teardown_journal),
     };
 
     nc_verbosity(NC_VERB_WARNING);
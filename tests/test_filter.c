@@ -861,6 +861,113 @@ test_get_operational_data(void **state)
     FREE_TEST_VARS(st);
 }
 
+static void
+test_get_monitoring_containers(void **state)
+{
+    struct np_test *st = *state;
+    char *filter;
+
+    /* 2 containers of netconf-state, the first one with a nested content match */
+    filter =
+            "<netconf-state xmlns=\"urn:ietf:params:xml:ns:yang:ietf-netconf-monitoring\">\n"
+            "  <datastores>\n"
+            "    <datastore>\n"
+            "      <name>running</name>\n"
+            "    </datastore>\n"
+            "  </datastores>\n"
+            "  <statistics/>\n"
+            "</netconf-state>\n";
+
+    GET_FILTER(st, filter);
+
+    /* both are returned, nothing else */
+    assert_non_null(strstr(st->str, "<name>running</name>"));
+    assert_non_null(strstr(st->str, "<statistics>"));
+    assert_null(strstr(st->str, "<name>startup</name>"));
+    assert_null(strstr(st->str, "<schemas>"));
+
+    FREE_TEST_VARS(st);
+}
+
+static void
+test_get_monitoring_predicate(void **state)
+{
+    struct np_test *st = *state;
+    char *filter;
+
+    /* a predicate referring to another container of netconf-state */
+    filter = "/ietf-netconf-monitoring:netconf-state/datastores/datastore[name='running']"
+            "[count(/ietf-netconf-monitoring:netconf-state/schemas/schema) > 0]";
+
+    GET_FILTER(st, filter);
+
+    /* the predicate was evaluated on all the data */
+    assert_non_null(strstr(st->str, "<name>running</name>"));
+    assert_null(strstr(st->str, "<schemas>"));
+
+    FREE_TEST_VARS(st);
+}
+
+static void
+test_subtree_filter_cache(void **state)
+{
+    struct np_test *st = *state;
+    char *filter, *expected;
+
+    filter =
+            "<top xmlns=\"ex2\">\n"
+            "  <protocols>\n"
+            "    <ospf>\n"
+            "      <area>\n"
+            "        <name>192.168.0.0</name>\n"
+            "      </area>\n"
+            "    </ospf>\n"
+            "  </protocols>\n"
+            "</top>\n";
+
+    expected =
+            "<get-config xmlns=\"urn:ietf:params:xml:ns:netconf:base:1.0\">\n"
+            "  <data>\n"
+            "    <top xmlns=\"ex2\">\n"
+            "      <protocols>\n"
+            "        <ospf>\n"
+            "          <area>\n"
+            "            <name>192.168.0.0</name>\n"
+            "            <interfaces>\n"
+            "              <interface>\n"
+            "                <name>192.168.0.1</name>\n"
+            "              </interface>\n"
+            "              <interface>\n"
+            "                <name>192.168.0.12</name>\n"
+            "              </interface>\n"
+            "              <interface>\n"
+            "                <name>192.168.0.25</name>\n"
+            "              </interface>\n"
+            "            </interfaces>\n"
+            "          </area>\n"
+            "        </ospf>\n"
+            "      </protocols>\n"
+            "    </top>\n"
+            "  </data>\n"
+            "</get-config>\n";
+
+    /* the same filter twice, the second one is cached */
+    GET_CONFIG_FILTER(st, filter);
+    assert_string_equal(st->str, expected);
+    FREE_TEST_VARS(st);
+
+    GET_CONFIG_FILTER(st, filter);
+    assert_string_equal(st->str, expected);
+    FREE_TEST_VARS(st);
+
+    /* check the cache was hit */
+    GET_FILTER(st, "/netopeer2-server:server-stats/filter-cache");
+    assert_non_null(strstr(st->str, "<hits>"));
+    assert_null(strstr(st->str, "<hits>0</hits>"));
+
+    FREE_TEST_VARS(st);
+}
+
 int
 main(int argc, char **argv)
 {
@@ -877,6 +984,9 @@ main(int argc, char **argv)
         cmocka_unit_test(test_get_containment_node),
         cmocka_unit_test(test_get_content_match_node),
         cmocka_unit_test(test_get_operational_data),
+        cmocka_unit_test(test_get_monitoring_containers),
+        cmocka_unit_test(test_get_monitoring_predicate),
+        cmocka_unit_test(test_subtree_filter_cache),
     };
 
     nc_verbosity(NC_VERB_WARNING);
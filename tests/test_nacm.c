@@ -435,6 +435,45 @@ test_filter_key_list(void **state)
     FREE_TEST_VARS(st);
 }
 
+static void
+test_instance_rule_not_cached(void **state)
+{
+    struct np_test *st = *state;
+    const char *expected;
+
+    /* the rule does not match this instance, a decision for the schema node would permit reading any weight */
+    GET_CONFIG_FILTER(st, "/nacm-test2:people[name='John']");
+    expected =
+            "<get-config xmlns=\"urn:ietf:params:xml:ns:netconf:base:1.0\">\n"
+            "  <data>\n"
+            "    <people xmlns=\"urn:nt2\">\n"
+            "      <name>John</name>\n"
+            "      <weight>75</weight>\n"
+            "    </people>\n"
+            "  </data>\n"
+            "</get-config>\n";
+    assert_string_equal(st->str, expected);
+    FREE_TEST_VARS(st);
+
+    /* the decision for the weight of Arnold must still be made for the instance */
+    GET_CONFIG_FILTER(st, "/nacm-test2:people[name='Arnold']");
+    expected =
+            "<get-config xmlns=\"urn:ietf:params:xml:ns:netconf:base:1.0\">\n"
+            "  <data>\n"
+            "    <people xmlns=\"urn:nt2\">\n"
+            "      <name>Arnold</name>\n"
+            "    </people>\n"
+            "  </data>\n"
+            "</get-config>\n";
+    assert_string_equal(st->str, expected);
+    FREE_TEST_VARS(st);
+
+    /* and again for the weight of John */
+    GET_CONFIG_FILTER(st, "/nacm-test2:people[name='John']/weight");
+    assert_non_null(strstr(st->str, "<weight>75</weight>"));
+    FREE_TEST_VARS(st);
+}
+
 static int
 setup_test_rule_wildcard_groups(void **state)
 {
@@ -1133,6 +1172,9 @@ main(int argc, char **argv)
             cmocka_unit_test_setup_teardown(test_filter_key_list,
                     setup_test_filter_key_list,
                     teardown_common),
+            cmocka_unit_test_setup_teardown(test_instance_rule_not_cached,
+                    setup_test_filter_key_list,
+                    teardown_common),
             cmocka_unit_test_setup_teardown(test_rule_wildcard_groups,
                     setup_test_rule_wildcard_groups,
                     teardown_common),
@@ -1162,6 +1204,9 @@ main(int argc, char **argv)
             cmocka_unit_test_setup_teardown(test_filter_key_list,
                     setup_test_filter_key_list,
                     teardown_common),
+            cmocka_unit_test_setup_teardown(test_instance_rule_not_cached,
+                    setup_test_filter_key_list,
+                    teardown_common),
             cmocka_unit_test_setup_teardown(test_rule_wildcard_groups,
                     setup_test_rule_wildcard_groups,
                     teardown_common),
@@ -305,6 +305,24 @@ test_get(void **state)
     FREE_TEST_VARS(st);
 }
 
+static void
+test_get_filter_error(void **state)
+{
+    struct np_test *st = *state;
+
+    /* retrieval RPCs are executed directly by the server workers, an invalid filter must still fail with an error */
+    st->rpc = nc_rpc_getconfig(NC_DATASTORE_RUNNING, "/ietf-netconf-acm:nacm/rule-list[", NC_WD_ALL,
+            NC_PARAMTYPE_CONST);
+    st->msgtype = nc_send_rpc(st->nc_sess, st->rpc, 1000, &st->msgid);
+    assert_int_equal(NC_MSG_RPC, st->msgtype);
+    ASSERT_RPC_ERROR(st);
+
+    /* the error message of the failed retrieval is in the reply */
+    assert_int_equal(LY_SUCCESS, lyd_print_mem(&st->str, st->envp, LYD_XML, 0));
+    assert_non_null(strstr(st->str, "<error-message"));
+    FREE_TEST_VARS(st);
+}
+
 static void
 test_kill(void **state)
 {
@@ -418,6 +436,24 @@ test_validate(void **state)
     /* Functionality tested in test_candidate.c */
 }
 
+static void
+test_clear_user_cache(void **state)
+{
+    struct np_test *st = *state;
+
+    /* Drop the cached system users, allowed only for the recovery user */
+    st->rpc = nc_rpc_act_generic_xml("<clear-user-cache xmlns=\"urn:cesnet:netopeer2-server\"/>", NC_PARAMTYPE_CONST);
+    st->msgtype = nc_send_rpc(st->nc_sess, st->rpc, 1000, &st->msgid);
+    assert_int_equal(NC_MSG_RPC, st->msgtype);
+    if (is_nacm_rec_uid()) {
+        ASSERT_OK_REPLY(st);
+    } else {
+        ASSERT_RPC_ERROR(st);
+        assert_string_equal(lyd_get_value(lyd_child(lyd_child(st->envp))->next), "access-denied");
+    }
+    FREE_TEST_VARS(st);
+}
+
 int
 main(int argc, char **argv)
 {
@@ -428,11 +464,13 @@ main(int argc, char **argv)
         cmocka_unit_test_setup(test_unlock, setup_test_unlock),
         cmocka_unit_test_setup_teardown(test_unlock_fail, setup_test_unlock, teardown_test_unlock_fail),
         cmocka_unit_test(test_get),
+        cmocka_unit_test(test_get_filter_error),
         cmocka_unit_test(test_kill),
         cmocka_unit_test(test_commit),
         cmocka_unit_test(test_discard),
         cmocka_unit_test(test_getconfig),
         cmocka_unit_test(test_validate),
+        cmocka_unit_test(test_clear_user_cache),
     };
 
     nc_verbosity(NC_VERB_WARNING);
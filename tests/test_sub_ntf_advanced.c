@@ -31,6 +31,15 @@
 #include "np_test.h"
 #include "np_test_config.h"
 
+/* notification queue depth of the server */
+#define NP_TEST_QUEUE_DEPTH "16"
+
+/* size of a notification that fills the socket buffers with only a few of them */
+#define NP_TEST_LARGE_NOTIF_SIZE 65536
+
+/* number of large notifications sent to a reader that does not read */
+#define NP_TEST_LARGE_NOTIF_COUNT 64
+
 static int
 local_setup(void **state)
 {
@@ -54,8 +63,8 @@ local_setup(void **state)
     assert_int_equal(sr_install_module(conn, module2, NULL, NULL), SR_ERR_OK);
     assert_int_equal(sr_disconnect(conn), SR_ERR_OK);
 
-    /* setup netopeer2 server */
-    if (!(rv = np_glob_setup_np2(state, test_name))) {
+    /* setup netopeer2 server with a small notification queue that suspends the subscriptions of a slow reader */
+    if (!(rv = np_glob_setup_np2_arg(state, test_name, "-q" NP_TEST_QUEUE_DEPTH ":suspend"))) {
         /* state is allocated in np_glob_setup_np2 have to set here */
         st = *state;
         /* Open connection to start a sessions for the tests */
@@ -420,6 +429,8 @@ test_ds_subscriptions(void **state)
             "            <sent-event-records>0</sent-event-records>\n"
             "            <excluded-event-records>0</excluded-event-records>\n"
             "            <state>active</state>\n"
+            "            <queue-depth xmlns=\"urn:cesnet:netopeer2-server\">0</queue-depth>\n"
+            "            <dropped-event-records xmlns=\"urn:cesnet:netopeer2-server\">0</dropped-event-records>\n"
             "          </receiver>\n"
             "        </receivers>\n"
             "      </subscription>\n"
@@ -456,6 +467,8 @@ test_ds_subscriptions_sent_event(void **state)
             "            <sent-event-records>3</sent-event-records>\n"
             "            <excluded-event-records>0</excluded-event-records>\n"
             "            <state>active</state>\n"
+            "            <queue-depth xmlns=\"urn:cesnet:netopeer2-server\">0</queue-depth>\n"
+            "            <dropped-event-records xmlns=\"urn:cesnet:netopeer2-server\">0</dropped-event-records>\n"
             "          </receiver>\n"
             "        </receivers>\n"
             "      </subscription>\n"
@@ -504,6 +517,8 @@ test_ds_subscriptions_excluded_event(void **state)
             "            <sent-event-records>1</sent-event-records>\n"
             "            <excluded-event-records>1</excluded-event-records>\n"
             "            <state>active</state>\n"
+            "            <queue-depth xmlns=\"urn:cesnet:netopeer2-server\">0</queue-depth>\n"
+            "            <dropped-event-records xmlns=\"urn:cesnet:netopeer2-server\">0</dropped-event-records>\n"
             "          </receiver>\n"
             "        </receivers>\n"
             "      </subscription>\n"
@@ -560,6 +575,8 @@ test_multiple_subscriptions(void **state)
             "            <sent-event-records>0</sent-event-records>\n"
             "            <excluded-event-records>0</excluded-event-records>\n"
             "            <state>active</state>\n"
+            "            <queue-depth xmlns=\"urn:cesnet:netopeer2-server\">0</queue-depth>\n"
+            "            <dropped-event-records xmlns=\"urn:cesnet:netopeer2-server\">0</dropped-event-records>\n"
             "          </receiver>\n"
             "        </receivers>\n"
             "      </subscription>\n"
@@ -571,6 +588,8 @@ test_multiple_subscriptions(void **state)
             "            <sent-event-records>0</sent-event-records>\n"
             "            <excluded-event-records>0</excluded-event-records>\n"
             "            <state>active</state>\n"
+            "            <queue-depth xmlns=\"urn:cesnet:netopeer2-server\">0</queue-depth>\n"
+            "            <dropped-event-records xmlns=\"urn:cesnet:netopeer2-server\">0</dropped-event-records>\n"
             "          </receiver>\n"
             "        </receivers>\n"
             "      </subscription>\n"
@@ -615,6 +634,8 @@ test_multiple_subscriptions_notif(void **state)
             "            <sent-event-records>1</sent-event-records>\n"
             "            <excluded-event-records>0</excluded-event-records>\n"
             "            <state>active</state>\n"
+            "            <queue-depth xmlns=\"urn:cesnet:netopeer2-server\">0</queue-depth>\n"
+            "            <dropped-event-records xmlns=\"urn:cesnet:netopeer2-server\">0</dropped-event-records>\n"
             "          </receiver>\n"
             "        </receivers>\n"
             "      </subscription>\n"
@@ -626,6 +647,8 @@ test_multiple_subscriptions_notif(void **state)
             "            <sent-event-records>1</sent-event-records>\n"
             "            <excluded-event-records>0</excluded-event-records>\n"
             "            <state>active</state>\n"
+            "            <queue-depth xmlns=\"urn:cesnet:netopeer2-server\">0</queue-depth>\n"
+            "            <dropped-event-records xmlns=\"urn:cesnet:netopeer2-server\">0</dropped-event-records>\n"
             "          </receiver>\n"
             "        </receivers>\n"
             "      </subscription>\n"
@@ -637,6 +660,8 @@ test_multiple_subscriptions_notif(void **state)
             "            <sent-event-records>1</sent-event-records>\n"
             "            <excluded-event-records>0</excluded-event-records>\n"
             "            <state>active</state>\n"
+            "            <queue-depth xmlns=\"urn:cesnet:netopeer2-server\">0</queue-depth>\n"
+            "            <dropped-event-records xmlns=\"urn:cesnet:netopeer2-server\">0</dropped-event-records>\n"
             "          </receiver>\n"
             "        </receivers>\n"
             "      </subscription>\n"
@@ -988,6 +1013,97 @@ test_killsub_diff_sess(void **state)
     nc_session_free(tmp, NULL);
 }
 
+static void
+send_large_notifs(struct np_test *st)
+{
+    const char *start = "<n1 xmlns=\"n1\"><first>", *end = "</first></n1>";
+    char *data;
+    uint32_t i;
+
+    /* the writer blocks on the full socket of a session that is not read from so its queue overflows */
+    data = malloc(strlen(start) + NP_TEST_LARGE_NOTIF_SIZE + strlen(end) + 1);
+    assert_non_null(data);
+    strcpy(data, start);
+    memset(data + strlen(start), 'x', NP_TEST_LARGE_NOTIF_SIZE);
+    strcpy(data + strlen(start) + NP_TEST_LARGE_NOTIF_SIZE, end);
+    NOTIF_PARSE(st, data);
+    free(data);
+
+    for (i = 0; i < NP_TEST_LARGE_NOTIF_COUNT; ++i) {
+        assert_int_equal(sr_event_notif_send_tree(st->sr_sess, st->node, 1000, 1), SR_ERR_OK);
+    }
+    FREE_TEST_VARS(st);
+}
+
+static void
+test_queue_overflow_suspend(void **state)
+{
+    struct np_test *st = *state;
+    uint32_t i, received = 0;
+    int suspended = 0, resumed = 0;
+
+    SEND_RPC_ESTABSUB(st, "<n1 xmlns=\"n1\"/>", "notif1", NULL, NULL);
+    ASSERT_OK_SUB_NTF(st);
+    FREE_TEST_VARS(st);
+
+    send_large_notifs(st);
+
+    /* read everything, the subscription is suspended and resumed once the queue is half-empty */
+    for (i = 0; !resumed && (i < NP_TEST_LARGE_NOTIF_COUNT + 2); ++i) {
+        RECV_NOTIF(st);
+        if (!strcmp(LYD_NAME(st->op), "n1")) {
+            /* no notifications are received while suspended */
+            assert_int_equal(suspended, 0);
+            ++received;
+        } else if (!strcmp(LYD_NAME(st->op), "subscription-suspended")) {
+            assert_non_null(strstr(st->str, "insufficient-resources"));
+            suspended = 1;
+        } else if (!strcmp(LYD_NAME(st->op), "subscription-resumed")) {
+            assert_int_equal(suspended, 1);
+            resumed = 1;
+        }
+        FREE_TEST_VARS(st);
+    }
+    assert_int_equal(suspended, 1);
+    assert_int_equal(resumed, 1);
+    assert_true(received < NP_TEST_LARGE_NOTIF_COUNT);
+
+    /* notifications are sent again */
+    NOTIF_PARSE(st, "<n1 xmlns=\"n1\"><first>Test</first></n1>");
+    assert_int_equal(sr_event_notif_send_tree(st->sr_sess, st->node, 1000, 1), SR_ERR_OK);
+    RECV_NOTIF(st);
+    assert_string_equal(LYD_NAME(st->op), "n1");
+    FREE_TEST_VARS(st);
+}
+
+static void
+test_queue_overflow_close(void **state)
+{
+    struct np_test *st = *state;
+
+    SEND_RPC_ESTABSUB(st, "<n1 xmlns=\"n1\"/>", "notif1", NULL, NULL);
+    ASSERT_OK_SUB_NTF(st);
+    FREE_TEST_VARS(st);
+
+    send_large_notifs(st);
+
+    /* close the session with a full queue and a writer blocked on it */
+    nc_session_free(st->nc_sess, NULL);
+    st->nc_sess = nc_connect_unix(st->socket_path, NULL);
+    assert_non_null(st->nc_sess);
+
+    /* the server keeps sending notifications to other sessions */
+    SEND_RPC_ESTABSUB(st, "<n1 xmlns=\"n1\"/>", "notif1", NULL, NULL);
+    ASSERT_OK_SUB_NTF(st);
+    FREE_TEST_VARS(st);
+
+    NOTIF_PARSE(st, "<n1 xmlns=\"n1\"><first>Test</first></n1>");
+    assert_int_equal(sr_event_notif_send_tree(st->sr_sess, st->node, 1000, 1), SR_ERR_OK);
+    RECV_NOTIF(st);
+    assert_string_equal(LYD_NAME(st->op), "n1");
+    FREE_TEST_VARS(st);
+}
+
 int
 main(int argc, char **argv)
 {
@@ -1010,6 +1126,8 @@ main(int argc, char **argv)
         cmocka_unit_test_setup_teardown(test_killsub_fail_no_such_sub, setup_test_killsub, teardown_nacm),
         cmocka_unit_test_setup_teardown(test_killsub_same_sess, setup_test_killsub, teardown_nacm),
         cmocka_unit_test_setup_teardown(test_killsub_diff_sess, setup_test_killsub, teardown_nacm),
+        cmocka_unit_test_teardown(test_queue_overflow_suspend, teardown_common),
+        cmocka_unit_test_teardown(test_queue_overflow_close, teardown_common),
     };
 
     nc_verbosity(NC_VERB_WARNING);